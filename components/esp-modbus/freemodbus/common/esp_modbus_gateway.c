@@ -0,0 +1,501 @@
+/*
+ * SPDX-FileCopyrightText: 2016-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdlib.h>             // for calloc/free
+#include <string.h>             // for memcpy
+#include "esp_err.h"            // for esp_err_t
+#include "esp_timer.h"          // for the queue wait and bus time
+#include "freertos/FreeRTOS.h"  // for task and semaphore api access
+#include "freertos/semphr.h"    // for the stop semaphore
+#include "esp_modbus_master.h"  // for the serial master interface
+#include "esp_modbus_gateway.h" // for public interface defines
+#include "port.h"               // for task affinity and port options
+#include "mb.h"                 // for function and exception codes
+#include "mb_m.h"               // for the exception of the slave response
+#include "mbframe.h"            // for MBAP header fields
+
+static const char TAG[] __attribute__((unused)) = "MB_CONTROLLER_GATEWAY";
+
+#if MB_TCP_GATEWAY_ENABLED
+
+#include "port_tcp_slave.h"     // for the frames of the TCP slave port
+
+#define MB_GATEWAY_PROTOCOL_ID      (0)     // 0 = Modbus Protocol
+#define MB_GATEWAY_DATA_SIZE        (256)   // Holds the data of the largest request or response
+#define MB_GATEWAY_UID_MAX          (247)   // Highest address of a serial slave
+#define MB_GATEWAY_SERIAL_OVERHEAD  (3)     // Address and CRC of a RTU frame
+// Bus bytes a client can use in its turn, not less than the cost of the largest request
+#define MB_GATEWAY_QUANTUM          (2 * (MB_PDU_SIZE_MAX + MB_GATEWAY_SERIAL_OVERHEAD))
+
+// Request waiting for the serial bus
+typedef struct mb_gateway_req_s {
+    struct mb_gateway_req_s* next;
+    mb_param_request_t request;
+    uint8_t data[MB_GATEWAY_DATA_SIZE] __attribute__((aligned(2)));
+    uint16_t client_id;
+    uint32_t conn_id;
+    uint16_t tid;
+    uint16_t cost;                      // serial bus bytes of the request and its response
+    int64_t queued_us;
+} mb_gateway_req_t;
+
+// Queue of a client slot of the TCP slave port
+typedef struct {
+    mb_gateway_req_t* head;
+    mb_gateway_req_t* tail;
+    uint16_t count;
+    int32_t deficit;                    // bus bytes left in the turn of the client
+} mb_gateway_client_t;
+
+typedef struct {
+    mb_gateway_req_t* reqs;
+    mb_gateway_req_t* free_reqs;
+    mb_gateway_client_t clients[MB_TCP_PORT_MAX_CONN];
+    uint16_t ready[MB_TCP_PORT_MAX_CONN]; // ring of the clients with waiting requests
+    uint16_t ready_head;
+    uint16_t ready_count;
+    portMUX_TYPE lock;
+    TaskHandle_t task_handle;
+    SemaphoreHandle_t stop_sema;        // set by mbc_gateway_stop(), given by the task when it exits
+    void* master_handler;
+    int64_t start_us;
+    uint64_t wait_total_us;
+    mb_gateway_stats_t stats;
+} mb_gateway_t;
+
+static mb_gateway_t mb_gateway = { .lock = portMUX_INITIALIZER_UNLOCKED };
+
+// Serial bus bytes of the request and its expected response
+static uint16_t mbc_gateway_req_cost(const mb_param_request_t* request, uint16_t pdu_len)
+{
+    uint16_t resp_len = 5;  // echo of the address and the value or the quantity of a write
+    switch (request->command) {
+        case MB_FUNC_READ_COILS:
+        case MB_FUNC_READ_DISCRETE_INPUTS:
+            resp_len = 2 + ((request->reg_size + 7) >> 3);
+            break;
+        case MB_FUNC_READ_HOLDING_REGISTER:
+        case MB_FUNC_READ_INPUT_REGISTER:
+            resp_len = 2 + (request->reg_size << 1);
+            break;
+        default:
+            break;
+    }
+    return pdu_len + resp_len + 2 * MB_GATEWAY_SERIAL_OVERHEAD;
+}
+
+// Converts the request PDU to a master request, returns the exception code if the request
+// can not be forwarded
+static uint8_t mbc_gateway_parse(mb_gateway_req_t* req, uint8_t uid, const uint8_t* pdu, uint16_t pdu_len)
+{
+    if ((uid == 0) || (uid > MB_GATEWAY_UID_MAX)) {
+        return MB_EX_GATEWAY_PATH_FAILED;
+    }
+    uint8_t command = pdu[0];
+    if ((command != MB_FUNC_READ_COILS) && (command != MB_FUNC_READ_DISCRETE_INPUTS)
+            && (command != MB_FUNC_READ_HOLDING_REGISTER) && (command != MB_FUNC_READ_INPUT_REGISTER)
+            && (command != MB_FUNC_WRITE_SINGLE_COIL) && (command != MB_FUNC_WRITE_REGISTER)
+            && (command != MB_FUNC_WRITE_MULTIPLE_COILS) && (command != MB_FUNC_WRITE_MULTIPLE_REGISTERS)) {
+        return MB_EX_ILLEGAL_FUNCTION;
+    }
+    if (pdu_len < 5) {
+        return MB_EX_ILLEGAL_DATA_VALUE;
+    }
+    uint16_t value = (uint16_t)((pdu[3] << 8) | pdu[4]);
+    req->request.slave_addr = uid;
+    req->request.command = command;
+    req->request.reg_start = (uint16_t)((pdu[1] << 8) | pdu[2]);
+    req->request.reg_size = value;
+    switch (command) {
+        case MB_FUNC_READ_COILS:
+        case MB_FUNC_READ_DISCRETE_INPUTS:
+            if ((pdu_len != 5) || (value < 1) || (value > 2000)) {
+                return MB_EX_ILLEGAL_DATA_VALUE;
+            }
+            break;
+        case MB_FUNC_READ_HOLDING_REGISTER:
+        case MB_FUNC_READ_INPUT_REGISTER:
+            if ((pdu_len != 5) || (value < 1) || (value > 125)) {
+                return MB_EX_ILLEGAL_DATA_VALUE;
+            }
+            break;
+        case MB_FUNC_WRITE_SINGLE_COIL:
+            if ((pdu_len != 5) || ((value != 0xFF00) && (value != 0x0000))) {
+                return MB_EX_ILLEGAL_DATA_VALUE;
+            }
+            // fall through
+        case MB_FUNC_WRITE_REGISTER:
+            if (pdu_len != 5) {
+                return MB_EX_ILLEGAL_DATA_VALUE;
+            }
+            *(uint16_t*)req->data = value;
+            req->request.reg_size = 1;
+            break;
+        case MB_FUNC_WRITE_MULTIPLE_COILS:
+            if ((pdu_len < 6) || (value < 1) || (value > 1968)
+                    || (pdu[5] != ((value + 7) >> 3)) || (pdu_len != (6 + pdu[5]))) {
+                return MB_EX_ILLEGAL_DATA_VALUE;
+            }
+            memcpy(req->data, &pdu[6], pdu[5]);
+            break;
+        case MB_FUNC_WRITE_MULTIPLE_REGISTERS:
+            if ((pdu_len < 6) || (value < 1) || (value > 123)
+                    || (pdu[5] != (value << 1)) || (pdu_len != (6 + pdu[5]))) {
+                return MB_EX_ILLEGAL_DATA_VALUE;
+            }
+            // The master takes the register values in host byte order
+            for (uint16_t i = 0; i < value; i++) {
+                ((uint16_t*)req->data)[i] = (uint16_t)((pdu[6 + 2 * i] << 8) | pdu[7 + 2 * i]);
+            }
+            break;
+        default:
+            break;
+    }
+    req->cost = mbc_gateway_req_cost(&req->request, pdu_len);
+    return MB_EX_NONE;
+}
+
+// Builds the response PDU of a completed request, returns its length
+static uint16_t mbc_gateway_response(const mb_gateway_req_t* req, uint8_t* pdu)
+{
+    const mb_param_request_t* request = &req->request;
+    uint16_t len = 0;
+    pdu[len++] = request->command;
+    switch (request->command) {
+        case MB_FUNC_READ_COILS:
+        case MB_FUNC_READ_DISCRETE_INPUTS:
+            pdu[len++] = (uint8_t)((request->reg_size + 7) >> 3);
+            memcpy(&pdu[len], req->data, pdu[1]);
+            len += pdu[1];
+            break;
+        case MB_FUNC_READ_HOLDING_REGISTER:
+        case MB_FUNC_READ_INPUT_REGISTER:
+            pdu[len++] = (uint8_t)(request->reg_size << 1);
+            for (uint16_t i = 0; i < request->reg_size; i++) {
+                uint16_t value = ((const uint16_t*)req->data)[i];
+                pdu[len++] = (uint8_t)(value >> 8);
+                pdu[len++] = (uint8_t)(value & 0xFF);
+            }
+            break;
+        default: {
+            // Writes return the address and the written value or the quantity
+            uint16_t value = ((request->command == MB_FUNC_WRITE_SINGLE_COIL)
+                                || (request->command == MB_FUNC_WRITE_REGISTER))
+                                ? *(const uint16_t*)req->data : request->reg_size;
+            pdu[len++] = (uint8_t)(request->reg_start >> 8);
+            pdu[len++] = (uint8_t)(request->reg_start & 0xFF);
+            pdu[len++] = (uint8_t)(value >> 8);
+            pdu[len++] = (uint8_t)(value & 0xFF);
+            break;
+        }
+    }
+    return len;
+}
+
+// Maps the error of the master to the exception sent to the client. The exception
+// response of the slave is forwarded as is, the gateway reports a target failure only
+// if the slave did not answer or is skipped by the breaker after its timeouts.
+// Must be called from the task bound to the master instance which sent the request.
+static uint8_t mbc_gateway_get_exception(esp_err_t error)
+{
+    eMBException exception = MB_EX_NONE;
+    switch (error) {
+        case ESP_ERR_TIMEOUT:
+        case ESP_ERR_NOT_ALLOWED:
+            return MB_EX_GATEWAY_TGT_FAILED;
+        case ESP_ERR_INVALID_RESPONSE:
+            exception = eMBMasterGetException();
+            return (exception != MB_EX_NONE) ? (uint8_t)exception : MB_EX_SLAVE_DEVICE_FAILURE;
+        case ESP_ERR_NOT_SUPPORTED:
+            return MB_EX_ILLEGAL_DATA_ADDRESS;
+        case ESP_ERR_INVALID_STATE:
+            return MB_EX_SLAVE_BUSY;
+        default:
+            return MB_EX_SLAVE_DEVICE_FAILURE;
+    }
+}
+
+static void mbc_gateway_send(uint16_t client_id, uint32_t conn_id, uint16_t tid, uint8_t uid,
+                                uint8_t* frame, uint16_t pdu_len)
+{
+    frame[MB_TCP_TID] = (uint8_t)(tid >> 8);
+    frame[MB_TCP_TID + 1] = (uint8_t)(tid & 0xFF);
+    frame[MB_TCP_PID] = 0;
+    frame[MB_TCP_PID + 1] = MB_GATEWAY_PROTOCOL_ID;
+    frame[MB_TCP_LEN] = (uint8_t)((pdu_len + 1) >> 8);
+    frame[MB_TCP_LEN + 1] = (uint8_t)((pdu_len + 1) & 0xFF);
+    frame[MB_TCP_UID] = uid;
+    (void)xMBTCPPortSendTo(client_id, conn_id, frame, MB_TCP_FUNC + pdu_len);
+}
+
+static void mbc_gateway_send_exception(uint16_t client_id, uint32_t conn_id, uint16_t tid, uint8_t uid,
+                                        uint8_t command, uint8_t exception)
+{
+    uint8_t frame[MB_TCP_FUNC + 2];
+    frame[MB_TCP_FUNC] = command | MB_FUNC_ERROR;
+    frame[MB_TCP_FUNC + 1] = exception;
+    mbc_gateway_send(client_id, conn_id, tid, uid, frame, 2);
+}
+
+// Must be called with the lock held
+static void mbc_gateway_ready_push(mb_gateway_t* gw, uint16_t client_id)
+{
+    gw->ready[(gw->ready_head + gw->ready_count) % MB_TCP_PORT_MAX_CONN] = client_id;
+    gw->ready_count++;
+}
+
+// Must be called with the lock held. Takes the next request by deficit round robin over
+// the clients with waiting requests: each client sends requests for up to MB_GATEWAY_QUANTUM
+// bus bytes in its turn, so the bus time is shared evenly whatever the request sizes are.
+static mb_gateway_req_t* mbc_gateway_next_req(mb_gateway_t* gw)
+{
+    while (gw->ready_count) {
+        uint16_t client_id = gw->ready[gw->ready_head];
+        mb_gateway_client_t* client = &gw->clients[client_id];
+        mb_gateway_req_t* req = client->head;
+        gw->ready_head = (gw->ready_head + 1) % MB_TCP_PORT_MAX_CONN;
+        gw->ready_count--;
+        if (client->deficit < req->cost) {
+            // The turn is over, the client gets its next quantum at the end of the ring
+            client->deficit += MB_GATEWAY_QUANTUM;
+            mbc_gateway_ready_push(gw, client_id);
+            continue;
+        }
+        client->deficit -= req->cost;
+        client->head = req->next;
+        client->count--;
+        gw->stats.queued--;
+        if (client->count) {
+            // The turn of the client continues with its next request
+            gw->ready_head = (gw->ready_head + MB_TCP_PORT_MAX_CONN - 1) % MB_TCP_PORT_MAX_CONN;
+            gw->ready[gw->ready_head] = client_id;
+            gw->ready_count++;
+        } else {
+            client->tail = NULL;
+            client->deficit = 0;
+        }
+        return req;
+    }
+    return NULL;
+}
+
+// Receives the requests from the server task of the TCP slave port
+static void mbc_gateway_frame(USHORT client_id, ULONG conn_id, UCHAR* frame, USHORT length)
+{
+    mb_gateway_t* gw = &mb_gateway;
+    // The port checked the length field of the MBAP header
+    uint16_t tid = MB_TCP_GET_FIELD(frame, MB_TCP_TID);
+    if (MB_TCP_GET_FIELD(frame, MB_TCP_PID) != MB_GATEWAY_PROTOCOL_ID) {
+        return;
+    }
+    uint8_t uid = frame[MB_TCP_UID];
+    uint8_t* pdu = &frame[MB_TCP_FUNC];
+    uint16_t pdu_len = length - MB_TCP_FUNC;
+
+    portENTER_CRITICAL(&gw->lock);
+    mb_gateway_client_t* client = &gw->clients[client_id];
+    mb_gateway_req_t* req = NULL;
+    if ((client->count < MB_TCP_GATEWAY_CLIENT_DEPTH) && gw->free_reqs) {
+        req = gw->free_reqs;
+        gw->free_reqs = req->next;
+    }
+    portEXIT_CRITICAL(&gw->lock);
+
+    uint8_t exception = MB_EX_SLAVE_BUSY;
+    if (req) {
+        exception = mbc_gateway_parse(req, uid, pdu, pdu_len);
+        req->next = NULL;
+        req->client_id = client_id;
+        req->conn_id = conn_id;
+        req->tid = tid;
+        req->queued_us = esp_timer_get_time();
+    }
+
+    portENTER_CRITICAL(&gw->lock);
+    if (req && (exception == MB_EX_NONE)) {
+        if (client->tail) {
+            client->tail->next = req;
+        } else {
+            client->head = req;
+            client->deficit = MB_GATEWAY_QUANTUM;
+            mbc_gateway_ready_push(gw, client_id);
+        }
+        client->tail = req;
+        client->count++;
+        if (++gw->stats.queued > gw->stats.queued_max) {
+            gw->stats.queued_max = gw->stats.queued;
+        }
+    } else if (req) {
+        req->next = gw->free_reqs;
+        gw->free_reqs = req;
+        gw->stats.rejected++;
+    } else {
+        gw->stats.busy++;
+    }
+    portEXIT_CRITICAL(&gw->lock);
+
+    if (exception == MB_EX_NONE) {
+        xTaskNotifyGive(gw->task_handle);
+    } else {
+        ESP_LOGD(TAG, "Client %u, TID 0x%x, unit %u, exception 0x%x.",
+                    (unsigned)client_id, (unsigned)tid, (unsigned)uid, (unsigned)exception);
+        mbc_gateway_send_exception(client_id, conn_id, tid, uid, pdu[0], exception);
+    }
+}
+
+static void mbc_gateway_forward(mb_gateway_t* gw, mb_gateway_req_t* req)
+{
+    int64_t start_us = esp_timer_get_time();
+    uint32_t wait_us = (uint32_t)(start_us - req->queued_us);
+    esp_err_t error = mbc_master_send_request(&req->request, req->data);
+    int64_t end_us = esp_timer_get_time();
+
+    uint8_t frame[MB_TCP_FUNC + MB_PDU_SIZE_MAX];
+    uint16_t pdu_len = 0;
+    if (error == ESP_OK) {
+        pdu_len = mbc_gateway_response(req, &frame[MB_TCP_FUNC]);
+    } else {
+        frame[MB_TCP_FUNC] = req->request.command | MB_FUNC_ERROR;
+        frame[MB_TCP_FUNC + 1] = mbc_gateway_get_exception(error);
+        pdu_len = 2;
+    }
+    mbc_gateway_send(req->client_id, req->conn_id, req->tid, req->request.slave_addr, frame, pdu_len);
+
+    portENTER_CRITICAL(&gw->lock);
+    gw->stats.requests++;
+    if (error != ESP_OK) {
+        gw->stats.exceptions++;
+    }
+    gw->wait_total_us += wait_us;
+    if (wait_us > gw->stats.wait_max_us) {
+        gw->stats.wait_max_us = wait_us;
+    }
+    gw->stats.bus_busy_us += (uint64_t)(end_us - start_us);
+    portEXIT_CRITICAL(&gw->lock);
+}
+
+// Sends the waiting requests to the serial bus one after the other. The task exits
+// between two requests once mbc_gateway_stop() sets the stop semaphore.
+static void mbc_gateway_task(void* arg)
+{
+    mb_gateway_t* gw = (mb_gateway_t*)arg;
+    if (gw->master_handler) {
+        (void)mbc_master_select(gw->master_handler);
+    }
+    SemaphoreHandle_t stop_sema = NULL;
+    while (!stop_sema) {
+        (void)ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        for (;;) {
+            portENTER_CRITICAL(&gw->lock);
+            stop_sema = gw->stop_sema;
+            mb_gateway_req_t* req = stop_sema ? NULL : mbc_gateway_next_req(gw);
+            portEXIT_CRITICAL(&gw->lock);
+            if (!req) {
+                break;
+            }
+            if (xMBTCPPortClientActive(req->client_id, req->conn_id)) {
+                mbc_gateway_forward(gw, req);
+            } else {
+                // Nobody waits for the response
+                portENTER_CRITICAL(&gw->lock);
+                gw->stats.dropped++;
+                portEXIT_CRITICAL(&gw->lock);
+            }
+            portENTER_CRITICAL(&gw->lock);
+            req->next = gw->free_reqs;
+            gw->free_reqs = req;
+            portEXIT_CRITICAL(&gw->lock);
+        }
+    }
+    xSemaphoreGive(stop_sema);
+    vTaskDelete(NULL);
+}
+#endif
+
+esp_err_t mbc_gateway_start(void* master_handler)
+{
+#if MB_TCP_GATEWAY_ENABLED
+    mb_gateway_t* gw = &mb_gateway;
+    MB_GATEWAY_CHECK((gw->task_handle == NULL), ESP_ERR_INVALID_STATE, "mb gateway is already started.");
+    gw->reqs = calloc(MB_TCP_GATEWAY_QUEUE_SIZE, sizeof(mb_gateway_req_t));
+    MB_GATEWAY_CHECK((gw->reqs != NULL), ESP_ERR_NO_MEM, "mb gateway queue allocation failure.");
+    gw->free_reqs = NULL;
+    for (int i = MB_TCP_GATEWAY_QUEUE_SIZE - 1; i >= 0; i--) {
+        gw->reqs[i].next = gw->free_reqs;
+        gw->free_reqs = &gw->reqs[i];
+    }
+    memset(gw->clients, 0, sizeof(gw->clients));
+    memset(&gw->stats, 0, sizeof(gw->stats));
+    gw->ready_head = 0;
+    gw->ready_count = 0;
+    gw->wait_total_us = 0;
+    gw->stop_sema = NULL;
+    gw->master_handler = master_handler;
+    gw->start_us = esp_timer_get_time();
+    BaseType_t status = xTaskCreatePinnedToCore(mbc_gateway_task, "mbc_gateway",
+                                                MB_CONTROLLER_STACK_SIZE, gw,
+                                                MB_CONTROLLER_PRIORITY, &gw->task_handle,
+                                                MB_PORT_TASK_AFFINITY);
+    if (status != pdPASS) {
+        free(gw->reqs);
+        gw->reqs = NULL;
+        gw->task_handle = NULL;
+    }
+    MB_GATEWAY_CHECK((status == pdPASS), ESP_ERR_NO_MEM,
+                    "mb gateway task creation error, xTaskCreate() returns (0x%x).", (int)status);
+    vMBTCPPortSetFrameCB(mbc_gateway_frame);
+    return ESP_OK;
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+esp_err_t mbc_gateway_stop(void)
+{
+#if MB_TCP_GATEWAY_ENABLED
+    mb_gateway_t* gw = &mb_gateway;
+    MB_GATEWAY_CHECK((gw->task_handle != NULL), ESP_ERR_INVALID_STATE, "mb gateway is not started.");
+    SemaphoreHandle_t stop_sema = xSemaphoreCreateBinary();
+    MB_GATEWAY_CHECK((stop_sema != NULL), ESP_ERR_NO_MEM, "mb gateway stop semaphore allocation failure.");
+    // The requests received from now on go to the slave stack again, no frame
+    // callback is running once the callback is cleared
+    vMBTCPPortSetFrameCB(NULL);
+    // Let the task finish the request it is sending and wait until it exits
+    portENTER_CRITICAL(&gw->lock);
+    gw->stop_sema = stop_sema;
+    portEXIT_CRITICAL(&gw->lock);
+    xTaskNotifyGive(gw->task_handle);
+    (void)xSemaphoreTake(stop_sema, portMAX_DELAY);
+    vSemaphoreDelete(stop_sema);
+    gw->stop_sema = NULL;
+    gw->task_handle = NULL;
+    free(gw->reqs);
+    gw->reqs = NULL;
+    gw->free_reqs = NULL;
+    return ESP_OK;
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+esp_err_t mbc_gateway_get_stats(mb_gateway_stats_t* stats)
+{
+#if MB_TCP_GATEWAY_ENABLED
+    mb_gateway_t* gw = &mb_gateway;
+    MB_GATEWAY_CHECK((stats != NULL), ESP_ERR_INVALID_ARG, "mb incorrect stats pointer.");
+    MB_GATEWAY_CHECK((gw->task_handle != NULL), ESP_ERR_INVALID_STATE, "mb gateway is not started.");
+    portENTER_CRITICAL(&gw->lock);
+    *stats = gw->stats;
+    uint64_t wait_total_us = gw->wait_total_us;
+    portEXIT_CRITICAL(&gw->lock);
+    stats->wait_avg_us = stats->requests ? (uint32_t)(wait_total_us / stats->requests) : 0;
+    stats->uptime_us = (uint64_t)(esp_timer_get_time() - gw->start_us);
+    stats->bus_utilisation = stats->uptime_us ? (uint8_t)((stats->bus_busy_us * 100) / stats->uptime_us) : 0;
+    return ESP_OK;
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
@@ -0,0 +1,947 @@
+/*
+ * SPDX-FileCopyrightText: 2016-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdlib.h>             // for calloc/free
+#include "esp_err.h"            // for esp_err_t
+#include "mbc_master.h"         // for master interface define
+#include "esp_modbus_master.h"  // for public interface defines
+#include "esp_modbus_callbacks.h"   // for callback functions
+#include "port.h"               // for task affinity of the submit worker
+#include "esp_timer.h"          // for the probe time of skipped slaves
+#include "freertos/semphr.h"    // for the stop semaphore of the submit worker
+
+static const char TAG[] __attribute__((unused)) = "MB_CONTROLLER_MASTER";
+
+// This file implements public API for Modbus master controller.
+// These functions are wrappers for interface functions of the controller
+static mb_master_interface_t* master_interfaces[MB_MASTER_INSTANCES] = { NULL };
+
+// Interface of the master instance selected by the calling task
+#define MB_MASTER_IFACE() (master_interfaces[ucMBMasterPortGetInstance()])
+
+void mbc_master_init_iface(void* handler)
+{
+    mb_master_interface_t* iface = (mb_master_interface_t*) handler;
+    master_interfaces[iface->opts.mbm_instance] = iface;
+    // The task which initializes the controller continues to use it
+    (void)xMBMasterPortBindTask(NULL, iface->opts.mbm_instance);
+}
+
+esp_err_t mbc_master_select(void* handler)
+{
+    mb_master_interface_t* iface = (mb_master_interface_t*) handler;
+    MB_MASTER_CHECK((iface != NULL), ESP_ERR_INVALID_ARG, "mb incorrect handler.");
+    MB_MASTER_CHECK((iface->opts.mbm_instance < MB_MASTER_INSTANCES)
+                        && (master_interfaces[iface->opts.mbm_instance] == iface),
+                    ESP_ERR_INVALID_STATE,
+                    "Master interface is not correctly initialized.");
+    (void)xMBMasterPortBindTask(NULL, iface->opts.mbm_instance);
+    return ESP_OK;
+}
+
+void mbc_master_unselect(void)
+{
+    vMBMasterPortUnbindTask(NULL);
+}
+
+// FNV-1a hash of the parameter key
+static uint32_t mbc_master_key_hash(const char* key)
+{
+    uint32_t hash = 2166136261UL;
+    while (*key) {
+        hash = (hash ^ (uint8_t)*key++) * 16777619UL;
+    }
+    return hash;
+}
+
+// The index is an open addressing table with linear probing and at least
+// twice as many slots as characteristics, so a lookup checks one or two slots.
+esp_err_t mbc_master_build_key_index(mb_master_options_t* mbm_opts)
+{
+    mbc_master_free_key_index(mbm_opts);
+    size_t slots = 2;
+    while (slots < (mbm_opts->mbm_param_descriptor_size * 2)) {
+        slots <<= 1;
+    }
+    MB_MASTER_CHECK((slots <= 0x10000), ESP_ERR_INVALID_SIZE, "mb descriptor table is too large.");
+    uint16_t* index = calloc(slots, sizeof(uint16_t));
+    MB_MASTER_CHECK((index != NULL), ESP_ERR_NO_MEM, "mb key index allocation failure.");
+    const mb_parameter_descriptor_t* table = mbm_opts->mbm_param_descriptor_table;
+    for (uint16_t cid = 0; cid < mbm_opts->mbm_param_descriptor_size; cid++) {
+        size_t slot = mbc_master_key_hash(table[cid].param_key) & (slots - 1);
+        while (index[slot]) {
+            if (strcmp(table[index[slot] - 1].param_key, table[cid].param_key) == 0) {
+                break; // duplicate key, the first characteristic keeps the name as before
+            }
+            slot = (slot + 1) & (slots - 1);
+        }
+        if (!index[slot]) {
+            index[slot] = cid + 1;
+        }
+    }
+    mbm_opts->mbm_param_key_index = index;
+    mbm_opts->mbm_param_key_index_mask = (uint16_t)(slots - 1);
+    return ESP_OK;
+}
+
+void mbc_master_free_key_index(mb_master_options_t* mbm_opts)
+{
+    free(mbm_opts->mbm_param_key_index);
+    mbm_opts->mbm_param_key_index = NULL;
+    mbm_opts->mbm_param_key_index_mask = 0;
+}
+
+const mb_parameter_descriptor_t* mbc_master_find_param(const mb_master_options_t* mbm_opts,
+                                                        uint16_t cid, const char* name)
+{
+    const mb_parameter_descriptor_t* table = mbm_opts->mbm_param_descriptor_table;
+    // The caller usually passes the key that belongs to the cid
+    if ((cid < mbm_opts->mbm_param_descriptor_size) && (strcmp(table[cid].param_key, name) == 0)) {
+        return &table[cid];
+    }
+    const uint16_t* index = mbm_opts->mbm_param_key_index;
+    if (!index) {
+        return NULL;
+    }
+    size_t slot = mbc_master_key_hash(name) & mbm_opts->mbm_param_key_index_mask;
+    while (index[slot]) {
+        if (strcmp(table[index[slot] - 1].param_key, name) == 0) {
+            return &table[index[slot] - 1];
+        }
+        slot = (slot + 1) & mbm_opts->mbm_param_key_index_mask;
+    }
+    return NULL;
+}
+
+#if MB_MASTER_BREAKER_ENABLED
+// Health of one slave address
+typedef struct {
+    uint8_t state;                      // mb_slave_health_t
+    uint8_t failures;                   // consecutive requests without response
+    uint8_t backoff_shift;              // an open circuit waits MIN_MS << backoff_shift
+    uint32_t retry_ms;                  // time of the next probe of an open circuit
+} mb_master_health_entry_t;
+
+// Health of the slaves of one master instance indexed by the slave address
+typedef struct {
+    mb_master_health_entry_t slaves[MB_MASTER_TOTAL_SLAVE_NUM + 1];
+    portMUX_TYPE lock;
+    mb_master_health_cb_t cb;
+    void* cb_arg;
+} mb_master_health_t;
+
+static mb_master_health_t mbm_health[MB_MASTER_INSTANCES] = {
+    [0 ... MB_MASTER_INSTANCES - 1] = { .lock = portMUX_INITIALIZER_UNLOCKED }
+};
+
+static uint32_t mbc_master_health_time_ms(void)
+{
+    return (uint32_t)(esp_timer_get_time() / 1000);
+}
+
+static void mbc_master_health_report(mb_master_health_t* health, uint8_t slave_addr,
+                                        mb_slave_health_t old_state, mb_slave_health_t new_state)
+{
+    mb_master_health_cb_t cb = health->cb;
+    if (cb && (old_state != new_state)) {
+        cb(slave_addr, old_state, new_state, health->cb_arg);
+    }
+}
+
+// Returns false if the requests to the slave are skipped. The first request after
+// the backoff time of an open circuit is let through as the probe of the slave.
+static bool mbc_master_health_allow(UCHAR instance, uint8_t slave_addr)
+{
+    if ((slave_addr == 0) || (slave_addr > MB_MASTER_TOTAL_SLAVE_NUM)) {
+        return true; // broadcast requests get no response
+    }
+    mb_master_health_t* health = &mbm_health[instance];
+    mb_master_health_entry_t* slave = &health->slaves[slave_addr];
+    bool allow = true;
+    portENTER_CRITICAL(&health->lock);
+    mb_slave_health_t old_state = slave->state;
+    if (old_state == MB_SLAVE_OPEN) {
+        allow = ((int32_t)(mbc_master_health_time_ms() - slave->retry_ms) >= 0);
+        if (allow) {
+            slave->state = MB_SLAVE_HALF_OPEN;
+        }
+    } else if (old_state == MB_SLAVE_HALF_OPEN) {
+        allow = false; // the probe is pending
+    }
+    mb_slave_health_t new_state = slave->state;
+    portEXIT_CRITICAL(&health->lock);
+    mbc_master_health_report(health, slave_addr, old_state, new_state);
+    return allow;
+}
+
+// Updates the health of the slave from the result of a request let through by
+// mbc_master_health_allow(). Only a missed response counts against the slave,
+// errors of the master itself leave its health as it was.
+static void mbc_master_health_update(UCHAR instance, uint8_t slave_addr, esp_err_t error)
+{
+    if ((slave_addr == 0) || (slave_addr > MB_MASTER_TOTAL_SLAVE_NUM)) {
+        return;
+    }
+    bool answered = (error == ESP_OK) || (error == ESP_ERR_INVALID_RESPONSE)
+                        || (error == ESP_ERR_NOT_SUPPORTED);
+    mb_master_health_t* health = &mbm_health[instance];
+    mb_master_health_entry_t* slave = &health->slaves[slave_addr];
+    portENTER_CRITICAL(&health->lock);
+    mb_slave_health_t old_state = slave->state;
+    if (answered) {
+        slave->state = MB_SLAVE_HEALTHY;
+        slave->failures = 0;
+        slave->backoff_shift = 0;
+    } else if (error == ESP_ERR_TIMEOUT) {
+        if (slave->failures < UINT8_MAX) {
+            slave->failures++;
+        }
+        if (old_state == MB_SLAVE_HALF_OPEN) {
+            if ((MB_MASTER_BREAKER_BACKOFF_MIN_MS << slave->backoff_shift) < MB_MASTER_BREAKER_BACKOFF_MAX_MS) {
+                slave->backoff_shift++;
+            }
+            slave->state = MB_SLAVE_OPEN;
+        } else if (slave->failures >= MB_MASTER_BREAKER_FAILURES) {
+            slave->state = MB_SLAVE_OPEN;
+        } else {
+            slave->state = MB_SLAVE_SUSPECT;
+        }
+        if (slave->state == MB_SLAVE_OPEN) {
+            uint64_t backoff_ms = (uint64_t)MB_MASTER_BREAKER_BACKOFF_MIN_MS << slave->backoff_shift;
+            if (backoff_ms > MB_MASTER_BREAKER_BACKOFF_MAX_MS) {
+                backoff_ms = MB_MASTER_BREAKER_BACKOFF_MAX_MS;
+            }
+            slave->retry_ms = mbc_master_health_time_ms() + (uint32_t)backoff_ms;
+        }
+    } else if (old_state == MB_SLAVE_HALF_OPEN) {
+        slave->state = MB_SLAVE_OPEN; // the probe was not sent, the next request probes again
+    }
+    mb_slave_health_t new_state = slave->state;
+    portEXIT_CRITICAL(&health->lock);
+    mbc_master_health_report(health, slave_addr, old_state, new_state);
+}
+
+// Slave address of the characteristic, the broadcast address if it is unknown
+static uint8_t mbc_master_param_slave(const mb_master_interface_t* iface, uint16_t cid, const char* name)
+{
+    const mb_parameter_descriptor_t* param = name ? mbc_master_find_param(&iface->opts, cid, name) : NULL;
+    return param ? param->mb_slave_addr : 0;
+}
+#endif
+
+#if MB_MASTER_SUBMIT_QUEUE_SIZE
+// Request queued by mbc_master_submit()
+typedef struct {
+    mb_param_request_t request;
+    void* data_ptr;
+    mb_master_done_cb_t done_cb;
+    void* arg;
+    uint8_t priority;
+    uint32_t seq;                       // submit order, keeps requests of equal priority FIFO
+} mb_master_job_t;
+
+// Binary min-heap of the queued requests ordered by priority and submit order,
+// one queue and worker task per master instance. Requests to a slave whose request
+// window is full are parked until one of its outstanding requests completes.
+typedef struct {
+    mb_master_job_t* jobs;
+    uint16_t job_count;
+    mb_master_job_t* parked;            // shares the allocation of jobs
+    uint16_t parked_count;
+    uint16_t held_count;                // 1 while the worker sends a job, the job keeps its slot
+    uint32_t job_seq;
+    uint32_t done_seq;                  // incremented on each completion of an outstanding request
+    portMUX_TYPE job_lock;
+    TaskHandle_t task_handle;
+    SemaphoreHandle_t stop_sema;        // set by mbc_master_submit_stop(), given by the worker when it exits
+} mb_master_submit_queue_t;
+
+static mb_master_submit_queue_t mbm_submit_queues[MB_MASTER_INSTANCES] = {
+    [0 ... MB_MASTER_INSTANCES - 1] = { .job_lock = portMUX_INITIALIZER_UNLOCKED }
+};
+
+static bool mbc_master_job_before(const mb_master_job_t* a, const mb_master_job_t* b)
+{
+    if (a->priority != b->priority) {
+        return a->priority < b->priority;
+    }
+    return (int32_t)(a->seq - b->seq) < 0;
+}
+
+static void mbc_master_job_swap(mb_master_job_t* jobs, uint16_t i, uint16_t j)
+{
+    mb_master_job_t job = jobs[i];
+    jobs[i] = jobs[j];
+    jobs[j] = job;
+}
+
+// Must be called with the job_lock of the queue held, the job keeps its submit order
+static bool mbc_master_push_job(mb_master_submit_queue_t* queue, const mb_master_job_t* job)
+{
+    if ((queue->job_count + queue->parked_count + queue->held_count) >= MB_MASTER_SUBMIT_QUEUE_SIZE) {
+        return false;
+    }
+    mb_master_job_t* jobs = queue->jobs;
+    uint16_t pos = queue->job_count++;
+    jobs[pos] = *job;
+    while (pos > 0) {
+        uint16_t parent = (pos - 1) >> 1;
+        if (!mbc_master_job_before(&jobs[pos], &jobs[parent])) {
+            break;
+        }
+        mbc_master_job_swap(jobs, pos, parent);
+        pos = parent;
+    }
+    return true;
+}
+
+// Must be called with the job_lock of the queue held
+static bool mbc_master_pop_job(mb_master_submit_queue_t* queue, mb_master_job_t* job)
+{
+    if (queue->job_count == 0) {
+        return false;
+    }
+    mb_master_job_t* jobs = queue->jobs;
+    *job = jobs[0];
+    jobs[0] = jobs[--queue->job_count];
+    uint16_t pos = 0;
+    for (;;) {
+        uint16_t first = pos;
+        uint16_t left = (pos << 1) + 1;
+        uint16_t right = left + 1;
+        if ((left < queue->job_count) && mbc_master_job_before(&jobs[left], &jobs[first])) {
+            first = left;
+        }
+        if ((right < queue->job_count) && mbc_master_job_before(&jobs[right], &jobs[first])) {
+            first = right;
+        }
+        if (first == pos) {
+            break;
+        }
+        mbc_master_job_swap(jobs, pos, first);
+        pos = first;
+    }
+    return true;
+}
+
+// Request handed to the submit_request method of the interface, completed from the port task
+typedef struct {
+    mb_master_job_t job;
+    UCHAR instance;
+} mb_master_async_job_t;
+
+// Must be called with the job_lock of the queue held, returns the number of jobs moved
+// from the parked list of the slave back to the queue
+static uint16_t mbc_master_unpark_jobs(mb_master_submit_queue_t* queue, uint8_t slave_addr)
+{
+    uint16_t moved = 0;
+    uint16_t i = 0;
+    while (i < queue->parked_count) {
+        if (queue->parked[i].request.slave_addr == slave_addr) {
+            mb_master_job_t job = queue->parked[i];
+            queue->parked[i] = queue->parked[--queue->parked_count];
+            (void)mbc_master_push_job(queue, &job); // the slot of the parked job is free now
+            moved++;
+        } else {
+            i++;
+        }
+    }
+    return moved;
+}
+
+static void mbc_master_async_done(const mb_param_request_t* request, void* data_ptr, esp_err_t error, void* arg)
+{
+    mb_master_async_job_t* async_job = (mb_master_async_job_t*)arg;
+    mb_master_submit_queue_t* queue = &mbm_submit_queues[async_job->instance];
+#if MB_MASTER_BREAKER_ENABLED
+    mbc_master_health_update(async_job->instance, request->slave_addr, error);
+#endif
+    // A slot in the request window of the slave is free, its parked requests can be sent
+    portENTER_CRITICAL(&queue->job_lock);
+    queue->done_seq++;
+    uint16_t moved = queue->parked ? mbc_master_unpark_jobs(queue, request->slave_addr) : 0;
+    TaskHandle_t task_handle = queue->task_handle;
+    portEXIT_CRITICAL(&queue->job_lock);
+    while (task_handle && moved--) {
+        xTaskNotifyGive(task_handle);
+    }
+    if (async_job->job.done_cb) {
+        async_job->job.done_cb(request, data_ptr, error, async_job->job.arg);
+    }
+    free(async_job);
+}
+
+// Sends the request without waiting for the response if the interface supports it.
+// Returns ESP_ERR_NOT_SUPPORTED if the request has to be sent by the blocking send_request
+// method, ESP_ERR_INVALID_STATE if the request window of the slave is full and
+// ESP_ERR_TIMEOUT if the slave is not connected.
+static esp_err_t mbc_master_submit_async(UCHAR instance, const mb_master_job_t* job)
+{
+    if (!master_interfaces[instance]->submit_request) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    mb_master_async_job_t* async_job = malloc(sizeof(mb_master_async_job_t));
+    if (!async_job) {
+        return ESP_ERR_NO_MEM;
+    }
+    async_job->job = *job;
+    async_job->instance = instance;
+    esp_err_t error = master_interfaces[instance]->submit_request(&async_job->job.request, job->data_ptr,
+                                                                  mbc_master_async_done, async_job);
+    if (error != ESP_OK) {
+        free(async_job);
+    }
+    return error;
+}
+
+// Parks the job until a request to its slave completes. Returns false if a request
+// completed since done_seq was read, the window may have a free slot then and the job
+// is queued again instead.
+static bool mbc_master_park_job(mb_master_submit_queue_t* queue, const mb_master_job_t* job, uint32_t done_seq)
+{
+    portENTER_CRITICAL(&queue->job_lock);
+    bool parked = (queue->done_seq == done_seq);
+    queue->held_count = 0;
+    if (parked) {
+        queue->parked[queue->parked_count++] = *job;
+    } else {
+        (void)mbc_master_push_job(queue, job); // takes the slot the job was held in
+    }
+    portEXIT_CRITICAL(&queue->job_lock);
+    return parked;
+}
+
+static void mbc_master_release_job(mb_master_submit_queue_t* queue)
+{
+    portENTER_CRITICAL(&queue->job_lock);
+    queue->held_count = 0;
+    portEXIT_CRITICAL(&queue->job_lock);
+}
+
+// Sends the queued requests one after the other. The notification count is the
+// number of queued requests, so a burst is served without blocking in between.
+// If the interface can send without waiting for the response (Modbus TCP), the requests
+// to different slaves are outstanding at the same time and complete in any order.
+// A request to a slave with a full request window waits in the parked list and does
+// not hold back the requests to the other slaves. The worker exits between two requests
+// once mbc_master_submit_stop() sets the stop semaphore.
+static void mbc_master_submit_task(void* arg)
+{
+    // The worker sends through the master instance given as its parameter
+    UCHAR instance = (UCHAR)(uintptr_t)arg;
+    (void)xMBMasterPortBindTask(NULL, instance);
+    mb_master_submit_queue_t* queue = &mbm_submit_queues[instance];
+    mb_master_job_t job;
+    SemaphoreHandle_t stop_sema = NULL;
+    while (!stop_sema) {
+        (void)ulTaskNotifyTake(pdFALSE, portMAX_DELAY);
+        portENTER_CRITICAL(&queue->job_lock);
+        stop_sema = queue->stop_sema;
+        bool found = !stop_sema && mbc_master_pop_job(queue, &job);
+        queue->held_count = found ? 1 : 0;
+        uint32_t done_seq = queue->done_seq;
+        portEXIT_CRITICAL(&queue->job_lock);
+        if (!found) {
+            continue;
+        }
+#if MB_MASTER_BREAKER_ENABLED
+        if (!mbc_master_health_allow(instance, job.request.slave_addr)) {
+            mbc_master_release_job(queue);
+            if (job.done_cb) {
+                job.done_cb(&job.request, job.data_ptr, ESP_ERR_NOT_ALLOWED, job.arg);
+            }
+            continue;
+        }
+#endif
+        esp_err_t error = mbc_master_submit_async(instance, &job);
+        if (error == ESP_OK) {
+            mbc_master_release_job(queue);
+            continue; // completed by mbc_master_async_done()
+        }
+        if (error == ESP_ERR_NOT_SUPPORTED) {
+            error = master_interfaces[instance]->send_request(&job.request, job.data_ptr);
+#if MB_MASTER_BREAKER_ENABLED
+            mbc_master_health_update(instance, job.request.slave_addr, error);
+#endif
+        } else {
+#if MB_MASTER_BREAKER_ENABLED
+            // The request was not sent, a probe of the slave is left to the next request
+            mbc_master_health_update(instance, job.request.slave_addr, ESP_ERR_INVALID_STATE);
+#endif
+            if (error == ESP_ERR_INVALID_STATE) {
+                // The request window of the slave is full, send it once a request completes
+                if (!mbc_master_park_job(queue, &job, done_seq)) {
+                    xTaskNotifyGive(xTaskGetCurrentTaskHandle());
+                }
+                continue;
+            }
+        }
+        // Requests to a disconnected slave fail at once with ESP_ERR_TIMEOUT
+        mbc_master_release_job(queue);
+        if (job.done_cb) {
+            job.done_cb(&job.request, job.data_ptr, error, job.arg);
+        }
+    }
+    xSemaphoreGive(stop_sema);
+    vTaskDelete(NULL);
+}
+
+static esp_err_t mbc_master_submit_start(void)
+{
+    UCHAR instance = ucMBMasterPortGetInstance();
+    mb_master_submit_queue_t* queue = &mbm_submit_queues[instance];
+    if (queue->task_handle) {
+        return ESP_OK;
+    }
+    queue->jobs = calloc(2 * MB_MASTER_SUBMIT_QUEUE_SIZE, sizeof(mb_master_job_t));
+    MB_MASTER_CHECK((queue->jobs != NULL), ESP_ERR_NO_MEM, "mb submit queue allocation failure.");
+    queue->job_count = 0;
+    queue->parked = &queue->jobs[MB_MASTER_SUBMIT_QUEUE_SIZE];
+    queue->parked_count = 0;
+    queue->held_count = 0;
+    queue->stop_sema = NULL;
+    BaseType_t status = xTaskCreatePinnedToCore(mbc_master_submit_task, "mbc_submit",
+                                                MB_CONTROLLER_STACK_SIZE, (void*)(uintptr_t)instance,
+                                                MB_CONTROLLER_PRIORITY, &queue->task_handle,
+                                                MB_PORT_TASK_AFFINITY);
+    if (status != pdPASS) {
+        free(queue->jobs);
+        queue->jobs = NULL;
+        queue->parked = NULL;
+        queue->task_handle = NULL;
+    }
+    MB_MASTER_CHECK((status == pdPASS), ESP_ERR_NO_MEM,
+                    "mb submit task creation error, xTaskCreate() returns (0x%x).", (int)status);
+    return ESP_OK;
+}
+
+// Stops the worker and completes the requests still queued. The request the worker
+// is sending completes first, so the worker does not own a lock of the interface
+// when the controller is destroyed.
+static esp_err_t mbc_master_submit_stop(void)
+{
+    mb_master_submit_queue_t* queue = &mbm_submit_queues[ucMBMasterPortGetInstance()];
+    mb_master_job_t job;
+    if (!queue->task_handle) {
+        return ESP_OK;
+    }
+    SemaphoreHandle_t stop_sema = xSemaphoreCreateBinary();
+    MB_MASTER_CHECK((stop_sema != NULL), ESP_ERR_NO_MEM, "mb submit stop semaphore allocation failure.");
+    portENTER_CRITICAL(&queue->job_lock);
+    queue->stop_sema = stop_sema;
+    portEXIT_CRITICAL(&queue->job_lock);
+    xTaskNotifyGive(queue->task_handle);
+    (void)xSemaphoreTake(stop_sema, portMAX_DELAY);
+    vSemaphoreDelete(stop_sema);
+    portENTER_CRITICAL(&queue->job_lock);
+    queue->stop_sema = NULL;
+    queue->task_handle = NULL;
+    queue->held_count = 0;
+    while (queue->parked_count) {
+        (void)mbc_master_push_job(queue, &queue->parked[--queue->parked_count]);
+    }
+    queue->parked = NULL;
+    portEXIT_CRITICAL(&queue->job_lock);
+    for (;;) {
+        portENTER_CRITICAL(&queue->job_lock);
+        bool found = mbc_master_pop_job(queue, &job);
+        portEXIT_CRITICAL(&queue->job_lock);
+        if (!found) {
+            break;
+        }
+        if (job.done_cb) {
+            job.done_cb(&job.request, job.data_ptr, ESP_ERR_INVALID_STATE, job.arg);
+        }
+    }
+    free(queue->jobs);
+    queue->jobs = NULL;
+    return ESP_OK;
+}
+#endif
+
+esp_err_t mbc_master_submit(const mb_param_request_t* request, void* data_ptr, uint8_t priority,
+                                mb_master_done_cb_t done_cb, void* arg)
+{
+#if MB_MASTER_SUBMIT_QUEUE_SIZE
+    mb_master_interface_t* master_interface_ptr = MB_MASTER_IFACE();
+    MB_MASTER_CHECK((request != NULL), ESP_ERR_INVALID_ARG, "mb request structure.");
+    MB_MASTER_CHECK((data_ptr != NULL), ESP_ERR_INVALID_ARG, "mb incorrect data pointer.");
+    mb_master_submit_queue_t* queue = &mbm_submit_queues[ucMBMasterPortGetInstance()];
+    MB_MASTER_CHECK((master_interface_ptr != NULL) && (queue->task_handle != NULL),
+                    ESP_ERR_INVALID_STATE,
+                    "Master interface is not started.");
+    mb_master_job_t job = {
+        .request = *request,
+        .data_ptr = data_ptr,
+        .done_cb = done_cb,
+        .arg = arg,
+        .priority = priority
+    };
+    portENTER_CRITICAL(&queue->job_lock);
+    job.seq = queue->job_seq++;
+    bool queued = mbc_master_push_job(queue, &job);
+    portEXIT_CRITICAL(&queue->job_lock);
+    if (!queued) {
+        return ESP_ERR_NO_MEM;
+    }
+    xTaskNotifyGive(queue->task_handle);
+    return ESP_OK;
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+esp_err_t mbc_master_get_slave_stats(uint8_t slave_addr, mb_master_slave_stats_t* stats)
+{
+#if MB_MASTER_ADAPTIVE_TIMEOUT_ENABLED
+    _Static_assert(MB_MASTER_RTT_HIST_SIZE == MB_MASTER_RTT_HIST_BUCKETS,
+                    "The histogram of the API and the stack must have the same size.");
+    MB_MASTER_CHECK((stats != NULL), ESP_ERR_INVALID_ARG, "mb incorrect stats pointer.");
+    xMBMasterRespondStats slave_stats;
+    if (!xMBMasterPortGetRespondStats((UCHAR)slave_addr, &slave_stats)) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    stats->rtt_avg_us = slave_stats.ulSRTTUs;
+    stats->rtt_dev_us = slave_stats.ulRTTVarUs;
+    stats->rtt_min_us = slave_stats.ulResponses ? slave_stats.ulRTTMinUs : 0;
+    stats->rtt_max_us = slave_stats.ulRTTMaxUs;
+    stats->timeout_ms = slave_stats.ulTimeoutUs / 1000;
+    stats->responses = slave_stats.ulResponses;
+    stats->timeouts = slave_stats.ulTimeouts;
+    memcpy(stats->rtt_hist, slave_stats.ulHist, sizeof(stats->rtt_hist));
+    return ESP_OK;
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+esp_err_t mbc_master_get_slave_conn_stats(uint8_t slave_addr, mb_master_conn_stats_t* stats)
+{
+    mb_master_interface_t* master_interface_ptr = MB_MASTER_IFACE();
+    MB_MASTER_CHECK((master_interface_ptr != NULL),
+                    ESP_ERR_INVALID_STATE,
+                    "Master interface is not correctly initialized.");
+    MB_MASTER_CHECK((stats != NULL), ESP_ERR_INVALID_ARG, "mb incorrect stats pointer.");
+    if (!master_interface_ptr->get_conn_stats) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    return master_interface_ptr->get_conn_stats(slave_addr, stats);
+}
+
+esp_err_t mbc_master_set_health_cb(mb_master_health_cb_t cb, void* arg)
+{
+#if MB_MASTER_BREAKER_ENABLED
+    mb_master_health_t* health = &mbm_health[ucMBMasterPortGetInstance()];
+    portENTER_CRITICAL(&health->lock);
+    health->cb = cb;
+    health->cb_arg = arg;
+    portEXIT_CRITICAL(&health->lock);
+    return ESP_OK;
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+esp_err_t mbc_master_get_slave_health(uint8_t slave_addr, mb_slave_health_t* state)
+{
+#if MB_MASTER_BREAKER_ENABLED
+    MB_MASTER_CHECK((state != NULL), ESP_ERR_INVALID_ARG, "mb incorrect state pointer.");
+    MB_MASTER_CHECK((slave_addr <= MB_MASTER_TOTAL_SLAVE_NUM), ESP_ERR_INVALID_ARG, "mb incorrect slave address.");
+    mb_master_health_t* health = &mbm_health[ucMBMasterPortGetInstance()];
+    portENTER_CRITICAL(&health->lock);
+    *state = (mb_slave_health_t)health->slaves[slave_addr].state;
+    portEXIT_CRITICAL(&health->lock);
+    return ESP_OK;
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+/**
+ * Modbus controller destroy function
+ */
+esp_err_t mbc_master_destroy(void)
+{
+    mb_master_interface_t* master_interface_ptr = MB_MASTER_IFACE();
+    esp_err_t error = ESP_OK;
+    MB_MASTER_CHECK((master_interface_ptr != NULL),
+                    ESP_ERR_INVALID_STATE,
+                    "Master interface is not correctly initialized.");
+    MB_MASTER_CHECK((master_interface_ptr->destroy != NULL),
+                    ESP_ERR_INVALID_STATE,
+                    "Master interface is not correctly initialized.");
+#if MB_MASTER_SUBMIT_QUEUE_SIZE
+    error = mbc_master_submit_stop();
+    MB_MASTER_CHECK((error == ESP_OK),
+                    error,
+                    "Master submit worker stop failure, error=(0x%x).",
+                    (int)error);
+#endif
+    error = master_interface_ptr->destroy();
+    MB_MASTER_CHECK((error == ESP_OK),
+                    error,
+                    "Master destroy failure, error=(0x%x).",
+                    (int)error);
+    return error;
+}
+
+esp_err_t mbc_master_get_cid_info(uint16_t cid, const mb_parameter_descriptor_t** param_info)
+{
+    mb_master_interface_t* master_interface_ptr = MB_MASTER_IFACE();
+    esp_err_t error = ESP_OK;
+    MB_MASTER_CHECK((master_interface_ptr != NULL),
+                    ESP_ERR_INVALID_STATE,
+                    "Master interface is not correctly initialized.");
+    MB_MASTER_CHECK((master_interface_ptr->get_cid_info != NULL),
+                    ESP_ERR_INVALID_STATE,
+                    "Master interface is not correctly initialized.");
+    error = master_interface_ptr->get_cid_info(cid, param_info);
+    MB_MASTER_CHECK((error == ESP_OK),
+                    error,
+                    "Master get cid info failure, error=(0x%x).",
+                    (int)error);
+    return error;
+}
+
+/**
+ * Get parameter data for corresponding characteristic
+ */
+esp_err_t mbc_master_get_parameter(uint16_t cid, char* name, uint8_t* value, uint8_t* type)
+{
+    mb_master_interface_t* master_interface_ptr = MB_MASTER_IFACE();
+    esp_err_t error = ESP_OK;
+    MB_MASTER_CHECK((master_interface_ptr != NULL),
+                    ESP_ERR_INVALID_STATE,
+                    "Master interface is not correctly initialized.");
+    MB_MASTER_CHECK((master_interface_ptr->get_parameter != NULL),
+                    ESP_ERR_INVALID_STATE,
+                    "Master interface is not correctly initialized.");
+#if MB_MASTER_BREAKER_ENABLED
+    UCHAR instance = ucMBMasterPortGetInstance();
+    uint8_t slave_addr = mbc_master_param_slave(master_interface_ptr, cid, name);
+    if (!mbc_master_health_allow(instance, slave_addr)) {
+        return ESP_ERR_NOT_ALLOWED; // the slave is skipped, not a failure of the master
+    }
+    bool cached = false;
+    if (master_interface_ptr->get_parameter_cached != NULL) {
+        error = master_interface_ptr->get_parameter_cached(cid, name, value, type, &cached);
+    } else {
+        error = master_interface_ptr->get_parameter(cid, name, value, type);
+    }
+    // A result served from the cache of the controller did not reach the slave,
+    // it is handled as an error of the master and leaves the health as it was.
+    mbc_master_health_update(instance, slave_addr, cached ? ESP_ERR_INVALID_STATE : error);
+#else
+    error = master_interface_ptr->get_parameter(cid, name, value, type);
+#endif
+    MB_MASTER_CHECK((error == ESP_OK),
+                    error,
+                    "Master get parameter failure, error=(0x%x) (%s).",
+                    (int)error, esp_err_to_name(error));
+    return error;
+}
+
+/**
+ * Send custom Modbus request defined as mb_param_request_t structure
+ */
+esp_err_t mbc_master_send_request(mb_param_request_t* request, void* data_ptr)
+{
+    mb_master_interface_t* master_interface_ptr = MB_MASTER_IFACE();
+    esp_err_t error = ESP_OK;
+    MB_MASTER_CHECK((master_interface_ptr != NULL),
+                    ESP_ERR_INVALID_STATE,
+                    "Master interface is not correctly initialized.");
+    MB_MASTER_CHECK((master_interface_ptr->send_request != NULL),
+                    ESP_ERR_INVALID_STATE,
+                    "Master interface is not correctly initialized.");
+#if MB_MASTER_BREAKER_ENABLED
+    MB_MASTER_CHECK((request != NULL), ESP_ERR_INVALID_ARG, "mb request structure.");
+    UCHAR instance = ucMBMasterPortGetInstance();
+    uint8_t slave_addr = request->slave_addr;
+    if (!mbc_master_health_allow(instance, slave_addr)) {
+        return ESP_ERR_NOT_ALLOWED; // the slave is skipped, not a failure of the master
+    }
+    error = master_interface_ptr->send_request(request, data_ptr);
+    mbc_master_health_update(instance, slave_addr, error);
+#else
+    error = master_interface_ptr->send_request(request, data_ptr);
+#endif
+    MB_MASTER_CHECK((error == ESP_OK),
+                    error,
+                    "Master send request failure error=(0x%x) (%s).",
+                    (int)error, esp_err_to_name(error));
+    return ESP_OK;
+}
+
+/**
+ * Set Modbus parameter description table
+ */
+esp_err_t mbc_master_set_descriptor(const mb_parameter_descriptor_t* descriptor,
+                                        const uint16_t num_elements)
+{
+    mb_master_interface_t* master_interface_ptr = MB_MASTER_IFACE();
+    esp_err_t error = ESP_OK;
+    MB_MASTER_CHECK((master_interface_ptr != NULL),
+                    ESP_ERR_INVALID_STATE,
+                    "Master interface is not correctly initialized.");
+    MB_MASTER_CHECK((master_interface_ptr->set_descriptor != NULL),
+                    ESP_ERR_INVALID_STATE,
+                    "Master interface is not correctly initialized.");
+    error = master_interface_ptr->set_descriptor(descriptor, num_elements);
+    MB_MASTER_CHECK((error == ESP_OK),
+                    error,
+                    "Master set descriptor failure, error=(0x%x) (%s).",
+                    (int)error, esp_err_to_name(error));
+    return ESP_OK;
+}
+
+/**
+ * Set parameter value for characteristic selected by name and cid
+ */
+esp_err_t mbc_master_set_parameter(uint16_t cid, char* name, uint8_t* value, uint8_t* type)
+{
+    mb_master_interface_t* master_interface_ptr = MB_MASTER_IFACE();
+    esp_err_t error = ESP_OK;
+    MB_MASTER_CHECK((master_interface_ptr != NULL),
+                    ESP_ERR_INVALID_STATE,
+                    "Master interface is not correctly initialized.");
+    MB_MASTER_CHECK((master_interface_ptr->set_parameter != NULL),
+                    ESP_ERR_INVALID_STATE,
+                    "Master interface is not correctly initialized.");
+#if MB_MASTER_BREAKER_ENABLED
+    UCHAR instance = ucMBMasterPortGetInstance();
+    uint8_t slave_addr = mbc_master_param_slave(master_interface_ptr, cid, name);
+    if (!mbc_master_health_allow(instance, slave_addr)) {
+        return ESP_ERR_NOT_ALLOWED; // the slave is skipped, not a failure of the master
+    }
+    error = master_interface_ptr->set_parameter(cid, name, value, type);
+    mbc_master_health_update(instance, slave_addr, error);
+#else
+    error = master_interface_ptr->set_parameter(cid, name, value, type);
+#endif
+    MB_MASTER_CHECK((error == ESP_OK),
+                    error,
+                    "Master set parameter failure, error=(0x%x) (%s).",
+                    (int)error, esp_err_to_name(error));
+    return ESP_OK;
+}
+
+/**
+ * Setup Modbus controller parameters
+ */
+esp_err_t mbc_master_setup(void* comm_info)
+{
+    mb_master_interface_t* master_interface_ptr = MB_MASTER_IFACE();
+    esp_err_t error = ESP_OK;
+    MB_MASTER_CHECK((master_interface_ptr != NULL),
+                    ESP_ERR_INVALID_STATE,
+                    "Master interface is not correctly initialized.");
+    MB_MASTER_CHECK((master_interface_ptr->setup != NULL),
+                    ESP_ERR_INVALID_STATE,
+                    "Master interface is not correctly initialized.");
+    error = master_interface_ptr->setup(comm_info);
+    MB_MASTER_CHECK((error == ESP_OK),
+                    error,
+                    "Master setup failure, error=(0x%x) (%s).",
+                    (int)error, esp_err_to_name(error));
+    return ESP_OK;
+}
+
+/**
+ * Modbus controller stack start function
+ */
+esp_err_t mbc_master_start(void)
+{
+    mb_master_interface_t* master_interface_ptr = MB_MASTER_IFACE();
+    esp_err_t error = ESP_OK;
+    MB_MASTER_CHECK((master_interface_ptr != NULL),
+                    ESP_ERR_INVALID_STATE,
+                    "Master interface is not correctly initialized.");
+    MB_MASTER_CHECK((master_interface_ptr->start != NULL),
+                    ESP_ERR_INVALID_STATE,
+                    "Master interface is not correctly initialized.");
+    error = master_interface_ptr->start();
+    MB_MASTER_CHECK((error == ESP_OK),
+                    error,
+                    "Master start failure, error=(0x%x) (%s).",
+                    (int)error, esp_err_to_name(error));
+#if MB_MASTER_BREAKER_ENABLED
+    mb_master_health_t* health = &mbm_health[ucMBMasterPortGetInstance()];
+    portENTER_CRITICAL(&health->lock);
+    memset(health->slaves, 0, sizeof(health->slaves));
+    portEXIT_CRITICAL(&health->lock);
+#endif
+#if MB_MASTER_SUBMIT_QUEUE_SIZE
+    error = mbc_master_submit_start();
+    MB_MASTER_CHECK((error == ESP_OK),
+                    error,
+                    "Master submit queue start failure, error=(0x%x) (%s).",
+                    (int)error, esp_err_to_name(error));
+#endif
+    return ESP_OK;
+}
+
+eMBErrorCode eMBMasterRegDiscreteCB(UCHAR * pucRegBuffer, USHORT usAddress,
+                            USHORT usNDiscrete)
+{
+    mb_master_interface_t* master_interface_ptr = MB_MASTER_IFACE();
+    eMBErrorCode error = MB_ENOERR;
+    MB_MASTER_CHECK((master_interface_ptr != NULL),
+                    ESP_ERR_INVALID_STATE,
+                    "Master interface is not correctly initialized.");
+    MB_MASTER_CHECK((master_interface_ptr->master_reg_cb_discrete != NULL),
+                    ESP_ERR_INVALID_STATE,
+                    "Master interface is not correctly initialized.");
+    error = master_interface_ptr->master_reg_cb_discrete(pucRegBuffer, usAddress, usNDiscrete);
+    return error;
+}
+
+eMBErrorCode eMBMasterRegCoilsCB(UCHAR* pucRegBuffer, USHORT usAddress,
+        USHORT usNCoils, eMBRegisterMode eMode)
+{
+    mb_master_interface_t* master_interface_ptr = MB_MASTER_IFACE();
+    eMBErrorCode error = MB_ENOERR;
+    MB_MASTER_CHECK((master_interface_ptr != NULL),
+                    ESP_ERR_INVALID_STATE,
+                    "Master interface is not correctly initialized.");
+    MB_MASTER_CHECK((master_interface_ptr->master_reg_cb_coils != NULL),
+                    ESP_ERR_INVALID_STATE,
+                    "Master interface is not correctly initialized.");
+    error = master_interface_ptr->master_reg_cb_coils(pucRegBuffer, usAddress,
+                                                        usNCoils, eMode);
+    return error;
+}
+
+eMBErrorCode eMBMasterRegHoldingCB(UCHAR * pucRegBuffer, USHORT usAddress,
+        USHORT usNRegs, eMBRegisterMode eMode)
+{
+    mb_master_interface_t* master_interface_ptr = MB_MASTER_IFACE();
+    eMBErrorCode error = MB_ENOERR;
+    MB_MASTER_CHECK((master_interface_ptr != NULL),
+                    ESP_ERR_INVALID_STATE,
+                    "Master interface is not correctly initialized.");
+    MB_MASTER_CHECK((master_interface_ptr->master_reg_cb_holding != NULL),
+                    ESP_ERR_INVALID_STATE,
+                    "Master interface is not correctly initialized.");
+    error = master_interface_ptr->master_reg_cb_holding(pucRegBuffer, usAddress,
+                                                        usNRegs, eMode);
+    return error;
+}
+
+eMBErrorCode eMBMasterRegInputCB(UCHAR * pucRegBuffer, USHORT usAddress,
+                                USHORT usNRegs)
+{
+    mb_master_interface_t* master_interface_ptr = MB_MASTER_IFACE();
+    eMBErrorCode error = MB_ENOERR;
+    MB_MASTER_CHECK((master_interface_ptr != NULL),
+                    ESP_ERR_INVALID_STATE,
+                    "Master interface is not correctly initialized.");
+    MB_MASTER_CHECK((master_interface_ptr->master_reg_cb_input != NULL),
+                    ESP_ERR_INVALID_STATE,
+                    "Master interface is not correctly initialized.");
+    error = master_interface_ptr->master_reg_cb_input(pucRegBuffer, usAddress, usNRegs);
+    return error;
+}
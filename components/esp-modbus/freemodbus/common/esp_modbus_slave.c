@@ -37,32 +37,74 @@ static uint8_t mb_slave_id[] = { MB_ID_BYTE0(MB_CONTROLLER_SLAVE_ID),
 static mb_slave_interface_t* slave_interface_ptr = NULL;
 static const char TAG[] __attribute__((unused)) = "MB_CONTROLLER_SLAVE";
 
+// Returns the position of the first area in the sorted index that starts above addr
+static uint16_t mbc_slave_area_upper_bound(mb_param_type_t type, uint16_t addr)
+{
+    mb_slave_options_t* mbs_opts = &slave_interface_ptr->opts;
+    mb_descr_entry_t** index = mbs_opts->mbs_area_index[type];
+    uint16_t low = 0;
+    uint16_t high = mbs_opts->mbs_area_count[type];
+    while (low < high) {
+        uint16_t mid = (low + high) >> 1;
+        if (index[mid]->start_offset <= addr) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
 // Searches the register in the area specified by type, returns descriptor if found, else NULL
+// The areas of a type do not overlap, so only the last area starting at or below addr can hold it.
 static mb_descr_entry_t* mbc_slave_find_reg_descriptor(mb_param_type_t type, uint16_t addr, size_t regs)
 {
-    mb_descr_entry_t* it;
-    uint16_t reg_size = 0;
-
     mb_slave_options_t* mbs_opts = &slave_interface_ptr->opts;
-
-    if (LIST_EMPTY(&mbs_opts->mbs_area_descriptors[type])) {
+    uint16_t pos = mbc_slave_area_upper_bound(type, addr);
+    if (pos == 0) {
         return NULL;
     }
-
-    // search for the register in each area
-    for (it = LIST_FIRST(&mbs_opts->mbs_area_descriptors[type]); it != NULL; it = LIST_NEXT(it, entries)) {
-        reg_size = REG_SIZE(type, it->size);
-        if ((addr >= it->start_offset)
-            && (it->p_data)
-            && (regs >= 1)
-            && ((addr + regs) <= (it->start_offset + reg_size))
-            && (reg_size >= 1)) {
-            return it;
-        }
+    mb_descr_entry_t* it = mbs_opts->mbs_area_index[type][pos - 1];
+    uint16_t reg_size = REG_SIZE(type, it->size);
+    if ((it->p_data)
+        && (regs >= 1)
+        && ((addr + regs) <= (it->start_offset + reg_size))
+        && (reg_size >= 1)) {
+        return it;
     }
     return NULL;
 }
 
+// Adds the area to the sorted index of its type, fails if it overlaps an area already defined
+static esp_err_t mbc_slave_index_area(mb_descr_entry_t* new_descr)
+{
+    mb_slave_options_t* mbs_opts = &slave_interface_ptr->opts;
+    mb_param_type_t type = new_descr->type;
+    uint16_t count = mbs_opts->mbs_area_count[type];
+    uint16_t pos = mbc_slave_area_upper_bound(type, new_descr->start_offset);
+    mb_descr_entry_t** index = mbs_opts->mbs_area_index[type];
+    uint32_t new_end = (uint32_t)new_descr->start_offset + (REG_SIZE(type, new_descr->size));
+    if (pos > 0) {
+        mb_descr_entry_t* prev = index[pos - 1];
+        uint32_t prev_end = (uint32_t)prev->start_offset + (REG_SIZE(type, prev->size));
+        MB_SLAVE_CHECK((prev_end <= new_descr->start_offset), ESP_ERR_INVALID_ARG,
+                        "mb area 0x%x overlaps area 0x%x.", (unsigned)new_descr->start_offset, (unsigned)prev->start_offset);
+    }
+    if (pos < count) {
+        MB_SLAVE_CHECK((new_end <= index[pos]->start_offset), ESP_ERR_INVALID_ARG,
+                        "mb area 0x%x overlaps area 0x%x.", (unsigned)new_descr->start_offset, (unsigned)index[pos]->start_offset);
+    }
+    MB_SLAVE_CHECK((count < UINT16_MAX), ESP_ERR_NO_MEM, "mb too many areas.");
+    index = (mb_descr_entry_t**) heap_caps_realloc(index, (count + 1) * sizeof(mb_descr_entry_t*),
+                                        MALLOC_CAP_INTERNAL|MALLOC_CAP_8BIT);
+    MB_SLAVE_CHECK((index != NULL), ESP_ERR_NO_MEM, "mb can not allocate memory for area index.");
+    memmove(&index[pos + 1], &index[pos], (count - pos) * sizeof(mb_descr_entry_t*));
+    index[pos] = new_descr;
+    mbs_opts->mbs_area_index[type] = index;
+    mbs_opts->mbs_area_count[type] = count + 1;
+    return ESP_OK;
+}
+
 static void mbc_slave_free_descriptors(void) {
 
     mb_descr_entry_t* it;
@@ -73,6 +115,9 @@ static void mbc_slave_free_descriptors(void) {
             LIST_REMOVE(it, entries);
             free(it);
         }
+        free(mbs_opts->mbs_area_index[descr_type]);
+        mbs_opts->mbs_area_index[descr_type] = NULL;
+        mbs_opts->mbs_area_count[descr_type] = 0;
     }
 }
 
@@ -85,6 +130,10 @@ void mbc_slave_init_iface(void* handler)
     LIST_INIT(&mbs_opts->mbs_area_descriptors[MB_PARAM_HOLDING]);
     LIST_INIT(&mbs_opts->mbs_area_descriptors[MB_PARAM_COIL]);
     LIST_INIT(&mbs_opts->mbs_area_descriptors[MB_PARAM_DISCRETE]);
+    for (int descr_type = 0; descr_type < MB_PARAM_COUNT; descr_type++) {
+        mbs_opts->mbs_area_index[descr_type] = NULL;
+        mbs_opts->mbs_area_count[descr_type] = 0;
+    }
 }
 
 /**
@@ -212,9 +261,7 @@ esp_err_t mbc_slave_set_descriptor(mb_register_area_descriptor_t descr_data)
                         (int)error);
     } else {
         mb_slave_options_t* mbs_opts = &slave_interface_ptr->opts;
-        // Check if the address is already in the descriptor list
-        mb_descr_entry_t* it = mbc_slave_find_reg_descriptor(descr_data.type, descr_data.start_offset, 1);
-        MB_SLAVE_CHECK((it == NULL), ESP_ERR_INVALID_ARG, "mb incorrect descriptor or already defined.");
+        MB_SLAVE_CHECK((descr_data.type < MB_PARAM_COUNT), ESP_ERR_INVALID_ARG, "mb incorrect descriptor type.");
 
         mb_descr_entry_t* new_descr = (mb_descr_entry_t*) heap_caps_malloc(sizeof(mb_descr_entry_t),
                                             MALLOC_CAP_INTERNAL|MALLOC_CAP_8BIT);
@@ -223,8 +270,13 @@ esp_err_t mbc_slave_set_descriptor(mb_register_area_descriptor_t descr_data)
         new_descr->type = descr_data.type;
         new_descr->p_data = descr_data.address;
         new_descr->size = descr_data.size;
+        // Check that the area does not overlap one already defined and index it
+        error = mbc_slave_index_area(new_descr);
+        if (error != ESP_OK) {
+            free(new_descr);
+            return error;
+        }
         LIST_INSERT_HEAD(&mbs_opts->mbs_area_descriptors[descr_data.type], new_descr, entries);
-        error = ESP_OK;
     }
     return error;
 }
@@ -0,0 +1,88 @@
+/*
+ * SPDX-FileCopyrightText: 2016-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef _ESP_MB_GATEWAY_INTERFACE_H
+#define _ESP_MB_GATEWAY_INTERFACE_H
+
+#include <stdint.h>                 // for standard int types definition
+#include <stddef.h>                 // for NULL and std defines
+#include "esp_modbus_common.h"      // for common types
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MB_GATEWAY_CHECK(a, err_code, format, ...) MB_RETURN_ON_FALSE(a, err_code, TAG, format __VA_OPT__(,) __VA_ARGS__)
+
+/**
+ * @brief Statistics of the Modbus TCP to serial gateway
+ */
+typedef struct {
+    uint32_t requests;                      /*!< Requests sent to the serial bus */
+    uint32_t exceptions;                    /*!< Sent requests answered with an exception */
+    uint32_t busy;                          /*!< Requests answered with exception 0x06 because the queue was full */
+    uint32_t rejected;                      /*!< Requests answered with an exception without being sent */
+    uint32_t dropped;                       /*!< Requests dropped because the client disconnected */
+    uint16_t queued;                        /*!< Requests waiting for the serial bus */
+    uint16_t queued_max;                    /*!< Highest number of requests waiting for the serial bus */
+    uint32_t wait_avg_us;                   /*!< Average time a sent request waited in the queue */
+    uint32_t wait_max_us;                   /*!< Longest time a sent request waited in the queue */
+    uint64_t bus_busy_us;                   /*!< Time spent in serial transactions */
+    uint64_t uptime_us;                     /*!< Time since the gateway was started */
+    uint8_t bus_utilisation;                /*!< bus_busy_us in percent of uptime_us */
+} mb_gateway_stats_t;
+
+/**
+ * @brief Start forwarding the requests of the Modbus TCP slave to a serial master
+ *        (see CONFIG_FMB_TCP_GATEWAY). The requests are forwarded to the serial slave
+ *        addressed by their unit identifier and answered with the response of the slave.
+ *        Read and write requests of coils, discrete inputs, input and holding registers
+ *        (function codes 1, 2, 3, 4, 5, 6, 15 and 16) are supported, other requests are
+ *        answered with exception 0x01. The TCP slave controller and the serial master
+ *        have to be started before.
+ *
+ * @param[in] master_handler handler of the serial master returned by mbc_master_init(),
+ *                           NULL to use the first master instance
+ *
+ * @return
+ *     - ESP_OK                 Success
+ *     - ESP_ERR_NO_MEM         Queue or task allocation failure
+ *     - ESP_ERR_INVALID_STATE  The gateway is already started
+ *     - ESP_ERR_NOT_SUPPORTED  The gateway is disabled in the configuration
+ */
+esp_err_t mbc_gateway_start(void* master_handler);
+
+/**
+ * @brief Stop the gateway, the waiting requests are dropped. A request being sent
+ *        to the serial bus is completed first, so the call blocks up to the response timeout.
+ *        Must be called before the TCP slave controller is destroyed.
+ *
+ * @return
+ *     - ESP_OK                 Success
+ *     - ESP_ERR_INVALID_STATE  The gateway is not started
+ *     - ESP_ERR_NO_MEM         The gateway task can not be signalled to stop
+ *     - ESP_ERR_NOT_SUPPORTED  The gateway is disabled in the configuration
+ */
+esp_err_t mbc_gateway_stop(void);
+
+/**
+ * @brief Get the statistics of the gateway since it was started
+ *
+ * @param[out] stats pointer to the statistics structure
+ *
+ * @return
+ *     - ESP_OK                 Success
+ *     - ESP_ERR_INVALID_ARG    The stats pointer is NULL
+ *     - ESP_ERR_INVALID_STATE  The gateway is not started
+ *     - ESP_ERR_NOT_SUPPORTED  The gateway is disabled in the configuration
+ */
+esp_err_t mbc_gateway_get_stats(mb_gateway_stats_t* stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _ESP_MB_GATEWAY_INTERFACE_H
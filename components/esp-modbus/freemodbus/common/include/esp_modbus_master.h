@@ -104,6 +104,76 @@ typedef struct {
     uint16_t reg_size;              /*!< Modbus number of registers */
 } mb_param_request_t;
 
+/**
+ * @brief Completion callback of a request queued by mbc_master_submit()
+ *
+ * Called from the context of the submit worker task or, for a request sent without waiting
+ * for the response, of the port task. It should return quickly.
+ *
+ * @param[in] request the request as it was submitted
+ * @param[in] data_ptr data buffer of the request, holds the response of a read if err is ESP_OK
+ * @param[in] err result of the request, the same codes as returned by mbc_master_send_request()
+ * @param[in] arg user argument given to mbc_master_submit()
+ */
+typedef void (*mb_master_done_cb_t)(const mb_param_request_t* request, void* data_ptr, esp_err_t err, void* arg);
+
+#define MB_MASTER_RTT_HIST_SIZE (12) /*!< Number of buckets of the round trip time histogram */
+
+/**
+ * @brief Response time statistics of a slave
+ */
+typedef struct {
+    uint32_t rtt_avg_us;                    /*!< Smoothed round trip time */
+    uint32_t rtt_dev_us;                    /*!< Smoothed mean deviation of the round trip time */
+    uint32_t rtt_min_us;                    /*!< Shortest round trip time */
+    uint32_t rtt_max_us;                    /*!< Longest round trip time */
+    uint32_t timeout_ms;                    /*!< Response timeout used for the next request */
+    uint32_t responses;                     /*!< Number of responses */
+    uint32_t timeouts;                      /*!< Number of missed responses */
+    uint32_t rtt_hist[MB_MASTER_RTT_HIST_SIZE]; /*!< Round trip times, bucket 0 counts times below 1 ms,
+                                                bucket n times from 2^(n-1) to 2^n ms, the last one all longer times */
+} mb_master_slave_stats_t;
+
+/**
+ * @brief Connection statistics of a Modbus TCP slave
+ */
+typedef struct {
+    uint8_t connected;                      /*!< 1 if the slave is connected */
+    uint32_t connects;                      /*!< Number of established connections */
+    uint32_t reconnects;                    /*!< Number of connections established after the first one */
+    uint32_t connect_failures;              /*!< Number of failed connect attempts */
+    uint32_t connect_last_us;               /*!< Latency of the last established connection */
+    uint32_t connect_avg_us;                /*!< Smoothed connect latency */
+    uint32_t connect_max_us;                /*!< Longest connect latency */
+} mb_master_conn_stats_t;
+
+#ifndef ESP_ERR_NOT_ALLOWED
+#define ESP_ERR_NOT_ALLOWED (0x10D) /*!< Returned for the requests to a skipped slave */
+#endif
+
+/**
+ * @brief Health of a slave seen by the master (see CONFIG_FMB_MASTER_SLAVE_BREAKER)
+ */
+typedef enum {
+    MB_SLAVE_HEALTHY = 0,   /*!< The slave answered the last request */
+    MB_SLAVE_SUSPECT,       /*!< The last requests to the slave were not answered */
+    MB_SLAVE_OPEN,          /*!< The slave is skipped, its requests fail with ESP_ERR_NOT_ALLOWED */
+    MB_SLAVE_HALF_OPEN      /*!< A probe request is sent to the skipped slave */
+} mb_slave_health_t;
+
+/**
+ * @brief Callback reporting a health change of a slave
+ *
+ * Called from the context of the task which sent the request, it should return quickly.
+ *
+ * @param[in] slave_addr address of the slave
+ * @param[in] old_state health before the change
+ * @param[in] new_state health after the change
+ * @param[in] arg user argument given to mbc_master_set_health_cb()
+ */
+typedef void (*mb_master_health_cb_t)(uint8_t slave_addr, mb_slave_health_t old_state,
+                                        mb_slave_health_t new_state, void* arg);
+
 /**
  * @brief Initialize Modbus controller and stack for TCP port
  *
@@ -136,6 +206,31 @@ esp_err_t mbc_master_init(mb_port_type_t port_type, void** handler);
  */
 void mbc_master_init_iface(void* handler);
 
+/**
+ * @brief Select the master instance used by the calling task
+ *
+ * Each call of mbc_master_init() creates the next serial master instance
+ * (see CONFIG_FMB_MASTER_SERIAL_INSTANCES) and selects it for the calling task.
+ * The other API functions use the instance selected by the calling task,
+ * tasks which never select an instance use the first one. The selection is kept
+ * by the task itself (in a thread local storage pointer), a destroyed instance
+ * drops the selections of all its tasks.
+ *
+ * @param[in] handler handler returned by mbc_master_init() for the instance
+ * @return
+ *     - ESP_OK                 Success
+ *     - ESP_ERR_INVALID_ARG    The handler is NULL
+ *     - ESP_ERR_INVALID_STATE  The handler does not belong to an initialized instance
+ */
+esp_err_t mbc_master_select(void* handler);
+
+/**
+ * @brief Release the instance selected by the calling task with mbc_master_select()
+ *
+ * The task uses the first instance again.
+ */
+void mbc_master_unselect(void);
+
 /**
  * @brief Destroy Modbus controller and stack
  *
@@ -197,10 +292,94 @@ esp_err_t mbc_master_set_descriptor(const mb_parameter_descriptor_t* descriptor,
  *     - esp_err_t ESP_ERR_INVALID_RESPONSE - an invalid response from slave
  *     - esp_err_t ESP_ERR_TIMEOUT - operation timeout or no response from slave
  *     - esp_err_t ESP_ERR_NOT_SUPPORTED - the request command is not supported by slave
+ *     - esp_err_t ESP_ERR_NOT_ALLOWED - the slave is skipped after missed responses
  *     - esp_err_t ESP_FAIL - slave returned an exception or other failure
  */
 esp_err_t mbc_master_send_request(mb_param_request_t* request, void* data_ptr);
 
+/**
+ * @brief Queue a data request and return without waiting for the response.
+ *        The requests are sent by a worker task of the controller in the order of their priority,
+ *        requests of the same priority in the order they were submitted. When a request completes
+ *        the callback is called with its result. A request to a slave whose request window is full
+ *        waits until one of its outstanding requests completes without holding back the requests to
+ *        other slaves, a request to a disconnected slave completes at once with ESP_ERR_TIMEOUT.
+ *        Requests still in the queue when the controller is destroyed complete with ESP_ERR_INVALID_STATE.
+ *
+ * @param[in] request pointer to request structure of type mb_param_request_t, it is copied
+ * @param[in] data_ptr pointer to data buffer to send or receive data, must stay valid until completion
+ * @param[in] priority priority of the request, 0 is the highest priority
+ * @param[in] done_cb completion callback, can be NULL
+ * @param[in] arg user argument passed to the callback
+ *
+ * @return
+ *     - esp_err_t ESP_OK - the request is queued
+ *     - esp_err_t ESP_ERR_INVALID_ARG - invalid argument of function
+ *     - esp_err_t ESP_ERR_INVALID_STATE - the controller is not started
+ *     - esp_err_t ESP_ERR_NO_MEM - the queue is full
+ *     - esp_err_t ESP_ERR_NOT_SUPPORTED - the queue is disabled in the configuration
+ */
+esp_err_t mbc_master_submit(const mb_param_request_t* request, void* data_ptr, uint8_t priority,
+                                mb_master_done_cb_t done_cb, void* arg);
+
+/**
+ * @brief Get the response time statistics of a slave. The round trip time is measured
+ *        from the start of a request to its response and is the base of the adaptive
+ *        response timeout of the slave (see CONFIG_FMB_MASTER_ADAPTIVE_TIMEOUT).
+ *
+ * @param[in] slave_addr address of the slave
+ * @param[out] stats statistics of the slave
+ *
+ * @return
+ *     - esp_err_t ESP_OK - the statistics are returned
+ *     - esp_err_t ESP_ERR_INVALID_ARG - invalid argument of function
+ *     - esp_err_t ESP_ERR_NOT_FOUND - no request was sent to the slave or its statistics are not tracked
+ *     - esp_err_t ESP_ERR_NOT_SUPPORTED - the adaptive timeout is disabled in the configuration
+ */
+esp_err_t mbc_master_get_slave_stats(uint8_t slave_addr, mb_master_slave_stats_t* stats);
+
+/**
+ * @brief Get the connection statistics of a Modbus TCP slave. Each slave is connected on its own
+ *        and reconnected with an exponential backoff (see CONFIG_FMB_MASTER_TCP_RECONNECT_MIN_MS).
+ *
+ * @param[in] slave_addr address of the slave
+ * @param[out] stats statistics of the slave
+ *
+ * @return
+ *     - esp_err_t ESP_OK - the statistics are returned
+ *     - esp_err_t ESP_ERR_INVALID_ARG - invalid argument of function
+ *     - esp_err_t ESP_ERR_NOT_FOUND - the slave is not registered
+ *     - esp_err_t ESP_ERR_NOT_SUPPORTED - the master is not a TCP master or the concurrent mode is disabled
+ */
+esp_err_t mbc_master_get_slave_conn_stats(uint8_t slave_addr, mb_master_conn_stats_t* stats);
+
+/**
+ * @brief Set the callback which reports the health changes of the slaves of the selected master.
+ *        A slave which missed CONFIG_FMB_MASTER_BREAKER_FAILURES responses in a row is skipped:
+ *        its requests fail with ESP_ERR_NOT_ALLOWED until a probe request is answered.
+ *
+ * @param[in] cb callback function, NULL to remove it
+ * @param[in] arg user argument passed to the callback
+ *
+ * @return
+ *     - esp_err_t ESP_OK - the callback is set
+ *     - esp_err_t ESP_ERR_NOT_SUPPORTED - the health tracking is disabled in the configuration
+ */
+esp_err_t mbc_master_set_health_cb(mb_master_health_cb_t cb, void* arg);
+
+/**
+ * @brief Get the health of a slave
+ *
+ * @param[in] slave_addr address of the slave
+ * @param[out] state health of the slave
+ *
+ * @return
+ *     - esp_err_t ESP_OK - the health is returned
+ *     - esp_err_t ESP_ERR_INVALID_ARG - invalid argument of function
+ *     - esp_err_t ESP_ERR_NOT_SUPPORTED - the health tracking is disabled in the configuration
+ */
+esp_err_t mbc_master_get_slave_health(uint8_t slave_addr, mb_slave_health_t* state);
+
 /**
  * @brief Get information about supported characteristic defined as cid. Uses parameter description table to get
  *        this information. The function will check if characteristic defined as a cid parameter is supported
@@ -234,6 +413,7 @@ esp_err_t mbc_master_get_cid_info(uint16_t cid, const mb_parameter_descriptor_t*
  *     - esp_err_t ESP_ERR_INVALID_STATE - invalid state during data processing or allocation failure
  *     - esp_err_t ESP_ERR_TIMEOUT - operation timed out and no response from slave
  *     - esp_err_t ESP_ERR_NOT_SUPPORTED - the request command is not supported by slave
+ *     - esp_err_t ESP_ERR_NOT_ALLOWED - the slave is skipped after missed responses
  *     - esp_err_t ESP_ERR_NOT_FOUND - the parameter is not found in the parameter description table
  *     - esp_err_t ESP_FAIL - slave returned an exception or other failure
 */
@@ -255,6 +435,7 @@ esp_err_t mbc_master_get_parameter(uint16_t cid, char* name, uint8_t* value, uin
  *     - esp_err_t ESP_ERR_INVALID_STATE - invalid state during data processing or allocation failure
  *     - esp_err_t ESP_ERR_TIMEOUT - operation timed out and no response from slave
  *     - esp_err_t ESP_ERR_NOT_SUPPORTED - the request command is not supported by slave
+ *     - esp_err_t ESP_ERR_NOT_ALLOWED - the slave is skipped after missed responses
  *     - esp_err_t ESP_FAIL - slave returned an exception or other failure
 */
 esp_err_t mbc_master_set_parameter(uint16_t cid, char* name, uint8_t* value, uint8_t *type);
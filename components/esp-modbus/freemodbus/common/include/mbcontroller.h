@@ -19,5 +19,6 @@
 
 #include "esp_modbus_master.h"
 #include "esp_modbus_slave.h"
+#include "esp_modbus_gateway.h"
 
 #endif
@@ -21,6 +21,17 @@
 
 /* ----------------------- Defines ------------------------------------------*/
 
+#define MB_MASTER_SUBMIT_QUEUE_SIZE         (CONFIG_FMB_MASTER_SUBMIT_QUEUE_SIZE) // Requests waiting for the submit worker
+
+#ifdef CONFIG_FMB_MASTER_SLAVE_BREAKER
+#define MB_MASTER_BREAKER_ENABLED           (1)
+#define MB_MASTER_BREAKER_FAILURES          (CONFIG_FMB_MASTER_BREAKER_FAILURES) // Missed responses before a slave is skipped
+#define MB_MASTER_BREAKER_BACKOFF_MIN_MS    (CONFIG_FMB_MASTER_BREAKER_BACKOFF_MIN_MS)
+#define MB_MASTER_BREAKER_BACKOFF_MAX_MS    (CONFIG_FMB_MASTER_BREAKER_BACKOFF_MAX_MS)
+#else
+#define MB_MASTER_BREAKER_ENABLED           (0)
+#endif
+
 /**
  * @brief Request mode for parameter to use in data dictionary
  */
@@ -58,6 +69,7 @@ typedef struct mb_slave_addr_entry_s{
  */
 typedef struct {
     mb_port_type_t port_type;                           /*!< Modbus port type */
+    uint8_t mbm_instance;                               /*!< Master stack instance of the controller */
     mb_communication_info_t mbm_comm;                   /*!< Modbus communication info */
     uint8_t* mbm_reg_buffer_ptr;                        /*!< Modbus data buffer pointer */
     uint16_t mbm_reg_buffer_size;                       /*!< Modbus data buffer size */
@@ -65,6 +77,8 @@ typedef struct {
     EventGroupHandle_t mbm_event_group;                 /*!< Modbus controller event group */
     const mb_parameter_descriptor_t* mbm_param_descriptor_table; /*!< Modbus controller parameter description table */
     size_t mbm_param_descriptor_size;                   /*!< Modbus controller parameter description table size*/
+    uint16_t* mbm_param_key_index;                      /*!< Hash index of param_key, slots hold cid + 1, 0 is empty */
+    uint16_t mbm_param_key_index_mask;                  /*!< Number of slots in the key index minus one */
 #if MB_MASTER_TCP_ENABLED
     LIST_HEAD(mbm_slave_addr_info_, mb_slave_addr_entry_s) mbm_slave_list; /*!< Slave address information list */
     uint16_t mbm_slave_list_count;
@@ -73,9 +87,12 @@ typedef struct {
 
 typedef esp_err_t (*iface_get_cid_info)(uint16_t, const mb_parameter_descriptor_t**); /*!< Interface get_cid_info method */
 typedef esp_err_t (*iface_get_parameter)(uint16_t, char*, uint8_t*, uint8_t*);        /*!< Interface get_parameter method */
+typedef esp_err_t (*iface_get_parameter_cached)(uint16_t, char*, uint8_t*, uint8_t*, bool*); /*!< Interface get_parameter_cached method */
 typedef esp_err_t (*iface_send_request)(mb_param_request_t*, void*);                  /*!< Interface send_request method */
 typedef esp_err_t (*iface_set_descriptor)(const mb_parameter_descriptor_t*, const uint16_t); /*!< Interface set_descriptor method */
 typedef esp_err_t (*iface_set_parameter)(uint16_t, char*, uint8_t*, uint8_t*);        /*!< Interface set_parameter method */
+typedef esp_err_t (*iface_submit_request)(mb_param_request_t*, void*, mb_master_done_cb_t, void*); /*!< Interface submit_request method */
+typedef esp_err_t (*iface_get_conn_stats)(uint8_t, mb_master_conn_stats_t*);         /*!< Interface get_conn_stats method */
 
 /**
  * @brief Modbus controller interface structure
@@ -91,9 +108,12 @@ typedef struct {
     iface_start start;                      /*!< Interface method start */
     iface_get_cid_info get_cid_info;        /*!< Interface get_cid_info method */
     iface_get_parameter get_parameter;      /*!< Interface get_parameter method */
+    iface_get_parameter_cached get_parameter_cached; /*!< Optional get_parameter method which tells if the result was served from a cached response without a request, NULL if not supported */
     iface_send_request send_request;        /*!< Interface send_request method */
     iface_set_descriptor set_descriptor;    /*!< Interface set_descriptor method */
     iface_set_parameter set_parameter;      /*!< Interface set_parameter method */
+    iface_submit_request submit_request;    /*!< Optional method to send a request without waiting for the response, NULL if not supported */
+    iface_get_conn_stats get_conn_stats;    /*!< Optional method to get the connection statistics of a slave, NULL if not supported */
     // Modbus register calback function pointers
     reg_discrete_cb master_reg_cb_discrete; /*!< Stack callback discrete rw method */
     reg_input_cb master_reg_cb_input;       /*!< Stack callback input rw method */
@@ -101,4 +121,34 @@ typedef struct {
     reg_coils_cb master_reg_cb_coils;       /*!< Stack callback coils rw method */
 } mb_master_interface_t;
 
+/**
+ * @brief Build the name index of the parameter description table set in the options
+ *
+ * @param[in] mbm_opts master options with the descriptor table already set
+ *
+ * @return
+ *     - ESP_OK on success
+ *     - ESP_ERR_NO_MEM if the index can not be allocated
+ */
+esp_err_t mbc_master_build_key_index(mb_master_options_t* mbm_opts);
+
+/**
+ * @brief Free the name index of the parameter description table
+ */
+void mbc_master_free_key_index(mb_master_options_t* mbm_opts);
+
+/**
+ * @brief Find the characteristic by its name
+ *
+ * The entry at cid is checked first, the hash index is used if its key differs.
+ *
+ * @param[in] mbm_opts master options with the descriptor table and index set
+ * @param[in] cid expected cid of the characteristic
+ * @param[in] name parameter key of the characteristic
+ *
+ * @return pointer to the descriptor or NULL if there is no characteristic with this name
+ */
+const mb_parameter_descriptor_t* mbc_master_find_param(const mb_master_options_t* mbm_opts,
+                                                        uint16_t cid, const char* name);
+
 #endif //_MB_CONTROLLER_MASTER_H
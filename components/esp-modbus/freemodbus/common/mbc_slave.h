@@ -55,6 +55,8 @@ typedef struct {
     EventGroupHandle_t mbs_event_group;                 /*!< controller event group */
     QueueHandle_t mbs_notification_queue_handle;        /*!< controller notification queue */
     LIST_HEAD(mbs_area_descriptors_, mb_descr_entry_s) mbs_area_descriptors[MB_PARAM_COUNT]; /*!< register area descriptors */
+    mb_descr_entry_t** mbs_area_index[MB_PARAM_COUNT]; /*!< area descriptors of each type sorted by start offset */
+    uint16_t mbs_area_count[MB_PARAM_COUNT];            /*!< number of areas in the sorted index */
 } mb_slave_options_t;
 
 typedef mb_event_group_t (*iface_check_event)(mb_event_group_t);          /*!< Interface method check_event */
@@ -64,9 +64,7 @@ typedef enum
 typedef enum
 {
     STATE_TX_IDLE,              /*!< Transmitter is in idle state. */
-    STATE_TX_START,             /*!< Starting transmission (':' sent). */
-    STATE_TX_DATA,              /*!< Sending of data (Address, Data, LRC). */
-    STATE_TX_END,               /*!< End of transmission. */
+    STATE_TX_START,             /*!< Frame is ready to be encoded and sent. */
     STATE_TX_NOTIFY             /*!< Notify sender that the frame has been sent. */
 } eMBSndState;
 
@@ -102,6 +100,9 @@ static volatile USHORT usSndBufferCount;
 static volatile UCHAR ucLRC;
 static volatile UCHAR ucMBLFCharacter;
 
+/* ':', two characters per byte, CR and LF */
+static UCHAR ucASCIITxBuf[1 + 2 * MB_SER_PDU_SIZE_MAX + 2];
+
 /* ----------------------- Start implementation -----------------------------*/
 eMBErrorCode
 eMBASCIIInit( UCHAR ucSlaveAddress, UCHAR ucPort, ULONG ulBaudRate, eMBParity eParity )
@@ -345,56 +346,28 @@ BOOL
 xMBASCIITransmitFSM( void )
 {
     BOOL            xNeedPoll = TRUE;
-    UCHAR           ucByte;
+    USHORT          usTxLength;
 
     assert( eRcvState == STATE_RX_IDLE );
     switch ( eSndState )
     {
-        /* Start of transmission. The start of a frame is defined by sending
-         * the character ':'. */
+        /* The frame is encoded completely and handed to the port in one
+         * call: ':', each data byte as two hex characters with the high
+         * nibble first (address, data, LRC), then CR and LF. */
     case STATE_TX_START:
-        ucByte = ':';
-        xMBPortSerialPutByte( ( CHAR )ucByte );
-        eSndState = STATE_TX_DATA;
-        eBytePos = BYTE_HIGH_NIBBLE;
-        break;
-
-        /* Send the data block. Each data byte is encoded as a character hex
-         * stream with the high nibble sent first and the low nibble sent
-         * last. If all data bytes are exhausted we send a '\r' character
-         * to end the transmission. */
-    case STATE_TX_DATA:
-        if( usSndBufferCount > 0 )
+        usTxLength = 0;
+        ucASCIITxBuf[usTxLength++] = ':';
+        while( usSndBufferCount > 0 )
         {
-            switch ( eBytePos )
-            {
-            case BYTE_HIGH_NIBBLE:
-                ucByte = prvucMBBIN2CHAR( ( UCHAR )( *pucSndBufferCur >> 4 ) );
-                xMBPortSerialPutByte( ( CHAR ) ucByte );
-                eBytePos = BYTE_LOW_NIBBLE;
-                break;
-
-            case BYTE_LOW_NIBBLE:
-                ucByte = prvucMBBIN2CHAR( ( UCHAR )( *pucSndBufferCur & 0x0F ) );
-                xMBPortSerialPutByte( ( CHAR )ucByte );
-                pucSndBufferCur++;
-                eBytePos = BYTE_HIGH_NIBBLE;
-                usSndBufferCount--;
-                break;
-            }
+            ucASCIITxBuf[usTxLength++] = prvucMBBIN2CHAR( ( UCHAR )( *pucSndBufferCur >> 4 ) );
+            ucASCIITxBuf[usTxLength++] = prvucMBBIN2CHAR( ( UCHAR )( *pucSndBufferCur & 0x0F ) );
+            pucSndBufferCur++;
+            usSndBufferCount--;
         }
-        else
-        {
-            xMBPortSerialPutByte( MB_ASCII_DEFAULT_CR );
-            eSndState = STATE_TX_END;
-        }
-        break;
-
-        /* Finish the frame by sending a LF character. */
-    case STATE_TX_END:
-        xMBPortSerialPutByte( ( CHAR )ucMBLFCharacter );
-        /* We need another state to make sure that the CR character has
-         * been sent. */
+        ucASCIITxBuf[usTxLength++] = MB_ASCII_DEFAULT_CR;
+        ucASCIITxBuf[usTxLength++] = ucMBLFCharacter;
+        xMBPortSerialPutBytes( ucASCIITxBuf, usTxLength );
+        /* We need another state to make sure that the frame has been sent. */
         eSndState = STATE_TX_NOTIFY;
         break;
 
@@ -66,9 +66,7 @@ typedef enum
 typedef enum
 {
     STATE_M_TX_IDLE,            /*!< Transmitter is in idle state. */
-    STATE_M_TX_START,           /*!< Starting transmission (':' sent). */
-    STATE_M_TX_DATA,            /*!< Sending of data (Address, Data, LRC). */
-    STATE_M_TX_END,             /*!< End of transmission. */
+    STATE_M_TX_START,           /*!< Frame is ready to be encoded and sent. */
     STATE_M_TX_NOTIFY,          /*!< Notify sender that the frame has been sent. */
     STATE_M_TX_XFWR,            /*!< Transmitter is in transfer finish and wait receive state. */
 } eMBMasterAsciiSndState;
@@ -81,9 +79,8 @@ typedef enum
 
 /* ----------------------- Shared values  -----------------------------------*/
 /* These Modbus values are shared in ASCII mode*/
-extern volatile UCHAR   ucMasterRcvBuf[];
-extern volatile UCHAR   ucMasterSndBuf[];
-extern volatile eMBMasterTimerMode eMasterCurTimerMode;
+extern volatile UCHAR   ucMasterRcvBuf[MB_MASTER_INSTANCES][MB_SERIAL_BUF_SIZE];
+extern volatile UCHAR   ucMasterSndBuf[MB_MASTER_INSTANCES][MB_SERIAL_BUF_SIZE];
 
 /* ----------------------- Static functions ---------------------------------*/
 static UCHAR    prvucMBCHAR2BIN( UCHAR ucCharacter );
@@ -92,30 +89,44 @@ static UCHAR    prvucMBBIN2CHAR( UCHAR ucByte );
 
 static UCHAR    prvucMBLRC( UCHAR * pucFrame, USHORT usLen );
 
-/* ----------------------- Static variables ---------------------------------*/
-static volatile eMBMasterAsciiSndState eSndState;
-static volatile eMBMasterAsciiRcvState eRcvState;
+/* ----------------------- Type definitions ---------------------------------*/
+typedef struct
+{
+    volatile eMBMasterAsciiSndState eSndState;
+    volatile eMBMasterAsciiRcvState eRcvState;
+
+    volatile UCHAR  *ucMasterASCIIRcvBuf;
+    volatile UCHAR  *ucMasterASCIISndBuf;
+
+    volatile USHORT usMasterRcvBufferPos;
+    volatile eMBBytePos eBytePos;
+
+    volatile UCHAR  *pucMasterSndBufferCur;
+    volatile USHORT usMasterSndBufferCount;
 
-static volatile UCHAR *ucMasterASCIIRcvBuf = ucMasterRcvBuf;
-static volatile UCHAR *ucMasterASCIISndBuf = ucMasterSndBuf;
+    volatile UCHAR  ucMBLFCharacter;
 
-static volatile USHORT usMasterRcvBufferPos;
-static volatile eMBBytePos eBytePos;
+    /* ':', two characters per byte, CR and LF */
+    UCHAR           ucMasterASCIITxBuf[1 + 2 * MB_SER_PDU_SIZE_MAX + 2];
+} xMBMasterASCIIContext;
 
-static volatile UCHAR *pucMasterSndBufferCur;
-static volatile USHORT usMasterSndBufferCount;
+/* ----------------------- Static variables ---------------------------------*/
+static xMBMasterASCIIContext xASCIIContext[MB_MASTER_INSTANCES];
 
-static volatile UCHAR ucLRC;
-static volatile UCHAR ucMBLFCharacter;
+#define MB_ASCII_CTX( )     ( &xASCIIContext[ucMBMasterPortGetInstance( )] )
 
 /* ----------------------- Start implementation -----------------------------*/
 eMBErrorCode
 eMBMasterASCIIInit( UCHAR ucPort, ULONG ulBaudRate, eMBParity eParity )
 {
     eMBErrorCode    eStatus = MB_ENOERR;
+    UCHAR           ucInstance = ucMBMasterPortGetInstance(  );
+    xMBMasterASCIIContext *pxCtx = &xASCIIContext[ucInstance];
 
     ENTER_CRITICAL_SECTION(  );
-    ucMBLFCharacter = MB_ASCII_DEFAULT_LF;
+    pxCtx->ucMasterASCIIRcvBuf = ucMasterRcvBuf[ucInstance];
+    pxCtx->ucMasterASCIISndBuf = ucMasterSndBuf[ucInstance];
+    pxCtx->ucMBLFCharacter = MB_ASCII_DEFAULT_LF;
 
     if( xMBMasterPortSerialInit( ucPort, ulBaudRate, MB_ASCII_BITS_PER_SYMB, eParity ) != TRUE )
     {
@@ -134,8 +145,9 @@ eMBMasterASCIIInit( UCHAR ucPort, ULONG ulBaudRate, eMBParity eParity )
 void
 eMBMasterASCIIStart( void )
 {
+    xMBMasterASCIIContext *pxCtx = MB_ASCII_CTX( );
     ENTER_CRITICAL_SECTION(  );
-    eRcvState = STATE_M_RX_IDLE;
+    pxCtx->eRcvState = STATE_M_RX_IDLE;
     vMBMasterPortSerialEnable( TRUE, FALSE );
     xMBMasterPortEventPost(EV_MASTER_READY);
     EXIT_CRITICAL_SECTION(  );
@@ -153,9 +165,10 @@ eMBMasterASCIIStop( void )
 eMBErrorCode
 eMBMasterASCIIReceive( UCHAR * pucRcvAddress, UCHAR ** pucFrame, USHORT * pusLength )
 {
+    xMBMasterASCIIContext *pxCtx = MB_ASCII_CTX( );
     eMBErrorCode    eStatus = MB_ENOERR;
-    UCHAR          *pucMBASCIIFrame = ( UCHAR* ) ucMasterASCIIRcvBuf;
-    USHORT          usFrameLength = usMasterRcvBufferPos;
+    UCHAR          *pucMBASCIIFrame = ( UCHAR* ) pxCtx->ucMasterASCIIRcvBuf;
+    USHORT          usFrameLength = pxCtx->usMasterRcvBufferPos;
 
     if( xMBMasterPortSerialGetResponse( &pucMBASCIIFrame, &usFrameLength ) == FALSE )
     {
@@ -191,6 +204,7 @@ eMBMasterASCIIReceive( UCHAR * pucRcvAddress, UCHAR ** pucFrame, USHORT * pusLen
 eMBErrorCode
 eMBMasterASCIISend( UCHAR ucSlaveAddress, const UCHAR * pucFrame, USHORT usLength )
 {
+    xMBMasterASCIIContext *pxCtx = MB_ASCII_CTX( );
     eMBErrorCode    eStatus = MB_ENOERR;
     UCHAR           usLRC;
 
@@ -200,26 +214,26 @@ eMBMasterASCIISend( UCHAR ucSlaveAddress, const UCHAR * pucFrame, USHORT usLengt
      * slow with processing the received frame and the master sent another
      * frame on the network. We have to abort sending the frame.
      */
-    if(eRcvState == STATE_M_RX_IDLE)
+    if(pxCtx->eRcvState == STATE_M_RX_IDLE)
     {
         ENTER_CRITICAL_SECTION(  );
         /* First byte before the Modbus-PDU is the slave address. */
-        pucMasterSndBufferCur = ( UCHAR * ) pucFrame - 1;
-        usMasterSndBufferCount = 1;
+        pxCtx->pucMasterSndBufferCur = ( UCHAR * ) pucFrame - 1;
+        pxCtx->usMasterSndBufferCount = 1;
 
         /* Now copy the Modbus-PDU into the Modbus-Serial-Line-PDU. */
-        pucMasterSndBufferCur[MB_SER_PDU_ADDR_OFF] = ucSlaveAddress;
-        usMasterSndBufferCount += usLength;
+        pxCtx->pucMasterSndBufferCur[MB_SER_PDU_ADDR_OFF] = ucSlaveAddress;
+        pxCtx->usMasterSndBufferCount += usLength;
 
         /* Calculate LRC checksum for Modbus-Serial-Line-PDU. */
-        usLRC = prvucMBLRC( ( UCHAR * ) pucMasterSndBufferCur, usMasterSndBufferCount );
-        pucMasterSndBufferCur[usMasterSndBufferCount++] = usLRC;
+        usLRC = prvucMBLRC( ( UCHAR * ) pxCtx->pucMasterSndBufferCur, pxCtx->usMasterSndBufferCount );
+        pxCtx->pucMasterSndBufferCur[pxCtx->usMasterSndBufferCount++] = usLRC;
 
         /* Activate the transmitter. */
-        eSndState = STATE_M_TX_START;
+        pxCtx->eSndState = STATE_M_TX_START;
         EXIT_CRITICAL_SECTION(  );
 
-        if ( xMBMasterPortSerialSendRequest( ( UCHAR * ) pucMasterSndBufferCur, usMasterSndBufferCount ) == FALSE )
+        if ( xMBMasterPortSerialSendRequest( ( UCHAR * ) pxCtx->pucMasterSndBufferCur, pxCtx->usMasterSndBufferCount ) == FALSE )
         {
             eStatus = MB_EIO;
         }
@@ -235,16 +249,17 @@ eMBMasterASCIISend( UCHAR ucSlaveAddress, const UCHAR * pucFrame, USHORT usLengt
 BOOL
 xMBMasterASCIIReceiveFSM( void )
 {
+    xMBMasterASCIIContext *pxCtx = MB_ASCII_CTX( );
     BOOL            xNeedPoll = FALSE;
     UCHAR           ucByte;
     UCHAR           ucResult;
 
-    assert(( eSndState == STATE_M_TX_IDLE ) || ( eSndState == STATE_M_TX_XFWR ));
+    assert(( pxCtx->eSndState == STATE_M_TX_IDLE ) || ( pxCtx->eSndState == STATE_M_TX_XFWR ));
 
     /* Always read the character. */
     xNeedPoll = xMBMasterPortSerialGetByte( ( CHAR * ) & ucByte );
 
-    switch ( eRcvState )
+    switch ( pxCtx->eRcvState )
     {
         /* If we have received a character in the init state we have to
         * wait until the frame is finished.
@@ -271,10 +286,10 @@ xMBMasterASCIIReceiveFSM( void )
         if( ucByte == ':' )
         {
             /* Reset the input buffers to store the frame in receive state. */
-            usMasterRcvBufferPos = 0;
-            eBytePos = BYTE_HIGH_NIBBLE;
-            eRcvState = STATE_M_RX_RCV;
-            eSndState = STATE_M_TX_IDLE;
+            pxCtx->usMasterRcvBufferPos = 0;
+            pxCtx->eBytePos = BYTE_HIGH_NIBBLE;
+            pxCtx->eRcvState = STATE_M_RX_RCV;
+            pxCtx->eSndState = STATE_M_TX_IDLE;
         }
         break;
 
@@ -289,54 +304,54 @@ xMBMasterASCIIReceiveFSM( void )
         if( ucByte == ':' )
         {
             /* Empty receive buffer. */
-            eBytePos = BYTE_HIGH_NIBBLE;
-            usMasterRcvBufferPos = 0;
+            pxCtx->eBytePos = BYTE_HIGH_NIBBLE;
+            pxCtx->usMasterRcvBufferPos = 0;
         }
         else if( ucByte == MB_ASCII_DEFAULT_CR )
         {
-            eRcvState = STATE_M_RX_WAIT_EOF;
+            pxCtx->eRcvState = STATE_M_RX_WAIT_EOF;
         }
         else
         {
             ucResult = prvucMBCHAR2BIN( ucByte );
-            switch ( eBytePos )
+            switch ( pxCtx->eBytePos )
             {
                 /* High nibble of the byte comes first. We check for
                  * a buffer overflow here. */
             case BYTE_HIGH_NIBBLE:
-                if( usMasterRcvBufferPos < MB_SER_PDU_SIZE_MAX )
+                if( pxCtx->usMasterRcvBufferPos < MB_SER_PDU_SIZE_MAX )
                 {
-                    ucMasterASCIIRcvBuf[usMasterRcvBufferPos] = ( UCHAR )( ucResult << 4 );
-                    eBytePos = BYTE_LOW_NIBBLE;
+                    pxCtx->ucMasterASCIIRcvBuf[pxCtx->usMasterRcvBufferPos] = ( UCHAR )( ucResult << 4 );
+                    pxCtx->eBytePos = BYTE_LOW_NIBBLE;
                     break;
                 }
                 else
                 {
                     /* not handled in Modbus specification but seems
                      * a resonable implementation. */
-                    eRcvState = STATE_M_RX_ERROR;
+                    pxCtx->eRcvState = STATE_M_RX_ERROR;
                     /* Disable previously activated timer because of error state. */
                     vMBPortTimersDisable(  );
                 }
                 break;
 
             case BYTE_LOW_NIBBLE:
-                ucMasterASCIIRcvBuf[usMasterRcvBufferPos] |= ucResult;
-                usMasterRcvBufferPos++;
-                eBytePos = BYTE_HIGH_NIBBLE;
+                pxCtx->ucMasterASCIIRcvBuf[pxCtx->usMasterRcvBufferPos] |= ucResult;
+                pxCtx->usMasterRcvBufferPos++;
+                pxCtx->eBytePos = BYTE_HIGH_NIBBLE;
                 break;
             }
         }
         break;
 
     case STATE_M_RX_WAIT_EOF:
-        if( ucByte == ucMBLFCharacter )
+        if( ucByte == pxCtx->ucMBLFCharacter )
         {
             /* Disable character timeout timer because all characters are
              * received. */
             vMBMasterPortTimersDisable(  );
             /* Receiver is again in idle state. */
-            eRcvState = STATE_M_RX_IDLE;
+            pxCtx->eRcvState = STATE_M_RX_IDLE;
 
             /* Notify the caller of eMBMasterASCIIReceive that a new frame
              * was received. */
@@ -347,9 +362,9 @@ xMBMasterASCIIReceiveFSM( void )
         {
             /* Start of frame character received but last message is not completed.
              * Empty receive buffer and back to receive state. */
-            eBytePos = BYTE_HIGH_NIBBLE;
-            usMasterRcvBufferPos = 0;
-            eRcvState = STATE_M_RX_IDLE;
+            pxCtx->eBytePos = BYTE_HIGH_NIBBLE;
+            pxCtx->usMasterRcvBufferPos = 0;
+            pxCtx->eRcvState = STATE_M_RX_IDLE;
 
             /* Enable timer for respond timeout and wait for next frame. */
             vMBMasterPortTimersRespondTimeoutEnable(  );
@@ -357,7 +372,7 @@ xMBMasterASCIIReceiveFSM( void )
         else
         {
             /* Frame is not okay. Delete entire frame. */
-            eRcvState = STATE_M_RX_IDLE;
+            pxCtx->eRcvState = STATE_M_RX_IDLE;
         }
         break;
     }
@@ -368,13 +383,14 @@ xMBMasterASCIIReceiveFSM( void )
 BOOL
 xMBMasterASCIITransmitFSM( void )
 {
+    xMBMasterASCIIContext *pxCtx = MB_ASCII_CTX( );
     BOOL            xNeedPoll = TRUE;
-    UCHAR           ucByte;
+    USHORT          usTxLength;
     BOOL            xFrameIsBroadcast = FALSE;
 
-    assert( eRcvState == STATE_M_RX_IDLE );
+    assert( pxCtx->eRcvState == STATE_M_RX_IDLE );
 
-    switch ( eSndState )
+    switch ( pxCtx->eSndState )
     {
          /* We should not get a transmitter event if the transmitter is in
           * idle state.  */
@@ -386,61 +402,33 @@ xMBMasterASCIITransmitFSM( void )
     case STATE_M_TX_IDLE:
         break;
 
-        /* Start of transmission. The start of a frame is defined by sending
-         * the character ':'. */
+        /* The frame is encoded completely and handed to the port in one
+         * call: ':', each data byte as two hex characters with the high
+         * nibble first (address, data, LRC), then CR and LF. */
     case STATE_M_TX_START:
-        ucByte = ':';
-        xMBMasterPortSerialPutByte( ( CHAR )ucByte );
-        eSndState = STATE_M_TX_DATA;
-        eBytePos = BYTE_HIGH_NIBBLE;
-        break;
-
-        /* Send the data block. Each data byte is encoded as a character hex
-         * stream with the high nibble sent first and the low nibble sent
-         * last. If all data bytes are exhausted we send a '\r' character
-         * to end the transmission. */
-    case STATE_M_TX_DATA:
-        if( usMasterSndBufferCount > 0 )
+        usTxLength = 0;
+        pxCtx->ucMasterASCIITxBuf[usTxLength++] = ':';
+        while( pxCtx->usMasterSndBufferCount > 0 )
         {
-            switch ( eBytePos )
-            {
-            case BYTE_HIGH_NIBBLE:
-                ucByte = prvucMBBIN2CHAR( ( UCHAR )( *pucMasterSndBufferCur >> 4 ) );
-                xMBMasterPortSerialPutByte( ( CHAR ) ucByte );
-                eBytePos = BYTE_LOW_NIBBLE;
-                break;
-
-            case BYTE_LOW_NIBBLE:
-                ucByte = prvucMBBIN2CHAR( ( UCHAR )( *pucMasterSndBufferCur & 0x0F ) );
-                xMBMasterPortSerialPutByte( ( CHAR )ucByte );
-                pucMasterSndBufferCur++;
-                eBytePos = BYTE_HIGH_NIBBLE;
-                usMasterSndBufferCount--;
-                break;
-            }
+            pxCtx->ucMasterASCIITxBuf[usTxLength++] = prvucMBBIN2CHAR( ( UCHAR )( *pxCtx->pucMasterSndBufferCur >> 4 ) );
+            pxCtx->ucMasterASCIITxBuf[usTxLength++] = prvucMBBIN2CHAR( ( UCHAR )( *pxCtx->pucMasterSndBufferCur & 0x0F ) );
+            pxCtx->pucMasterSndBufferCur++;
+            pxCtx->usMasterSndBufferCount--;
         }
-        else
-        {
-            xMBMasterPortSerialPutByte( MB_ASCII_DEFAULT_CR );
-            eSndState = STATE_M_TX_END;
-        }
-        break;
-
-        /* Finish the frame by sending a LF character. */
-    case STATE_M_TX_END:
-        xMBMasterPortSerialPutByte( ( CHAR )ucMBLFCharacter );
-        /* We need another state to make sure that the CR character has
-         * been sent. */
-        eSndState = STATE_M_TX_NOTIFY;
+        pxCtx->ucMasterASCIITxBuf[usTxLength++] = MB_ASCII_DEFAULT_CR;
+        pxCtx->ucMasterASCIITxBuf[usTxLength++] = pxCtx->ucMBLFCharacter;
+        xMBMasterPortSerialPutBytes( pxCtx->ucMasterASCIITxBuf, usTxLength );
+        /* We need another state to make sure that the frame has been sent. */
+        pxCtx->eSndState = STATE_M_TX_NOTIFY;
         break;
 
         /* Notify the task which called eMBMasterASCIISend that the frame has
          * been sent. */
     case STATE_M_TX_NOTIFY:
-        xFrameIsBroadcast = ( ucMasterASCIISndBuf[MB_SEND_BUF_PDU_OFF - MB_SER_PDU_PDU_OFF]
+        xFrameIsBroadcast = ( pxCtx->ucMasterASCIISndBuf[MB_SEND_BUF_PDU_OFF - MB_SER_PDU_PDU_OFF]
                                                     == MB_ADDRESS_BROADCAST ) ? TRUE : FALSE;
         vMBMasterRequestSetType( xFrameIsBroadcast );
-        eSndState = STATE_M_TX_XFWR;
+        pxCtx->eSndState = STATE_M_TX_XFWR;
         /* If the frame is broadcast ,master will enable timer of convert delay,
          * else master will enable timer of respond timeout. */
         if ( xFrameIsBroadcast == TRUE )
@@ -461,9 +449,10 @@ xMBMasterASCIITransmitFSM( void )
 BOOL MB_PORT_ISR_ATTR
 xMBMasterASCIITimerT1SExpired( void )
 {
+    xMBMasterASCIIContext *pxCtx = MB_ASCII_CTX( );
     BOOL xNeedPoll = FALSE;
 
-    switch ( eRcvState )
+    switch ( pxCtx->eRcvState )
     {
         /* Timer t35 expired. Startup phase is finished. */
     case STATE_M_RX_INIT:
@@ -473,13 +462,13 @@ xMBMasterASCIITimerT1SExpired( void )
         /* Start of message is not received during respond timeout.
          * Process error. */
     case STATE_M_RX_IDLE:
-        eRcvState = STATE_M_RX_ERROR;
+        pxCtx->eRcvState = STATE_M_RX_ERROR;
         break;
 
         /* A recieve timeout expired and no any new character received.
          * Wait for respond time and go to error state to inform listener about error */
     case STATE_M_RX_RCV:
-        eRcvState = STATE_M_RX_ERROR;
+        pxCtx->eRcvState = STATE_M_RX_ERROR;
         break;
 
         /* An error occured while receiving the frame. */
@@ -492,16 +481,16 @@ xMBMasterASCIITimerT1SExpired( void )
          * the next frame.
          */
     case STATE_M_RX_WAIT_EOF:
-        eRcvState = STATE_M_RX_IDLE;
+        pxCtx->eRcvState = STATE_M_RX_IDLE;
         break;
 
     default:
         assert( 0 );
         break;
     }
-    eRcvState = STATE_M_RX_IDLE;
+    pxCtx->eRcvState = STATE_M_RX_IDLE;
 
-    switch (eSndState)
+    switch (pxCtx->eSndState)
     {
         /* A frame was send finish and convert delay or respond timeout expired.
          * If the frame is broadcast,The master will idle,and if the frame is not
@@ -515,12 +504,11 @@ xMBMasterASCIITimerT1SExpired( void )
 
         /* Function called in an illegal state. */
     default:
-        assert( ( eSndState == STATE_M_TX_START ) || ( eSndState == STATE_M_TX_IDLE )
-                || ( eSndState == STATE_M_TX_DATA ) || ( eSndState == STATE_M_TX_END )
-                || ( eSndState == STATE_M_TX_NOTIFY ) );
+        assert( ( pxCtx->eSndState == STATE_M_TX_START ) || ( pxCtx->eSndState == STATE_M_TX_IDLE )
+                || ( pxCtx->eSndState == STATE_M_TX_NOTIFY ) );
         break;
     }
-    eSndState = STATE_M_TX_IDLE;
+    pxCtx->eSndState = STATE_M_TX_IDLE;
 
     vMBMasterPortTimersDisable( );
     /* If timer mode is convert delay, the master event then turns EV_MASTER_EXECUTE status. */
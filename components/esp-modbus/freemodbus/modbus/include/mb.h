@@ -265,14 +265,25 @@ eMBErrorCode    eMBSetSlaveID( UCHAR ucSlaveID, BOOL xIsRunning,
  *   such a frame is received. If \c NULL a previously registered function handler
  *   for this function code is removed.
  *
- * \return eMBErrorCode::MB_ENOERR if the handler has been installed. If no
- *   more resources are available it returns eMBErrorCode::MB_ENORES. In this
- *   case the values in mbconfig.h should be adjusted. If the argument was not
- *   valid it returns eMBErrorCode::MB_EINVAL.
+ * \return eMBErrorCode::MB_ENOERR if the handler has been installed or
+ *   removed. If the argument was not valid it returns eMBErrorCode::MB_EINVAL.
  */
 eMBErrorCode    eMBRegisterCB( UCHAR ucFunctionCode,
                                pxMBFunctionHandler pxHandler );
 
+/*! \ingroup modbus
+ * \brief Number of requests received with a function code.
+ *
+ * Handlers are looked up in a table indexed by the function code, the
+ * counter of the code is incremented on every dispatch, also if no handler
+ * is registered for it.
+ *
+ * \param ucFunctionCode The Modbus function code, 1 to 127.
+ *
+ * \return The number of requests since start up.
+ */
+ULONG           ulMBGetFuncHits( UCHAR ucFunctionCode );
+
 /* ----------------------- Callback -----------------------------------------*/
 
 /*! \defgroup modbus_registers Modbus Registers
@@ -214,14 +214,25 @@ eMBErrorCode    eMBMasterPoll( void );
  *   such a frame is received. If \c NULL a previously registered function handler
  *   for this function code is removed.
  *
- * \return eMBErrorCode::MB_ENOERR if the handler has been installed. If no
- *   more resources are available it returns eMBErrorCode::MB_ENORES. In this
- *   case the values in mbconfig.h should be adjusted. If the argument was not
- *   valid it returns eMBErrorCode::MB_EINVAL.
+ * \return eMBErrorCode::MB_ENOERR if the handler has been installed or
+ *   removed. If the argument was not valid it returns eMBErrorCode::MB_EINVAL.
  */
 eMBErrorCode    eMBMasterRegisterCB( UCHAR ucFunctionCode,
                                pxMBFunctionHandler pxHandler );
 
+/*! \ingroup modbus
+ * \brief Number of responses received with a function code.
+ *
+ * Handlers are looked up in a table indexed by the function code, the
+ * counter of the code is incremented on every dispatch, also if no handler
+ * is registered for it.
+ *
+ * \param ucFunctionCode The Modbus function code, 1 to 127.
+ *
+ * \return The number of responses since start up.
+ */
+ULONG           ulMBMasterGetFuncHits( UCHAR ucFunctionCode );
+
 /* ----------------------- Callback -----------------------------------------*/
 
 /*! \defgroup modbus_master registers Modbus Registers
@@ -407,6 +418,7 @@ eMBMasterTimerMode xMBMasterGetCurTimerMode( void );
 BOOL xMBMasterRequestIsBroadcast( void );
 eMBMasterErrorEventType eMBMasterGetErrorType( void );
 void vMBMasterSetErrorType( eMBMasterErrorEventType errorType );
+eMBException eMBMasterGetException( void );
 eMBMasterReqErrCode eMBMasterWaitRequestFinish( void );
 eMBMode ucMBMasterGetCommMode( void );
 
@@ -99,6 +99,17 @@ PR_BEGIN_EXTERN_C
 #define MB_ASCII_BITS_PER_SYMB                  (  CONFIG_FMB_SERIAL_ASCII_BITS_PER_SYMB )
 #endif
 
+/*! \brief CRC16 engine of the RTU layer.
+ *
+ * 0 uses the two classic byte tables, 1 one table of 16 bit entries, 4 and 8
+ * process 4 or 8 bytes per step (slice-by-N).
+ */
+#ifdef CONFIG_FMB_CRC16_SLICES
+#define MB_CRC16_SLICES                         (  CONFIG_FMB_CRC16_SLICES )
+#else
+#define MB_CRC16_SLICES                         ( 0 )
+#endif
+
 #define MB_EVENT_QUEUE_SIZE                     ( CONFIG_FMB_CONTROLLER_NOTIFY_QUEUE_SIZE )
 #define MB_EVENT_QUEUE_TIMEOUT                  ( pdMS_TO_TICKS( CONFIG_FMB_EVENT_QUEUE_TIMEOUT ) )
 
@@ -125,15 +136,6 @@ PR_BEGIN_EXTERN_C
 #define MB_ASCII_TIMEOUT_WAIT_BEFORE_SEND_MS    ( 0 )
 #endif
 
-/*! \brief Maximum number of Modbus functions codes the protocol stack
- *    should support.
- *
- * The maximum number of supported Modbus functions must be greater than
- * the sum of all enabled functions in this file and custom function
- * handlers. If set to small adding more functions will fail.
- */
-#define MB_FUNC_HANDLERS_MAX                    ( 16 )
-
 /*! \brief Number of bytes which should be allocated for the <em>Report Slave ID
  *    </em>command.
  *
@@ -193,6 +195,27 @@ PR_BEGIN_EXTERN_C
 /*! \brief The total slaves in Modbus Master system.
  * \note : The slave ID must be continuous from 1.*/
 #define MB_MASTER_TOTAL_SLAVE_NUM               ( 247 )
+/*! \brief Number of master stacks which run at the same time. The state of
+ * the stack, the port and the frame layers is kept once per instance. */
+#ifdef CONFIG_FMB_MASTER_SERIAL_INSTANCES
+#define MB_MASTER_INSTANCES                     ( CONFIG_FMB_MASTER_SERIAL_INSTANCES )
+#else
+#define MB_MASTER_INSTANCES                     ( 1 )
+#endif
+/*! \brief If the response timeout adapts to the round trip time of each slave.
+ * The timeout is kept within MB_MASTER_ADAPTIVE_TIMEOUT_MIN_MS and
+ * MB_MASTER_ADAPTIVE_TIMEOUT_MAX_MS for up to MB_MASTER_ADAPTIVE_TIMEOUT_SLAVES
+ * slaves per instance. */
+#ifdef CONFIG_FMB_MASTER_ADAPTIVE_TIMEOUT
+#define MB_MASTER_ADAPTIVE_TIMEOUT_ENABLED      ( CONFIG_FMB_MASTER_ADAPTIVE_TIMEOUT )
+#define MB_MASTER_ADAPTIVE_TIMEOUT_MIN_MS       ( CONFIG_FMB_MASTER_ADAPTIVE_TIMEOUT_MIN_MS )
+#define MB_MASTER_ADAPTIVE_TIMEOUT_MAX_MS       ( CONFIG_FMB_MASTER_ADAPTIVE_TIMEOUT_MAX_MS )
+#define MB_MASTER_ADAPTIVE_TIMEOUT_SLAVES       ( CONFIG_FMB_MASTER_ADAPTIVE_TIMEOUT_SLAVES )
+#else
+#define MB_MASTER_ADAPTIVE_TIMEOUT_ENABLED      ( 0 )
+#endif
+/*! \brief Number of buckets of the round trip time histogram of a slave. */
+#define MB_MASTER_RTT_HIST_BUCKETS              ( 12 )
 #endif
 
 #endif
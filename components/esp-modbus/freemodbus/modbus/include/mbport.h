@@ -139,6 +139,29 @@ void            vMBMasterRunResRelease( void );
 
 uint64_t        xMBMasterPortGetTransactionId( void );
 
+/* ----------------------- Master instance functions ------------------------*/
+/* The master stack keeps its state once per instance. The functions of the
+ * stack and the port use the instance bound to the calling task, tasks which
+ * are not bound use the first instance. Port callbacks in an ISR or on a shared
+ * task select the instance from their context with ucMBMasterPortSetInstance( ). */
+#if MB_MASTER_INSTANCES > 1
+UCHAR           ucMBMasterPortGetInstance( void );
+
+UCHAR           ucMBMasterPortSetInstance( UCHAR ucInstance );
+
+BOOL            xMBMasterPortBindTask( TaskHandle_t xTask, UCHAR ucInstance );
+
+void            vMBMasterPortUnbindTask( TaskHandle_t xTask );
+
+void            vMBMasterPortUnbindInstance( UCHAR ucInstance );
+#else
+#define ucMBMasterPortGetInstance( )                ( 0 )
+#define ucMBMasterPortSetInstance( ucInstance )     ( ( void )( ucInstance ), ( UCHAR )0 )
+#define xMBMasterPortBindTask( xTask, ucInstance )  ( TRUE )
+#define vMBMasterPortUnbindTask( xTask )            ( ( void )( xTask ) )
+#define vMBMasterPortUnbindInstance( ucInstance )   ( ( void )( ucInstance ) )
+#endif
+
 #endif // MB_MASTER_RTU_ENABLED || MB_MASTER_ASCII_ENABLED || MB_MASTER_TCP_ENABLED
 /* ----------------------- Serial port functions ----------------------------*/
 
@@ -155,6 +178,8 @@ BOOL            xMBPortSerialGetByte( CHAR * pucByte );
 
 BOOL            xMBPortSerialPutByte( CHAR ucByte );
 
+BOOL            xMBPortSerialPutBytes( const UCHAR * pucBuf, USHORT usLength );
+
 BOOL            xMBPortSerialGetRequest( UCHAR **ppucMBSerialFrame, USHORT * pusSerialLength ) __attribute__ ((weak));
 
 BOOL            xMBPortSerialSendResponse( UCHAR *pucMBSerialFrame, USHORT usSerialLength ) __attribute__ ((weak));
@@ -171,8 +196,12 @@ void            vMBMasterPortSerialEnable( BOOL xRxEnable, BOOL xTxEnable );
 
 BOOL            xMBMasterPortSerialGetByte( CHAR * pucByte );
 
+USHORT          usMBMasterPortSerialGetBytes( UCHAR * pucBuf, USHORT usLength );
+
 BOOL            xMBMasterPortSerialPutByte( CHAR ucByte );
 
+BOOL            xMBMasterPortSerialPutBytes( const UCHAR * pucBuf, USHORT usLength );
+
 BOOL            xMBMasterPortSerialGetResponse( UCHAR **ppucMBSerialFrame, USHORT * usSerialLength );
 
 BOOL            xMBMasterPortSerialSendRequest( UCHAR *pucMBSerialFrame, USHORT usSerialLength );
@@ -205,6 +234,34 @@ void            vMBMasterPortTimersRespondTimeoutEnable( void );
 
 void            vMBMasterPortTimersDisable( void );
 
+/* ----------------- Response time of the slaves --------------------------*/
+#if MB_MASTER_ADAPTIVE_TIMEOUT_ENABLED
+/*! \brief Round trip time statistics of one slave. */
+typedef struct
+{
+    UCHAR           ucSlaveAddress;     /*!< address of the slave, 0 if the entry is free */
+    ULONG           ulSRTTUs;           /*!< smoothed round trip time */
+    ULONG           ulRTTVarUs;         /*!< smoothed mean deviation of the round trip time */
+    ULONG           ulRTTMinUs;         /*!< shortest round trip time */
+    ULONG           ulRTTMaxUs;         /*!< longest round trip time */
+    ULONG           ulTimeoutUs;        /*!< response timeout of the next request */
+    ULONG           ulResponses;        /*!< number of measured responses */
+    ULONG           ulTimeouts;         /*!< number of missed responses */
+    ULONG           ulHist[MB_MASTER_RTT_HIST_BUCKETS]; /*!< bucket 0 counts round trip times
+                                           below 1 ms, bucket n times from 2^(n-1) to 2^n ms,
+                                           the last bucket all longer times */
+} xMBMasterRespondStats;
+
+void            vMBMasterPortRespondTimeUpdate( UCHAR ucSlaveAddress, ULONG ulRespondTimeUs );
+
+void            vMBMasterPortRespondTimeoutExpired( UCHAR ucSlaveAddress );
+
+BOOL            xMBMasterPortGetRespondStats( UCHAR ucSlaveAddress, xMBMasterRespondStats *pxStats );
+#else
+#define vMBMasterPortRespondTimeUpdate( ucSlaveAddress, ulRespondTimeUs )
+#define vMBMasterPortRespondTimeoutExpired( ucSlaveAddress )
+#endif
+
 
 /* ----------------- Callback for the master error process ------------------*/
 void            vMBMasterErrorCBRespondTimeout( UCHAR ucDestAddress, const UCHAR* pucPDUData,
@@ -238,11 +295,16 @@ extern          BOOL( *pxMBFrameCBTransmitterEmpty ) ( void );
 extern          BOOL( *pxMBPortCBTimerExpired ) ( void );
 
 #if MB_MASTER_RTU_ENABLED || MB_MASTER_ASCII_ENABLED || MB_MASTER_TCP_ENABLED
-extern          BOOL( *pxMBMasterFrameCBByteReceived ) ( void );
+/* The master callbacks are set per instance, see ucMBMasterPortGetInstance( ). */
+extern          BOOL( *pxMBMasterFrameCBByteReceived[MB_MASTER_INSTANCES] ) ( void );
+
+/* Optional, receives all bytes buffered by the port at once. NULL if the
+ * transmission layer only has the byte receiver. */
+extern          BOOL( *pxMBMasterFrameCBBlockReceived[MB_MASTER_INSTANCES] ) ( USHORT usLength );
 
-extern          BOOL( *pxMBMasterFrameCBTransmitterEmpty ) ( void );
+extern          BOOL( *pxMBMasterFrameCBTransmitterEmpty[MB_MASTER_INSTANCES] ) ( void );
 
-extern          BOOL( *pxMBMasterPortCBTimerExpired ) ( void );
+extern          BOOL( *pxMBMasterPortCBTimerExpired[MB_MASTER_INSTANCES] ) ( void );
 #endif
 /* ----------------------- TCP port functions -------------------------------*/
 #if MB_TCP_ENABLED
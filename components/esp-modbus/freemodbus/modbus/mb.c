@@ -97,42 +97,45 @@ BOOL( *pxMBPortCBTimerExpired ) ( void );
 BOOL( *pxMBFrameCBReceiveFSMCur ) ( void );
 BOOL( *pxMBFrameCBTransmitFSMCur ) ( void );
 
-/* An array of Modbus functions handlers which associates Modbus function
- * codes with implementing functions.
+/* Modbus function handlers indexed by the function code. The built-in
+ * handlers are set here, custom ones are added with eMBRegisterCB( ).
  */
-static xMBFunctionHandler xFuncHandlers[MB_FUNC_HANDLERS_MAX] = {
+static pxMBFunctionHandler pxFuncHandlers[MB_FUNC_CODE_MAX + 1] = {
 #if MB_FUNC_OTHER_REP_SLAVEID_ENABLED > 0
-    {MB_FUNC_OTHER_REPORT_SLAVEID, eMBFuncReportSlaveID},
+    [MB_FUNC_OTHER_REPORT_SLAVEID] = eMBFuncReportSlaveID,
 #endif
 #if MB_FUNC_READ_INPUT_ENABLED > 0
-    {MB_FUNC_READ_INPUT_REGISTER, eMBFuncReadInputRegister},
+    [MB_FUNC_READ_INPUT_REGISTER] = eMBFuncReadInputRegister,
 #endif
 #if MB_FUNC_READ_HOLDING_ENABLED > 0
-    {MB_FUNC_READ_HOLDING_REGISTER, eMBFuncReadHoldingRegister},
+    [MB_FUNC_READ_HOLDING_REGISTER] = eMBFuncReadHoldingRegister,
 #endif
 #if MB_FUNC_WRITE_MULTIPLE_HOLDING_ENABLED > 0
-    {MB_FUNC_WRITE_MULTIPLE_REGISTERS, eMBFuncWriteMultipleHoldingRegister},
+    [MB_FUNC_WRITE_MULTIPLE_REGISTERS] = eMBFuncWriteMultipleHoldingRegister,
 #endif
 #if MB_FUNC_WRITE_HOLDING_ENABLED > 0
-    {MB_FUNC_WRITE_REGISTER, eMBFuncWriteHoldingRegister},
+    [MB_FUNC_WRITE_REGISTER] = eMBFuncWriteHoldingRegister,
 #endif
 #if MB_FUNC_READWRITE_HOLDING_ENABLED > 0
-    {MB_FUNC_READWRITE_MULTIPLE_REGISTERS, eMBFuncReadWriteMultipleHoldingRegister},
+    [MB_FUNC_READWRITE_MULTIPLE_REGISTERS] = eMBFuncReadWriteMultipleHoldingRegister,
 #endif
 #if MB_FUNC_READ_COILS_ENABLED > 0
-    {MB_FUNC_READ_COILS, eMBFuncReadCoils},
+    [MB_FUNC_READ_COILS] = eMBFuncReadCoils,
 #endif
 #if MB_FUNC_WRITE_COIL_ENABLED > 0
-    {MB_FUNC_WRITE_SINGLE_COIL, eMBFuncWriteCoil},
+    [MB_FUNC_WRITE_SINGLE_COIL] = eMBFuncWriteCoil,
 #endif
 #if MB_FUNC_WRITE_MULTIPLE_COILS_ENABLED > 0
-    {MB_FUNC_WRITE_MULTIPLE_COILS, eMBFuncWriteMultipleCoils},
+    [MB_FUNC_WRITE_MULTIPLE_COILS] = eMBFuncWriteMultipleCoils,
 #endif
 #if MB_FUNC_READ_DISCRETE_INPUTS_ENABLED > 0
-    {MB_FUNC_READ_DISCRETE_INPUTS, eMBFuncReadDiscreteInputs},
+    [MB_FUNC_READ_DISCRETE_INPUTS] = eMBFuncReadDiscreteInputs,
 #endif
 };
 
+/* Number of requests received for each function code. */
+static ULONG    ulFuncHits[MB_FUNC_CODE_MAX + 1];
+
 /* ----------------------- Start implementation -----------------------------*/
 eMBErrorCode
 eMBInit( eMBMode eMode, UCHAR ucSlaveAddress, UCHAR ucPort, ULONG ulBaudRate, eMBParity eParity )
@@ -238,41 +241,15 @@ eMBTCPInit( UCHAR ucSlaveUid, USHORT ucTCPPort )
 eMBErrorCode
 eMBRegisterCB( UCHAR ucFunctionCode, pxMBFunctionHandler pxHandler )
 {
-    int             i;
     eMBErrorCode    eStatus;
 
     if( ( 0 < ucFunctionCode ) && ( ucFunctionCode <= MB_FUNC_CODE_MAX ) )
     {
+        /* A NULL handler removes the function code. */
         ENTER_CRITICAL_SECTION(  );
-        if( pxHandler != NULL )
-        {
-            for( i = 0; i < MB_FUNC_HANDLERS_MAX; i++ )
-            {
-                if( ( xFuncHandlers[i].pxHandler == NULL ) ||
-                    ( xFuncHandlers[i].pxHandler == pxHandler ) )
-                {
-                    xFuncHandlers[i].ucFunctionCode = ucFunctionCode;
-                    xFuncHandlers[i].pxHandler = pxHandler;
-                    break;
-                }
-            }
-            eStatus = ( i != MB_FUNC_HANDLERS_MAX ) ? MB_ENOERR : MB_ENORES;
-        }
-        else
-        {
-            for( i = 0; i < MB_FUNC_HANDLERS_MAX; i++ )
-            {
-                if( xFuncHandlers[i].ucFunctionCode == ucFunctionCode )
-                {
-                    xFuncHandlers[i].ucFunctionCode = 0;
-                    xFuncHandlers[i].pxHandler = NULL;
-                    break;
-                }
-            }
-            /* Remove can't fail. */
-            eStatus = MB_ENOERR;
-        }
+        pxFuncHandlers[ucFunctionCode] = pxHandler;
         EXIT_CRITICAL_SECTION(  );
+        eStatus = MB_ENOERR;
     }
     else
     {
@@ -281,6 +258,12 @@ eMBRegisterCB( UCHAR ucFunctionCode, pxMBFunctionHandler pxHandler )
     return eStatus;
 }
 
+ULONG
+ulMBGetFuncHits( UCHAR ucFunctionCode )
+{
+    return ( ucFunctionCode <= MB_FUNC_CODE_MAX ) ? ulFuncHits[ucFunctionCode] : 0;
+}
+
 
 eMBErrorCode
 eMBClose( void )
@@ -350,7 +333,6 @@ eMBPoll( void )
     static USHORT   usLength;
     static eMBException eException;
 
-    int             i;
     eMBErrorCode    eStatus = MB_ENOERR;
     eMBEventType    eEvent;
 
@@ -392,17 +374,12 @@ eMBPoll( void )
             ESP_LOGD(MB_PORT_TAG, "%s:EV_EXECUTE", __func__);
             ucFunctionCode = ucMBFrame[MB_PDU_FUNC_OFF];
             eException = MB_EX_ILLEGAL_FUNCTION;
-            for( i = 0; i < MB_FUNC_HANDLERS_MAX; i++ )
+            if( ucFunctionCode <= MB_FUNC_CODE_MAX )
             {
-                /* No more function handlers registered. Abort. */
-                if( xFuncHandlers[i].ucFunctionCode == 0 )
-                {
-                    break;
-                }
-                if( xFuncHandlers[i].ucFunctionCode == ucFunctionCode )
+                ulFuncHits[ucFunctionCode]++;
+                if( pxFuncHandlers[ucFunctionCode] != NULL )
                 {
-                    eException = xFuncHandlers[i].pxHandler( ucMBFrame, &usLength );
-                    break;
+                    eException = pxFuncHandlers[ucFunctionCode]( ucMBFrame, &usLength );
                 }
             }
 
@@ -69,112 +69,138 @@
 #define MB_PORT_HAS_CLOSE 1
 #endif
 
-/* ----------------------- Static variables ---------------------------------*/
-
-static UCHAR ucMBMasterDestAddress;
-static BOOL xMBRunInMasterMode = FALSE;
-static volatile eMBMasterErrorEventType eMBMasterCurErrorType;
-static volatile USHORT usMasterSendPDULength;
-static volatile eMBMode eMBMasterCurrentMode;
-
-/*------------------------ Shared variables ---------------------------------*/
-
-volatile UCHAR ucMasterSndBuf[MB_SERIAL_BUF_SIZE];
-volatile UCHAR ucMasterRcvBuf[MB_SERIAL_BUF_SIZE];
-volatile eMBMasterTimerMode eMasterCurTimerMode;
-volatile BOOL xFrameIsBroadcast = FALSE;
-
-static enum
+/* ----------------------- Type definitions ---------------------------------*/
+typedef enum
 {
     STATE_ENABLED,
     STATE_DISABLED,
     STATE_NOT_INITIALIZED
-} eMBState = STATE_NOT_INITIALIZED;
+} eMBMasterState;
 
-/* Functions pointer which are initialized in eMBInit( ). Depending on the
- * mode (RTU or ASCII) the are set to the correct implementations.
- * Using for Modbus Master,Add by Armink 20130813
- */
-static peMBFrameSend peMBMasterFrameSendCur;
-static pvMBFrameStart pvMBMasterFrameStartCur;
-static pvMBFrameStop pvMBMasterFrameStopCur;
-static peMBFrameReceive peMBMasterFrameReceiveCur;
-static pvMBFrameClose pvMBMasterFrameCloseCur;
+/* State of one master instance. */
+typedef struct
+{
+    UCHAR ucMBMasterDestAddress;
+    BOOL xMBRunInMasterMode;
+    volatile eMBMasterErrorEventType eMBMasterCurErrorType;
+    volatile eMBException eMBMasterCurException;
+    volatile USHORT usMasterSendPDULength;
+    volatile eMBMode eMBMasterCurrentMode;
+    volatile eMBMasterTimerMode eMasterCurTimerMode;
+    volatile BOOL xFrameIsBroadcast;
+    eMBMasterState eMBState;
+
+    /* Functions pointer which are initialized in eMBInit( ). Depending on the
+     * mode (RTU or ASCII) the are set to the correct implementations.
+     * Using for Modbus Master,Add by Armink 20130813
+     */
+    peMBFrameSend peMBMasterFrameSendCur;
+    pvMBFrameStart pvMBMasterFrameStartCur;
+    pvMBFrameStop pvMBMasterFrameStopCur;
+    peMBFrameReceive peMBMasterFrameReceiveCur;
+    pvMBFrameClose pvMBMasterFrameCloseCur;
+
+    /* Transaction state of eMBMasterPoll( ) kept between the events. */
+    UCHAR *ucMBSendFrame;
+    UCHAR *ucMBRcvFrame;
+    UCHAR ucRcvAddress;
+    USHORT usLength;
+    uint64_t xCurTransactionId;
+} xMBMasterInstance;
+
+/* ----------------------- Static variables ---------------------------------*/
+static xMBMasterInstance xMBMasterInstances[MB_MASTER_INSTANCES] = {
+    [0 ... MB_MASTER_INSTANCES - 1] = { .eMBState = STATE_NOT_INITIALIZED }
+};
+
+#define MB_MASTER_INST( )   ( &xMBMasterInstances[ucMBMasterPortGetInstance( )] )
+
+/*------------------------ Shared variables ---------------------------------*/
+
+volatile UCHAR ucMasterSndBuf[MB_MASTER_INSTANCES][MB_SERIAL_BUF_SIZE];
+volatile UCHAR ucMasterRcvBuf[MB_MASTER_INSTANCES][MB_SERIAL_BUF_SIZE];
 
 /* Callback functions required by the porting layer. They are called when
  * an external event has happend which includes a timeout or the reception
  * or transmission of a character.
  * Using for Modbus Master,Add by Armink 20130813
  */
-BOOL( *pxMBMasterFrameCBByteReceived ) ( void );
+BOOL( *pxMBMasterFrameCBByteReceived[MB_MASTER_INSTANCES] ) ( void );
+
+BOOL( *pxMBMasterFrameCBBlockReceived[MB_MASTER_INSTANCES] ) ( USHORT usLength );
 
-BOOL( *pxMBMasterFrameCBTransmitterEmpty ) ( void );
+BOOL( *pxMBMasterFrameCBTransmitterEmpty[MB_MASTER_INSTANCES] ) ( void );
 
-BOOL( *pxMBMasterPortCBTimerExpired ) ( void );
+BOOL( *pxMBMasterPortCBTimerExpired[MB_MASTER_INSTANCES] ) ( void );
 
 BOOL( *pxMBMasterFrameCBReceiveFSMCur ) ( void );
 
 BOOL( *pxMBMasterFrameCBTransmitFSMCur ) ( void );
 
-/* An array of Modbus functions handlers which associates Modbus function
- * codes with implementing functions.
+/* Modbus function handlers indexed by the function code. The built-in
+ * handlers are set here, custom ones are added with eMBMasterRegisterCB( ).
  */
-static xMBFunctionHandler xMasterFuncHandlers[MB_FUNC_HANDLERS_MAX] = {
+static pxMBFunctionHandler pxMasterFuncHandlers[MB_FUNC_CODE_MAX + 1] = {
 #if MB_FUNC_OTHER_REP_SLAVEID_ENABLED > 0
-    {MB_FUNC_OTHER_REPORT_SLAVEID, eMBFuncReportSlaveID},
+    [MB_FUNC_OTHER_REPORT_SLAVEID] = eMBFuncReportSlaveID,
 #endif
 #if MB_FUNC_READ_INPUT_ENABLED > 0
-    {MB_FUNC_READ_INPUT_REGISTER, eMBMasterFuncReadInputRegister},
+    [MB_FUNC_READ_INPUT_REGISTER] = eMBMasterFuncReadInputRegister,
 #endif
 #if MB_FUNC_READ_HOLDING_ENABLED > 0
-    {MB_FUNC_READ_HOLDING_REGISTER, eMBMasterFuncReadHoldingRegister},
+    [MB_FUNC_READ_HOLDING_REGISTER] = eMBMasterFuncReadHoldingRegister,
 #endif
 #if MB_FUNC_WRITE_MULTIPLE_HOLDING_ENABLED > 0
-    {MB_FUNC_WRITE_MULTIPLE_REGISTERS, eMBMasterFuncWriteMultipleHoldingRegister},
+    [MB_FUNC_WRITE_MULTIPLE_REGISTERS] = eMBMasterFuncWriteMultipleHoldingRegister,
 #endif
 #if MB_FUNC_WRITE_HOLDING_ENABLED > 0
-    {MB_FUNC_WRITE_REGISTER, eMBMasterFuncWriteHoldingRegister},
+    [MB_FUNC_WRITE_REGISTER] = eMBMasterFuncWriteHoldingRegister,
 #endif
 #if MB_FUNC_READWRITE_HOLDING_ENABLED > 0
-    {MB_FUNC_READWRITE_MULTIPLE_REGISTERS, eMBMasterFuncReadWriteMultipleHoldingRegister},
+    [MB_FUNC_READWRITE_MULTIPLE_REGISTERS] = eMBMasterFuncReadWriteMultipleHoldingRegister,
 #endif
 #if MB_FUNC_READ_COILS_ENABLED > 0
-    {MB_FUNC_READ_COILS, eMBMasterFuncReadCoils},
+    [MB_FUNC_READ_COILS] = eMBMasterFuncReadCoils,
 #endif
 #if MB_FUNC_WRITE_COIL_ENABLED > 0
-    {MB_FUNC_WRITE_SINGLE_COIL, eMBMasterFuncWriteCoil},
+    [MB_FUNC_WRITE_SINGLE_COIL] = eMBMasterFuncWriteCoil,
 #endif
 #if MB_FUNC_WRITE_MULTIPLE_COILS_ENABLED > 0
-    {MB_FUNC_WRITE_MULTIPLE_COILS, eMBMasterFuncWriteMultipleCoils},
+    [MB_FUNC_WRITE_MULTIPLE_COILS] = eMBMasterFuncWriteMultipleCoils,
 #endif
 #if MB_FUNC_READ_DISCRETE_INPUTS_ENABLED > 0
-    {MB_FUNC_READ_DISCRETE_INPUTS, eMBMasterFuncReadDiscreteInputs},
+    [MB_FUNC_READ_DISCRETE_INPUTS] = eMBMasterFuncReadDiscreteInputs,
 #endif
 };
 
+/* Number of responses received for each function code. */
+static ULONG    ulMasterFuncHits[MB_FUNC_CODE_MAX + 1];
+
 /* ----------------------- Start implementation -----------------------------*/
 #if MB_MASTER_TCP_ENABLED
 eMBErrorCode
 eMBMasterTCPInit( USHORT ucTCPPort )
 {
+    UCHAR           ucInstance = ucMBMasterPortGetInstance( );
+    xMBMasterInstance *pxInst = &xMBMasterInstances[ucInstance];
     eMBErrorCode    eStatus = MB_ENOERR;
 
     if( ( eStatus = eMBMasterTCPDoInit( ucTCPPort ) ) != MB_ENOERR ) {
-        eMBState = STATE_DISABLED;
+        pxInst->eMBState = STATE_DISABLED;
     }
     else if( !xMBMasterPortEventInit(  ) ) {
         /* Port dependent event module initialization failed. */
         eStatus = MB_EPORTERR;
     } else {
-        pvMBMasterFrameStartCur = eMBMasterTCPStart;
-        pvMBMasterFrameStopCur = eMBMasterTCPStop;
-        peMBMasterFrameReceiveCur = eMBMasterTCPReceive;
-        peMBMasterFrameSendCur = eMBMasterTCPSend;
-        pxMBMasterPortCBTimerExpired = xMBMasterTCPTimerExpired;
-        pvMBMasterFrameCloseCur = MB_PORT_HAS_CLOSE ? vMBMasterTCPPortClose : NULL;
-        ucMBMasterDestAddress = MB_TCP_PSEUDO_ADDRESS;
-        eMBMasterCurrentMode = MB_TCP;
-        eMBState = STATE_DISABLED;
+        pxInst->pvMBMasterFrameStartCur = eMBMasterTCPStart;
+        pxInst->pvMBMasterFrameStopCur = eMBMasterTCPStop;
+        pxInst->peMBMasterFrameReceiveCur = eMBMasterTCPReceive;
+        pxInst->peMBMasterFrameSendCur = eMBMasterTCPSend;
+        pxMBMasterPortCBTimerExpired[ucInstance] = xMBMasterTCPTimerExpired;
+        pxInst->pvMBMasterFrameCloseCur = MB_PORT_HAS_CLOSE ? vMBMasterTCPPortClose : NULL;
+        pxInst->ucMBMasterDestAddress = MB_TCP_PSEUDO_ADDRESS;
+        pxInst->eMBMasterCurrentMode = MB_TCP;
+        pxInst->eMBState = STATE_DISABLED;
 
         // initialize the OS resource for modbus master.
         vMBMasterOsResInit();
@@ -191,36 +217,40 @@ eMBMasterTCPInit( USHORT ucTCPPort )
 eMBErrorCode
 eMBMasterSerialInit( eMBMode eMode, UCHAR ucPort, ULONG ulBaudRate, eMBParity eParity )
 {
+    UCHAR           ucInstance = ucMBMasterPortGetInstance( );
+    xMBMasterInstance *pxInst = &xMBMasterInstances[ucInstance];
     eMBErrorCode    eStatus = MB_ENOERR;
 
     switch (eMode)
     {
 #if MB_MASTER_RTU_ENABLED > 0
     case MB_RTU:
-        pvMBMasterFrameStartCur = eMBMasterRTUStart;
-        pvMBMasterFrameStopCur = eMBMasterRTUStop;
-        peMBMasterFrameSendCur = eMBMasterRTUSend;
-        peMBMasterFrameReceiveCur = eMBMasterRTUReceive;
-        pvMBMasterFrameCloseCur = MB_PORT_HAS_CLOSE ? vMBMasterPortClose : NULL;
-        pxMBMasterFrameCBByteReceived = xMBMasterRTUReceiveFSM;
-        pxMBMasterFrameCBTransmitterEmpty = xMBMasterRTUTransmitFSM;
-        pxMBMasterPortCBTimerExpired = xMBMasterRTUTimerExpired;
-        eMBMasterCurrentMode = MB_ASCII;
+        pxInst->pvMBMasterFrameStartCur = eMBMasterRTUStart;
+        pxInst->pvMBMasterFrameStopCur = eMBMasterRTUStop;
+        pxInst->peMBMasterFrameSendCur = eMBMasterRTUSend;
+        pxInst->peMBMasterFrameReceiveCur = eMBMasterRTUReceive;
+        pxInst->pvMBMasterFrameCloseCur = MB_PORT_HAS_CLOSE ? vMBMasterPortClose : NULL;
+        pxMBMasterFrameCBByteReceived[ucInstance] = xMBMasterRTUReceiveFSM;
+        pxMBMasterFrameCBBlockReceived[ucInstance] = xMBMasterRTUReceiveBlock;
+        pxMBMasterFrameCBTransmitterEmpty[ucInstance] = xMBMasterRTUTransmitFSM;
+        pxMBMasterPortCBTimerExpired[ucInstance] = xMBMasterRTUTimerExpired;
+        pxInst->eMBMasterCurrentMode = MB_ASCII;
 
         eStatus = eMBMasterRTUInit(ucPort, ulBaudRate, eParity);
         break;
 #endif
 #if MB_MASTER_ASCII_ENABLED > 0
     case MB_ASCII:
-        pvMBMasterFrameStartCur = eMBMasterASCIIStart;
-        pvMBMasterFrameStopCur = eMBMasterASCIIStop;
-        peMBMasterFrameSendCur = eMBMasterASCIISend;
-        peMBMasterFrameReceiveCur = eMBMasterASCIIReceive;
-        pvMBMasterFrameCloseCur = MB_PORT_HAS_CLOSE ? vMBMasterPortClose : NULL;
-        pxMBMasterFrameCBByteReceived = xMBMasterASCIIReceiveFSM;
-        pxMBMasterFrameCBTransmitterEmpty = xMBMasterASCIITransmitFSM;
-        pxMBMasterPortCBTimerExpired = xMBMasterASCIITimerT1SExpired;
-        eMBMasterCurrentMode = MB_RTU;
+        pxInst->pvMBMasterFrameStartCur = eMBMasterASCIIStart;
+        pxInst->pvMBMasterFrameStopCur = eMBMasterASCIIStop;
+        pxInst->peMBMasterFrameSendCur = eMBMasterASCIISend;
+        pxInst->peMBMasterFrameReceiveCur = eMBMasterASCIIReceive;
+        pxInst->pvMBMasterFrameCloseCur = MB_PORT_HAS_CLOSE ? vMBMasterPortClose : NULL;
+        pxMBMasterFrameCBByteReceived[ucInstance] = xMBMasterASCIIReceiveFSM;
+        pxMBMasterFrameCBBlockReceived[ucInstance] = NULL;
+        pxMBMasterFrameCBTransmitterEmpty[ucInstance] = xMBMasterASCIITransmitFSM;
+        pxMBMasterPortCBTimerExpired[ucInstance] = xMBMasterASCIITimerT1SExpired;
+        pxInst->eMBMasterCurrentMode = MB_RTU;
 
         eStatus = eMBMasterASCIIInit(ucPort, ulBaudRate, eParity );
         break;
@@ -239,7 +269,7 @@ eMBMasterSerialInit( eMBMode eMode, UCHAR ucPort, ULONG ulBaudRate, eMBParity eP
         }
         else
         {
-            eMBState = STATE_DISABLED;
+            pxInst->eMBState = STATE_DISABLED;
         }
         /* initialize the OS resource for modbus master. */
         vMBMasterOsResInit();
@@ -250,13 +280,14 @@ eMBMasterSerialInit( eMBMode eMode, UCHAR ucPort, ULONG ulBaudRate, eMBParity eP
 eMBErrorCode
 eMBMasterClose( void )
 {
+    xMBMasterInstance *pxInst = MB_MASTER_INST( );
     eMBErrorCode    eStatus = MB_ENOERR;
 
-    if( eMBState == STATE_DISABLED )
+    if( pxInst->eMBState == STATE_DISABLED )
     {
-        if( pvMBMasterFrameCloseCur != NULL )
+        if( pxInst->pvMBMasterFrameCloseCur != NULL )
         {
-            pvMBMasterFrameCloseCur(  );
+            pxInst->pvMBMasterFrameCloseCur(  );
         }
     }
     else
@@ -269,15 +300,16 @@ eMBMasterClose( void )
 eMBErrorCode
 eMBMasterEnable( void )
 {
+    xMBMasterInstance *pxInst = MB_MASTER_INST( );
     eMBErrorCode    eStatus = MB_ENOERR;
 
-    if( eMBState == STATE_DISABLED )
+    if( pxInst->eMBState == STATE_DISABLED )
     {
         /* Activate the protocol stack. */
-        pvMBMasterFrameStartCur(  );
+        pxInst->pvMBMasterFrameStartCur(  );
         /* Release the resource, because it created in busy state */
         //vMBMasterRunResRelease( );
-        eMBState = STATE_ENABLED;
+        pxInst->eMBState = STATE_ENABLED;
     }
     else
     {
@@ -289,15 +321,16 @@ eMBMasterEnable( void )
 eMBErrorCode
 eMBMasterDisable( void )
 {
+    xMBMasterInstance *pxInst = MB_MASTER_INST( );
     eMBErrorCode    eStatus;
 
-    if( eMBState == STATE_ENABLED )
+    if( pxInst->eMBState == STATE_ENABLED )
     {
-        pvMBMasterFrameStopCur(  );
-        eMBState = STATE_DISABLED;
+        pxInst->pvMBMasterFrameStopCur(  );
+        pxInst->eMBState = STATE_DISABLED;
         eStatus = MB_ENOERR;
     }
-    else if( eMBState == STATE_DISABLED )
+    else if( pxInst->eMBState == STATE_DISABLED )
     {
         eStatus = MB_ENOERR;
     }
@@ -308,24 +341,46 @@ eMBMasterDisable( void )
     return eStatus;
 }
 
+eMBErrorCode
+eMBMasterRegisterCB( UCHAR ucFunctionCode, pxMBFunctionHandler pxHandler )
+{
+    eMBErrorCode    eStatus;
+
+    if( ( 0 < ucFunctionCode ) && ( ucFunctionCode <= MB_FUNC_CODE_MAX ) )
+    {
+        /* A NULL handler removes the function code. */
+        ENTER_CRITICAL_SECTION(  );
+        pxMasterFuncHandlers[ucFunctionCode] = pxHandler;
+        EXIT_CRITICAL_SECTION(  );
+        eStatus = MB_ENOERR;
+    }
+    else
+    {
+        eStatus = MB_EINVAL;
+    }
+    return eStatus;
+}
+
+ULONG
+ulMBMasterGetFuncHits( UCHAR ucFunctionCode )
+{
+    return ( ucFunctionCode <= MB_FUNC_CODE_MAX ) ? ulMasterFuncHits[ucFunctionCode] : 0;
+}
+
 eMBErrorCode
 eMBMasterPoll( void )
 {
-    static UCHAR    *ucMBSendFrame = NULL;
-    static UCHAR    *ucMBRcvFrame = NULL;
-    static UCHAR    ucRcvAddress;
-    static UCHAR    ucFunctionCode;
-    static USHORT   usLength;
-    static eMBException eException;
-    static uint64_t xCurTransactionId = 0;
-    int             i;
+    xMBMasterInstance *pxInst = MB_MASTER_INST( );
+    UCHAR           ucFunctionCode;
+    eMBException    eException;
+    pxMBFunctionHandler pxHandler;
     int             j;
     eMBErrorCode    eStatus = MB_ENOERR;
     xMBMasterEventType      xEvent;
     eMBMasterErrorEventType errorType;
 
     /* Check if the protocol stack is ready. */
-    if( eMBState != STATE_ENABLED ) {
+    if( pxInst->eMBState != STATE_ENABLED ) {
         return MB_EILLSTATE;
     }
 
@@ -343,37 +398,41 @@ eMBMasterPoll( void )
             case EV_MASTER_FRAME_TRANSMIT:
                 ESP_LOGD(MB_PORT_TAG, "%" PRIu64 ":EV_MASTER_FRAME_TRANSMIT", xEvent.xTransactionId);
                 /* Master is busy now. */
-                vMBMasterGetPDUSndBuf( &ucMBSendFrame );
-                ESP_LOG_BUFFER_HEX_LEVEL("POLL transmit buffer", (void*)ucMBSendFrame, usMBMasterGetPDUSndLength(), ESP_LOG_DEBUG);
-                eStatus = peMBMasterFrameSendCur( ucMBMasterGetDestAddress(), ucMBSendFrame, usMBMasterGetPDUSndLength() );
+                atomic_store(&(pxInst->eMBMasterCurException), MB_EX_NONE);
+                vMBMasterGetPDUSndBuf( &pxInst->ucMBSendFrame );
+                ESP_LOG_BUFFER_HEX_LEVEL("POLL transmit buffer", (void*)pxInst->ucMBSendFrame, usMBMasterGetPDUSndLength(), ESP_LOG_DEBUG);
+                eStatus = pxInst->peMBMasterFrameSendCur( ucMBMasterGetDestAddress(), pxInst->ucMBSendFrame, usMBMasterGetPDUSndLength() );
                 if (eStatus != MB_ENOERR) {
                     vMBMasterSetErrorType(EV_ERROR_RECEIVE_DATA);
                     ( void ) xMBMasterPortEventPost( EV_MASTER_ERROR_PROCESS );
                     ESP_LOGE( MB_PORT_TAG, "%" PRIu64 ":Frame send error = %d", xEvent.xTransactionId, (unsigned)eStatus );
                 }
-                xCurTransactionId = xEvent.xTransactionId;
+                pxInst->xCurTransactionId = xEvent.xTransactionId;
                 break;
             case EV_MASTER_FRAME_SENT:
-                if (xCurTransactionId == xEvent.xTransactionId) {
+                if (pxInst->xCurTransactionId == xEvent.xTransactionId) {
                     ESP_LOGD( MB_PORT_TAG, "%" PRIu64 ":EV_MASTER_FRAME_SENT", xEvent.xTransactionId );
-                    ESP_LOG_BUFFER_HEX_LEVEL("POLL sent buffer", (void*)ucMBSendFrame, usMBMasterGetPDUSndLength(), ESP_LOG_DEBUG);
+                    ESP_LOG_BUFFER_HEX_LEVEL("POLL sent buffer", (void*)pxInst->ucMBSendFrame, usMBMasterGetPDUSndLength(), ESP_LOG_DEBUG);
                 }
                 break;
             case EV_MASTER_FRAME_RECEIVED:
                 ESP_LOGD( MB_PORT_TAG, "%" PRIu64 ":EV_MASTER_FRAME_RECEIVED", xEvent.xTransactionId );
-                eStatus = peMBMasterFrameReceiveCur( &ucRcvAddress, &ucMBRcvFrame, &usLength);
-                if (xCurTransactionId == xEvent.xTransactionId) {
-                    MB_PORT_CHECK(ucMBSendFrame, MB_EILLSTATE, "Send buffer initialization fail.");
+                eStatus = pxInst->peMBMasterFrameReceiveCur( &pxInst->ucRcvAddress, &pxInst->ucMBRcvFrame, &pxInst->usLength);
+                if (pxInst->xCurTransactionId == xEvent.xTransactionId) {
+                    MB_PORT_CHECK(pxInst->ucMBSendFrame, MB_EILLSTATE, "Send buffer initialization fail.");
                     // Check if the frame is for us. If not ,send an error process event.
-                    if ( ( eStatus == MB_ENOERR ) && ( ( ucRcvAddress == ucMBMasterGetDestAddress() )
-                                                    || ( ucRcvAddress == MB_TCP_PSEUDO_ADDRESS) ) ) {
-                        if ( ( ucMBRcvFrame[MB_PDU_FUNC_OFF]  & ~MB_FUNC_ERROR ) == ( ucMBSendFrame[MB_PDU_FUNC_OFF] ) ) {
+                    if ( ( eStatus == MB_ENOERR ) && ( ( pxInst->ucRcvAddress == ucMBMasterGetDestAddress() )
+                                                    || ( pxInst->ucRcvAddress == MB_TCP_PSEUDO_ADDRESS) ) ) {
+                        if ( ( pxInst->ucMBRcvFrame[MB_PDU_FUNC_OFF]  & ~MB_FUNC_ERROR ) == ( pxInst->ucMBSendFrame[MB_PDU_FUNC_OFF] ) ) {
                             ESP_LOGD(MB_PORT_TAG, "%" PRIu64 ": Packet data received successfully (%u).", xEvent.xTransactionId, (unsigned)eStatus);
-                            ESP_LOG_BUFFER_HEX_LEVEL("POLL receive buffer", (void*)ucMBRcvFrame, (uint16_t)usLength, ESP_LOG_DEBUG);
+                            ESP_LOG_BUFFER_HEX_LEVEL("POLL receive buffer", (void*)pxInst->ucMBRcvFrame, (uint16_t)pxInst->usLength, ESP_LOG_DEBUG);
+                            /* The transaction ID is the time the request was posted. */
+                            vMBMasterPortRespondTimeUpdate( ucMBMasterGetDestAddress( ),
+                                    ( ULONG )( xEvent.xPostTimestamp - pxInst->xCurTransactionId ) );
                             ( void ) xMBMasterPortEventPost( EV_MASTER_EXECUTE );
                         } else {
                             ESP_LOGE( MB_PORT_TAG, "Drop incorrect frame, receive_func(%u) != send_func(%u)",
-                                            ucMBRcvFrame[MB_PDU_FUNC_OFF], ucMBSendFrame[MB_PDU_FUNC_OFF]);
+                                            pxInst->ucMBRcvFrame[MB_PDU_FUNC_OFF], pxInst->ucMBSendFrame[MB_PDU_FUNC_OFF]);
                             vMBMasterSetErrorType(EV_ERROR_RECEIVE_DATA);
                             ( void ) xMBMasterPortEventPost( EV_MASTER_ERROR_PROCESS );
                         }
@@ -381,7 +440,7 @@ eMBMasterPoll( void )
                         vMBMasterSetErrorType(EV_ERROR_RECEIVE_DATA);
                         ( void ) xMBMasterPortEventPost( EV_MASTER_ERROR_PROCESS );
                         ESP_LOGD( MB_PORT_TAG, "%" PRIu64 ": Packet data receive failed (addr=%u)(%u).",
-                                               xEvent.xTransactionId, (unsigned)ucRcvAddress, (unsigned)eStatus);
+                                               xEvent.xTransactionId, (unsigned)pxInst->ucRcvAddress, (unsigned)eStatus);
                     }
                 } else {
                     // Ignore the `EV_MASTER_FRAME_RECEIVED` event because the respond timeout occurred
@@ -390,39 +449,34 @@ eMBMasterPoll( void )
                 }
                 break;
             case EV_MASTER_EXECUTE:
-                if (xCurTransactionId == xEvent.xTransactionId) {
-                    MB_PORT_CHECK(ucMBRcvFrame, MB_EILLSTATE, "receive buffer initialization fail.");
+                if (pxInst->xCurTransactionId == xEvent.xTransactionId) {
+                    MB_PORT_CHECK(pxInst->ucMBRcvFrame, MB_EILLSTATE, "receive buffer initialization fail.");
                     ESP_LOGD(MB_PORT_TAG, "%" PRIu64 ":EV_MASTER_EXECUTE", xEvent.xTransactionId);
-                    ucFunctionCode = ucMBRcvFrame[MB_PDU_FUNC_OFF];
+                    ucFunctionCode = pxInst->ucMBRcvFrame[MB_PDU_FUNC_OFF];
                     eException = MB_EX_ILLEGAL_FUNCTION;
                     /* If receive frame has exception. The receive function code highest bit is 1.*/
                     if (ucFunctionCode & MB_FUNC_ERROR) {
-                        eException = (eMBException)ucMBRcvFrame[MB_PDU_DATA_OFF];
+                        eException = (eMBException)pxInst->ucMBRcvFrame[MB_PDU_DATA_OFF];
+                        atomic_store(&(pxInst->eMBMasterCurException), eException);
                     } else {
-                        for ( i = 0; i < MB_FUNC_HANDLERS_MAX; i++ )
-                        {
-                            /* No more function handlers registered. Abort. */
-                            if (xMasterFuncHandlers[i].ucFunctionCode == 0) {
-                                break;
-                            }
-                            if (xMasterFuncHandlers[i].ucFunctionCode == ucFunctionCode) {
-                                vMBMasterSetCBRunInMasterMode(TRUE);
-                                /* If master request is broadcast,
-                                * the master need execute function for all slave.
-                                */
-                                if ( xMBMasterRequestIsBroadcast() ) {
-                                    usLength = usMBMasterGetPDUSndLength();
-                                    for(j = 1; j <= MB_MASTER_TOTAL_SLAVE_NUM; j++)
-                                    {
-                                        vMBMasterSetDestAddress(j);
-                                        eException = xMasterFuncHandlers[i].pxHandler(ucMBRcvFrame, &usLength);
-                                    }
-                                } else {
-                                    eException = xMasterFuncHandlers[i].pxHandler( ucMBRcvFrame, &usLength );
+                        ulMasterFuncHits[ucFunctionCode]++;
+                        pxHandler = pxMasterFuncHandlers[ucFunctionCode];
+                        if (pxHandler != NULL) {
+                            vMBMasterSetCBRunInMasterMode(TRUE);
+                            /* If master request is broadcast,
+                            * the master need execute function for all slave.
+                            */
+                            if ( xMBMasterRequestIsBroadcast() ) {
+                                pxInst->usLength = usMBMasterGetPDUSndLength();
+                                for(j = 1; j <= MB_MASTER_TOTAL_SLAVE_NUM; j++)
+                                {
+                                    vMBMasterSetDestAddress(j);
+                                    eException = pxHandler(pxInst->ucMBRcvFrame, &pxInst->usLength);
                                 }
-                                vMBMasterSetCBRunInMasterMode( FALSE );
-                                break;
+                            } else {
+                                eException = pxHandler( pxInst->ucMBRcvFrame, &pxInst->usLength );
                             }
+                            vMBMasterSetCBRunInMasterMode( FALSE );
                         }
                     }
                     /* If master has exception, will send error process event. Otherwise the master is idle.*/
@@ -441,24 +495,25 @@ eMBMasterPoll( void )
                 }
                 break;
             case EV_MASTER_ERROR_PROCESS:
-                if (xCurTransactionId == xEvent.xTransactionId) {
+                if (pxInst->xCurTransactionId == xEvent.xTransactionId) {
                     ESP_LOGD( MB_PORT_TAG, "%" PRIu64 ":EV_MASTER_ERROR_PROCESS", xEvent.xTransactionId);
                     /* Execute specified error process callback function. */
                     errorType = eMBMasterGetErrorType( );
-                    vMBMasterGetPDUSndBuf( &ucMBSendFrame );
+                    vMBMasterGetPDUSndBuf( &pxInst->ucMBSendFrame );
                     switch ( errorType )
                     {
                         case EV_ERROR_RESPOND_TIMEOUT:
+                            vMBMasterPortRespondTimeoutExpired( ucMBMasterGetDestAddress( ) );
                             vMBMasterErrorCBRespondTimeout( ucMBMasterGetDestAddress( ),
-                                    ucMBSendFrame, usMBMasterGetPDUSndLength( ) );
+                                    pxInst->ucMBSendFrame, usMBMasterGetPDUSndLength( ) );
                             break;
                         case EV_ERROR_RECEIVE_DATA:
                             vMBMasterErrorCBReceiveData( ucMBMasterGetDestAddress( ),
-                                    ucMBSendFrame, usMBMasterGetPDUSndLength( ) );
+                                    pxInst->ucMBSendFrame, usMBMasterGetPDUSndLength( ) );
                             break;
                         case EV_ERROR_EXECUTE_FUNCTION:
                             vMBMasterErrorCBExecuteFunction( ucMBMasterGetDestAddress( ),
-                                    ucMBSendFrame, usMBMasterGetPDUSndLength( ) );
+                                    pxInst->ucMBSendFrame, usMBMasterGetPDUSndLength( ) );
                             break;
                         case EV_ERROR_OK:
                             vMBMasterCBRequestSuccess( );
@@ -469,9 +524,9 @@ eMBMasterPoll( void )
                     }
                 }
                 vMBMasterPortTimersDisable( );
-                uint64_t xProcTime = xCurTransactionId ? ( xEvent.xPostTimestamp - xCurTransactionId ) : 0;
-                ESP_LOGD( MB_PORT_TAG, "Transaction (%" PRIu64 "), processing time(us) = %" PRId64, xCurTransactionId, xProcTime );
-                xCurTransactionId = 0;
+                uint64_t xProcTime = pxInst->xCurTransactionId ? ( xEvent.xPostTimestamp - pxInst->xCurTransactionId ) : 0;
+                ESP_LOGD( MB_PORT_TAG, "Transaction (%" PRIu64 "), processing time(us) = %" PRId64, pxInst->xCurTransactionId, xProcTime );
+                pxInst->xCurTransactionId = 0;
                 vMBMasterSetErrorType( EV_ERROR_INIT );
                 vMBMasterRunResRelease( );
                 break;
@@ -490,85 +545,105 @@ eMBMasterPoll( void )
 // Get whether the Modbus Master is run in master mode.
 BOOL xMBMasterGetCBRunInMasterMode( void )
 {
-    return atomic_load(&xMBRunInMasterMode);
+    xMBMasterInstance *pxInst = MB_MASTER_INST( );
+    return atomic_load(&pxInst->xMBRunInMasterMode);
 }
 
 // Set whether the Modbus Master is run in master mode.
 void vMBMasterSetCBRunInMasterMode( BOOL IsMasterMode )
 {
-    atomic_store(&(xMBRunInMasterMode), IsMasterMode);
+    xMBMasterInstance *pxInst = MB_MASTER_INST( );
+    atomic_store(&(pxInst->xMBRunInMasterMode), IsMasterMode);
 }
 
 // Get Modbus Master send destination address.
 UCHAR ucMBMasterGetDestAddress( void )
 {
-    return atomic_load(&ucMBMasterDestAddress);
+    xMBMasterInstance *pxInst = MB_MASTER_INST( );
+    return atomic_load(&pxInst->ucMBMasterDestAddress);
 }
 
 // Set Modbus Master send destination address.
 void vMBMasterSetDestAddress( UCHAR Address )
 {
-    atomic_store(&(ucMBMasterDestAddress), Address);
+    xMBMasterInstance *pxInst = MB_MASTER_INST( );
+    atomic_store(&(pxInst->ucMBMasterDestAddress), Address);
 }
 
 // Get Modbus Master current error event type.
 eMBMasterErrorEventType inline eMBMasterGetErrorType( void )
 {
-    return atomic_load(&eMBMasterCurErrorType);
+    xMBMasterInstance *pxInst = MB_MASTER_INST( );
+    return atomic_load(&pxInst->eMBMasterCurErrorType);
 }
 
 // Set Modbus Master current error event type.
 void IRAM_ATTR vMBMasterSetErrorType( eMBMasterErrorEventType errorType )
 {
-    atomic_store(&(eMBMasterCurErrorType), errorType);
+    xMBMasterInstance *pxInst = MB_MASTER_INST( );
+    atomic_store(&(pxInst->eMBMasterCurErrorType), errorType);
+}
+
+// Get the exception code of the last response of the slave, MB_EX_NONE if it had no exception.
+eMBException eMBMasterGetException( void )
+{
+    xMBMasterInstance *pxInst = MB_MASTER_INST( );
+    return atomic_load(&pxInst->eMBMasterCurException);
 }
 
 /* Get Modbus Master send PDU's buffer address pointer.*/
 void vMBMasterGetPDUSndBuf( UCHAR ** pucFrame )
 {
-    *pucFrame = ( UCHAR * ) &ucMasterSndBuf[MB_SEND_BUF_PDU_OFF];
+    *pucFrame = ( UCHAR * ) &ucMasterSndBuf[ucMBMasterPortGetInstance( )][MB_SEND_BUF_PDU_OFF];
 }
 
 /* Set Modbus Master send PDU's buffer length.*/
 void vMBMasterSetPDUSndLength( USHORT SendPDULength )
 {
-    atomic_store(&(usMasterSendPDULength), SendPDULength);
+    xMBMasterInstance *pxInst = MB_MASTER_INST( );
+    atomic_store(&(pxInst->usMasterSendPDULength), SendPDULength);
 }
 
 /* Get Modbus Master send PDU's buffer length.*/
 USHORT usMBMasterGetPDUSndLength( void )
 {
-    return atomic_load(&usMasterSendPDULength);
+    xMBMasterInstance *pxInst = MB_MASTER_INST( );
+    return atomic_load(&pxInst->usMasterSendPDULength);
 }
 
 /* Set Modbus Master current timer mode.*/
 void vMBMasterSetCurTimerMode( eMBMasterTimerMode eMBTimerMode )
 {
-    atomic_store(&(eMasterCurTimerMode), eMBTimerMode);
+    xMBMasterInstance *pxInst = MB_MASTER_INST( );
+    atomic_store(&(pxInst->eMasterCurTimerMode), eMBTimerMode);
 }
 
 /* Get Modbus Master current timer mode.*/
 eMBMasterTimerMode MB_PORT_ISR_ATTR xMBMasterGetCurTimerMode( void )
 {
-    return atomic_load(&eMasterCurTimerMode);
+    xMBMasterInstance *pxInst = MB_MASTER_INST( );
+    return atomic_load(&pxInst->eMasterCurTimerMode);
 }
 
 /* The master request is broadcast? */
 BOOL MB_PORT_ISR_ATTR xMBMasterRequestIsBroadcast( void )
 {
-    return xFrameIsBroadcast;
+    xMBMasterInstance *pxInst = MB_MASTER_INST( );
+    return pxInst->xFrameIsBroadcast;
 }
 
 /* The master request is broadcast? */
 void vMBMasterRequestSetType( BOOL xIsBroadcast )
 {
-    atomic_store(&(xFrameIsBroadcast), xIsBroadcast);
+    xMBMasterInstance *pxInst = MB_MASTER_INST( );
+    atomic_store(&(pxInst->xFrameIsBroadcast), xIsBroadcast);
 }
 
 // Get Modbus Master communication mode.
 eMBMode ucMBMasterGetCommMode(void)
 {
-    return eMBMasterCurrentMode;
+    xMBMasterInstance *pxInst = MB_MASTER_INST( );
+    return pxInst->eMBMasterCurrentMode;
 }
 
 #endif // MB_MASTER_RTU_ENABLED || MB_MASTER_ASCII_ENABLED || MB_MASTER_TCP_ENABLED
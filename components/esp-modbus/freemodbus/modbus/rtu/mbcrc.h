@@ -38,6 +38,12 @@
 #ifndef _MB_CRC_H
 #define _MB_CRC_H
 
+#define MB_CRC16_INIT   ( 0xFFFF )       /*!< Initial value of the incremental CRC. */
+
 USHORT          usMBCRC16( UCHAR * pucFrame, USHORT usLen );
 
+/* Continue a CRC16 over the next usLen bytes, start with MB_CRC16_INIT.
+ * The result over a complete frame including its CRC field is 0. */
+USHORT          usMBCRC16Update( USHORT usCRC, const UCHAR * pucData, USHORT usLen );
+
 #endif
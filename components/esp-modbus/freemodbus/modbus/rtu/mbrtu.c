@@ -317,9 +317,10 @@ xMBRTUTransmitFSM( void )
         /* check if we are finished. */
         if( usSndBufferCount != 0 )
         {
-            xMBPortSerialPutByte( ( CHAR )*pucSndBufferCur );
-            pucSndBufferCur++;  /* next byte in sendbuffer. */
-            usSndBufferCount--;
+            /* Hand the whole frame to the port so it goes out as one burst. */
+            xMBPortSerialPutBytes( ( UCHAR * ) pucSndBufferCur, usSndBufferCount );
+            pucSndBufferCur += usSndBufferCount;
+            usSndBufferCount = 0;
         }
         else
         {
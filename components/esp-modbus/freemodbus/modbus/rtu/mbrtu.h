@@ -66,6 +66,7 @@ void            eMBMasterRTUStop( void );
 eMBErrorCode    eMBMasterRTUReceive( UCHAR * pucRcvAddress, UCHAR ** pucFrame, USHORT * pusLength );
 eMBErrorCode    eMBMasterRTUSend( UCHAR slaveAddress, const UCHAR * pucFrame, USHORT usLength );
 BOOL            xMBMasterRTUReceiveFSM( void );
+BOOL            xMBMasterRTUReceiveBlock( USHORT usLength );
 BOOL            xMBMasterRTUTransmitFSM( void );
 BOOL            xMBMasterRTUTimerExpired( void );
 #endif
@@ -73,19 +73,30 @@ typedef enum
 
 #if MB_MASTER_RTU_ENABLED > 0
 /*------------------------ Shared variables ---------------------------------*/
-extern volatile UCHAR   ucMasterRcvBuf[];
-extern volatile UCHAR   ucMasterSndBuf[];
+extern volatile UCHAR   ucMasterRcvBuf[MB_MASTER_INSTANCES][MB_SERIAL_BUF_SIZE];
+extern volatile UCHAR   ucMasterSndBuf[MB_MASTER_INSTANCES][MB_SERIAL_BUF_SIZE];
 
-/* ----------------------- Static variables ---------------------------------*/
-static volatile eMBMasterSndState   eSndState;
-static volatile eMBMasterRcvState   eRcvState;
+/* ----------------------- Type definitions ---------------------------------*/
+typedef struct
+{
+    volatile eMBMasterSndState eSndState;
+    volatile eMBMasterRcvState eRcvState;
 
-static volatile UCHAR   *pucMasterSndBufferCur;
-static volatile USHORT  usMasterSndBufferCount;
-static volatile USHORT  usMasterRcvBufferPos;
+    volatile UCHAR  *pucMasterSndBufferCur;
+    volatile USHORT usMasterSndBufferCount;
+    volatile USHORT usMasterRcvBufferPos;
+    /* CRC of ucMasterRTURcvBuf[0..usMasterRcvBufferPos), kept up to date while
+     * the frame is received so that the check at the end is a compare. */
+    volatile USHORT usMasterRcvCRC;
 
-static volatile UCHAR *ucMasterRTURcvBuf = ucMasterRcvBuf;
-static volatile UCHAR *ucMasterRTUSndBuf = ucMasterSndBuf;
+    volatile UCHAR  *ucMasterRTURcvBuf;
+    volatile UCHAR  *ucMasterRTUSndBuf;
+} xMBMasterRTUContext;
+
+/* ----------------------- Static variables ---------------------------------*/
+static xMBMasterRTUContext xRTUContext[MB_MASTER_INSTANCES];
+
+#define MB_RTU_CTX( )       ( &xRTUContext[ucMBMasterPortGetInstance( )] )
 
 /* ----------------------- Start implementation -----------------------------*/
 eMBErrorCode
@@ -93,6 +104,14 @@ eMBMasterRTUInit(UCHAR ucPort, ULONG ulBaudRate, eMBParity eParity )
 {
     eMBErrorCode    eStatus = MB_ENOERR;
     ULONG           usTimerT35_50us;
+    UCHAR           ucInstance = ucMBMasterPortGetInstance(  );
+    xMBMasterRTUContext *pxCtx = &xRTUContext[ucInstance];
+
+    pxCtx->ucMasterRTURcvBuf = ucMasterRcvBuf[ucInstance];
+    pxCtx->ucMasterRTUSndBuf = ucMasterSndBuf[ucInstance];
+
+    /* Build the CRC tables now rather than while the first frame comes in. */
+    ( void )usMBCRC16Update( MB_CRC16_INIT, NULL, 0 );
 
     ENTER_CRITICAL_SECTION(  );
 
@@ -135,13 +154,14 @@ eMBMasterRTUInit(UCHAR ucPort, ULONG ulBaudRate, eMBParity eParity )
 void
 eMBMasterRTUStart( void )
 {
+    xMBMasterRTUContext *pxCtx = MB_RTU_CTX( );
     ENTER_CRITICAL_SECTION(  );
     /* Initially the receiver is in the state STATE_M_RX_INIT. we start
      * the timer and if no character is received within t3.5 we change
      * to STATE_M_RX_IDLE. This makes sure that we delay startup of the
      * modbus protocol stack until the bus is free.
      */
-    eRcvState = STATE_M_RX_INIT;
+    pxCtx->eRcvState = STATE_M_RX_INIT;
     vMBMasterPortSerialEnable( TRUE, FALSE );
     vMBMasterPortTimersT35Enable(  );
 
@@ -160,9 +180,11 @@ eMBMasterRTUStop( void )
 eMBErrorCode
 eMBMasterRTUReceive( UCHAR * pucRcvAddress, UCHAR ** pucFrame, USHORT * pusLength )
 {
+    xMBMasterRTUContext *pxCtx = MB_RTU_CTX( );
     eMBErrorCode    eStatus = MB_ENOERR;
-    UCHAR          *pucMBRTUFrame = ( UCHAR* ) ucMasterRTURcvBuf;
-    USHORT          usFrameLength = usMasterRcvBufferPos;
+    UCHAR          *pucMBRTUFrame = ( UCHAR* ) pxCtx->ucMasterRTURcvBuf;
+    USHORT          usFrameLength = pxCtx->usMasterRcvBufferPos;
+    USHORT          usCRC16;
 
     if( xMBMasterPortSerialGetResponse( &pucMBRTUFrame, &usFrameLength ) == FALSE )
     {
@@ -173,9 +195,18 @@ eMBMasterRTUReceive( UCHAR * pucRcvAddress, UCHAR ** pucFrame, USHORT * pusLengt
     assert( usFrameLength < MB_SER_PDU_SIZE_MAX );
     assert( pucMBRTUFrame );
 
+    /* The running CRC is valid only if the port returned the receive buffer as is. */
+    if( ( pucMBRTUFrame == ( UCHAR * ) pxCtx->ucMasterRTURcvBuf ) && ( usFrameLength == pxCtx->usMasterRcvBufferPos ) )
+    {
+        usCRC16 = pxCtx->usMasterRcvCRC;
+    }
+    else
+    {
+        usCRC16 = usMBCRC16( ( UCHAR * ) pucMBRTUFrame, usFrameLength );
+    }
+
     /* Length and CRC check */
-    if( ( usFrameLength >= MB_RTU_SER_PDU_SIZE_MIN )
-        && ( usMBCRC16( ( UCHAR * ) pucMBRTUFrame, usFrameLength ) == 0 ) )
+    if( ( usFrameLength >= MB_RTU_SER_PDU_SIZE_MIN ) && ( usCRC16 == 0 ) )
     {
         /* Save the address field. All frames are passed to the upper layer
          * and the decision if a frame is used is done there.
@@ -202,6 +233,7 @@ eMBMasterRTUReceive( UCHAR * pucRcvAddress, UCHAR ** pucFrame, USHORT * pusLengt
 eMBErrorCode
 eMBMasterRTUSend( UCHAR ucSlaveAddress, const UCHAR * pucFrame, USHORT usLength )
 {
+    xMBMasterRTUContext *pxCtx = MB_RTU_CTX( );
     eMBErrorCode    eStatus = MB_ENOERR;
     USHORT          usCRC16;
 
@@ -211,27 +243,27 @@ eMBMasterRTUSend( UCHAR ucSlaveAddress, const UCHAR * pucFrame, USHORT usLength
      * slow with processing the received frame and the master sent another
      * frame on the network. We have to abort sending the frame.
      */
-    if( eRcvState == STATE_M_RX_IDLE )
+    if( pxCtx->eRcvState == STATE_M_RX_IDLE )
     {
         ENTER_CRITICAL_SECTION(  );
         /* First byte before the Modbus-PDU is the slave address. */
-        pucMasterSndBufferCur = ( UCHAR * ) pucFrame - 1;
-        usMasterSndBufferCount = 1;
+        pxCtx->pucMasterSndBufferCur = ( UCHAR * ) pucFrame - 1;
+        pxCtx->usMasterSndBufferCount = 1;
 
         /* Now copy the Modbus-PDU into the Modbus-Serial-Line-PDU. */
-        pucMasterSndBufferCur[MB_SER_PDU_ADDR_OFF] = ucSlaveAddress;
-        usMasterSndBufferCount += usLength;
+        pxCtx->pucMasterSndBufferCur[MB_SER_PDU_ADDR_OFF] = ucSlaveAddress;
+        pxCtx->usMasterSndBufferCount += usLength;
 
         /* Calculate CRC16 checksum for Modbus-Serial-Line-PDU. */
-        usCRC16 = usMBCRC16( ( UCHAR * ) pucMasterSndBufferCur, usMasterSndBufferCount );
-        pucMasterSndBufferCur[usMasterSndBufferCount++] = ( UCHAR )( usCRC16 & 0xFF );
-        pucMasterSndBufferCur[usMasterSndBufferCount++] = ( UCHAR )( usCRC16 >> 8 );
+        usCRC16 = usMBCRC16( ( UCHAR * ) pxCtx->pucMasterSndBufferCur, pxCtx->usMasterSndBufferCount );
+        pxCtx->pucMasterSndBufferCur[pxCtx->usMasterSndBufferCount++] = ( UCHAR )( usCRC16 & 0xFF );
+        pxCtx->pucMasterSndBufferCur[pxCtx->usMasterSndBufferCount++] = ( UCHAR )( usCRC16 >> 8 );
         EXIT_CRITICAL_SECTION(  );
 
         /* Activate the transmitter. */
-        eSndState = STATE_M_TX_XMIT;
+        pxCtx->eSndState = STATE_M_TX_XMIT;
 
-        if ( xMBMasterPortSerialSendRequest( ( UCHAR * ) pucMasterSndBufferCur, usMasterSndBufferCount ) == FALSE )
+        if ( xMBMasterPortSerialSendRequest( ( UCHAR * ) pxCtx->pucMasterSndBufferCur, pxCtx->usMasterSndBufferCount ) == FALSE )
         {
             eStatus = MB_EIO;
         }
@@ -249,17 +281,18 @@ eMBMasterRTUSend( UCHAR ucSlaveAddress, const UCHAR * pucFrame, USHORT usLength
 BOOL
 xMBMasterRTUReceiveFSM( void )
 {
+    xMBMasterRTUContext *pxCtx = MB_RTU_CTX( );
     BOOL            xStatus = FALSE;
     UCHAR           ucByte;
 
-    if ( ( eSndState != STATE_M_TX_IDLE ) && ( eSndState != STATE_M_TX_XFWR ) ) {
+    if ( ( pxCtx->eSndState != STATE_M_TX_IDLE ) && ( pxCtx->eSndState != STATE_M_TX_XFWR ) ) {
         return FALSE;
     }
 
     /* Always read the character. */
     xStatus = xMBMasterPortSerialGetByte( ( CHAR * ) & ucByte );
 
-    switch ( eRcvState )
+    switch ( pxCtx->eRcvState )
     {
         /* If we have received a character in the init state we have to
          * wait until the frame is finished.
@@ -287,11 +320,12 @@ xMBMasterRTUReceiveFSM( void )
          */
         vMBMasterPortTimersDisable( );
 
-        usMasterRcvBufferPos = 0;
+        pxCtx->usMasterRcvBufferPos = 0;
         if( xStatus && ucByte ) {
-            ucMasterRTURcvBuf[usMasterRcvBufferPos++] = ucByte;
-            eRcvState = STATE_M_RX_RCV;
-            eSndState = STATE_M_TX_IDLE;
+            pxCtx->ucMasterRTURcvBuf[pxCtx->usMasterRcvBufferPos++] = ucByte;
+            pxCtx->usMasterRcvCRC = usMBCRC16Update( MB_CRC16_INIT, &ucByte, 1 );
+            pxCtx->eRcvState = STATE_M_RX_RCV;
+            pxCtx->eSndState = STATE_M_TX_IDLE;
         }
 
         /* Enable t3.5 timers. */
@@ -306,15 +340,16 @@ xMBMasterRTUReceiveFSM( void )
          * ignored.
          */
     case STATE_M_RX_RCV:
-        if( usMasterRcvBufferPos < MB_SER_PDU_SIZE_MAX )
+        if( pxCtx->usMasterRcvBufferPos < MB_SER_PDU_SIZE_MAX )
         {
             if ( xStatus ) {
-                ucMasterRTURcvBuf[usMasterRcvBufferPos++] = ucByte;
+                pxCtx->ucMasterRTURcvBuf[pxCtx->usMasterRcvBufferPos++] = ucByte;
+                pxCtx->usMasterRcvCRC = usMBCRC16Update( pxCtx->usMasterRcvCRC, &ucByte, 1 );
             }
         }
         else
         {
-            eRcvState = STATE_M_RX_ERROR;
+            pxCtx->eRcvState = STATE_M_RX_ERROR;
         }
 #if CONFIG_FMB_TIMER_PORT_ENABLED
         vMBMasterPortTimersT35Enable( );
@@ -324,17 +359,84 @@ xMBMasterRTUReceiveFSM( void )
     return xStatus;
 }
 
+/* Block variant of xMBMasterRTUReceiveFSM( ). The port hands over all bytes
+ * buffered by the driver when the line went idle, they are read with a single
+ * driver call straight into the receive buffer and the FSM is advanced by the
+ * whole length at once.
+ */
+BOOL
+xMBMasterRTUReceiveBlock( USHORT usLength )
+{
+    xMBMasterRTUContext *pxCtx = MB_RTU_CTX( );
+    USHORT          usRead;
+    USHORT          usSkip = 0;
+
+    if ( ( pxCtx->eSndState != STATE_M_TX_IDLE ) && ( pxCtx->eSndState != STATE_M_TX_XFWR ) ) {
+        return FALSE;
+    }
+
+    switch ( pxCtx->eRcvState )
+    {
+        /* Wait until the frame is finished, the bytes are of no use and
+         * are flushed by the port. */
+    case STATE_M_RX_INIT:
+    case STATE_M_RX_ERROR:
+        vMBMasterPortTimersT35Enable( );
+        break;
+
+    case STATE_M_RX_IDLE:
+        vMBMasterPortTimersDisable( );
+        pxCtx->usMasterRcvBufferPos = 0;
+        usRead = usMBMasterPortSerialGetBytes( ( UCHAR * ) pxCtx->ucMasterRTURcvBuf,
+                            ( usLength < MB_SER_PDU_SIZE_MAX ) ? usLength : MB_SER_PDU_SIZE_MAX );
+        /* Zero bytes ahead of the address are line noise, as in the byte receiver. */
+        while( ( usSkip < usRead ) && ( pxCtx->ucMasterRTURcvBuf[usSkip] == 0 ) ) {
+            usSkip++;
+        }
+        if( usSkip < usRead ) {
+            memmove( ( UCHAR * ) pxCtx->ucMasterRTURcvBuf, ( UCHAR * ) pxCtx->ucMasterRTURcvBuf + usSkip, usRead - usSkip );
+            pxCtx->usMasterRcvBufferPos = usRead - usSkip;
+            pxCtx->usMasterRcvCRC = usMBCRC16Update( MB_CRC16_INIT, ( UCHAR * ) pxCtx->ucMasterRTURcvBuf, pxCtx->usMasterRcvBufferPos );
+            pxCtx->eRcvState = ( usLength > MB_SER_PDU_SIZE_MAX ) ? STATE_M_RX_ERROR : STATE_M_RX_RCV;
+            pxCtx->eSndState = STATE_M_TX_IDLE;
+        }
+#if CONFIG_FMB_TIMER_PORT_ENABLED
+        vMBMasterPortTimersT35Enable( );
+#endif
+        break;
+
+        /* The frame is continued by another chunk. */
+    case STATE_M_RX_RCV:
+        if( ( pxCtx->usMasterRcvBufferPos + usLength ) <= MB_SER_PDU_SIZE_MAX )
+        {
+            usRead = usMBMasterPortSerialGetBytes( ( UCHAR * ) pxCtx->ucMasterRTURcvBuf + pxCtx->usMasterRcvBufferPos, usLength );
+            pxCtx->usMasterRcvCRC = usMBCRC16Update( pxCtx->usMasterRcvCRC, ( UCHAR * ) pxCtx->ucMasterRTURcvBuf + pxCtx->usMasterRcvBufferPos, usRead );
+            pxCtx->usMasterRcvBufferPos += usRead;
+        }
+        else
+        {
+            pxCtx->eRcvState = STATE_M_RX_ERROR;
+        }
+#if CONFIG_FMB_TIMER_PORT_ENABLED
+        vMBMasterPortTimersT35Enable( );
+#endif
+        break;
+    }
+    return TRUE;
+}
+
 BOOL
 xMBMasterRTUTransmitFSM( void )
 {
+    xMBMasterRTUContext *pxCtx = MB_RTU_CTX( );
     BOOL xNeedPoll = TRUE;
     BOOL xFrameIsBroadcast = FALSE;
 
-    if ( eRcvState != STATE_M_RX_IDLE ) {
+    if ( pxCtx->eRcvState != STATE_M_RX_IDLE ) {
         return FALSE;
     }
 
-    switch ( eSndState )
+    switch ( pxCtx->eSndState )
     {
         /* We should not get a transmitter event if the transmitter is in
          * idle state.  */
@@ -347,18 +449,19 @@ xMBMasterRTUTransmitFSM( void )
 
     case STATE_M_TX_XMIT:
         /* check if we are finished. */
-        if( usMasterSndBufferCount != 0 )
+        if( pxCtx->usMasterSndBufferCount != 0 )
         {
-            xMBMasterPortSerialPutByte( ( CHAR )*pucMasterSndBufferCur );
-            pucMasterSndBufferCur++;  /* next byte in sendbuffer. */
-            usMasterSndBufferCount--;
+            /* Hand the whole frame to the port so it goes out as one burst. */
+            xMBMasterPortSerialPutBytes( ( UCHAR * ) pxCtx->pucMasterSndBufferCur, pxCtx->usMasterSndBufferCount );
+            pxCtx->pucMasterSndBufferCur += pxCtx->usMasterSndBufferCount;
+            pxCtx->usMasterSndBufferCount = 0;
         }
         else
         {
-            xFrameIsBroadcast = ( ucMasterRTUSndBuf[MB_SEND_BUF_PDU_OFF - MB_SER_PDU_PDU_OFF]
+            xFrameIsBroadcast = ( pxCtx->ucMasterRTUSndBuf[MB_SEND_BUF_PDU_OFF - MB_SER_PDU_PDU_OFF]
                                                         == MB_ADDRESS_BROADCAST ) ? TRUE : FALSE;
             vMBMasterRequestSetType( xFrameIsBroadcast );
-            eSndState = STATE_M_TX_XFWR;
+            pxCtx->eSndState = STATE_M_TX_XFWR;
             /* If the frame is broadcast ,master will enable timer of convert delay,
              * else master will enable timer of respond timeout. */
             if ( xFrameIsBroadcast == TRUE )
@@ -379,9 +482,10 @@ xMBMasterRTUTransmitFSM( void )
 BOOL MB_PORT_ISR_ATTR
 xMBMasterRTUTimerExpired(void)
 {
+    xMBMasterRTUContext *pxCtx = MB_RTU_CTX( );
     BOOL xNeedPoll = FALSE;
 
-    switch (eRcvState)
+    switch (pxCtx->eRcvState)
     {
         /* Timer t35 expired. Startup phase is finished. */
     case STATE_M_RX_INIT:
@@ -403,12 +507,12 @@ xMBMasterRTUTimerExpired(void)
 
         /* Function called in an illegal state. */
     default:
-        assert(eRcvState == STATE_M_RX_IDLE);
+        assert(pxCtx->eRcvState == STATE_M_RX_IDLE);
         break;
     }
-    eRcvState = STATE_M_RX_IDLE;
+    pxCtx->eRcvState = STATE_M_RX_IDLE;
 
-    switch (eSndState)
+    switch (pxCtx->eSndState)
     {
         /* A frame was send finish and convert delay or respond timeout expired.
          * If the frame is broadcast,The master will idle,and if the frame is not
@@ -421,10 +525,10 @@ xMBMasterRTUTimerExpired(void)
         break;
         /* Function called in an illegal state. */
     default:
-        assert( ( eSndState == STATE_M_TX_XMIT ) || ( eSndState == STATE_M_TX_IDLE ));
+        assert( ( pxCtx->eSndState == STATE_M_TX_XMIT ) || ( pxCtx->eSndState == STATE_M_TX_IDLE ));
         break;
     }
-    eSndState = STATE_M_TX_IDLE;
+    pxCtx->eSndState = STATE_M_TX_IDLE;
 
     vMBMasterPortTimersDisable( );
     /* If timer mode is convert delay, the master event then turns EV_MASTER_EXECUTE status. */
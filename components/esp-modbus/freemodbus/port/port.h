@@ -39,6 +39,7 @@
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/queue.h"         // for queue
+#include "freertos/task.h"          // for task handle
 
 #include "esp_log.h"                // for ESP_LOGE macro
 #include "esp_timer.h"
@@ -90,6 +91,24 @@
 #define MB_TCP_SEND_TIMEOUT_MS          (500) // send event timeout in mS
 #define MB_TCP_SEND_TIMEOUT             (pdMS_TO_TICKS(MB_TCP_SEND_TIMEOUT_MS))
 #define MB_TCP_PORT_MAX_CONN            (CONFIG_FMB_TCP_PORT_MAX_CONN)
+#define MB_TCP_SLAVE_BUF_POOL_SIZE      ((CONFIG_FMB_TCP_SLAVE_BUF_POOL_SIZE < MB_TCP_PORT_MAX_CONN) ? \
+                                            CONFIG_FMB_TCP_SLAVE_BUF_POOL_SIZE : MB_TCP_PORT_MAX_CONN)
+#ifdef CONFIG_FMB_MASTER_TCP_CONCURRENT
+#define MB_TCP_MASTER_CONCURRENT        (1)
+#define MB_TCP_MASTER_REQUEST_WINDOW    (CONFIG_FMB_MASTER_TCP_REQUEST_WINDOW) // Outstanding requests per slave connection
+#define MB_TCP_MASTER_CONNECT_TIMEOUT_MS    (CONFIG_FMB_MASTER_TCP_CONNECT_TIMEOUT_MS) // Connect attempt timeout
+#define MB_TCP_MASTER_RECONNECT_MIN_MS      (CONFIG_FMB_MASTER_TCP_RECONNECT_MIN_MS) // Reconnect backoff limits
+#define MB_TCP_MASTER_RECONNECT_MAX_MS      (CONFIG_FMB_MASTER_TCP_RECONNECT_MAX_MS)
+#else
+#define MB_TCP_MASTER_CONCURRENT        (0)
+#endif
+#ifdef CONFIG_FMB_TCP_GATEWAY
+#define MB_TCP_GATEWAY_ENABLED          (1)
+#define MB_TCP_GATEWAY_QUEUE_SIZE       (CONFIG_FMB_TCP_GATEWAY_QUEUE_SIZE) // Requests waiting for the serial bus
+#define MB_TCP_GATEWAY_CLIENT_DEPTH     (CONFIG_FMB_TCP_GATEWAY_CLIENT_QUEUE_DEPTH) // Waiting requests per client
+#else
+#define MB_TCP_GATEWAY_ENABLED          (0)
+#endif
 
 // Set the API unlock time to maximum response time
 // The actual release time will be dependent on the timer time
@@ -60,45 +60,54 @@
                                             EV_MASTER_ERROR_RECEIVE_DATA | \
                                             EV_MASTER_ERROR_EXECUTE_FUNCTION )
 
+/* ----------------------- Type definitions ---------------------------------*/
+typedef struct
+{
+    SemaphoreHandle_t xResourceMasterHdl;
+    EventGroupHandle_t xEventGroupMasterHdl;
+    EventGroupHandle_t xEventGroupMasterConfirmHdl;
+    QueueHandle_t xQueueMasterHdl;
+    uint64_t xTransactionID;
+} xMBMasterEventContext;
+
 /* ----------------------- Variables ----------------------------------------*/
-static SemaphoreHandle_t xResourceMasterHdl;
-static EventGroupHandle_t xEventGroupMasterHdl;
-static EventGroupHandle_t xEventGroupMasterConfirmHdl;
-static QueueHandle_t xQueueMasterHdl;
+static xMBMasterEventContext xEventContext[MB_MASTER_INSTANCES];
 
-static uint64_t xTransactionID = 0;
+#define MB_EVENT_CTX( )     ( &xEventContext[ucMBMasterPortGetInstance( )] )
 
 /* ----------------------- Start implementation -----------------------------*/
 
 BOOL
 xMBMasterPortEventInit( void )
 {
-    xEventGroupMasterHdl = xEventGroupCreate();
-    xEventGroupMasterConfirmHdl = xEventGroupCreate();
-    MB_PORT_CHECK((xEventGroupMasterHdl != NULL) && (xEventGroupMasterConfirmHdl != NULL),
+    xMBMasterEventContext *pxCtx = MB_EVENT_CTX( );
+    pxCtx->xEventGroupMasterHdl = xEventGroupCreate();
+    pxCtx->xEventGroupMasterConfirmHdl = xEventGroupCreate();
+    MB_PORT_CHECK((pxCtx->xEventGroupMasterHdl != NULL) && (pxCtx->xEventGroupMasterConfirmHdl != NULL),
                     FALSE, "mb stack event group creation error.");
-    xQueueMasterHdl = xQueueCreate(MB_EVENT_QUEUE_SIZE, sizeof(xMBMasterEventType));
-    MB_PORT_CHECK(xQueueMasterHdl, FALSE, "mb stack event group creation error.");
-    vQueueAddToRegistry(xQueueMasterHdl, "MbMasterPortEventQueue");
-    xTransactionID = 0;
+    pxCtx->xQueueMasterHdl = xQueueCreate(MB_EVENT_QUEUE_SIZE, sizeof(xMBMasterEventType));
+    MB_PORT_CHECK(pxCtx->xQueueMasterHdl, FALSE, "mb stack event group creation error.");
+    vQueueAddToRegistry(pxCtx->xQueueMasterHdl, "MbMasterPortEventQueue");
+    pxCtx->xTransactionID = 0;
     return TRUE;
 }
 
 BOOL MB_PORT_ISR_ATTR
 xMBMasterPortEventPost( eMBMasterEventEnum eEvent)
 {
+    xMBMasterEventContext *pxCtx = MB_EVENT_CTX( );
     BaseType_t xStatus, xHigherPriorityTaskWoken = pdFALSE;
-    assert(xQueueMasterHdl != NULL);
+    assert(pxCtx->xQueueMasterHdl != NULL);
     xMBMasterEventType xEvent;
     xEvent.xPostTimestamp = esp_timer_get_time();
     
     if (eEvent & EV_MASTER_TRANS_START) {
-        atomic_store(&(xTransactionID), xEvent.xPostTimestamp);
+        atomic_store(&(pxCtx->xTransactionID), xEvent.xPostTimestamp);
     }
     xEvent.eEvent = (eEvent & ~EV_MASTER_TRANS_START);
 
     if( (BOOL)xPortInIsrContext() == TRUE ) {
-        xStatus = xQueueSendFromISR(xQueueMasterHdl, (const void*)&xEvent, &xHigherPriorityTaskWoken);
+        xStatus = xQueueSendFromISR(pxCtx->xQueueMasterHdl, (const void*)&xEvent, &xHigherPriorityTaskWoken);
         if ( xHigherPriorityTaskWoken ) {
             portYIELD_FROM_ISR();
         }
@@ -107,7 +116,7 @@ xMBMasterPortEventPost( eMBMasterEventEnum eEvent)
             return FALSE;
         }
     } else {
-        xStatus = xQueueSend(xQueueMasterHdl, (const void*)&xEvent, MB_EVENT_QUEUE_TIMEOUT);
+        xStatus = xQueueSend(pxCtx->xQueueMasterHdl, (const void*)&xEvent, MB_EVENT_QUEUE_TIMEOUT);
         MB_PORT_CHECK((xStatus == pdTRUE), FALSE, "%s: Post message failure.", __func__);
     }
     return TRUE;
@@ -116,13 +125,14 @@ xMBMasterPortEventPost( eMBMasterEventEnum eEvent)
 BOOL
 xMBMasterPortEventGet(xMBMasterEventType *peEvent)
 {
-    assert(xQueueMasterHdl != NULL);
+    xMBMasterEventContext *pxCtx = MB_EVENT_CTX( );
+    assert(pxCtx->xQueueMasterHdl != NULL);
     BOOL xEventHappened = FALSE;
 
-    if (xQueueReceive(xQueueMasterHdl, peEvent, portMAX_DELAY) == pdTRUE) {
-        peEvent->xTransactionId = atomic_load(&xTransactionID);
+    if (xQueueReceive(pxCtx->xQueueMasterHdl, peEvent, portMAX_DELAY) == pdTRUE) {
+        peEvent->xTransactionId = atomic_load(&pxCtx->xTransactionID);
         // Set event bits in confirmation group (for synchronization with port task)
-        xEventGroupSetBits(xEventGroupMasterConfirmHdl, peEvent->eEvent);
+        xEventGroupSetBits(pxCtx->xEventGroupMasterConfirmHdl, peEvent->eEvent);
         peEvent->xGetTimestamp = esp_timer_get_time();
         xEventHappened = TRUE;
     }
@@ -132,29 +142,32 @@ xMBMasterPortEventGet(xMBMasterEventType *peEvent)
 eMBMasterEventEnum
 xMBMasterPortFsmWaitConfirmation( eMBMasterEventEnum eEventMask, ULONG ulTimeout)
 {
+    xMBMasterEventContext *pxCtx = MB_EVENT_CTX( );
     EventBits_t uxBits;
-    uxBits = xEventGroupWaitBits( xEventGroupMasterConfirmHdl,  // The event group being tested.
+    uxBits = xEventGroupWaitBits( pxCtx->xEventGroupMasterConfirmHdl,  // The event group being tested.
                                     eEventMask,                 // The bits within the event group to wait for.
                                     pdFALSE,                    // Keep masked bits.
                                     pdFALSE,                    // Don't wait for both bits, either bit will do.
                                     ulTimeout);                 // Wait timeout for either bit to be set.
     if (ulTimeout && uxBits) {
         // Clear confirmation events that where set in the mask
-        xEventGroupClearBits( xEventGroupMasterConfirmHdl, (uxBits & eEventMask) );
+        xEventGroupClearBits( pxCtx->xEventGroupMasterConfirmHdl, (uxBits & eEventMask) );
     }
     return (eMBMasterEventEnum)(uxBits & eEventMask);
 }
 
 uint64_t xMBMasterPortGetTransactionId( )
 {
-    return atomic_load(&xTransactionID);
+    xMBMasterEventContext *pxCtx = MB_EVENT_CTX( );
+    return atomic_load(&pxCtx->xTransactionID);
 }
 
 // This function is initialize the OS resource for modbus master.
 void vMBMasterOsResInit( void )
 {
-    xResourceMasterHdl = xSemaphoreCreateBinary();
-    MB_PORT_CHECK((xResourceMasterHdl != NULL), ; , "%s: Resource create error.", __func__);
+    xMBMasterEventContext *pxCtx = MB_EVENT_CTX( );
+    pxCtx->xResourceMasterHdl = xSemaphoreCreateBinary();
+    MB_PORT_CHECK((pxCtx->xResourceMasterHdl != NULL), ; , "%s: Resource create error.", __func__);
 }
 
 /**
@@ -167,8 +180,9 @@ void vMBMasterOsResInit( void )
  */
 BOOL xMBMasterRunResTake( LONG lTimeOut )
 {
+    xMBMasterEventContext *pxCtx = MB_EVENT_CTX( );
     BaseType_t xStatus = pdTRUE;
-    xStatus = xSemaphoreTake( xResourceMasterHdl, lTimeOut );
+    xStatus = xSemaphoreTake( pxCtx->xResourceMasterHdl, lTimeOut );
     MB_PORT_CHECK((xStatus == pdTRUE), FALSE , "%s: Resource take failure.", __func__);
     ESP_LOGD(MB_PORT_TAG,"%s:Take MB resource (%lu ticks).", __func__, lTimeOut);
     return TRUE;
@@ -180,8 +194,9 @@ BOOL xMBMasterRunResTake( LONG lTimeOut )
  */
 void vMBMasterRunResRelease( void )
 {
+    xMBMasterEventContext *pxCtx = MB_EVENT_CTX( );
     BaseType_t xStatus = pdFALSE;
-    xStatus = xSemaphoreGive( xResourceMasterHdl );
+    xStatus = xSemaphoreGive( pxCtx->xResourceMasterHdl );
     if (xStatus != pdTRUE) {
         ESP_LOGD(MB_PORT_TAG,"%s: Release resource fail.", __func__);
     }
@@ -198,7 +213,8 @@ void vMBMasterRunResRelease( void )
  */
 void vMBMasterErrorCBRespondTimeout(UCHAR ucDestAddress, const UCHAR* pucPDUData, USHORT ucPDULength)
 {
-    (void)xEventGroupSetBits( xEventGroupMasterHdl, EV_MASTER_ERROR_RESPOND_TIMEOUT );
+    xMBMasterEventContext *pxCtx = MB_EVENT_CTX( );
+    (void)xEventGroupSetBits( pxCtx->xEventGroupMasterHdl, EV_MASTER_ERROR_RESPOND_TIMEOUT );
     ESP_LOGD(MB_PORT_TAG,"%s:Callback respond timeout.", __func__);
 }
 
@@ -212,7 +228,8 @@ void vMBMasterErrorCBRespondTimeout(UCHAR ucDestAddress, const UCHAR* pucPDUData
  */
 void vMBMasterErrorCBReceiveData(UCHAR ucDestAddress, const UCHAR* pucPDUData, USHORT ucPDULength)
 {
-    (void)xEventGroupSetBits( xEventGroupMasterHdl, EV_MASTER_ERROR_RECEIVE_DATA );
+    xMBMasterEventContext *pxCtx = MB_EVENT_CTX( );
+    (void)xEventGroupSetBits( pxCtx->xEventGroupMasterHdl, EV_MASTER_ERROR_RECEIVE_DATA );
     ESP_LOGD(MB_PORT_TAG,"%s:Callback receive data timeout failure.", __func__);
     ESP_LOG_BUFFER_HEX_LEVEL("Err rcv buf", (void *)pucPDUData, (USHORT)ucPDULength, ESP_LOG_DEBUG);
 }
@@ -229,7 +246,8 @@ void vMBMasterErrorCBReceiveData(UCHAR ucDestAddress, const UCHAR* pucPDUData, U
  */
 void vMBMasterErrorCBExecuteFunction(UCHAR ucDestAddress, const UCHAR* pucPDUData, USHORT ucPDULength)
 {
-    xEventGroupSetBits( xEventGroupMasterHdl, EV_MASTER_ERROR_EXECUTE_FUNCTION );
+    xMBMasterEventContext *pxCtx = MB_EVENT_CTX( );
+    xEventGroupSetBits( pxCtx->xEventGroupMasterHdl, EV_MASTER_ERROR_EXECUTE_FUNCTION );
     ESP_LOGD(MB_PORT_TAG,"%s:Callback execute data handler failure.", __func__);
     ESP_LOG_BUFFER_HEX_LEVEL("Exec func buf", (void*)pucPDUData, (USHORT)ucPDULength, ESP_LOG_DEBUG);
 }
@@ -241,7 +259,8 @@ void vMBMasterErrorCBExecuteFunction(UCHAR ucDestAddress, const UCHAR* pucPDUDat
  */
 void vMBMasterCBRequestSuccess( void ) 
 {
-    (void)xEventGroupSetBits( xEventGroupMasterHdl, EV_MASTER_PROCESS_SUCCESS );
+    xMBMasterEventContext *pxCtx = MB_EVENT_CTX( );
+    (void)xEventGroupSetBits( pxCtx->xEventGroupMasterHdl, EV_MASTER_PROCESS_SUCCESS );
     ESP_LOGD(MB_PORT_TAG,"%s: Callback request success.", __func__);
 }
 
@@ -255,10 +274,11 @@ void vMBMasterCBRequestSuccess( void )
  * @return request error code
  */
 eMBMasterReqErrCode eMBMasterWaitRequestFinish( void ) {
+    xMBMasterEventContext *pxCtx = MB_EVENT_CTX( );
     eMBMasterReqErrCode eErrStatus = MB_MRE_NO_ERR;
     eMBMasterEventEnum xRecvedEvent;
 
-    EventBits_t uxBits = xEventGroupWaitBits( xEventGroupMasterHdl, // The event group being tested.
+    EventBits_t uxBits = xEventGroupWaitBits( pxCtx->xEventGroupMasterHdl, // The event group being tested.
                                                 MB_EVENT_REQ_MASK,  // The bits within the event group to wait for.
                                                 pdTRUE,             // Masked bits should be cleared before returning.
                                                 pdFALSE,            // Don't wait for both bits, either bit will do.
@@ -270,7 +290,7 @@ eMBMasterReqErrCode eMBMasterWaitRequestFinish( void ) {
             // if we wait for certain event bits but get from poll subset
             ESP_LOGE(MB_PORT_TAG,"%s: incorrect event set = 0x%x", __func__, (int)xRecvedEvent);
         }
-        xEventGroupSetBits( xEventGroupMasterConfirmHdl, (xRecvedEvent & MB_EVENT_REQ_MASK) );
+        xEventGroupSetBits( pxCtx->xEventGroupMasterConfirmHdl, (xRecvedEvent & MB_EVENT_REQ_MASK) );
         if (MB_PORT_CHECK_EVENT(xRecvedEvent, EV_MASTER_PROCESS_SUCCESS)) {
             eErrStatus = MB_MRE_NO_ERR;
         } else if (MB_PORT_CHECK_EVENT(xRecvedEvent, EV_MASTER_ERROR_RESPOND_TIMEOUT)) {
@@ -294,21 +314,22 @@ eMBMasterReqErrCode eMBMasterWaitRequestFinish( void ) {
 
 void vMBMasterPortEventClose(void)
 {
-    if (xEventGroupMasterHdl) {
-        vEventGroupDelete(xEventGroupMasterHdl);
-        xEventGroupMasterHdl = NULL;
+    xMBMasterEventContext *pxCtx = MB_EVENT_CTX( );
+    if (pxCtx->xEventGroupMasterHdl) {
+        vEventGroupDelete(pxCtx->xEventGroupMasterHdl);
+        pxCtx->xEventGroupMasterHdl = NULL;
     }
-    if (xQueueMasterHdl) {
-        vQueueDelete(xQueueMasterHdl);
-        xQueueMasterHdl = NULL;
+    if (pxCtx->xQueueMasterHdl) {
+        vQueueDelete(pxCtx->xQueueMasterHdl);
+        pxCtx->xQueueMasterHdl = NULL;
     }
-    if (xEventGroupMasterConfirmHdl) {
-        vEventGroupDelete(xEventGroupMasterConfirmHdl);
-        xEventGroupMasterConfirmHdl = NULL;
+    if (pxCtx->xEventGroupMasterConfirmHdl) {
+        vEventGroupDelete(pxCtx->xEventGroupMasterConfirmHdl);
+        pxCtx->xEventGroupMasterConfirmHdl = NULL;
     }
-    if (xResourceMasterHdl) {
-        vSemaphoreDelete(xResourceMasterHdl);
-        xResourceMasterHdl = NULL;
+    if (pxCtx->xResourceMasterHdl) {
+        vSemaphoreDelete(pxCtx->xResourceMasterHdl);
+        pxCtx->xResourceMasterHdl = NULL;
     }
 }
 
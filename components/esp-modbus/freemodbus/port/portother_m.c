@@ -0,0 +1,144 @@
+/*
+ * SPDX-FileCopyrightText: 2006 Christian Walter
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * SPDX-FileContributor: 2016-2021 Espressif Systems (Shanghai) CO LTD
+ */
+/*
+ * FreeModbus Libary: ESP32 Demo Application
+ * Copyright (c) 2006 Christian Walter <wolti@sil.at>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * File: $Id: portother.c,v 1.1 2010/06/06 13:07:20 wolti Exp $
+ */
+
+/* ----------------------- System includes ----------------------------------*/
+#include <stdlib.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/semphr.h>
+
+/* ----------------------- Modbus includes ----------------------------------*/
+#include "mb_m.h"
+#include "mbport.h"
+#include "port.h"
+
+/* ----------------------- Defines ------------------------------------------*/
+#if MB_MASTER_INSTANCES > 1
+/* The instance of a task is kept in its last thread local storage pointer,
+ * index 0 belongs to the pthread library. */
+#define MB_MASTER_TLS_INDEX         ( CONFIG_FREERTOS_THREAD_LOCAL_STORAGE_POINTERS - 1 )
+#if MB_MASTER_TLS_INDEX < 1
+#error "Several master instances need CONFIG_FREERTOS_THREAD_LOCAL_STORAGE_POINTERS > 1."
+#endif
+
+/* The pointer holds the instance and the generation of the instance it was
+ * bound in, a binding from before the instance was closed no longer matches. */
+#define MB_MASTER_BINDING( ucInstance ) \
+    ( ( void * )( ( ( uintptr_t )ulInstanceGeneration[ucInstance] << 8 ) | ( ucInstance ) ) )
+
+/* ----------------------- Variables ----------------------------------------*/
+static volatile ULONG ulInstanceGeneration[MB_MASTER_INSTANCES];
+
+/* Instance of the port callback running in the ISR of each core. */
+static UCHAR ucIsrInstance[portNUM_PROCESSORS];
+#endif
+
+/* ----------------------- Start implementation -----------------------------*/
+#if MB_MASTER_INSTANCES > 1
+UCHAR MB_PORT_ISR_ATTR
+ucMBMasterPortGetInstance( void )
+{
+    if( xPortInIsrContext(  ) )
+    {
+        return ucIsrInstance[xPortGetCoreID(  )];
+    }
+    void           *pvBinding = pvTaskGetThreadLocalStoragePointer( NULL, MB_MASTER_TLS_INDEX );
+    UCHAR           ucInstance = ( UCHAR )( uintptr_t )pvBinding;
+
+    if( ( ucInstance < MB_MASTER_INSTANCES ) && ( pvBinding == MB_MASTER_BINDING( ucInstance ) ) )
+    {
+        return ucInstance;
+    }
+    return 0;
+}
+
+/* Select the instance for a port callback which runs in an ISR or on a task
+ * shared by the instances, the callback keeps its instance in its context.
+ * Returns the instance to restore when the callback is done. */
+UCHAR MB_PORT_ISR_ATTR
+ucMBMasterPortSetInstance( UCHAR ucInstance )
+{
+    UCHAR           ucPrevInstance = ucMBMasterPortGetInstance(  );
+
+    if( xPortInIsrContext(  ) )
+    {
+        ucIsrInstance[xPortGetCoreID(  )] = ucInstance;
+    }
+    else
+    {
+        vTaskSetThreadLocalStoragePointer( NULL, MB_MASTER_TLS_INDEX, MB_MASTER_BINDING( ucInstance ) );
+    }
+    return ucPrevInstance;
+}
+
+/* Bind the task (the calling task if xTask is NULL) to the instance. The
+ * task keeps the binding until it is bound again or the instance is closed. */
+BOOL
+xMBMasterPortBindTask( TaskHandle_t xTask, UCHAR ucInstance )
+{
+    MB_PORT_CHECK( ( ucInstance < MB_MASTER_INSTANCES ), FALSE,
+                    "incorrect master instance (%u).", ( unsigned )ucInstance );
+    vTaskSetThreadLocalStoragePointer( xTask, MB_MASTER_TLS_INDEX, MB_MASTER_BINDING( ucInstance ) );
+    return TRUE;
+}
+
+/* Drop the binding of the task (the calling task if xTask is NULL), it uses
+ * the first instance again. */
+void
+vMBMasterPortUnbindTask( TaskHandle_t xTask )
+{
+    vTaskSetThreadLocalStoragePointer( xTask, MB_MASTER_TLS_INDEX, NULL );
+}
+
+/* Drop the bindings of the instance, the tasks use the first instance again. */
+void
+vMBMasterPortUnbindInstance( UCHAR ucInstance )
+{
+    ulInstanceGeneration[ucInstance]++;
+}
+#endif
+
+void
+vMBMasterPortClose( void )
+{
+    extern void     vMBMasterPortSerialClose( void );
+    extern void     vMBMasterPortTimerClose( void );
+    extern void     vMBMasterPortEventClose( void );
+    vMBMasterPortSerialClose(  );
+    vMBMasterPortTimerClose(  );
+    vMBMasterPortEventClose(  );
+}
@@ -279,6 +279,13 @@ BOOL xMBPortSerialPutByte(CHAR ucByte)
     return (ucLength == 1);
 }
 
+// Send a complete frame to UART transmission buffer in one driver call
+BOOL xMBPortSerialPutBytes(const UCHAR* pucBuf, USHORT usLength)
+{
+    int iLength = uart_write_bytes(ucUartNumber, pucBuf, usLength);
+    return (iLength == usLength);
+}
+
 // Get one byte from intermediate RX buffer
 BOOL xMBPortSerialGetByte(CHAR* pucByte)
 {
@@ -59,37 +59,45 @@
 /* ----------------------- Static variables ---------------------------------*/
 static const CHAR *TAG = "MB_MASTER_SERIAL";
 
-// A queue to handle UART event.
-static QueueHandle_t xMbUartQueue;
-static TaskHandle_t  xMbTaskHandle;
-
-// The UART hardware port number
-static UCHAR ucUartNumber = UART_NUM_MAX - 1;
+typedef struct
+{
+    UCHAR ucInstance;                       // Master instance of the port
+    QueueHandle_t xMbUartQueue;             // A queue to handle UART event.
+    TaskHandle_t  xMbTaskHandle;
+    UCHAR ucUartNumber;                     // The UART hardware port number
+    BOOL bRxStateEnabled;                   // Receiver enabled flag
+    BOOL bTxStateEnabled;                   // Transmitter enabled flag
+    SemaphoreHandle_t xMasterSemaRxHandle;  // Rx blocking semaphore handle
+} xMBMasterSerialContext;
 
-static BOOL bRxStateEnabled = FALSE; // Receiver enabled flag
-static BOOL bTxStateEnabled = FALSE; // Transmitter enabled flag
+static xMBMasterSerialContext xSerialContext[MB_MASTER_INSTANCES] = {
+    [0 ... MB_MASTER_INSTANCES - 1] = { .ucUartNumber = UART_NUM_MAX - 1 }
+};
 
-static SemaphoreHandle_t xMasterSemaRxHandle; // Rx blocking semaphore handle
+#define MB_SERIAL_CTX( )    ( &xSerialContext[ucMBMasterPortGetInstance( )] )
 
 static BOOL xMBMasterPortRxSemaInit( void )
 {
-    xMasterSemaRxHandle = xSemaphoreCreateBinary();
-    MB_PORT_CHECK((xMasterSemaRxHandle != NULL), FALSE , "%s: RX semaphore create failure.", __func__);
+    xMBMasterSerialContext *pxCtx = MB_SERIAL_CTX( );
+    pxCtx->xMasterSemaRxHandle = xSemaphoreCreateBinary();
+    MB_PORT_CHECK((pxCtx->xMasterSemaRxHandle != NULL), FALSE , "%s: RX semaphore create failure.", __func__);
     return TRUE;
 }
 
 static void vMBMasterPortRxSemaClose( void )
 {
-    if (xMasterSemaRxHandle) {
-        vSemaphoreDelete(xMasterSemaRxHandle);
-        xMasterSemaRxHandle = NULL;
+    xMBMasterSerialContext *pxCtx = MB_SERIAL_CTX( );
+    if (pxCtx->xMasterSemaRxHandle) {
+        vSemaphoreDelete(pxCtx->xMasterSemaRxHandle);
+        pxCtx->xMasterSemaRxHandle = NULL;
     }
 }
 
 static BOOL xMBMasterPortRxSemaTake( LONG lTimeOut )
 {
+    xMBMasterSerialContext *pxCtx = MB_SERIAL_CTX( );
     BaseType_t xStatus = pdTRUE;
-    xStatus = xSemaphoreTake(xMasterSemaRxHandle, lTimeOut );
+    xStatus = xSemaphoreTake(pxCtx->xMasterSemaRxHandle, lTimeOut );
     MB_PORT_CHECK((xStatus == pdTRUE), FALSE , "%s: RX semaphore take failure.", __func__);
     ESP_LOGV(MB_PORT_TAG,"%s:Take RX semaphore (%" PRIu64 " ticks).", __func__, (uint64_t)lTimeOut);
     return TRUE;
@@ -97,8 +105,9 @@ static BOOL xMBMasterPortRxSemaTake( LONG lTimeOut )
 
 static void vMBMasterRxSemaRelease( void )
 {
+    xMBMasterSerialContext *pxCtx = MB_SERIAL_CTX( );
     BaseType_t xStatus = pdFALSE;
-    xStatus = xSemaphoreGive(xMasterSemaRxHandle);
+    xStatus = xSemaphoreGive(pxCtx->xMasterSemaRxHandle);
     if (xStatus != pdTRUE) {
         ESP_LOGD(MB_PORT_TAG,"%s:RX semaphore is free.", __func__);
     }
@@ -106,21 +115,23 @@ static void vMBMasterRxSemaRelease( void )
 
 static BOOL vMBMasterRxSemaIsBusy( void )
 {
+    xMBMasterSerialContext *pxCtx = MB_SERIAL_CTX( );
     BaseType_t xStatus = pdFALSE;
-    xStatus = (uxSemaphoreGetCount(xMasterSemaRxHandle) == 0) ? TRUE : FALSE;
+    xStatus = (uxSemaphoreGetCount(pxCtx->xMasterSemaRxHandle) == 0) ? TRUE : FALSE;
     return xStatus;
 }
 
 void vMBMasterRxFlush( void )
 {
+    xMBMasterSerialContext *pxCtx = MB_SERIAL_CTX( );
     size_t xSize = 1;
     esp_err_t xErr = ESP_OK;
     for (int xCount = 0; (xCount < MB_SERIAL_RX_FLUSH_RETRY) && xSize; xCount++) {
-        xErr = uart_get_buffered_data_len(ucUartNumber, &xSize);
+        xErr = uart_get_buffered_data_len(pxCtx->ucUartNumber, &xSize);
         MB_PORT_CHECK((xErr == ESP_OK), ; , "mb flush serial fail, error = 0x%x.", (int)xErr);
-        BaseType_t xStatus = xQueueReset(xMbUartQueue);
+        BaseType_t xStatus = xQueueReset(pxCtx->xMbUartQueue);
         if (xStatus) {
-            xErr = uart_flush_input(ucUartNumber);
+            xErr = uart_flush_input(pxCtx->ucUartNumber);
             MB_PORT_CHECK((xErr == ESP_OK), ; , "mb flush serial fail, error = 0x%x.", (int)xErr);
         }
     }
@@ -128,40 +139,48 @@ void vMBMasterRxFlush( void )
 
 void vMBMasterPortSerialEnable(BOOL bRxEnable, BOOL bTxEnable)
 {
+    xMBMasterSerialContext *pxCtx = MB_SERIAL_CTX( );
     // This function can be called from xMBRTUTransmitFSM() of different task
     if (bTxEnable) {
         vMBMasterRxFlush();
-        bTxStateEnabled = TRUE;
+        pxCtx->bTxStateEnabled = TRUE;
     } else {
-        bTxStateEnabled = FALSE;
+        pxCtx->bTxStateEnabled = FALSE;
     }
     if (bRxEnable) {
-        bRxStateEnabled = TRUE;
+        pxCtx->bRxStateEnabled = TRUE;
         vMBMasterRxSemaRelease();
-        vTaskResume(xMbTaskHandle); // Resume receiver task
+        vTaskResume(pxCtx->xMbTaskHandle); // Resume receiver task
     } else {
-        vTaskSuspend(xMbTaskHandle); // Block receiver task
-        bRxStateEnabled = FALSE;
+        vTaskSuspend(pxCtx->xMbTaskHandle); // Block receiver task
+        pxCtx->bRxStateEnabled = FALSE;
     }
 }
 
 static USHORT usMBMasterPortSerialRxPoll(size_t xEventSize)
 {
+    xMBMasterSerialContext *pxCtx = MB_SERIAL_CTX( );
     BOOL xStatus = TRUE;
     USHORT usCnt = 0;
 
     xStatus = xMBMasterPortRxSemaTake(MB_SERIAL_RX_SEMA_TOUT);
     if (xStatus) {
-        while(xStatus && (usCnt++ <= xEventSize)) {
-            // Call the Modbus stack callback function and let it fill the stack buffers.
-            xStatus = pxMBMasterFrameCBByteReceived(); // callback to receive FSM
+        if (pxMBMasterFrameCBBlockReceived[pxCtx->ucInstance]) {
+            // The whole buffered frame goes to the stack buffer with a single driver read
+            xStatus = pxMBMasterFrameCBBlockReceived[pxCtx->ucInstance]((USHORT)xEventSize);
+            usCnt = (USHORT)xEventSize;
+        } else {
+            while(xStatus && (usCnt++ <= xEventSize)) {
+                // Call the Modbus stack callback function and let it fill the stack buffers.
+                xStatus = pxMBMasterFrameCBByteReceived[pxCtx->ucInstance](); // callback to receive FSM
+            }
         }
         // The buffer is transferred into Modbus stack and is not needed here any more
-        uart_flush_input(ucUartNumber);
+        uart_flush_input(pxCtx->ucUartNumber);
         ESP_LOGD(TAG, "Received data: %u(bytes in buffer)", (unsigned)usCnt);
 #if !CONFIG_FMB_TIMER_PORT_ENABLED
         vMBMasterSetCurTimerMode(MB_TMODE_T35);
-        xStatus = pxMBMasterPortCBTimerExpired();
+        xStatus = pxMBMasterPortCBTimerExpired[pxCtx->ucInstance]();
         if (!xStatus) {
             xMBMasterPortEventPost(EV_MASTER_FRAME_RECEIVED);
             ESP_LOGD(TAG, "Send additional RX ready event.");
@@ -176,18 +195,19 @@ static USHORT usMBMasterPortSerialRxPoll(size_t xEventSize)
 
 BOOL xMBMasterPortSerialTxPoll(void)
 {
+    xMBMasterSerialContext *pxCtx = MB_SERIAL_CTX( );
     USHORT usCount = 0;
     BOOL bNeedPoll = TRUE;
 
-    if( bTxStateEnabled ) {
+    if( pxCtx->bTxStateEnabled ) {
         // Continue while all response bytes put in buffer or out of buffer
         while(bNeedPoll && (usCount++ < MB_SERIAL_BUF_SIZE)) {
             // Calls the modbus stack callback function to let it fill the UART transmit buffer.
-            bNeedPoll = pxMBMasterFrameCBTransmitterEmpty( ); // callback to transmit FSM
+            bNeedPoll = pxMBMasterFrameCBTransmitterEmpty[pxCtx->ucInstance]( ); // callback to transmit FSM
         }
         ESP_LOGD(TAG, "MB_TX_buffer sent: (%u) bytes.", (unsigned)(usCount - 1));
         // Waits while UART sending the packet
-        esp_err_t xTxStatus = uart_wait_tx_done(ucUartNumber, MB_SERIAL_TX_TOUT_TICKS);
+        esp_err_t xTxStatus = uart_wait_tx_done(pxCtx->ucUartNumber, MB_SERIAL_TX_TOUT_TICKS);
         vMBMasterPortSerialEnable(TRUE, FALSE);
         MB_PORT_CHECK((xTxStatus == ESP_OK), FALSE, "mb serial sent buffer failure.");
         return TRUE;
@@ -198,11 +218,15 @@ BOOL xMBMasterPortSerialTxPoll(void)
 // UART receive event task
 static void vUartTask(void* pvParameters)
 {
+    // The task serves the port of one instance, the stack callbacks use it as well
+    UCHAR ucInstance = (UCHAR)(uintptr_t)pvParameters;
+    (void)xMBMasterPortBindTask(NULL, ucInstance);
+    xMBMasterSerialContext *pxCtx = &xSerialContext[ucInstance];
     uart_event_t xEvent;
     USHORT usResult = 0;
     for(;;) {
-        if (xMBPortSerialWaitEvent(xMbUartQueue, (void*)&xEvent, portMAX_DELAY)) {
-            ESP_LOGD(TAG, "MB_uart[%u] event:", (unsigned)ucUartNumber);
+        if (xMBPortSerialWaitEvent(pxCtx->xMbUartQueue, (void*)&xEvent, portMAX_DELAY)) {
+            ESP_LOGD(TAG, "MB_uart[%u] event:", (unsigned)pxCtx->ucUartNumber);
             switch(xEvent.type) {
                 //Event of UART receiving data
                 case UART_DATA:
@@ -217,7 +241,7 @@ static void vUartTask(void* pvParameters)
                             break;
                         }
                         // Get buffered data length
-                        ESP_ERROR_CHECK(uart_get_buffered_data_len(ucUartNumber, &xEvent.size));
+                        ESP_ERROR_CHECK(uart_get_buffered_data_len(pxCtx->ucUartNumber, &xEvent.size));
                         // Read received data and send it to modbus stack
                         usResult = usMBMasterPortSerialRxPoll(xEvent.size);
                         ESP_LOGD(TAG,"Timeout occured, processed: %u bytes", (unsigned)usResult);
@@ -226,13 +250,13 @@ static void vUartTask(void* pvParameters)
                 //Event of HW FIFO overflow detected
                 case UART_FIFO_OVF:
                     ESP_LOGD(TAG, "hw fifo overflow.");
-                    xQueueReset(xMbUartQueue);
+                    xQueueReset(pxCtx->xMbUartQueue);
                     break;
                 //Event of UART ring buffer full
                 case UART_BUFFER_FULL:
                     ESP_LOGD(TAG, "ring buffer full.");
-                    xQueueReset(xMbUartQueue);
-                    uart_flush_input(ucUartNumber);
+                    xQueueReset(pxCtx->xMbUartQueue);
+                    uart_flush_input(pxCtx->ucUartNumber);
                     break;
                 //Event of UART RX break detected
                 case UART_BREAK:
@@ -241,14 +265,14 @@ static void vUartTask(void* pvParameters)
                 //Event of UART parity check error
                 case UART_PARITY_ERR:
                     ESP_LOGD(TAG, "uart parity error.");
-                    xQueueReset(xMbUartQueue);
-                    uart_flush_input(ucUartNumber);
+                    xQueueReset(pxCtx->xMbUartQueue);
+                    uart_flush_input(pxCtx->ucUartNumber);
                     break;
                 //Event of UART frame error
                 case UART_FRAME_ERR:
                     ESP_LOGD(TAG, "uart frame error.");
-                    xQueueReset(xMbUartQueue);
-                    uart_flush_input(ucUartNumber);
+                    xQueueReset(pxCtx->xMbUartQueue);
+                    uart_flush_input(pxCtx->ucUartNumber);
                     break;
                 default:
                     ESP_LOGD(TAG, "uart event type: %u.", (unsigned)xEvent.type);
@@ -262,9 +286,11 @@ static void vUartTask(void* pvParameters)
 /* ----------------------- Start implementation -----------------------------*/
 BOOL xMBMasterPortSerialInit( UCHAR ucPORT, ULONG ulBaudRate, UCHAR ucDataBits, eMBParity eParity )
 {
+    xMBMasterSerialContext *pxCtx = MB_SERIAL_CTX( );
     esp_err_t xErr = ESP_OK;
+    pxCtx->ucInstance = ucMBMasterPortGetInstance();
     // Set communication port number
-    ucUartNumber = ucPORT;
+    pxCtx->ucUartNumber = ucPORT;
     // Configure serial communication parameters
     UCHAR ucParity = UART_PARITY_DISABLE;
     UCHAR ucData = UART_DATA_8_BITS;
@@ -313,35 +339,35 @@ BOOL xMBMasterPortSerialInit( UCHAR ucPORT, ULONG ulBaudRate, UCHAR ucDataBits,
 #endif
     };
     // Set UART config
-    xErr = uart_param_config(ucUartNumber, &xUartConfig);
+    xErr = uart_param_config(pxCtx->ucUartNumber, &xUartConfig);
     MB_PORT_CHECK((xErr == ESP_OK),
             FALSE, "mb config failure, uart_param_config() returned (0x%x).", (int)xErr);
     // Install UART driver, and get the queue.
-    xErr = uart_driver_install(ucUartNumber, MB_SERIAL_BUF_SIZE, MB_SERIAL_BUF_SIZE,
-                                    MB_QUEUE_LENGTH, &xMbUartQueue, MB_PORT_SERIAL_ISR_FLAG);
+    xErr = uart_driver_install(pxCtx->ucUartNumber, MB_SERIAL_BUF_SIZE, MB_SERIAL_BUF_SIZE,
+                                    MB_QUEUE_LENGTH, &pxCtx->xMbUartQueue, MB_PORT_SERIAL_ISR_FLAG);
     MB_PORT_CHECK((xErr == ESP_OK), FALSE,
             "mb serial driver failure, uart_driver_install() returned (0x%x).", (int)xErr);
     // Set timeout for TOUT interrupt (T3.5 modbus time)
-    xErr = uart_set_rx_timeout(ucUartNumber, MB_SERIAL_TOUT);
+    xErr = uart_set_rx_timeout(pxCtx->ucUartNumber, MB_SERIAL_TOUT);
     MB_PORT_CHECK((xErr == ESP_OK), FALSE,
             "mb serial set rx timeout failure, uart_set_rx_timeout() returned (0x%x).", (int)xErr);
 
     // Set always timeout flag to trigger timeout interrupt even after rx fifo full
-    uart_set_always_rx_timeout(ucUartNumber, true);
+    uart_set_always_rx_timeout(pxCtx->ucUartNumber, true);
     MB_PORT_CHECK((xMBMasterPortRxSemaInit()), FALSE,
                         "mb serial RX semaphore create fail.");
     // Create a task to handle UART events
     BaseType_t xStatus = xTaskCreatePinnedToCore(vUartTask, "uart_queue_task",
                                                     MB_SERIAL_TASK_STACK_SIZE,
-                                                    NULL, MB_SERIAL_TASK_PRIO,
-                                                    &xMbTaskHandle, MB_PORT_TASK_AFFINITY);
+                                                    (void*)(uintptr_t)pxCtx->ucInstance, MB_SERIAL_TASK_PRIO,
+                                                    &pxCtx->xMbTaskHandle, MB_PORT_TASK_AFFINITY);
     if (xStatus != pdPASS) {
-        vTaskDelete(xMbTaskHandle);
+        vTaskDelete(pxCtx->xMbTaskHandle);
         // Force exit from function with failure
         MB_PORT_CHECK(FALSE, FALSE,
                 "mb stack serial task creation error. xTaskCreate() returned (0x%x).", (int)xStatus);
     } else {
-        vTaskSuspend(xMbTaskHandle); // Suspend serial task while stack is not started
+        vTaskSuspend(pxCtx->xMbTaskHandle); // Suspend serial task while stack is not started
     }
     ESP_LOGD(MB_PORT_TAG,"%s Init serial.", __func__);
     return TRUE;
@@ -349,23 +375,43 @@ BOOL xMBMasterPortSerialInit( UCHAR ucPORT, ULONG ulBaudRate, UCHAR ucDataBits,
 
 void vMBMasterPortSerialClose(void)
 {
+    xMBMasterSerialContext *pxCtx = MB_SERIAL_CTX( );
     vMBMasterPortRxSemaClose();
-    (void)vTaskDelete(xMbTaskHandle);
-    ESP_ERROR_CHECK(uart_driver_delete(ucUartNumber));
+    (void)vTaskDelete(pxCtx->xMbTaskHandle);
+    ESP_ERROR_CHECK(uart_driver_delete(pxCtx->ucUartNumber));
 }
 
 BOOL xMBMasterPortSerialPutByte(CHAR ucByte)
 {
+    xMBMasterSerialContext *pxCtx = MB_SERIAL_CTX( );
     // Send one byte to UART transmission buffer
     // This function is called by Modbus stack
-    UCHAR ucLength = uart_write_bytes(ucUartNumber, &ucByte, 1);
+    UCHAR ucLength = uart_write_bytes(pxCtx->ucUartNumber, &ucByte, 1);
     return (ucLength == 1);
 }
 
+// Send a complete frame to UART transmission buffer in one driver call
+BOOL xMBMasterPortSerialPutBytes(const UCHAR* pucBuf, USHORT usLength)
+{
+    xMBMasterSerialContext *pxCtx = MB_SERIAL_CTX( );
+    int iLength = uart_write_bytes(pxCtx->ucUartNumber, pucBuf, usLength);
+    return (iLength == usLength);
+}
+
 // Get one byte from intermediate RX buffer
 BOOL xMBMasterPortSerialGetByte(CHAR* pucByte)
 {
+    xMBMasterSerialContext *pxCtx = MB_SERIAL_CTX( );
     assert(pucByte != NULL);
-    USHORT usLength = uart_read_bytes(ucUartNumber, (uint8_t*)pucByte, 1, MB_SERIAL_RX_TOUT_TICKS);
+    USHORT usLength = uart_read_bytes(pxCtx->ucUartNumber, (uint8_t*)pucByte, 1, MB_SERIAL_RX_TOUT_TICKS);
     return (usLength == 1);
 }
+
+// Get up to usLength bytes from intermediate RX buffer in one driver call
+USHORT usMBMasterPortSerialGetBytes(UCHAR* pucBuf, USHORT usLength)
+{
+    xMBMasterSerialContext *pxCtx = MB_SERIAL_CTX( );
+    assert(pucBuf != NULL);
+    int iLength = uart_read_bytes(pxCtx->ucUartNumber, pucBuf, usLength, MB_SERIAL_RX_TOUT_TICKS);
+    return (iLength > 0) ? (USHORT)iLength : 0;
+}
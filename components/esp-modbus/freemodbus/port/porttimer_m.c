@@ -0,0 +1,274 @@
+/*
+ * SPDX-FileCopyrightText: 2013 Armink
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * SPDX-FileContributor: 2016-2021 Espressif Systems (Shanghai) CO LTD
+ */
+/*
+ * FreeModbus Libary: ESP32 Port
+ * Copyright (C) 2013 Armink <armink.ztl@gmail.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * IF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * File: $Id: porttimer_m.c,v 1.60 2013/08/13 15:07:05 Armink add Master Functions$
+ */
+
+/* ----------------------- Platform includes --------------------------------*/
+#include <inttypes.h>
+#include "port.h"
+
+/* ----------------------- Modbus includes ----------------------------------*/
+#include "mb_m.h"
+#include "mbport.h"
+#include "sdkconfig.h"
+
+static const char *TAG = "MBM_TIMER";
+
+/* ----------------------- Defines ------------------------------------------*/
+#if MB_MASTER_ADAPTIVE_TIMEOUT_ENABLED
+#define MB_RESPOND_TOUT_MIN_US  ( MB_MASTER_ADAPTIVE_TIMEOUT_MIN_MS * 1000UL )
+#define MB_RESPOND_TOUT_MAX_US  ( ( ( MB_MASTER_ADAPTIVE_TIMEOUT_MAX_MS < MB_MASTER_TIMEOUT_MS_RESPOND ) ? \
+                                    MB_MASTER_ADAPTIVE_TIMEOUT_MAX_MS : MB_MASTER_TIMEOUT_MS_RESPOND ) * 1000UL )
+#endif
+
+/* ----------------------- Variables ----------------------------------------*/
+static xTimerContext_t* pxTimerContext[MB_MASTER_INSTANCES];
+
+#if MB_MASTER_ADAPTIVE_TIMEOUT_ENABLED
+static xMBMasterRespondStats xRespondStats[MB_MASTER_INSTANCES][MB_MASTER_ADAPTIVE_TIMEOUT_SLAVES];
+static portMUX_TYPE xRespondStatsLock = portMUX_INITIALIZER_UNLOCKED;
+#endif
+
+/* ----------------------- Start implementation -----------------------------*/
+static void IRAM_ATTR vTimerAlarmCBHandler(void *param)
+{
+    // The timers of all instances share the timer task or ISR, the argument is the instance of the timer
+    UCHAR ucInstance = (UCHAR)(uintptr_t)param;
+    UCHAR ucPrevInstance = ucMBMasterPortSetInstance(ucInstance);
+    pxMBMasterPortCBTimerExpired[ucInstance](); // Timer expired callback function
+    pxTimerContext[ucInstance]->xTimerState = TRUE;
+    ESP_EARLY_LOGD(TAG, "Timer mode: (%u) triggered", (unsigned)xMBMasterGetCurTimerMode());
+    (void)ucMBMasterPortSetInstance(ucPrevInstance);
+}
+
+BOOL xMBMasterPortTimersInit(USHORT usTimeOut50us)
+{
+    UCHAR ucInstance = ucMBMasterPortGetInstance();
+    MB_PORT_CHECK((usTimeOut50us > 0), FALSE,
+            "Modbus timeout discreet is incorrect.");
+    MB_PORT_CHECK(!pxTimerContext[ucInstance], FALSE,
+                "Modbus timer is already created.");
+    xTimerContext_t* pxCtx = calloc(1, sizeof(xTimerContext_t));
+    if (!pxCtx) {
+        return FALSE;
+    }
+    pxTimerContext[ucInstance] = pxCtx;
+    pxCtx->xTimerIntHandle = NULL;
+    // Save timer reload value for Modbus T35 period
+    pxCtx->usT35Ticks = usTimeOut50us;
+    esp_timer_create_args_t xTimerConf = {
+        .callback = vTimerAlarmCBHandler,
+        .arg = (void*)(uintptr_t)ucInstance,
+#if (MB_TIMER_SUPPORTS_ISR_DISPATCH_METHOD && CONFIG_FMB_TIMER_USE_ISR_DISPATCH_METHOD)
+        .dispatch_method = ESP_TIMER_ISR,
+#else
+        .dispatch_method = ESP_TIMER_TASK,
+#endif
+        .name = "MBM_T35timer"
+    };
+    // Create Modbus timer
+    esp_err_t xErr = esp_timer_create(&xTimerConf, &(pxCtx->xTimerIntHandle));
+    if (xErr) {
+        return FALSE;
+    }
+    return TRUE;
+}
+
+// Set timer alarm value
+static BOOL xMBMasterPortTimersEnable(uint64_t xToutUs)
+{
+    xTimerContext_t* pxCtx = pxTimerContext[ucMBMasterPortGetInstance()];
+    MB_PORT_CHECK(pxCtx && (pxCtx->xTimerIntHandle), FALSE,
+                                "timer is not initialized.");
+    MB_PORT_CHECK((xToutUs > 0), FALSE,
+                            "incorrect tick value for timer = (%" PRIu64 ").", xToutUs);
+    esp_timer_stop(pxCtx->xTimerIntHandle);
+    esp_timer_start_once(pxCtx->xTimerIntHandle, xToutUs);
+    pxCtx->xTimerState = FALSE;
+    return TRUE;
+}
+
+void vMBMasterPortTimersT35Enable(void)
+{
+    uint64_t xToutUs = (pxTimerContext[ucMBMasterPortGetInstance()]->usT35Ticks * MB_TIMER_TICK_TIME_US);
+
+    // Set current timer mode, don't change it.
+    vMBMasterSetCurTimerMode(MB_TMODE_T35);
+    // Set timer alarm
+    (void)xMBMasterPortTimersEnable(xToutUs);
+}
+
+void vMBMasterPortTimersConvertDelayEnable(void)
+{
+    // Covert time in milliseconds into ticks
+    uint64_t xToutUs = (MB_MASTER_DELAY_MS_CONVERT * 1000);
+
+    // Set current timer mode
+    vMBMasterSetCurTimerMode(MB_TMODE_CONVERT_DELAY);
+    ESP_LOGD(MB_PORT_TAG,"%s Convert delay enable.", __func__);
+    (void)xMBMasterPortTimersEnable(xToutUs);
+}
+
+#if MB_MASTER_ADAPTIVE_TIMEOUT_ENABLED
+// Returns the entry of the slave, a free entry is taken for a new slave if xCreate is set.
+// Broadcast requests have no response and no entry. Must be called with xRespondStatsLock held.
+static xMBMasterRespondStats* prvpxMBMasterRespondStatsGet(UCHAR ucSlaveAddress, BOOL xCreate)
+{
+    xMBMasterRespondStats* pxStats = xRespondStats[ucMBMasterPortGetInstance()];
+    xMBMasterRespondStats* pxFree = NULL;
+    if (ucSlaveAddress == MB_ADDRESS_BROADCAST) {
+        return NULL;
+    }
+    for (USHORT usIndex = 0; usIndex < MB_MASTER_ADAPTIVE_TIMEOUT_SLAVES; usIndex++) {
+        if (pxStats[usIndex].ucSlaveAddress == ucSlaveAddress) {
+            return &pxStats[usIndex];
+        }
+        if (!pxFree && (pxStats[usIndex].ucSlaveAddress == MB_ADDRESS_BROADCAST)) {
+            pxFree = &pxStats[usIndex];
+        }
+    }
+    if (!xCreate || !pxFree) {
+        return NULL;
+    }
+    memset(pxFree, 0, sizeof(xMBMasterRespondStats));
+    pxFree->ucSlaveAddress = ucSlaveAddress;
+    pxFree->ulRTTMinUs = UINT32_MAX;
+    pxFree->ulTimeoutUs = MB_RESPOND_TOUT_MAX_US;
+    return pxFree;
+}
+
+// Adds a round trip time sample of the slave, the estimator is the one of RFC 6298:
+// SRTT += (RTT - SRTT) / 8, RTTVAR += (|RTT - SRTT| - RTTVAR) / 4, timeout = SRTT + 4 * RTTVAR
+void vMBMasterPortRespondTimeUpdate(UCHAR ucSlaveAddress, ULONG ulRespondTimeUs)
+{
+    portENTER_CRITICAL(&xRespondStatsLock);
+    xMBMasterRespondStats* pxStats = prvpxMBMasterRespondStatsGet(ucSlaveAddress, TRUE);
+    if (pxStats) {
+        if (pxStats->ulResponses == 0) {
+            pxStats->ulSRTTUs = ulRespondTimeUs;
+            pxStats->ulRTTVarUs = ulRespondTimeUs / 2;
+        } else {
+            LONG lDelta = (LONG)ulRespondTimeUs - (LONG)pxStats->ulSRTTUs;
+            ULONG ulDeviation = (ULONG)((lDelta < 0) ? -lDelta : lDelta);
+            pxStats->ulRTTVarUs = pxStats->ulRTTVarUs - (pxStats->ulRTTVarUs >> 2) + (ulDeviation >> 2);
+            pxStats->ulSRTTUs = (ULONG)((LONG)pxStats->ulSRTTUs + (lDelta / 8));
+        }
+        pxStats->ulResponses++;
+        pxStats->ulRTTMinUs = (ulRespondTimeUs < pxStats->ulRTTMinUs) ? ulRespondTimeUs : pxStats->ulRTTMinUs;
+        pxStats->ulRTTMaxUs = (ulRespondTimeUs > pxStats->ulRTTMaxUs) ? ulRespondTimeUs : pxStats->ulRTTMaxUs;
+        // Logarithmic buckets in milliseconds
+        ULONG ulRespondTimeMs = ulRespondTimeUs / 1000;
+        USHORT usBucket = ulRespondTimeMs ? (USHORT)(32 - __builtin_clz(ulRespondTimeMs)) : 0;
+        if (usBucket >= MB_MASTER_RTT_HIST_BUCKETS) {
+            usBucket = MB_MASTER_RTT_HIST_BUCKETS - 1;
+        }
+        pxStats->ulHist[usBucket]++;
+        ULONG ulTimeoutUs = pxStats->ulSRTTUs + 4 * pxStats->ulRTTVarUs;
+        if (ulTimeoutUs < MB_RESPOND_TOUT_MIN_US) {
+            ulTimeoutUs = MB_RESPOND_TOUT_MIN_US;
+        } else if (ulTimeoutUs > MB_RESPOND_TOUT_MAX_US) {
+            ulTimeoutUs = MB_RESPOND_TOUT_MAX_US;
+        }
+        pxStats->ulTimeoutUs = ulTimeoutUs;
+    }
+    portEXIT_CRITICAL(&xRespondStatsLock);
+}
+
+// The slave did not respond in time, back off the timeout until it responds again
+void vMBMasterPortRespondTimeoutExpired(UCHAR ucSlaveAddress)
+{
+    portENTER_CRITICAL(&xRespondStatsLock);
+    xMBMasterRespondStats* pxStats = prvpxMBMasterRespondStatsGet(ucSlaveAddress, TRUE);
+    if (pxStats) {
+        pxStats->ulTimeouts++;
+        pxStats->ulTimeoutUs = (pxStats->ulTimeoutUs < (MB_RESPOND_TOUT_MAX_US / 2)) ?
+                                    (pxStats->ulTimeoutUs * 2) : MB_RESPOND_TOUT_MAX_US;
+    }
+    portEXIT_CRITICAL(&xRespondStatsLock);
+}
+
+BOOL xMBMasterPortGetRespondStats(UCHAR ucSlaveAddress, xMBMasterRespondStats* pxStats)
+{
+    BOOL xFound = FALSE;
+    portENTER_CRITICAL(&xRespondStatsLock);
+    xMBMasterRespondStats* pxEntry = prvpxMBMasterRespondStatsGet(ucSlaveAddress, FALSE);
+    if (pxEntry) {
+        *pxStats = *pxEntry;
+        xFound = TRUE;
+    }
+    portEXIT_CRITICAL(&xRespondStatsLock);
+    return xFound;
+}
+#endif
+
+void vMBMasterPortTimersRespondTimeoutEnable(void)
+{
+#if MB_MASTER_ADAPTIVE_TIMEOUT_ENABLED
+    uint64_t xToutUs = MB_RESPOND_TOUT_MAX_US;
+    portENTER_CRITICAL(&xRespondStatsLock);
+    xMBMasterRespondStats* pxStats = prvpxMBMasterRespondStatsGet(ucMBMasterGetDestAddress(), FALSE);
+    if (pxStats) {
+        xToutUs = pxStats->ulTimeoutUs;
+    }
+    portEXIT_CRITICAL(&xRespondStatsLock);
+#else
+    uint64_t xToutUs = (MB_MASTER_TIMEOUT_MS_RESPOND * 1000);
+#endif
+
+    vMBMasterSetCurTimerMode(MB_TMODE_RESPOND_TIMEOUT);
+    ESP_LOGD(MB_PORT_TAG,"%s Respond enable timeout.", __func__);
+    (void)xMBMasterPortTimersEnable(xToutUs);
+}
+
+void MB_PORT_ISR_ATTR
+vMBMasterPortTimersDisable()
+{
+    // Disable timer alarm
+    esp_timer_stop(pxTimerContext[ucMBMasterPortGetInstance()]->xTimerIntHandle);
+}
+
+void vMBMasterPortTimerClose(void)
+{
+    UCHAR ucInstance = ucMBMasterPortGetInstance();
+    xTimerContext_t* pxCtx = pxTimerContext[ucInstance];
+    // Delete active timer
+    if (pxCtx) {
+        if (pxCtx->xTimerIntHandle) {
+            esp_timer_stop(pxCtx->xTimerIntHandle);
+            esp_timer_delete(pxCtx->xTimerIntHandle);
+        }
+        free(pxCtx);
+        pxTimerContext[ucInstance] = NULL;
+    }
+}
@@ -10,10 +10,13 @@
 #include <sys/time.h>               // for calculation of time stamp in milliseconds
 #include "esp_log.h"                // for log_write
 #include <string.h>                 // for memcpy
+#include <stdlib.h>                 // for qsort
+#include "esp_timer.h"              // for esp_timer_get_time
 #include "freertos/FreeRTOS.h"      // for task creation and queue access
 #include "freertos/task.h"          // for task api access
 #include "freertos/event_groups.h"  // for event groups
 #include "freertos/queue.h"         // for queue api access
+#include "freertos/semphr.h"        // for request mutex
 #include "mb_m.h"                   // for modbus stack master types definition
 #include "port.h"                   // for port callback functions
 #include "mbutils.h"                // for mbutils functions definition for stack callback
@@ -30,15 +33,56 @@ extern BOOL xMBMasterPortSerialTxPoll(void);
 // Actual wait time depends on the response timer
 #define MB_SERIAL_API_RESP_TICS    (pdMS_TO_TICKS(MB_MAX_RESPONSE_TIME_MS))
 
-static mb_master_interface_t* mbm_interface_ptr = NULL;
 static const char *TAG = "MB_CONTROLLER_MASTER";
 
+#if CONFIG_FMB_MASTER_COALESCE_READS
+#define MB_READ_BLOCK_NONE (0xFFFF)
+
+// Holding or input registers of one slave that are read by a single request
+typedef struct {
+    uint8_t slave_addr;                 // slave address of all characteristics in the block
+    mb_param_type_t param_type;         // register area of all characteristics in the block
+    uint16_t reg_start;                 // first register of the request
+    uint16_t reg_size;                  // number of registers of the request
+    uint32_t read_gen;                  // incremented on each read of the block
+    int64_t read_time;                  // time of the last read, 0 if the cache is invalid
+    esp_err_t read_err;                 // result of the last read
+    uint8_t* reg_data;                  // cached response, reg_size registers
+} mb_read_block_t;
+
+// Read plan entry of a characteristic
+typedef struct {
+    uint16_t block;                     // index of the read block or MB_READ_BLOCK_NONE
+    uint32_t read_gen;                  // read_gen of the block when the cid was last served
+} mb_read_plan_t;
+
+#endif
+
+// State of one serial master controller, selected by the instance of the calling task
+typedef struct {
+    mb_master_interface_t* interface_ptr;   // NULL if the instance is free
+    SemaphoreHandle_t request_lock;         // held from the buffer setup until the response
+#if CONFIG_FMB_MASTER_COALESCE_READS
+    mb_read_block_t* read_blocks;
+    uint16_t read_block_count;
+    mb_read_plan_t* read_plan;
+#endif
+} mb_serial_master_inst_t;
+
+static mb_serial_master_inst_t mbm_instances[MB_MASTER_INSTANCES];
+
+#define MBM_INST() (&mbm_instances[ucMBMasterPortGetInstance()])
+
 // Modbus event processing task
 static void modbus_master_task(void *pvParameters)
 {
+    // The instance of the controller is the task parameter
+    UCHAR instance = (UCHAR)(uintptr_t)pvParameters;
+    (void)xMBMasterPortBindTask(NULL, instance);
+    mb_serial_master_inst_t* mbm_inst = &mbm_instances[instance];
     // The interface must be initialized before start of state machine
-    MB_MASTER_ASSERT(mbm_interface_ptr != NULL);
-    mb_master_options_t* mbm_opts = &mbm_interface_ptr->opts;
+    MB_MASTER_ASSERT(mbm_inst->interface_ptr != NULL);
+    mb_master_options_t* mbm_opts = &mbm_inst->interface_ptr->opts;
     // Main Modbus stack processing cycle
     for (;;) {
         // Wait for poll events
@@ -63,10 +107,11 @@ static void modbus_master_task(void *pvParameters)
 // Setup Modbus controller parameters
 static esp_err_t mbc_serial_master_setup(void* comm_info)
 {
-    MB_MASTER_CHECK((mbm_interface_ptr != NULL),
+    mb_serial_master_inst_t* mbm_inst = MBM_INST();
+    MB_MASTER_CHECK((mbm_inst->interface_ptr != NULL),
                     ESP_ERR_INVALID_STATE,
                     "Master interface uninitialized.");
-    mb_master_options_t* mbm_opts = &mbm_interface_ptr->opts;
+    mb_master_options_t* mbm_opts = &mbm_inst->interface_ptr->opts;
 
     const mb_master_comm_info_t* comm_info_ptr = (mb_master_comm_info_t*)comm_info;
     // Check communication options
@@ -84,11 +129,12 @@ static esp_err_t mbc_serial_master_setup(void* comm_info)
 // Modbus controller stack start function
 static esp_err_t mbc_serial_master_start(void)
 {
-    MB_MASTER_CHECK((mbm_interface_ptr != NULL),
+    mb_serial_master_inst_t* mbm_inst = MBM_INST();
+    MB_MASTER_CHECK((mbm_inst->interface_ptr != NULL),
                     ESP_ERR_INVALID_STATE,
                     "Master interface uninitialized.");
     eMBErrorCode status = MB_EIO;
-    mb_master_options_t* mbm_opts = &mbm_interface_ptr->opts;
+    mb_master_options_t* mbm_opts = &mbm_inst->interface_ptr->opts;
     const mb_communication_info_t* comm_info = (mb_communication_info_t*)&mbm_opts->mbm_comm;
 
     // Initialize Modbus stack using mbcontroller parameters
@@ -109,13 +155,192 @@ static esp_err_t mbc_serial_master_start(void)
     return ESP_OK;
 }
 
+#if CONFIG_FMB_MASTER_COALESCE_READS
+static void mbc_serial_master_free_read_plan(void)
+{
+    mb_serial_master_inst_t* mbm_inst = MBM_INST();
+    for (uint16_t i = 0; i < mbm_inst->read_block_count; i++) {
+        free(mbm_inst->read_blocks[i].reg_data);
+    }
+    free(mbm_inst->read_blocks);
+    free(mbm_inst->read_plan);
+    mbm_inst->read_blocks = NULL;
+    mbm_inst->read_plan = NULL;
+    mbm_inst->read_block_count = 0;
+}
+
+static bool mbc_serial_master_can_coalesce(const mb_parameter_descriptor_t* reg_ptr)
+{
+    return ((reg_ptr->mb_param_type == MB_PARAM_HOLDING) || (reg_ptr->mb_param_type == MB_PARAM_INPUT))
+            && (reg_ptr->mb_size <= MB_MASTER_COALESCE_MAX_REGS);
+}
+
+static const mb_parameter_descriptor_t* mbm_sort_table = NULL;
+
+// Orders characteristics by slave, register area and start register
+static int mbc_serial_master_cmp_reg(const void* a, const void* b)
+{
+    const mb_parameter_descriptor_t* reg_a = &mbm_sort_table[*(const uint16_t*)a];
+    const mb_parameter_descriptor_t* reg_b = &mbm_sort_table[*(const uint16_t*)b];
+    if (reg_a->mb_slave_addr != reg_b->mb_slave_addr) {
+        return (int)reg_a->mb_slave_addr - (int)reg_b->mb_slave_addr;
+    }
+    if (reg_a->mb_param_type != reg_b->mb_param_type) {
+        return (int)reg_a->mb_param_type - (int)reg_b->mb_param_type;
+    }
+    return (int)reg_a->mb_reg_start - (int)reg_b->mb_reg_start;
+}
+
+// Groups the readable register characteristics of the table into blocks of adjacent registers.
+// Characteristics that do not share a block with others are read by their own request.
+static esp_err_t mbc_serial_master_plan_reads(const mb_parameter_descriptor_t* descriptor, uint16_t num_elements)
+{
+    mb_serial_master_inst_t* mbm_inst = MBM_INST();
+    mbc_serial_master_free_read_plan();
+    mbm_inst->read_plan = calloc(num_elements, sizeof(mb_read_plan_t));
+    uint16_t* order = calloc(num_elements, sizeof(uint16_t));
+    // Each characteristic can start a new block in the worst case
+    mbm_inst->read_blocks = calloc(num_elements, sizeof(mb_read_block_t));
+    if (!mbm_inst->read_plan || !order || !mbm_inst->read_blocks) {
+        free(order);
+        mbc_serial_master_free_read_plan();
+        return ESP_ERR_NO_MEM;
+    }
+    uint16_t count = 0;
+    for (uint16_t cid = 0; cid < num_elements; cid++) {
+        mbm_inst->read_plan[cid].block = MB_READ_BLOCK_NONE;
+        if (mbc_serial_master_can_coalesce(&descriptor[cid])) {
+            order[count++] = cid;
+        }
+    }
+    mbm_sort_table = descriptor;
+    qsort(order, count, sizeof(uint16_t), mbc_serial_master_cmp_reg);
+
+    uint16_t first = 0;
+    while (first < count) {
+        const mb_parameter_descriptor_t* reg_ptr = &descriptor[order[first]];
+        uint32_t start = reg_ptr->mb_reg_start;
+        uint32_t end = start + reg_ptr->mb_size;
+        uint16_t last = first + 1;
+        for (; last < count; last++) {
+            const mb_parameter_descriptor_t* next_ptr = &descriptor[order[last]];
+            uint32_t next_end = next_ptr->mb_reg_start + next_ptr->mb_size;
+            if ((next_ptr->mb_slave_addr != reg_ptr->mb_slave_addr)
+                    || (next_ptr->mb_param_type != reg_ptr->mb_param_type)
+                    || (next_ptr->mb_reg_start > end + MB_MASTER_COALESCE_GAP)
+                    || (((next_end > end) ? next_end : end) - start > MB_MASTER_COALESCE_MAX_REGS)) {
+                break;
+            }
+            end = (next_end > end) ? next_end : end;
+        }
+        if (last - first > 1) {
+            mb_read_block_t* block = &mbm_inst->read_blocks[mbm_inst->read_block_count];
+            block->slave_addr = reg_ptr->mb_slave_addr;
+            block->param_type = reg_ptr->mb_param_type;
+            block->reg_start = start;
+            block->reg_size = end - start;
+            block->reg_data = calloc(block->reg_size, sizeof(uint16_t));
+            if (!block->reg_data) {
+                free(order);
+                mbc_serial_master_free_read_plan();
+                return ESP_ERR_NO_MEM;
+            }
+            for (uint16_t i = first; i < last; i++) {
+                mbm_inst->read_plan[order[i]].block = mbm_inst->read_block_count;
+            }
+            ESP_LOGD(TAG, "read block %u: slave %u, registers %u..%u, %u characteristics.",
+                        (unsigned)mbm_inst->read_block_count, (unsigned)block->slave_addr,
+                        (unsigned)start, (unsigned)(end - 1), (unsigned)(last - first));
+            mbm_inst->read_block_count++;
+        }
+        first = last;
+    }
+    free(order);
+    return ESP_OK;
+}
+
+// Drop the cached responses of a slave, called after a write to it
+static void mbc_serial_master_invalidate_reads(uint8_t slave_addr)
+{
+    mb_serial_master_inst_t* mbm_inst = MBM_INST();
+    for (uint16_t i = 0; i < mbm_inst->read_block_count; i++) {
+        if (mbm_inst->read_blocks[i].slave_addr == slave_addr) {
+            mbm_inst->read_blocks[i].read_time = 0;
+        }
+    }
+}
+
+static esp_err_t mbc_serial_master_send_request(mb_param_request_t* request, void* data_ptr);
+static uint8_t mbc_serial_master_get_command(mb_param_type_t param_type, mb_param_mode_t mode);
+
+// Serve a characteristic from the response of its read block, the block is read again
+// if the cached response is too old or the characteristic was already served from it.
+// The cached flag is set if no request was sent for the characteristic.
+static esp_err_t mbc_serial_master_get_coalesced(const mb_parameter_descriptor_t* reg_info, uint8_t* value_ptr,
+                                                    bool* cached)
+{
+    mb_serial_master_inst_t* mbm_inst = MBM_INST();
+    mb_read_plan_t* plan = &mbm_inst->read_plan[reg_info->cid];
+    uint16_t block_index = plan->block;
+    mb_read_block_t* block = &mbm_inst->read_blocks[block_index];
+    // The block is shared by the characteristics read from other tasks
+    if (xSemaphoreTakeRecursive(mbm_inst->request_lock, MB_SERIAL_API_RESP_TICS) != pdTRUE) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    int64_t now = esp_timer_get_time();
+    *cached = true;
+    if ((block->read_time == 0)
+            || (plan->read_gen == block->read_gen)
+            || ((now - block->read_time) > MB_MASTER_COALESCE_MAX_AGE_US)) {
+        mb_param_request_t request = {
+            .slave_addr = block->slave_addr,
+            .command = mbc_serial_master_get_command(block->param_type, MB_PARAM_READ),
+            .reg_start = block->reg_start,
+            .reg_size = block->reg_size
+        };
+        *cached = false;
+        block->read_err = mbc_serial_master_send_request(&request, block->reg_data);
+        block->read_time = esp_timer_get_time();
+        block->read_gen++;
+        if ((block->read_err == ESP_ERR_INVALID_RESPONSE)
+                && (eMBMasterGetException() == MB_EX_ILLEGAL_DATA_ADDRESS)) {
+            // The slave rejects unused registers of the block, read its members one by one
+            ESP_LOGW(TAG, "%s: slave %u rejects read of registers %u..%u, block is split.",
+                        __FUNCTION__, (unsigned)block->slave_addr, (unsigned)block->reg_start,
+                        (unsigned)(block->reg_start + block->reg_size - 1));
+            for (uint16_t cid = 0; cid < mbm_inst->interface_ptr->opts.mbm_param_descriptor_size; cid++) {
+                if (mbm_inst->read_plan[cid].block == block_index) {
+                    mbm_inst->read_plan[cid].block = MB_READ_BLOCK_NONE;
+                }
+            }
+            block->read_time = 0;
+            request.reg_start = reg_info->mb_reg_start;
+            request.reg_size = reg_info->mb_size;
+            esp_err_t error = mbc_serial_master_send_request(&request, value_ptr);
+            (void)xSemaphoreGiveRecursive(mbm_inst->request_lock);
+            return error;
+        }
+    }
+    plan->read_gen = block->read_gen;
+    if (block->read_err == ESP_OK) {
+        memcpy(value_ptr, block->reg_data + (reg_info->mb_reg_start - block->reg_start) * sizeof(uint16_t),
+                reg_info->mb_size * sizeof(uint16_t));
+    }
+    esp_err_t error = block->read_err;
+    (void)xSemaphoreGiveRecursive(mbm_inst->request_lock);
+    return error;
+}
+#endif
+
 // Modbus controller destroy function
 static esp_err_t mbc_serial_master_destroy(void)
 {
-    MB_MASTER_CHECK((mbm_interface_ptr != NULL),
+    mb_serial_master_inst_t* mbm_inst = MBM_INST();
+    MB_MASTER_CHECK((mbm_inst->interface_ptr != NULL),
                     ESP_ERR_INVALID_STATE,
                     "Master interface uninitialized.");
-    mb_master_options_t* mbm_opts = &mbm_interface_ptr->opts;
+    mb_master_options_t* mbm_opts = &mbm_inst->interface_ptr->opts;
+    UCHAR instance = mbm_opts->mbm_instance;
     eMBErrorCode mb_error = MB_ENOERR;
     // Stop polling by clearing correspondent bit in the event group
     EventBits_t flag = xEventGroupClearBits(mbm_opts->mbm_event_group,
@@ -130,20 +355,28 @@ static esp_err_t mbc_serial_master_destroy(void)
     mb_error = eMBMasterClose();
     MB_MASTER_CHECK((mb_error == MB_ENOERR), ESP_ERR_INVALID_STATE,
                     "mb stack close failure returned (0x%x).", (int)mb_error);
-    free(mbm_interface_ptr); // free the memory allocated for options
+#if CONFIG_FMB_MASTER_COALESCE_READS
+    mbc_serial_master_free_read_plan();
+#endif
+    mbc_master_free_key_index(mbm_opts);
+    vSemaphoreDelete(mbm_inst->request_lock);
+    mbm_inst->request_lock = NULL;
+    free(mbm_inst->interface_ptr); // free the memory allocated for options
     vMBPortSetMode((UCHAR)MB_PORT_INACTIVE);
-    mbm_interface_ptr = NULL;
+    mbm_inst->interface_ptr = NULL;
+    vMBMasterPortUnbindInstance(instance);
     return ESP_OK;
 }
 
 // Set Modbus parameter description table
 static esp_err_t mbc_serial_master_set_descriptor(const mb_parameter_descriptor_t* descriptor, const uint16_t num_elements)
 {
+    mb_serial_master_inst_t* mbm_inst = MBM_INST();
     MB_MASTER_CHECK((descriptor != NULL),
                         ESP_ERR_INVALID_ARG, "mb incorrect descriptor.");
     MB_MASTER_CHECK((num_elements >= 1),
                         ESP_ERR_INVALID_ARG, "mb table size is incorrect.");
-    mb_master_options_t* mbm_opts = &mbm_interface_ptr->opts;
+    mb_master_options_t* mbm_opts = &mbm_inst->interface_ptr->opts;
     const mb_parameter_descriptor_t *reg_ptr = descriptor;
     // Go through all items in the table to check all Modbus registers
     for (uint16_t counter = 0; counter < (num_elements); counter++, reg_ptr++)
@@ -156,18 +389,28 @@ static esp_err_t mbc_serial_master_set_descriptor(const mb_parameter_descriptor_
         MB_MASTER_CHECK((reg_ptr->mb_size > 0),
                             ESP_ERR_INVALID_ARG, "mb descriptor param size is incorrect.");
     }
+    esp_err_t error = ESP_OK;
+#if CONFIG_FMB_MASTER_COALESCE_READS
+    error = mbc_serial_master_plan_reads(descriptor, num_elements);
+    MB_MASTER_CHECK((error == ESP_OK),
+                        error, "mb read plan allocation failure.");
+#endif
     mbm_opts->mbm_param_descriptor_table = descriptor;
     mbm_opts->mbm_param_descriptor_size = num_elements;
+    error = mbc_master_build_key_index(mbm_opts);
+    MB_MASTER_CHECK((error == ESP_OK),
+                        error, "mb key index allocation failure.");
     return ESP_OK;
 }
 
 // Send custom Modbus request defined as mb_param_request_t structure
 static esp_err_t mbc_serial_master_send_request(mb_param_request_t* request, void* data_ptr)
 {
-    MB_MASTER_CHECK((mbm_interface_ptr != NULL),
+    mb_serial_master_inst_t* mbm_inst = MBM_INST();
+    MB_MASTER_CHECK((mbm_inst->interface_ptr != NULL),
                     ESP_ERR_INVALID_STATE,
                     "Master interface uninitialized.");
-    mb_master_options_t* mbm_opts = &mbm_interface_ptr->opts;
+    mb_master_options_t* mbm_opts = &mbm_inst->interface_ptr->opts;
     MB_MASTER_CHECK((request != NULL),
                     ESP_ERR_INVALID_ARG, "mb request structure.");
     MB_MASTER_CHECK((data_ptr != NULL),
@@ -176,6 +419,13 @@ static esp_err_t mbc_serial_master_send_request(mb_param_request_t* request, voi
     eMBMasterReqErrCode mb_error = MB_MRE_MASTER_BUSY;
     esp_err_t error = ESP_FAIL;
 
+    // The response is written to the buffer of the request by the stack callbacks,
+    // the next request may set its buffer only after this one is complete.
+    if (xSemaphoreTakeRecursive(mbm_inst->request_lock, MB_SERIAL_API_RESP_TICS) != pdTRUE) {
+        ESP_LOGE(TAG, "%s: Master is busy, request is not sent.", __FUNCTION__);
+        return ESP_ERR_INVALID_STATE;
+    }
+
     if (xMBMasterRunResTake(MB_SERIAL_API_RESP_TICS)) {
         
         uint8_t mb_slave_addr = request->slave_addr;
@@ -237,7 +487,16 @@ static esp_err_t mbc_serial_master_send_request(mb_param_request_t* request, voi
                 mb_error = MB_MRE_NO_REG;
                 break;
         }
+#if CONFIG_FMB_MASTER_COALESCE_READS
+        if ((mb_command == MB_FUNC_WRITE_REGISTER)
+                || (mb_command == MB_FUNC_WRITE_MULTIPLE_REGISTERS)
+                || (mb_command == MB_FUNC_READWRITE_MULTIPLE_REGISTERS)) {
+            // The cached responses of the slave may be outdated now
+            mbc_serial_master_invalidate_reads(mb_slave_addr);
+        }
+#endif
     }
+    (void)xSemaphoreGiveRecursive(mbm_inst->request_lock);
 
     // Propagate the Modbus errors to higher level
     switch(mb_error)
@@ -274,10 +533,11 @@ static esp_err_t mbc_serial_master_send_request(mb_param_request_t* request, voi
 
 static esp_err_t mbc_serial_master_get_cid_info(uint16_t cid, const mb_parameter_descriptor_t** param_buffer)
 {
-    MB_MASTER_CHECK((mbm_interface_ptr != NULL),
+    mb_serial_master_inst_t* mbm_inst = MBM_INST();
+    MB_MASTER_CHECK((mbm_inst->interface_ptr != NULL),
                     ESP_ERR_INVALID_STATE,
                     "Master interface uninitialized.");
-    mb_master_options_t* mbm_opts = &mbm_interface_ptr->opts;
+    mb_master_options_t* mbm_opts = &mbm_inst->interface_ptr->opts;
 
     MB_MASTER_CHECK((param_buffer != NULL),
                         ESP_ERR_INVALID_ARG, "mb incorrect data buffer pointer.");
@@ -328,16 +588,17 @@ static uint8_t mbc_serial_master_get_command(mb_param_type_t param_type, mb_para
     return command;
 }
 
-// Helper to search parameter by name in the parameter description table
+// Helper to find parameter by cid and name in the parameter description table
 // and fills Modbus request fields accordingly
-static esp_err_t mbc_serial_master_set_request(char* name, mb_param_mode_t mode,
+static esp_err_t mbc_serial_master_set_request(uint16_t cid, char* name, mb_param_mode_t mode,
                                                 mb_param_request_t* request,
                                                 mb_parameter_descriptor_t* reg_data)
 {
-    MB_MASTER_CHECK((mbm_interface_ptr != NULL),
+    mb_serial_master_inst_t* mbm_inst = MBM_INST();
+    MB_MASTER_CHECK((mbm_inst->interface_ptr != NULL),
                     ESP_ERR_INVALID_STATE,
                     "Master interface uninitialized.");
-    mb_master_options_t* mbm_opts = &mbm_interface_ptr->opts;
+    mb_master_options_t* mbm_opts = &mbm_inst->interface_ptr->opts;
     esp_err_t error = ESP_ERR_NOT_FOUND;
     MB_MASTER_CHECK((name != NULL),
                         ESP_ERR_INVALID_ARG, "mb incorrect parameter name.");
@@ -346,39 +607,29 @@ static esp_err_t mbc_serial_master_set_request(char* name, mb_param_mode_t mode,
     MB_MASTER_CHECK((mode <= MB_PARAM_WRITE),
                         ESP_ERR_INVALID_ARG, "mb incorrect mode.");
     MB_MASTER_ASSERT(mbm_opts->mbm_param_descriptor_table != NULL);
-    const mb_parameter_descriptor_t* reg_ptr = mbm_opts->mbm_param_descriptor_table;
-    for (uint16_t counter = 0; counter < (mbm_opts->mbm_param_descriptor_size); counter++, reg_ptr++)
-    {
-        // Check the cid of the parameter is equal to record number in the table
-        // Check the length of name and parameter key strings from table
-        size_t param_key_len = strlen((const char*)reg_ptr->param_key);
-        if (param_key_len != strlen((const char*)name)) {
-            continue; // The length of strings is different then check next record in the table
-        }
-        // Compare the name of parameter with parameter key from table
-        int comp_result = memcmp((const void*)name, (const void*)reg_ptr->param_key, (size_t)param_key_len);
-        if (comp_result == 0) {
-            // The correct line is found in the table and reg_ptr points to the found parameter description
-            request->slave_addr = reg_ptr->mb_slave_addr;
-            request->reg_start = reg_ptr->mb_reg_start;
-            request->reg_size = reg_ptr->mb_size;
-            request->command = mbc_serial_master_get_command(reg_ptr->mb_param_type, mode);
-            MB_MASTER_CHECK((request->command > 0), ESP_ERR_INVALID_ARG,
-                                "mb incorrect command or parameter type.");
-            if (reg_data != NULL) {
-                *reg_data = *reg_ptr; // Set the cid registered parameter data
-            }
-            error = ESP_OK;
-            break;
+    // Look up the characteristic through the cid and the key index
+    const mb_parameter_descriptor_t* reg_ptr = mbc_master_find_param(mbm_opts, cid, name);
+    if (reg_ptr != NULL) {
+        request->slave_addr = reg_ptr->mb_slave_addr;
+        request->reg_start = reg_ptr->mb_reg_start;
+        request->reg_size = reg_ptr->mb_size;
+        request->command = mbc_serial_master_get_command(reg_ptr->mb_param_type, mode);
+        MB_MASTER_CHECK((request->command > 0), ESP_ERR_INVALID_ARG,
+                            "mb incorrect command or parameter type.");
+        if (reg_data != NULL) {
+            *reg_data = *reg_ptr; // Set the cid registered parameter data
         }
+        error = ESP_OK;
     }
     return error;
 }
 
-// Get parameter data for corresponding characteristic
-static esp_err_t mbc_serial_master_get_parameter(uint16_t cid, char* name,
-                                                    uint8_t* value_ptr, uint8_t *type)
+// Get parameter data for corresponding characteristic, cached is set if it was served
+// from the cached response of its read block without a request
+static esp_err_t mbc_serial_master_get_parameter_cached(uint16_t cid, char* name,
+                                                    uint8_t* value_ptr, uint8_t *type, bool* cached)
 {
+    mb_serial_master_inst_t* mbm_inst = MBM_INST();
     MB_MASTER_CHECK((name != NULL),
                         ESP_ERR_INVALID_ARG, "mb incorrect descriptor.");
     MB_MASTER_CHECK((type != NULL),
@@ -387,8 +638,15 @@ static esp_err_t mbc_serial_master_get_parameter(uint16_t cid, char* name,
     mb_param_request_t request ;
     mb_parameter_descriptor_t reg_info = { 0 };
 
-    error = mbc_serial_master_set_request(name, MB_PARAM_READ, &request, &reg_info);
+    *cached = false;
+    error = mbc_serial_master_set_request(cid, name, MB_PARAM_READ, &request, &reg_info);
     if ((error == ESP_OK) && (cid == reg_info.cid)) {
+#if CONFIG_FMB_MASTER_COALESCE_READS
+        if (mbm_inst->read_plan && (mbm_inst->read_plan[cid].block != MB_READ_BLOCK_NONE)) {
+            // Read the block of adjacent characteristics or use its cached response
+            error = mbc_serial_master_get_coalesced(&reg_info, value_ptr, cached);
+        } else
+#endif
         // Send request to read characteristic data
         error = mbc_serial_master_send_request(&request, value_ptr);
         if (error == ESP_OK) {
@@ -408,6 +666,14 @@ static esp_err_t mbc_serial_master_get_parameter(uint16_t cid, char* name,
     return error;
 }
 
+// Get parameter data for corresponding characteristic
+static esp_err_t mbc_serial_master_get_parameter(uint16_t cid, char* name,
+                                                    uint8_t* value_ptr, uint8_t *type)
+{
+    bool cached = false;
+    return mbc_serial_master_get_parameter_cached(cid, name, value_ptr, type, &cached);
+}
+
 // Set parameter value for characteristic selected by name and cid
 static esp_err_t mbc_serial_master_set_parameter(uint16_t cid, char* name,
                                                     uint8_t* value_ptr, uint8_t *type)
@@ -422,7 +688,7 @@ static esp_err_t mbc_serial_master_set_parameter(uint16_t cid, char* name,
     mb_param_request_t request ;
     mb_parameter_descriptor_t reg_info = { 0 };
 
-    error = mbc_serial_master_set_request(name, MB_PARAM_WRITE, &request, &reg_info);
+    error = mbc_serial_master_set_request(cid, name, MB_PARAM_WRITE, &request, &reg_info);
     if ((error == ESP_OK) && (cid == reg_info.cid)) {
         // Send request to write characteristic data
         error = mbc_serial_master_send_request(&request, value_ptr);
@@ -459,12 +725,13 @@ static esp_err_t mbc_serial_master_set_parameter(uint16_t cid, char* name,
 eMBErrorCode eMBRegInputCBSerialMaster(UCHAR * pucRegBuffer, USHORT usAddress,
                                 USHORT usNRegs)
 {
-    MB_MASTER_CHECK((mbm_interface_ptr != NULL),
+    mb_serial_master_inst_t* mbm_inst = MBM_INST();
+    MB_MASTER_CHECK((mbm_inst->interface_ptr != NULL),
                     MB_EILLSTATE,
                     "Master interface uninitialized.");
     MB_MASTER_CHECK((pucRegBuffer != NULL), MB_EINVAL,
                     "Master stack processing error.");
-    mb_master_options_t* mbm_opts = &mbm_interface_ptr->opts;
+    mb_master_options_t* mbm_opts = &mbm_inst->interface_ptr->opts;
     // Number of input registers to be transferred
     USHORT usRegInputNregs = (USHORT)mbm_opts->mbm_reg_buffer_size;
     UCHAR* pucInputBuffer = (UCHAR*)mbm_opts->mbm_reg_buffer_ptr; // Get instance address
@@ -499,12 +766,13 @@ eMBErrorCode eMBRegInputCBSerialMaster(UCHAR * pucRegBuffer, USHORT usAddress,
 eMBErrorCode eMBRegHoldingCBSerialMaster(UCHAR * pucRegBuffer, USHORT usAddress,
         USHORT usNRegs, eMBRegisterMode eMode)
 {
-    MB_MASTER_CHECK((mbm_interface_ptr != NULL),
+    mb_serial_master_inst_t* mbm_inst = MBM_INST();
+    MB_MASTER_CHECK((mbm_inst->interface_ptr != NULL),
                     MB_EILLSTATE,
                     "Master interface uninitialized.");
     MB_MASTER_CHECK((pucRegBuffer != NULL), MB_EINVAL,
                     "Master stack processing error.");
-    mb_master_options_t* mbm_opts = &mbm_interface_ptr->opts;
+    mb_master_options_t* mbm_opts = &mbm_inst->interface_ptr->opts;
     USHORT usRegHoldingNregs = (USHORT)mbm_opts->mbm_reg_buffer_size;
     UCHAR* pucHoldingBuffer = (UCHAR*)mbm_opts->mbm_reg_buffer_ptr;
     eMBErrorCode eStatus = MB_ENOERR;
@@ -548,11 +816,12 @@ eMBErrorCode eMBRegHoldingCBSerialMaster(UCHAR * pucRegBuffer, USHORT usAddress,
 eMBErrorCode eMBRegCoilsCBSerialMaster(UCHAR* pucRegBuffer, USHORT usAddress,
         USHORT usNCoils, eMBRegisterMode eMode)
 {
-    MB_MASTER_CHECK((mbm_interface_ptr != NULL),
+    mb_serial_master_inst_t* mbm_inst = MBM_INST();
+    MB_MASTER_CHECK((mbm_inst->interface_ptr != NULL),
                         MB_EILLSTATE, "Master interface uninitialized.");
     MB_MASTER_CHECK((pucRegBuffer != NULL),
                         MB_EINVAL, "Master stack processing error.");
-    mb_master_options_t* mbm_opts = &mbm_interface_ptr->opts;
+    mb_master_options_t* mbm_opts = &mbm_inst->interface_ptr->opts;
     USHORT usRegCoilNregs = (USHORT)mbm_opts->mbm_reg_buffer_size;
     UCHAR* pucRegCoilsBuf = (UCHAR*)mbm_opts->mbm_reg_buffer_ptr;
     eMBErrorCode eStatus = MB_ENOERR;
@@ -601,11 +870,12 @@ eMBErrorCode eMBRegCoilsCBSerialMaster(UCHAR* pucRegBuffer, USHORT usAddress,
 eMBErrorCode eMBRegDiscreteCBSerialMaster(UCHAR * pucRegBuffer, USHORT usAddress,
                             USHORT usNDiscrete)
 {
-    MB_MASTER_CHECK((mbm_interface_ptr != NULL),
+    mb_serial_master_inst_t* mbm_inst = MBM_INST();
+    MB_MASTER_CHECK((mbm_inst->interface_ptr != NULL),
                     MB_EILLSTATE, "Master interface uninitialized.");
     MB_MASTER_CHECK((pucRegBuffer != NULL),
                     MB_EINVAL, "Master stack processing error.");
-    mb_master_options_t* mbm_opts = &mbm_interface_ptr->opts;
+    mb_master_options_t* mbm_opts = &mbm_inst->interface_ptr->opts;
     USHORT usRegDiscreteNregs = (USHORT)mbm_opts->mbm_reg_buffer_size;
     UCHAR* pucRegDiscreteBuf = (UCHAR*)mbm_opts->mbm_reg_buffer_ptr;
     eMBErrorCode eStatus = MB_ENOERR;
@@ -640,15 +910,32 @@ eMBErrorCode eMBRegDiscreteCBSerialMaster(UCHAR * pucRegBuffer, USHORT usAddress
 // Initialization of resources for Modbus serial master controller
 esp_err_t mbc_serial_master_create(void** handler)
 {
+    // Take the first free instance, a single instance is reused as before
+    UCHAR instance = 0;
+#if MB_MASTER_INSTANCES > 1
+    while ((instance < MB_MASTER_INSTANCES) && (mbm_instances[instance].interface_ptr != NULL)) {
+        instance++;
+    }
+    MB_MASTER_CHECK((instance < MB_MASTER_INSTANCES),
+                        ESP_ERR_NO_MEM, "mb all master instances are in use.");
+    // The following calls of this task go to the new instance
+    (void)xMBMasterPortBindTask(NULL, instance);
+#endif
+    mb_serial_master_inst_t* mbm_inst = &mbm_instances[instance];
     // Allocate space for master interface structure
-    if (mbm_interface_ptr == NULL) {
-        mbm_interface_ptr = malloc(sizeof(mb_master_interface_t));
+    if (mbm_inst->interface_ptr == NULL) {
+        mbm_inst->interface_ptr = malloc(sizeof(mb_master_interface_t));
     }
-    MB_MASTER_ASSERT(mbm_interface_ptr != NULL);
+    MB_MASTER_ASSERT(mbm_inst->interface_ptr != NULL);
 
     // Initialize interface properties
-    mb_master_options_t* mbm_opts = &mbm_interface_ptr->opts;
+    mb_master_options_t* mbm_opts = &mbm_inst->interface_ptr->opts;
     mbm_opts->port_type = MB_PORT_SERIAL_MASTER;
+    mbm_opts->mbm_instance = instance;
+    mbm_opts->mbm_param_descriptor_table = NULL;
+    mbm_opts->mbm_param_descriptor_size = 0;
+    mbm_opts->mbm_param_key_index = NULL;
+    mbm_opts->mbm_param_key_index_mask = 0;
 
     vMBPortSetMode((UCHAR)MB_PORT_SERIAL_MASTER);
 
@@ -659,6 +946,12 @@ esp_err_t mbc_serial_master_create(void** handler)
 
     // Initialization of active context of the modbus controller
     BaseType_t status = 0;
+    // Requests of all tasks using this instance are sent one by one
+    if (mbm_inst->request_lock == NULL) {
+        mbm_inst->request_lock = xSemaphoreCreateRecursiveMutex();
+    }
+    MB_MASTER_CHECK((mbm_inst->request_lock != NULL),
+                        ESP_ERR_NO_MEM, "mb request mutex error.");
     // Parameter change notification queue
     mbm_opts->mbm_event_group = xEventGroupCreate();
     MB_MASTER_CHECK((mbm_opts->mbm_event_group != NULL),
@@ -667,7 +960,7 @@ esp_err_t mbc_serial_master_create(void** handler)
     status = xTaskCreatePinnedToCore((void*)&modbus_master_task,
                             "modbus_matask",
                             MB_CONTROLLER_STACK_SIZE,
-                            NULL,                       // No parameters
+                            (void*)(uintptr_t)instance, // Instance of the controller
                             MB_CONTROLLER_PRIORITY,
                             &mbm_opts->mbm_task_handle,
                             MB_PORT_TASK_AFFINITY);
@@ -679,22 +972,25 @@ esp_err_t mbc_serial_master_create(void** handler)
     MB_MASTER_ASSERT(mbm_opts->mbm_task_handle != NULL); // The task is created but handle is incorrect
 
     // Initialize public interface methods of the interface
-    mbm_interface_ptr->init = mbc_serial_master_create;
-    mbm_interface_ptr->destroy = mbc_serial_master_destroy;
-    mbm_interface_ptr->setup = mbc_serial_master_setup;
-    mbm_interface_ptr->start = mbc_serial_master_start;
-    mbm_interface_ptr->get_cid_info = mbc_serial_master_get_cid_info;
-    mbm_interface_ptr->get_parameter = mbc_serial_master_get_parameter;
-    mbm_interface_ptr->send_request = mbc_serial_master_send_request;
-    mbm_interface_ptr->set_descriptor = mbc_serial_master_set_descriptor;
-    mbm_interface_ptr->set_parameter = mbc_serial_master_set_parameter;
-
-    mbm_interface_ptr->master_reg_cb_discrete = eMBRegDiscreteCBSerialMaster;
-    mbm_interface_ptr->master_reg_cb_input = eMBRegInputCBSerialMaster;
-    mbm_interface_ptr->master_reg_cb_holding = eMBRegHoldingCBSerialMaster;
-    mbm_interface_ptr->master_reg_cb_coils = eMBRegCoilsCBSerialMaster;
-
-    *handler = mbm_interface_ptr;
+    mbm_inst->interface_ptr->init = mbc_serial_master_create;
+    mbm_inst->interface_ptr->destroy = mbc_serial_master_destroy;
+    mbm_inst->interface_ptr->setup = mbc_serial_master_setup;
+    mbm_inst->interface_ptr->start = mbc_serial_master_start;
+    mbm_inst->interface_ptr->get_cid_info = mbc_serial_master_get_cid_info;
+    mbm_inst->interface_ptr->get_parameter = mbc_serial_master_get_parameter;
+    mbm_inst->interface_ptr->get_parameter_cached = mbc_serial_master_get_parameter_cached;
+    mbm_inst->interface_ptr->send_request = mbc_serial_master_send_request;
+    mbm_inst->interface_ptr->set_descriptor = mbc_serial_master_set_descriptor;
+    mbm_inst->interface_ptr->set_parameter = mbc_serial_master_set_parameter;
+    mbm_inst->interface_ptr->submit_request = NULL;
+    mbm_inst->interface_ptr->get_conn_stats = NULL;
+
+    mbm_inst->interface_ptr->master_reg_cb_discrete = eMBRegDiscreteCBSerialMaster;
+    mbm_inst->interface_ptr->master_reg_cb_input = eMBRegInputCBSerialMaster;
+    mbm_inst->interface_ptr->master_reg_cb_holding = eMBRegHoldingCBSerialMaster;
+    mbm_inst->interface_ptr->master_reg_cb_coils = eMBRegCoilsCBSerialMaster;
+
+    *handler = mbm_inst->interface_ptr;
 
     return ESP_OK;
 }
@@ -15,6 +15,12 @@
 #include "esp_err.h"                // for esp_err_t
 #include "esp_modbus_common.h"      // for common defines
 
+#if CONFIG_FMB_MASTER_COALESCE_READS
+#define MB_MASTER_COALESCE_GAP          (CONFIG_FMB_MASTER_COALESCE_GAP) // Max unused registers inside of a read block
+#define MB_MASTER_COALESCE_MAX_AGE_US   (CONFIG_FMB_MASTER_COALESCE_MAX_AGE_MS * 1000LL) // Max age of a cached block
+#endif
+#define MB_MASTER_COALESCE_MAX_REGS     (125) // Max registers of one read holding/input request
+
 /**
  * @brief Initialize Modbus controller and stack
  *
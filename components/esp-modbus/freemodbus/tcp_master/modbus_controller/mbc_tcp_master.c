@@ -18,6 +18,7 @@
 #include "mb_m.h"                   // for modbus stack master types definition
 #include "port.h"                   // for port callback functions and defines
 #include "mbutils.h"                // for mbutils functions definition for stack callback
+#include "mbframe.h"                // for MBAP frame offsets
 #include "sdkconfig.h"              // for KConfig values
 #include "esp_modbus_common.h"      // for common types
 #include "esp_modbus_master.h"      // for public master types
@@ -206,6 +207,7 @@ static esp_err_t mbc_tcp_master_destroy(void)
     (void)vEventGroupDelete(mbm_opts->mbm_event_group);
     mbm_opts->mbm_event_group = NULL;
     mbc_tcp_master_free_slave_list();
+    mbc_master_free_key_index(mbm_opts);
     free(mbm_interface_ptr); // free the memory allocated for options
     vMBPortSetMode((UCHAR)MB_PORT_INACTIVE);
     mbm_interface_ptr = NULL;
@@ -247,22 +249,281 @@ static esp_err_t mbc_tcp_master_set_descriptor(const mb_parameter_descriptor_t*
     }
     mbm_opts->mbm_param_descriptor_table = descriptor;
     mbm_opts->mbm_param_descriptor_size = num_elements;
+    esp_err_t error = mbc_master_build_key_index(mbm_opts);
+    MB_MASTER_CHECK((error == ESP_OK), error, "mb key index allocation failure.");
     return ESP_OK;
 }
 
+// Propagate the Modbus errors to higher level
+static esp_err_t mbc_tcp_master_get_error(eMBMasterReqErrCode mb_error)
+{
+    esp_err_t error = ESP_FAIL;
+    switch(mb_error)
+    {
+        case MB_MRE_NO_ERR:
+            error = ESP_OK;
+            break;
+
+        case MB_MRE_NO_REG:
+            error = ESP_ERR_NOT_SUPPORTED; // Invalid register request
+            break;
+
+        case MB_MRE_TIMEDOUT:
+            error = ESP_ERR_TIMEOUT; // Slave did not send response
+            break;
+
+        case MB_MRE_EXE_FUN:
+        case MB_MRE_REV_DATA:
+            error = ESP_ERR_INVALID_RESPONSE; // Invalid response from slave
+            break;
+
+        case MB_MRE_MASTER_BUSY:
+            error = ESP_ERR_INVALID_STATE; // Master is busy (previous request is pending)
+            break;
+
+        default:
+            ESP_LOGE(TAG, "%s: Incorrect return code (0x%x) ", __FUNCTION__, (unsigned)mb_error);
+            error = ESP_FAIL;
+            break;
+    }
+
+    return error;
+}
+
+#if MB_TCP_MASTER_CONCURRENT
+
+// Limits of the quantity field of the requests
+#define MB_TCP_READ_BITS_MAX        (0x07D0)
+#define MB_TCP_READ_REGS_MAX        (0x007D)
+#define MB_TCP_WRITE_BITS_MAX       (0x07B0)
+#define MB_TCP_WRITE_REGS_MAX       (0x0078)
+
+// Builds the request PDU, the values to write are taken from data_ptr in the same
+// format as used by the request functions of the stack
+static eMBMasterReqErrCode mbc_tcp_master_build_pdu(const mb_param_request_t* request, const void* data_ptr,
+                                                    uint8_t* pdu, uint16_t* pdu_len)
+{
+    const uint8_t* data = (const uint8_t*)data_ptr;
+    const uint16_t* regs = (const uint16_t*)data_ptr;
+    uint16_t reg_size = request->reg_size;
+    uint16_t len = 5;
+    pdu[0] = request->command;
+    pdu[1] = (uint8_t)(request->reg_start >> 8);
+    pdu[2] = (uint8_t)(request->reg_start & 0xFF);
+    pdu[3] = (uint8_t)(reg_size >> 8);
+    pdu[4] = (uint8_t)(reg_size & 0xFF);
+    switch(request->command)
+    {
+        case MB_FUNC_READ_COILS:
+        case MB_FUNC_READ_DISCRETE_INPUTS:
+            if ((reg_size < 1) || (reg_size > MB_TCP_READ_BITS_MAX)) {
+                return MB_MRE_ILL_ARG;
+            }
+            break;
+        case MB_FUNC_READ_HOLDING_REGISTER:
+        case MB_FUNC_READ_INPUT_REGISTER:
+            if ((reg_size < 1) || (reg_size > MB_TCP_READ_REGS_MAX)) {
+                return MB_MRE_ILL_ARG;
+            }
+            break;
+        case MB_FUNC_WRITE_SINGLE_COIL:
+        case MB_FUNC_WRITE_REGISTER:
+            if ((request->command == MB_FUNC_WRITE_SINGLE_COIL) && (regs[0] != 0xFF00) && (regs[0] != 0x0000)) {
+                return MB_MRE_ILL_ARG;
+            }
+            pdu[3] = (uint8_t)(regs[0] >> 8);
+            pdu[4] = (uint8_t)(regs[0] & 0xFF);
+            break;
+        case MB_FUNC_WRITE_MULTIPLE_COILS:
+            if ((reg_size < 1) || (reg_size > MB_TCP_WRITE_BITS_MAX)) {
+                return MB_MRE_ILL_ARG;
+            }
+            pdu[5] = (uint8_t)((reg_size + 7) >> 3);
+            memcpy(&pdu[6], data, pdu[5]);
+            len = 6 + pdu[5];
+            break;
+        case MB_FUNC_WRITE_MULTIPLE_REGISTERS:
+        case MB_FUNC_READWRITE_MULTIPLE_REGISTERS:
+            if ((reg_size < 1) || (reg_size > MB_TCP_WRITE_REGS_MAX)) {
+                return MB_MRE_ILL_ARG;
+            }
+            if (request->command == MB_FUNC_READWRITE_MULTIPLE_REGISTERS) {
+                // Read and write the same registers, the write part follows the read part
+                memmove(&pdu[5], &pdu[1], 4);
+                len = 9;
+            }
+            pdu[len++] = (uint8_t)(reg_size << 1);
+            for (uint16_t idx = 0; idx < reg_size; idx++) {
+                pdu[len++] = (uint8_t)(regs[idx] >> 8);
+                pdu[len++] = (uint8_t)(regs[idx] & 0xFF);
+            }
+            break;
+        default:
+            ESP_LOGE(TAG, "%s: Incorrect function in request (%u) ", __FUNCTION__, (unsigned)request->command);
+            return MB_MRE_NO_REG;
+    }
+    *pdu_len = len;
+    return MB_MRE_NO_ERR;
+}
+
+// Checks the response PDU and copies the values read to data_ptr
+static eMBMasterReqErrCode mbc_tcp_master_parse_pdu(const mb_param_request_t* request, const uint8_t* pdu,
+                                                    uint16_t pdu_len, void* data_ptr)
+{
+    if ((pdu_len >= 2) && (pdu[0] == (request->command | MB_FUNC_ERROR))) {
+        ESP_LOGD(TAG, "%s: Exception (0x%x) for function (%u).", __FUNCTION__, (unsigned)pdu[1], (unsigned)request->command);
+        return MB_MRE_EXE_FUN;
+    }
+    if ((pdu_len < 2) || (pdu[0] != request->command)) {
+        return MB_MRE_REV_DATA;
+    }
+    uint16_t reg_size = request->reg_size;
+    switch(request->command)
+    {
+        case MB_FUNC_READ_COILS:
+        case MB_FUNC_READ_DISCRETE_INPUTS:
+            if ((pdu[1] != ((reg_size + 7) >> 3)) || (pdu_len < (2 + pdu[1]))) {
+                return MB_MRE_REV_DATA;
+            }
+            memcpy(data_ptr, &pdu[2], pdu[1]);
+            break;
+        case MB_FUNC_READ_HOLDING_REGISTER:
+        case MB_FUNC_READ_INPUT_REGISTER:
+        case MB_FUNC_READWRITE_MULTIPLE_REGISTERS:
+            if ((pdu[1] != (reg_size << 1)) || (pdu_len < (2 + pdu[1]))) {
+                return MB_MRE_REV_DATA;
+            }
+            for (uint16_t idx = 0; idx < reg_size; idx++) {
+                ((uint16_t*)data_ptr)[idx] = (uint16_t)((pdu[2 + (idx << 1)] << 8) | pdu[3 + (idx << 1)]);
+            }
+            break;
+        default:
+            // The write responses echo the address and the value or quantity
+            if (pdu_len < 5) {
+                return MB_MRE_REV_DATA;
+            }
+            break;
+    }
+    return MB_MRE_NO_ERR;
+}
+
+// Response timeout of the slave, adapted to its response time if enabled
+static ULONG mbc_tcp_master_get_timeout_ms(uint8_t slave_addr)
+{
+#if MB_MASTER_ADAPTIVE_TIMEOUT_ENABLED
+    xMBMasterRespondStats stats;
+    if (xMBMasterPortGetRespondStats((UCHAR)slave_addr, &stats) && (stats.ulTimeoutUs >= 1000)) {
+        return stats.ulTimeoutUs / 1000;
+    }
+#endif
+    return MB_MASTER_TIMEOUT_MS_RESPOND;
+}
+
+// Sends the request from the calling task and waits for the response, so the requests
+// of several tasks can be outstanding on the same connection at a time
+static eMBMasterReqErrCode mbc_tcp_master_transact(const mb_param_request_t* request, void* data_ptr)
+{
+    uint8_t* frame = malloc(MB_TCP_BUF_SIZE);
+    if (!frame) {
+        return MB_MRE_MASTER_BUSY;
+    }
+    uint16_t pdu_len = 0;
+    eMBMasterReqErrCode mb_error = mbc_tcp_master_build_pdu(request, data_ptr, &frame[MB_TCP_FUNC], &pdu_len);
+    if (mb_error == MB_MRE_NO_ERR) {
+        mb_error = eMBMasterTCPPortTransact((UCHAR)request->slave_addr, frame, &pdu_len,
+                                            mbc_tcp_master_get_timeout_ms(request->slave_addr));
+    }
+    if (mb_error == MB_MRE_NO_ERR) {
+        mb_error = mbc_tcp_master_parse_pdu(request, &frame[MB_TCP_FUNC], pdu_len, data_ptr);
+    }
+    free(frame);
+    return mb_error;
+}
+
+// Context of a request sent by mbc_tcp_master_submit_request(), the frame buffer
+// holds the request and then the response until the request is completed
+typedef struct {
+    mb_param_request_t request;
+    void* data_ptr;
+    mb_master_done_cb_t done_cb;
+    void* arg;
+    uint8_t frame[MB_TCP_BUF_SIZE];
+} mb_tcp_master_async_t;
+
+// Called from the port task when the response is received or the request timed out
+static void mbc_tcp_master_request_done(eMBMasterReqErrCode mb_error, USHORT pdu_len, void* arg)
+{
+    mb_tcp_master_async_t* ctx = (mb_tcp_master_async_t*)arg;
+    if (mb_error == MB_MRE_NO_ERR) {
+        mb_error = mbc_tcp_master_parse_pdu(&ctx->request, &ctx->frame[MB_TCP_FUNC], pdu_len, ctx->data_ptr);
+    }
+    ctx->done_cb(&ctx->request, ctx->data_ptr, mbc_tcp_master_get_error(mb_error), ctx->arg);
+    free(ctx);
+}
+
+// Sends the request without waiting for the response, done_cb is called once the
+// request is completed. Returns ESP_ERR_INVALID_STATE if the request window of the
+// slave is full and ESP_ERR_TIMEOUT if the slave is unknown or not connected,
+// done_cb is not called if an error is returned.
+static esp_err_t mbc_tcp_master_submit_request(mb_param_request_t* request, void* data_ptr,
+                                               mb_master_done_cb_t done_cb, void* arg)
+{
+    MB_MASTER_ASSERT(mbm_interface_ptr != NULL);
+    MB_MASTER_CHECK((request != NULL), ESP_ERR_INVALID_ARG, "mb request structure.");
+    MB_MASTER_CHECK((data_ptr != NULL), ESP_ERR_INVALID_ARG, "mb incorrect data pointer.");
+    MB_MASTER_CHECK((done_cb != NULL), ESP_ERR_INVALID_ARG, "mb incorrect done callback.");
+
+    mb_tcp_master_async_t* ctx = malloc(sizeof(mb_tcp_master_async_t));
+    MB_MASTER_CHECK((ctx != NULL), ESP_ERR_NO_MEM, "mb request context allocation error.");
+    ctx->request = *request;
+    ctx->data_ptr = data_ptr;
+    ctx->done_cb = done_cb;
+    ctx->arg = arg;
+    uint16_t pdu_len = 0;
+    eMBMasterReqErrCode mb_error = mbc_tcp_master_build_pdu(request, data_ptr, &ctx->frame[MB_TCP_FUNC], &pdu_len);
+    if (mb_error == MB_MRE_NO_ERR) {
+        mb_error = eMBMasterTCPPortSubmit((UCHAR)request->slave_addr, ctx->frame, pdu_len,
+                                          mbc_tcp_master_get_timeout_ms(request->slave_addr),
+                                          mbc_tcp_master_request_done, ctx);
+    }
+    if (mb_error != MB_MRE_NO_ERR) {
+        free(ctx);
+    }
+    return mbc_tcp_master_get_error(mb_error);
+}
+
+static esp_err_t mbc_tcp_master_get_conn_stats(uint8_t slave_addr, mb_master_conn_stats_t* stats)
+{
+    MbConnStats_t conn_stats;
+    if (!xMBTCPPortMasterGetConnStats((UCHAR)slave_addr, &conn_stats)) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    stats->connected = conn_stats.xConnected ? 1 : 0;
+    stats->connects = conn_stats.ulConnects;
+    stats->reconnects = conn_stats.ulReconnects;
+    stats->connect_failures = conn_stats.ulConnectFailures;
+    stats->connect_last_us = conn_stats.ulConnectLastUs;
+    stats->connect_avg_us = conn_stats.ulConnectAvgUs;
+    stats->connect_max_us = conn_stats.ulConnectMaxUs;
+    return ESP_OK;
+}
+
+#endif
+
 // Send custom Modbus request defined as mb_param_request_t structure
 static esp_err_t mbc_tcp_master_send_request(mb_param_request_t* request, void* data_ptr)
 {
     MB_MASTER_ASSERT(mbm_interface_ptr != NULL);
-    mb_master_options_t* mbm_opts = &mbm_interface_ptr->opts;
     MB_MASTER_CHECK((request != NULL), ESP_ERR_INVALID_ARG, "mb request structure.");
     MB_MASTER_CHECK((data_ptr != NULL), ESP_ERR_INVALID_ARG, "mb incorrect data pointer.");
 
     eMBMasterReqErrCode mb_error = MB_MRE_MASTER_BUSY;
-    esp_err_t error = ESP_FAIL;
 
+#if MB_TCP_MASTER_CONCURRENT
+    mb_error = mbc_tcp_master_transact(request, data_ptr);
+#else
     if (xMBMasterRunResTake(MB_TCP_API_RESP_TICS)) {
-        
+        mb_master_options_t* mbm_opts = &mbm_interface_ptr->opts;
         uint8_t mb_slave_addr = request->slave_addr;
         uint8_t mb_command = request->command;
         uint16_t mb_offset = request->reg_start;
@@ -323,39 +584,10 @@ static esp_err_t mbc_tcp_master_send_request(mb_param_request_t* request, void*
                 mb_error = MB_MRE_NO_REG;
                 break;
         }
-    } 
-
-    // Propagate the Modbus errors to higher level
-    switch(mb_error)
-    {
-        case MB_MRE_NO_ERR:
-            error = ESP_OK;
-            break;
-
-        case MB_MRE_NO_REG:
-            error = ESP_ERR_NOT_SUPPORTED; // Invalid register request
-            break;
-
-        case MB_MRE_TIMEDOUT:
-            error = ESP_ERR_TIMEOUT; // Slave did not send response
-            break;
-
-        case MB_MRE_EXE_FUN:
-        case MB_MRE_REV_DATA:
-            error = ESP_ERR_INVALID_RESPONSE; // Invalid response from slave
-            break;
-
-        case MB_MRE_MASTER_BUSY:
-            error = ESP_ERR_INVALID_STATE; // Master is busy (previous request is pending)
-            break;
-
-        default:
-            ESP_LOGE(TAG, "%s: Incorrect return code (0x%x) ", __FUNCTION__, (unsigned)mb_error);
-            error = ESP_FAIL;
-            break;
     }
+#endif
 
-    return error;
+    return mbc_tcp_master_get_error(mb_error);
 }
 
 static esp_err_t mbc_tcp_master_get_cid_info(uint16_t cid, const mb_parameter_descriptor_t** param_buffer)
@@ -437,8 +669,8 @@ static esp_err_t mbc_tcp_master_set_param_data(void* dest, void* src, mb_descr_t
     return err;
 }
 
-// Helper to search parameter by name in the parameter description table and fills Modbus request fields accordingly
-static esp_err_t mbc_tcp_master_set_request(char* name, mb_param_mode_t mode, mb_param_request_t* request,
+// Helper to find parameter by cid and name in the parameter description table and fills Modbus request fields accordingly
+static esp_err_t mbc_tcp_master_set_request(uint16_t cid, char* name, mb_param_mode_t mode, mb_param_request_t* request,
                                                 mb_parameter_descriptor_t* reg_data)
 {
     MB_MASTER_ASSERT(mbm_interface_ptr != NULL);
@@ -448,30 +680,18 @@ static esp_err_t mbc_tcp_master_set_request(char* name, mb_param_mode_t mode, mb
     MB_MASTER_CHECK((request != NULL), ESP_ERR_INVALID_ARG, "mb incorrect request parameter.");
     MB_MASTER_CHECK((mode <= MB_PARAM_WRITE), ESP_ERR_INVALID_ARG, "mb incorrect mode.");
     MB_MASTER_ASSERT(mbm_opts->mbm_param_descriptor_table != NULL);
-    const mb_parameter_descriptor_t* reg_ptr = mbm_opts->mbm_param_descriptor_table;
-    for (uint16_t counter = 0; counter < (mbm_opts->mbm_param_descriptor_size); counter++, reg_ptr++)
-    {
-        // Check the cid of the parameter is equal to record number in the table
-        // Check the length of name and parameter key strings from table
-        size_t param_key_len = strlen((const char*)reg_ptr->param_key);
-        if (param_key_len != strlen((const char*)name)) {
-            continue; // The length of strings is different then check next record in the table
-        }
-        // Compare the name of parameter with parameter key from table
-        int comp_result = memcmp((const void*)name, (const void*)reg_ptr->param_key, (size_t)param_key_len);
-        if (comp_result == 0) {
-            // The correct line is found in the table and reg_ptr points to the found parameter description
-            request->slave_addr = reg_ptr->mb_slave_addr;
-            request->reg_start = reg_ptr->mb_reg_start;
-            request->reg_size = reg_ptr->mb_size;
-            request->command = mbc_tcp_master_get_command(reg_ptr->mb_param_type, mode);
-            MB_MASTER_CHECK((request->command > 0), ESP_ERR_INVALID_ARG, "mb incorrect command or parameter type.");
-            if (reg_data != NULL) {
-                *reg_data = *reg_ptr; // Set the cid registered parameter data
-            }
-            error = ESP_OK;
-            break;
+    // Look up the characteristic through the cid and the key index
+    const mb_parameter_descriptor_t* reg_ptr = mbc_master_find_param(mbm_opts, cid, name);
+    if (reg_ptr != NULL) {
+        request->slave_addr = reg_ptr->mb_slave_addr;
+        request->reg_start = reg_ptr->mb_reg_start;
+        request->reg_size = reg_ptr->mb_size;
+        request->command = mbc_tcp_master_get_command(reg_ptr->mb_param_type, mode);
+        MB_MASTER_CHECK((request->command > 0), ESP_ERR_INVALID_ARG, "mb incorrect command or parameter type.");
+        if (reg_data != NULL) {
+            *reg_data = *reg_ptr; // Set the cid registered parameter data
         }
+        error = ESP_OK;
     }
     return error;
 }
@@ -487,7 +707,7 @@ static esp_err_t mbc_tcp_master_get_parameter(uint16_t cid, char* name, uint8_t*
     mb_parameter_descriptor_t reg_info = { 0 };
     uint8_t* pdata = NULL;
 
-    error = mbc_tcp_master_set_request(name, MB_PARAM_READ, &request, &reg_info);
+    error = mbc_tcp_master_set_request(cid, name, MB_PARAM_READ, &request, &reg_info);
     if ((error == ESP_OK) && (cid == reg_info.cid)) {
         // alloc buffer to store parameter data
         pdata = calloc(1, (reg_info.mb_size << 1));
@@ -534,7 +754,7 @@ static esp_err_t mbc_tcp_master_set_parameter(uint16_t cid, char* name, uint8_t*
     mb_parameter_descriptor_t reg_info = { 0 };
     uint8_t* pdata = NULL;
 
-    error = mbc_tcp_master_set_request(name, MB_PARAM_WRITE, &request, &reg_info);
+    error = mbc_tcp_master_set_request(cid, name, MB_PARAM_WRITE, &request, &reg_info);
     if ((error == ESP_OK) && (cid == reg_info.cid)) {
         pdata = calloc(1, (reg_info.mb_size << 1)); // alloc parameter buffer
         if (!pdata) {
@@ -766,6 +986,11 @@ esp_err_t mbc_tcp_master_create(void** handler)
     // Initialize interface properties
     mb_master_options_t* mbm_opts = &mbm_interface_ptr->opts;
     mbm_opts->port_type = MB_PORT_TCP_MASTER;
+    mbm_opts->mbm_instance = 0; // The TCP master uses the first stack instance
+    mbm_opts->mbm_param_descriptor_table = NULL;
+    mbm_opts->mbm_param_descriptor_size = 0;
+    mbm_opts->mbm_param_key_index = NULL;
+    mbm_opts->mbm_param_key_index_mask = 0;
 
     vMBPortSetMode((UCHAR)MB_PORT_TCP_MASTER);
 
@@ -801,9 +1026,17 @@ esp_err_t mbc_tcp_master_create(void** handler)
     mbm_interface_ptr->start = mbc_tcp_master_start;
     mbm_interface_ptr->get_cid_info = mbc_tcp_master_get_cid_info;
     mbm_interface_ptr->get_parameter = mbc_tcp_master_get_parameter;
+    mbm_interface_ptr->get_parameter_cached = NULL;
     mbm_interface_ptr->send_request = mbc_tcp_master_send_request;
     mbm_interface_ptr->set_descriptor = mbc_tcp_master_set_descriptor;
     mbm_interface_ptr->set_parameter = mbc_tcp_master_set_parameter;
+#if MB_TCP_MASTER_CONCURRENT
+    mbm_interface_ptr->submit_request = mbc_tcp_master_submit_request;
+    mbm_interface_ptr->get_conn_stats = mbc_tcp_master_get_conn_stats;
+#else
+    mbm_interface_ptr->submit_request = NULL;
+    mbm_interface_ptr->get_conn_stats = NULL;
+#endif
 
     mbm_interface_ptr->master_reg_cb_discrete = eMBRegDiscreteCBTcpMaster;
     mbm_interface_ptr->master_reg_cb_input = eMBRegInputCBTcpMaster;
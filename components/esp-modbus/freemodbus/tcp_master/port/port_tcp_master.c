@@ -86,6 +86,10 @@ static EventBits_t xMasterEvent = 0;
 
 /* ----------------------- Static functions ---------------------------------*/
 static void vMBTCPPortMasterTask(void *pvParameters);
+#if MB_TCP_MASTER_CONCURRENT
+static void vMBTCPPortMasterTransFree(MbSlaveInfo_t *pxInfo);
+static ULONG ulMBTCPPortMasterTransCheck(BOOL xAbort);
+#endif
 
 /* ----------------------- Begin implementation -----------------------------*/
 
@@ -188,6 +192,7 @@ static void vMBTCPPortMasterStartPoll(void)
     }
 }
 
+#if !MB_TCP_MASTER_CONCURRENT
 // Stop Modbus event state machine
 static void vMBTCPPortMasterStopPoll(void)
 {
@@ -202,6 +207,7 @@ static void vMBTCPPortMasterStopPoll(void)
         ESP_LOGE(TAG, "Fail to stop polling. Incorrect event handle...");
     }
 }
+#endif
 
 // The helper function to get time stamp in microseconds
 static int64_t xMBTCPGetTimeStamp(void)
@@ -235,6 +241,9 @@ static BOOL xMBTCPPortMasterCloseConnection(MbSlaveInfo_t *pxInfo)
 
 static void xMBTCPPortMasterShutdown(void)
 {
+#if MB_TCP_MASTER_CONCURRENT
+    (void)ulMBTCPPortMasterTransCheck(TRUE);
+#endif
     xSemaphoreGive(xShutdownSema);
     vTaskDelete(NULL);
     xMbPortConfig.xMbTcpTaskHandle = NULL;
@@ -246,6 +255,9 @@ static void xMBTCPPortMasterShutdown(void)
             if (pxInfo->pucRcvBuf) {
                 free(pxInfo->pucRcvBuf);
             }
+#if MB_TCP_MASTER_CONCURRENT
+            vMBTCPPortMasterTransFree(pxInfo);
+#endif
             free(pxInfo);
             xMbPortConfig.pxMbSlaveInfo[ucCnt] = NULL;
         }
@@ -260,6 +272,7 @@ void vMBTCPPortMasterSetNetOpt(void *pvNetIf, eMBPortIpVer xIpVersion, eMBPortPr
     xMbPortConfig.eMbIpVer = xIpVersion;
 }
 
+#if !MB_TCP_MASTER_CONCURRENT
 // Function returns time left for response processing according to response timeout
 static int64_t xMBTCPPortMasterGetRespTimeLeft(MbSlaveInfo_t *pxInfo)
 {
@@ -298,6 +311,7 @@ static int xMBTCPPortMasterGetBuf(MbSlaveInfo_t *pxInfo, UCHAR *pucDstBuf, USHOR
     UCHAR *pucBuf = pucDstBuf;
     USHORT usBytesLeft = usLength;
     struct timeval xTime;
+    int64_t xDeadline = xMBTCPGetTimeStamp() + ((int64_t)xTimeMs * 1000);
 
     MB_PORT_CHECK((pxInfo && pxInfo->xSockId > -1), -1, "Try to read incorrect socket = #%d.", (int)pxInfo->xSockId);
 
@@ -328,7 +342,7 @@ static int xMBTCPPortMasterGetBuf(MbSlaveInfo_t *pxInfo, UCHAR *pucDstBuf, USHOR
             pucBuf += xLength;
             usBytesLeft -= xLength;
         }
-        if (xMBTCPPortMasterGetRespTimeLeft(pxInfo) == 0) {
+        if (usBytesLeft && (xMBTCPGetTimeStamp() >= xDeadline)) {
             return ERR_TIMEOUT;
         }
     }
@@ -390,6 +404,208 @@ static int vMBTCPPortMasterReadPacket(MbSlaveInfo_t *pxInfo)
     }
     return -1;
 }
+#endif
+
+#if MB_TCP_MASTER_CONCURRENT
+
+static BOOL xMBTCPPortMasterTransInit(MbSlaveInfo_t *pxInfo)
+{
+    pxInfo->xTransLock = xSemaphoreCreateMutex();
+    pxInfo->xWindowSema = xSemaphoreCreateCounting(MB_TCP_MASTER_REQUEST_WINDOW, MB_TCP_MASTER_REQUEST_WINDOW);
+    BOOL xOk = (pxInfo->xTransLock != NULL) && (pxInfo->xWindowSema != NULL);
+    for (int xSlot = 0; xSlot < MB_TCP_MASTER_REQUEST_WINDOW; xSlot++) {
+        pxInfo->xTrans[xSlot].xDoneSema = xSemaphoreCreateBinary();
+        xOk = xOk && (pxInfo->xTrans[xSlot].xDoneSema != NULL);
+    }
+    return xOk;
+}
+
+static void vMBTCPPortMasterTransFree(MbSlaveInfo_t *pxInfo)
+{
+    for (int xSlot = 0; xSlot < MB_TCP_MASTER_REQUEST_WINDOW; xSlot++) {
+        if (pxInfo->xTrans[xSlot].xDoneSema) {
+            vSemaphoreDelete(pxInfo->xTrans[xSlot].xDoneSema);
+        }
+    }
+    if (pxInfo->xWindowSema) {
+        vSemaphoreDelete(pxInfo->xWindowSema);
+    }
+    if (pxInfo->xTransLock) {
+        vSemaphoreDelete(pxInfo->xTransLock);
+    }
+}
+
+// Completion of a submitted request, reported after the slot lock is released
+typedef struct {
+    pxMBMasterTCPDoneCB pxDoneCB;
+    void *pvDoneArg;
+    eMBMasterReqErrCode eErrStatus;
+    USHORT usPduLen;
+} MbTransDone_t;
+
+static eMBMasterReqErrCode eMBTCPPortMasterTransError(int xStatus)
+{
+    switch (xStatus) {
+        case ERR_OK:
+            return MB_MRE_NO_ERR;
+        case ERR_BUF:
+            return MB_MRE_REV_DATA;
+        default:
+            return MB_MRE_TIMEDOUT;
+    }
+}
+
+// Ends the outstanding request of the slot, must be called with xTransLock held.
+// The waiting task is woken up. The slot of a submitted request is released and
+// TRUE is returned, its callback is called by vMBTCPPortMasterTransNotify().
+static BOOL xMBTCPPortMasterTransEnd(MbSlaveInfo_t *pxInfo, MbTransaction_t *pxTrans, int xStatus, MbTransDone_t *pxDone)
+{
+    pxTrans->xStatus = xStatus;
+    if (xStatus == ERR_OK) {
+        vMBMasterPortRespondTimeUpdate(pxInfo->ucSlaveAddr, (ULONG)(xMBTCPGetTimeStamp() - pxTrans->xSendTimeStamp));
+    } else if (xStatus != ERR_BUF) {
+        vMBMasterPortRespondTimeoutExpired(pxInfo->ucSlaveAddr);
+    }
+    if (!pxTrans->pxDoneCB) {
+        xSemaphoreGive(pxTrans->xDoneSema);
+        return FALSE;
+    }
+    pxDone->pxDoneCB = pxTrans->pxDoneCB;
+    pxDone->pvDoneArg = pxTrans->pvDoneArg;
+    pxDone->eErrStatus = eMBTCPPortMasterTransError(xStatus);
+    pxDone->usPduLen = pxTrans->usRespLen;
+    pxTrans->xActive = FALSE;
+    return TRUE;
+}
+
+// Returns the slot of a submitted request to the window and calls its callback,
+// the callback is free to submit the next request
+static void vMBTCPPortMasterTransNotify(MbSlaveInfo_t *pxInfo, MbTransDone_t *pxDone)
+{
+    xSemaphoreGive(pxInfo->xWindowSema);
+    pxDone->pxDoneCB(pxDone->eErrStatus, pxDone->usPduLen, pxDone->pvDoneArg);
+}
+
+// Ends the submitted requests of the slave whose response timeout has passed, or all its
+// outstanding requests if the connection is lost (xAbort). Returns the time in milliseconds
+// until the next response timeout of a submitted request, ulWaitMs at most.
+static ULONG ulMBTCPPortMasterTransCheckSlave(MbSlaveInfo_t *pxInfo, BOOL xAbort, ULONG ulWaitMs)
+{
+    for (int xSlot = 0; xSlot < MB_TCP_MASTER_REQUEST_WINDOW; xSlot++) {
+        MbTransaction_t *pxTrans = &pxInfo->xTrans[xSlot];
+        MbTransDone_t xDone;
+        BOOL xNotify = FALSE;
+        int64_t xNow = xMBTCPGetTimeStamp();
+        xSemaphoreTake(pxInfo->xTransLock, portMAX_DELAY);
+        if (pxTrans->xActive && (pxTrans->xStatus == ERR_INPROGRESS)) {
+            if (xAbort) {
+                xNotify = xMBTCPPortMasterTransEnd(pxInfo, pxTrans, ERR_CONN, &xDone);
+            } else if (pxTrans->pxDoneCB && (xNow >= pxTrans->xDeadline)) {
+                xNotify = xMBTCPPortMasterTransEnd(pxInfo, pxTrans, ERR_TIMEOUT, &xDone);
+            } else if (pxTrans->pxDoneCB) {
+                ULONG ulLeftMs = (ULONG)((pxTrans->xDeadline - xNow) / 1000) + 1;
+                ulWaitMs = (ulLeftMs < ulWaitMs) ? ulLeftMs : ulWaitMs;
+            }
+        }
+        xSemaphoreGive(pxInfo->xTransLock);
+        if (xNotify) {
+            vMBTCPPortMasterTransNotify(pxInfo, &xDone);
+        }
+    }
+    return ulWaitMs;
+}
+
+// Checks the outstanding requests of all slaves, see ulMBTCPPortMasterTransCheckSlave()
+static ULONG ulMBTCPPortMasterTransCheck(BOOL xAbort)
+{
+    ULONG ulWaitMs = MB_TCP_READ_TIMEOUT_MS;
+    for (int xIndex = 0; xIndex < xMbPortConfig.usMbSlaveInfoCount; xIndex++) {
+        ulWaitMs = ulMBTCPPortMasterTransCheckSlave(xMbPortConfig.pxMbSlaveInfo[xIndex], xAbort, ulWaitMs);
+    }
+    return ulWaitMs;
+}
+
+// Completes the outstanding request with the TID of the response in the receive buffer of the slave.
+// The response of a request which has already timed out is dropped.
+static void vMBTCPPortMasterTransResponse(MbSlaveInfo_t *pxInfo, USHORT usLength)
+{
+    UCHAR *pucBuf = pxInfo->pucRcvBuf;
+    USHORT usTidRcv = MB_TCP_GET_FIELD(pucBuf, MB_TCP_TID);
+    USHORT usPduLen = usLength - 1; // without the UID
+    BOOL xFound = FALSE;
+    BOOL xNotify = FALSE;
+    MbTransDone_t xDone;
+    pxInfo->xRecvTimeStamp = xMBTCPGetTimeStamp();
+    xSemaphoreTake(pxInfo->xTransLock, portMAX_DELAY);
+    for (int xSlot = 0; xSlot < MB_TCP_MASTER_REQUEST_WINDOW; xSlot++) {
+        MbTransaction_t *pxTrans = &pxInfo->xTrans[xSlot];
+        if (pxTrans->xActive && (pxTrans->xStatus == ERR_INPROGRESS) && (pxTrans->usTid == usTidRcv)) {
+            int xStatus = ERR_BUF;
+            if (usPduLen <= pxTrans->usRespMax) {
+                memcpy(pxTrans->pucRespPdu, &pucBuf[MB_TCP_FUNC], usPduLen);
+                pxTrans->usRespLen = usPduLen;
+                xStatus = ERR_OK;
+            }
+            xNotify = xMBTCPPortMasterTransEnd(pxInfo, pxTrans, xStatus, &xDone);
+            xFound = TRUE;
+            break;
+        }
+    }
+    xSemaphoreGive(pxInfo->xTransLock);
+    if (xNotify) {
+        vMBTCPPortMasterTransNotify(pxInfo, &xDone);
+    }
+    if (!xFound) {
+        ESP_LOGD(TAG, MB_SLAVE_FMT(", no request for TID=0x%04x, discard data."),
+                 (int)pxInfo->xIndex, (int)pxInfo->xSockId, pxInfo->pcIpAddr, (unsigned)usTidRcv);
+    }
+}
+
+// Reads what the slave has sent so far without blocking and hands each complete response to
+// vMBTCPPortMasterTransResponse(). A partial frame stays in the receive buffer of the slave and
+// is resumed on the next read readiness of its socket.
+static int xMBTCPPortMasterReadResponse(MbSlaveInfo_t *pxInfo)
+{
+    UCHAR *pucBuf = pxInfo->pucRcvBuf;
+    for (;;) {
+        // The MBAP header first, then the rest of the frame given by its length field
+        USHORT usFrameLen = MB_TCP_UID;
+        if (pxInfo->usRcvPos >= MB_TCP_UID) {
+            usFrameLen += MB_TCP_GET_FIELD(pucBuf, MB_TCP_LEN);
+        }
+        int xLength = recv(pxInfo->xSockId, &pucBuf[pxInfo->usRcvPos], usFrameLen - pxInfo->usRcvPos, 0);
+        if (xLength < 0) {
+            if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
+                return ERR_OK;
+            }
+            ESP_LOGE(TAG, MB_SLAVE_FMT(", receive error, errno=%u."),
+                     (int)pxInfo->xIndex, (int)pxInfo->xSockId, pxInfo->pcIpAddr, (unsigned)errno);
+            return (errno == ENOTCONN) ? ERR_CONN : -1;
+        } else if (xLength == 0) {
+            // The slave closed the connection
+            return ERR_CONN;
+        }
+        pxInfo->usRcvPos += xLength;
+        if (pxInfo->usRcvPos < usFrameLen) {
+            continue;
+        }
+        if (usFrameLen == MB_TCP_UID) {
+            USHORT usLength = MB_TCP_GET_FIELD(pucBuf, MB_TCP_LEN);
+            if ((MB_TCP_GET_FIELD(pucBuf, MB_TCP_PID) != 0)
+                    || (usLength < 2) || (usLength > (MB_TCP_BUF_SIZE - MB_TCP_UID))) {
+                // The stream is out of sync, the connection has to be restarted
+                ESP_LOGE(TAG, MB_SLAVE_FMT(", incorrect MBAP header, length=%u."),
+                         (int)pxInfo->xIndex, (int)pxInfo->xSockId, pxInfo->pcIpAddr, (unsigned)usLength);
+                return ERR_VAL;
+            }
+            continue;
+        }
+        pxInfo->usRcvPos = 0;
+        vMBTCPPortMasterTransResponse(pxInfo, usFrameLen - MB_TCP_UID);
+    }
+}
+
+#endif
 
 static err_t xMBTCPPortMasterSetNonBlocking(MbSlaveInfo_t *pxInfo)
 {
@@ -521,6 +737,7 @@ BOOL xMBTCPPortMasterAddSlaveIp(const USHORT usIndex, const CHAR *pcIpStr, UCHAR
     return xRes;
 }
 
+#if !MB_TCP_MASTER_CONCURRENT
 // Unblocking connect function
 static err_t xMBTCPPortMasterConnect(MbSlaveInfo_t *pxInfo)
 {
@@ -618,7 +835,244 @@ static err_t xMBTCPPortMasterConnect(MbSlaveInfo_t *pxInfo)
     freeaddrinfo(pxAddrList);
     return xErr;
 }
+#endif
+
+#if MB_TCP_MASTER_CONCURRENT
+
+// Starts the non-blocking connect to the slave without waiting for its completion,
+// returns ERR_INPROGRESS while the connection is pending
+static err_t xMBTCPPortMasterConnectStart(MbSlaveInfo_t *pxInfo)
+{
+    CHAR cPort[8];
+    struct addrinfo xHint;
+    struct addrinfo *pxAddrList;
+
+    memset(&xHint, 0, sizeof(xHint));
+    xHint.ai_flags = AI_ADDRCONFIG;
+    xHint.ai_family = (xMbPortConfig.eMbIpVer == MB_PORT_IPV4) ? AF_INET : AF_INET6;
+    xHint.ai_socktype = (pxInfo->xMbProto == MB_PROTO_UDP) ? SOCK_DGRAM : SOCK_STREAM;
+    xHint.ai_protocol = (pxInfo->xMbProto == MB_PROTO_UDP) ? IPPROTO_UDP : IPPROTO_TCP;
+    snprintf(cPort, sizeof(cPort), "%u", (unsigned)xMbPortConfig.usPort);
+    if (getaddrinfo(pxInfo->pcIpAddr, cPort, &xHint, &pxAddrList) != 0) {
+        ESP_LOGE(TAG, "Cannot resolve host: %s", pxInfo->pcIpAddr);
+        return ERR_CONN;
+    }
+#if CONFIG_LWIP_IPV6
+    if (pxAddrList->ai_family == AF_INET6) {
+        // Set scope id to fix routing issues with local address
+        ((struct sockaddr_in6 *)(pxAddrList->ai_addr))->sin6_scope_id =
+            esp_netif_get_netif_impl_index(xMbPortConfig.pvNetIface);
+    }
+#endif
+    err_t xErr = ERR_CONN;
+    pxInfo->xSockId = socket(pxAddrList->ai_family, pxAddrList->ai_socktype, pxAddrList->ai_protocol);
+    if (pxInfo->xSockId < 0) {
+        ESP_LOGE(TAG, "Unable to create socket: #%d, errno %u", (int)pxInfo->xSockId, (unsigned)errno);
+        pxInfo->xSockId = -1;
+        freeaddrinfo(pxAddrList);
+        return ERR_IF;
+    }
+    if (xMBTCPPortMasterSetNonBlocking(pxInfo) == ERR_OK) {
+        vMBTCPPortSetKeepAlive(pxInfo);
+        if (connect(pxInfo->xSockId, pxAddrList->ai_addr, pxAddrList->ai_addrlen) == 0) {
+            xErr = ERR_OK;
+        } else if ((errno == EINPROGRESS) || (errno == EALREADY)) {
+            xErr = ERR_INPROGRESS;
+        } else {
+            ESP_LOGV(TAG, MB_SLAVE_FMT(" unable to connect, errno %u (%s)"),
+                     (int)pxInfo->xIndex, (int)pxInfo->xSockId, pxInfo->pcIpAddr, (unsigned)errno, strerror(errno));
+        }
+    }
+    freeaddrinfo(pxAddrList);
+    if (xErr == ERR_CONN) {
+        xMBTCPPortMasterCloseConnection(pxInfo);
+    }
+    return xErr;
+}
 
+// The connect attempt of the slave completed, the requests can be sent to it
+static void vMBTCPPortMasterConnUp(MbSlaveInfo_t *pxInfo, int64_t xNow)
+{
+    MbConnStats_t *pxStats = &pxInfo->xConnStats;
+    ULONG ulLatencyUs = (ULONG)(xNow - pxInfo->xConnStartTime);
+    xSemaphoreTake(pxInfo->xTransLock, portMAX_DELAY);
+    pxInfo->eConnState = MB_TCP_CONN_CONNECTED;
+    if (pxStats->ulConnects++) {
+        pxStats->ulReconnects++;
+        pxStats->ulConnectAvgUs = (ULONG)((int64_t)pxStats->ulConnectAvgUs +
+                                    (((int64_t)ulLatencyUs - (int64_t)pxStats->ulConnectAvgUs) >> 3));
+    } else {
+        pxStats->ulConnectAvgUs = ulLatencyUs;
+    }
+    pxStats->ulConnectLastUs = ulLatencyUs;
+    pxStats->ulConnectMaxUs = (ulLatencyUs > pxStats->ulConnectMaxUs) ? ulLatencyUs : pxStats->ulConnectMaxUs;
+    xSemaphoreGive(pxInfo->xTransLock);
+    pxInfo->ulConnBackoffMs = MB_TCP_MASTER_RECONNECT_MIN_MS;
+    pxInfo->usRcvPos = 0;
+    pxInfo->xRecvTimeStamp = xNow;
+    pxInfo->xSendTimeStamp = xNow;
+    ESP_LOGI(TAG, MB_SLAVE_FMT(", connected in %u ms."),
+             (int)pxInfo->xIndex, (int)pxInfo->xSockId, pxInfo->pcIpAddr, (unsigned)(ulLatencyUs / 1000));
+}
+
+// The connect attempt failed or the connection is lost. Completes the outstanding requests
+// of the slave and schedules the next connect attempt, the delay doubles after each failed attempt.
+static void vMBTCPPortMasterConnDown(MbSlaveInfo_t *pxInfo, int64_t xNow)
+{
+    xSemaphoreTake(pxInfo->xTransLock, portMAX_DELAY);
+    BOOL xWasConnected = (pxInfo->eConnState == MB_TCP_CONN_CONNECTED);
+    if (!xWasConnected) {
+        pxInfo->xConnStats.ulConnectFailures++;
+    }
+    pxInfo->eConnState = MB_TCP_CONN_IDLE;
+    if (pxInfo->xSockId >= 0) {
+        xMBTCPPortMasterCloseConnection(pxInfo);
+    }
+    xSemaphoreGive(pxInfo->xTransLock);
+    (void)ulMBTCPPortMasterTransCheckSlave(pxInfo, TRUE, 0);
+    pxInfo->xConnRetryTime = xNow + ((int64_t)pxInfo->ulConnBackoffMs * 1000);
+    ESP_LOGW(TAG, "Slave #%d(%s), %s, retry in %u ms.", (int)pxInfo->xIndex, pxInfo->pcIpAddr,
+             xWasConnected ? "connection lost" : "connect failed", (unsigned)pxInfo->ulConnBackoffMs);
+    if (!xWasConnected) {
+        pxInfo->ulConnBackoffMs = ((pxInfo->ulConnBackoffMs << 1) < MB_TCP_MASTER_RECONNECT_MAX_MS) ?
+                                    (pxInfo->ulConnBackoffMs << 1) : MB_TCP_MASTER_RECONNECT_MAX_MS;
+    }
+}
+
+// Runs the connection state machine of each slave which is not connected: starts the connect
+// attempts which are due and fails the pending ones which timed out. Returns the time in
+// milliseconds until the next connection event, ulWaitMs at most.
+static ULONG ulMBTCPPortMasterConnCheck(ULONG ulWaitMs)
+{
+    for (int xIndex = 0; xIndex < xMbPortConfig.usMbSlaveInfoCount; xIndex++) {
+        MbSlaveInfo_t *pxInfo = xMbPortConfig.pxMbSlaveInfo[xIndex];
+        int64_t xNow = xMBTCPGetTimeStamp();
+        int64_t xEventTime = 0;
+        if ((pxInfo->eConnState == MB_TCP_CONN_IDLE) && (xNow >= pxInfo->xConnRetryTime)) {
+            pxInfo->xConnStartTime = xNow;
+            err_t xErr = xMBTCPPortMasterConnectStart(pxInfo);
+            if (xErr == ERR_OK) {
+                vMBTCPPortMasterConnUp(pxInfo, xMBTCPGetTimeStamp());
+            } else if (xErr == ERR_INPROGRESS) {
+                pxInfo->eConnState = MB_TCP_CONN_CONNECTING;
+            } else {
+                vMBTCPPortMasterConnDown(pxInfo, xNow);
+            }
+        } else if ((pxInfo->eConnState == MB_TCP_CONN_CONNECTING)
+                    && ((xNow - pxInfo->xConnStartTime) >= ((int64_t)MB_TCP_MASTER_CONNECT_TIMEOUT_MS * 1000))) {
+            ESP_LOGD(TAG, MB_SLAVE_FMT(", connect timeout."),
+                     (int)pxInfo->xIndex, (int)pxInfo->xSockId, pxInfo->pcIpAddr);
+            vMBTCPPortMasterConnDown(pxInfo, xNow);
+        }
+        if (pxInfo->eConnState == MB_TCP_CONN_IDLE) {
+            xEventTime = pxInfo->xConnRetryTime;
+        } else if (pxInfo->eConnState == MB_TCP_CONN_CONNECTING) {
+            xEventTime = pxInfo->xConnStartTime + ((int64_t)MB_TCP_MASTER_CONNECT_TIMEOUT_MS * 1000);
+        } else {
+            continue;
+        }
+        ULONG ulLeftMs = (xEventTime > xNow) ? (ULONG)((xEventTime - xNow) / 1000) + 1 : 0;
+        ulWaitMs = (ulLeftMs < ulWaitMs) ? ulLeftMs : ulWaitMs;
+    }
+    return ulWaitMs;
+}
+
+// Returns TRUE once each slave has completed its first connect attempt
+static BOOL xMBTCPPortMasterConnTried(void)
+{
+    for (int xIndex = 0; xIndex < xMbPortConfig.usMbSlaveInfoCount; xIndex++) {
+        const MbConnStats_t *pxStats = &xMbPortConfig.pxMbSlaveInfo[xIndex]->xConnStats;
+        if (!pxStats->ulConnects && !pxStats->ulConnectFailures) {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+// Connection cycle of the slaves. Each slave is connected by its own state machine without
+// blocking, the connected slaves are polled while the others are still (re)connecting and
+// the loss of one connection does not interrupt the others. The requests are sent by the
+// tasks calling the master API, this loop receives the responses of all slaves and completes
+// each request when its response arrives.
+static void vMBTCPPortMasterConnLoop(void)
+{
+    BOOL xPollStarted = FALSE;
+    while (1) {
+        fd_set xReadSet;
+        fd_set xWriteSet;
+        struct timeval xTimeVal;
+        int xMaxSd = -1;
+        // Wake up for the next response timeout of a submitted request or connection event
+        ULONG ulWaitMs = ulMBTCPPortMasterTransCheck(FALSE);
+        ulWaitMs = ulMBTCPPortMasterConnCheck(ulWaitMs);
+        TCP_PORT_CHECK_SHDN(xShutdownSema, xMBTCPPortMasterShutdown);
+        if (!xPollStarted && xMBTCPPortMasterConnTried()) {
+            // Start the stack once all slaves are tried, the unreachable ones are retried later
+            ESP_LOGI(TAG, "Slave connections started, start polling...");
+            vMBTCPPortMasterStartPoll();
+            xPollStarted = TRUE;
+        }
+        FD_ZERO(&xReadSet);
+        FD_ZERO(&xWriteSet);
+        for (int xIndex = 0; xIndex < xMbPortConfig.usMbSlaveInfoCount; xIndex++) {
+            MbSlaveInfo_t *pxInfo = xMbPortConfig.pxMbSlaveInfo[xIndex];
+            if (pxInfo->eConnState == MB_TCP_CONN_CONNECTED) {
+                FD_SET(pxInfo->xSockId, &xReadSet);
+            } else if (pxInfo->eConnState == MB_TCP_CONN_CONNECTING) {
+                FD_SET(pxInfo->xSockId, &xWriteSet);
+            } else {
+                continue;
+            }
+            xMaxSd = (pxInfo->xSockId > xMaxSd) ? pxInfo->xSockId : xMaxSd;
+        }
+        if (xMaxSd < 0) {
+            vTaskDelay(pdMS_TO_TICKS(ulWaitMs) ? pdMS_TO_TICKS(ulWaitMs) : 1);
+            continue;
+        }
+        vMBTCPPortMasterMStoTimeVal((USHORT)ulWaitMs, &xTimeVal);
+        int xRes = select(xMaxSd + 1, &xReadSet, &xWriteSet, NULL, &xTimeVal);
+        TCP_PORT_CHECK_SHDN(xShutdownSema, xMBTCPPortMasterShutdown);
+        if (xRes == 0) {
+            continue;
+        }
+        for (int xIndex = 0; xIndex < xMbPortConfig.usMbSlaveInfoCount; xIndex++) {
+            MbSlaveInfo_t *pxInfo = xMbPortConfig.pxMbSlaveInfo[xIndex];
+            int64_t xNow = xMBTCPGetTimeStamp();
+            if (pxInfo->eConnState == MB_TCP_CONN_CONNECTING) {
+                // The pending connect is completed if the socket is writable
+                if ((xRes > 0) && !FD_ISSET(pxInfo->xSockId, &xWriteSet)) {
+                    continue;
+                }
+                err_t xErr = xMBTCPPortMasterCheckAlive(pxInfo, 0);
+                if (xErr == ERR_OK) {
+                    vMBTCPPortMasterConnUp(pxInfo, xNow);
+                } else if (xErr != ERR_INPROGRESS) {
+                    vMBTCPPortMasterConnDown(pxInfo, xNow);
+                }
+            } else if (pxInfo->eConnState == MB_TCP_CONN_CONNECTED) {
+                int xErr = ERR_OK;
+                if (xRes > 0) {
+                    if (FD_ISSET(pxInfo->xSockId, &xReadSet)) {
+                        xErr = xMBTCPPortMasterReadResponse(pxInfo);
+                    }
+                } else {
+                    // The select failed, find the broken connections
+                    xErr = xMBTCPPortMasterCheckAlive(pxInfo, 0);
+                    xErr = (xErr == ERR_INPROGRESS) ? ERR_OK : xErr;
+                }
+                if (xErr != ERR_OK) {
+                    ESP_LOGE(TAG, MB_SLAVE_FMT(", receive failure, error=%d."),
+                             (int)pxInfo->xIndex, (int)pxInfo->xSockId, pxInfo->pcIpAddr, (int)xErr);
+                    vMBTCPPortMasterConnDown(pxInfo, xNow);
+                }
+            }
+        }
+    }
+}
+
+#endif
+
+#if !MB_TCP_MASTER_CONCURRENT
 // Find the first slave info whose descriptor is set in xFdSet
 static MbSlaveInfo_t *xMBTCPPortMasterGetSlaveReady(fd_set *pxFdSet)
 {
@@ -671,18 +1125,21 @@ static void xMBTCPPortMasterFsmSetError(eMBMasterErrorEventType xErrType, eMBMas
     vMBMasterSetErrorType(xErrType);
     xMBMasterPortEventPost(xPostEvent);
 }
+#endif
 
 static void vMBTCPPortMasterTask(void *pvParameters)
 {
     MbSlaveInfo_t *pxInfo;
+#if !MB_TCP_MASTER_CONCURRENT
     MbSlaveInfo_t *pxCurrInfo;
+    int64_t xTime = 0;
 
     fd_set xConnSet;
     fd_set xReadSet;
     int xMaxSd = 0;
     err_t xErr = ERR_ABRT;
     USHORT usSlaveConnCnt = 0;
-    int64_t xTime = 0;
+#endif
 
     // Register each slave in the connection info structure
     while (1) {
@@ -715,6 +1172,16 @@ static void vMBTCPPortMasterTask(void *pvParameters)
                 free(pxInfo->pucRcvBuf);
                 break;
             }
+#if MB_TCP_MASTER_CONCURRENT
+            if (!xMBTCPPortMasterTransInit(pxInfo)) {
+                ESP_LOGE(TAG, "Slave(#%u), transaction window allocation fail.",
+                         (unsigned)xMbPortConfig.usMbSlaveInfoCount);
+                vMBTCPPortMasterTransFree(pxInfo);
+                free(pxInfo->pucRcvBuf);
+                free(pxInfo);
+                break;
+            }
+#endif
             pxInfo->usRcvPos = 0;
             pxInfo->pcIpAddr = xSlaveAddrInfo.pcIPAddr;
             pxInfo->xSockId = -1;
@@ -725,12 +1192,20 @@ static void vMBTCPPortMasterTask(void *pvParameters)
             pxInfo->ucSlaveAddr = xSlaveAddrInfo.ucSlaveAddr;
             pxInfo->xIndex = xSlaveAddrInfo.usIndex;
             pxInfo->usTidCnt = (USHORT)(xMbPortConfig.usMbSlaveInfoCount << 8U);
+#if MB_TCP_MASTER_CONCURRENT
+            pxInfo->eConnState = MB_TCP_CONN_IDLE;
+            pxInfo->xConnRetryTime = 0;
+            pxInfo->ulConnBackoffMs = MB_TCP_MASTER_RECONNECT_MIN_MS;
+#endif
             // Register slave
             xMbPortConfig.pxMbSlaveInfo[xMbPortConfig.usMbSlaveInfoCount++] = pxInfo;
             ESP_LOGI(TAG, "Add slave IP: %s", xSlaveAddrInfo.pcIPAddr);
         }
     }
 
+#if MB_TCP_MASTER_CONCURRENT
+    vMBTCPPortMasterConnLoop();
+#else
     // Main connection cycle
     while (1)
     {
@@ -899,6 +1374,7 @@ static void vMBTCPPortMasterTask(void *pvParameters)
             TCP_PORT_CHECK_SHDN(xShutdownSema, xMBTCPPortMasterShutdown);
         } // while(usMbSlaveInfoCount)
     } // while (1)
+#endif
     vTaskDelete(NULL);
 }
 
@@ -995,7 +1471,10 @@ BOOL xMBMasterTCPPortSendResponse(UCHAR *pucMBTCPFrame, USHORT usTCPLength)
                 ESP_LOGD(TAG, MB_SLAVE_FMT(", send data successful: TID=0x%02x, %d (bytes), errno %u"),
                          (int)pxInfo->xIndex, (int)pxInfo->xSockId, pxInfo->pcIpAddr, pxInfo->usTidCnt, (int)xRes, (unsigned)errno);
                 pxInfo->xError = 0;
+#if !MB_TCP_MASTER_CONCURRENT
+                // The port task owns the receive position of a concurrent slave
                 pxInfo->usRcvPos = 0;
+#endif
                 if (pxInfo->usTidCnt < (USHRT_MAX - 1)) {
                     pxInfo->usTidCnt++;
                 } else {
@@ -1012,6 +1491,163 @@ BOOL xMBMasterTCPPortSendResponse(UCHAR *pucMBTCPFrame, USHORT usTCPLength)
     return bFrameSent;
 }
 
+#if MB_TCP_MASTER_CONCURRENT
+
+// Finds the slave info without changing the current slave of the state machine
+static MbSlaveInfo_t *xMBTCPPortMasterLookupSlave(UCHAR ucSlaveAddr)
+{
+    for (int xIndex = 0; xIndex < xMbPortConfig.usMbSlaveInfoCount; xIndex++) {
+        if (xMbPortConfig.pxMbSlaveInfo[xIndex]->ucSlaveAddr == ucSlaveAddr) {
+            return xMbPortConfig.pxMbSlaveInfo[xIndex];
+        }
+    }
+    return NULL;
+}
+
+// Claims a slot of the window, adds the MBAP header in front of the request PDU and
+// sends the request. The caller holds a count of the window semaphore which is
+// returned if the request is not sent.
+static MbTransaction_t *pxMBTCPPortMasterTransSend(MbSlaveInfo_t *pxInfo, UCHAR ucSlaveAddr, UCHAR *pucFrame,
+                                                   USHORT usPduLen, ULONG ulTimeoutMs,
+                                                   pxMBMasterTCPDoneCB pxDoneCB, void *pvArg)
+{
+    MbTransaction_t *pxTrans = NULL;
+    xSemaphoreTake(pxInfo->xTransLock, portMAX_DELAY);
+    for (int xSlot = 0; (xSlot < MB_TCP_MASTER_REQUEST_WINDOW) && !pxTrans; xSlot++) {
+        if (!pxInfo->xTrans[xSlot].xActive) {
+            pxTrans = &pxInfo->xTrans[xSlot];
+        }
+    }
+    if (!pxTrans) {
+        // The window semaphore counts the free slots, so this should not happen
+        xSemaphoreGive(pxInfo->xTransLock);
+        xSemaphoreGive(pxInfo->xWindowSema);
+        return NULL;
+    }
+    pxTrans->xActive = TRUE;
+    pxTrans->usTid = pxInfo->usTidCnt;
+    pxTrans->xStatus = ERR_INPROGRESS;
+    pxTrans->pucRespPdu = &pucFrame[MB_TCP_FUNC];
+    pxTrans->usRespMax = MB_TCP_BUF_SIZE - MB_TCP_FUNC;
+    pxTrans->usRespLen = 0;
+    pxTrans->pxDoneCB = pxDoneCB;
+    pxTrans->pvDoneArg = pvArg;
+    if (pxInfo->usTidCnt < (USHRT_MAX - 1)) {
+        pxInfo->usTidCnt++;
+    } else {
+        pxInfo->usTidCnt = (USHORT)(pxInfo->xIndex << 8U);
+    }
+    USHORT usLength = usPduLen + 1;
+    pucFrame[MB_TCP_TID] = (UCHAR)(pxTrans->usTid >> 8U);
+    pucFrame[MB_TCP_TID + 1] = (UCHAR)(pxTrans->usTid & 0xFF);
+    pucFrame[MB_TCP_PID] = 0;
+    pucFrame[MB_TCP_PID + 1] = 0;
+    pucFrame[MB_TCP_LEN] = (UCHAR)(usLength >> 8U);
+    pucFrame[MB_TCP_LEN + 1] = (UCHAR)(usLength & 0xFF);
+#if MB_TCP_UID_ENABLED
+    pucFrame[MB_TCP_UID] = ucSlaveAddr;
+#else
+    pucFrame[MB_TCP_UID] = 0x00;
+#endif
+    int xRes = ERR_CONN;
+    if (pxInfo->eConnState == MB_TCP_CONN_CONNECTED) {
+        xRes = xMBMasterTCPPortWritePoll(pxInfo, pucFrame, usLength + MB_TCP_UID, MB_TCP_SEND_TIMEOUT_MS);
+    }
+    pxTrans->xSendTimeStamp = xMBTCPGetTimeStamp();
+    pxTrans->xDeadline = pxTrans->xSendTimeStamp + ((int64_t)ulTimeoutMs * 1000);
+    pxInfo->xSendTimeStamp = pxTrans->xSendTimeStamp;
+    if (xRes < 0) {
+        pxTrans->xActive = FALSE;
+    }
+    USHORT usTid = pxTrans->usTid;
+    xSemaphoreGive(pxInfo->xTransLock);
+    if (xRes < 0) {
+        ESP_LOGD(TAG, MB_SLAVE_FMT(", send data failure, error = %d."),
+                 (int)pxInfo->xIndex, (int)pxInfo->xSockId, pxInfo->pcIpAddr, (int)xRes);
+        xSemaphoreGive(pxInfo->xWindowSema);
+        return NULL;
+    }
+    ESP_LOGD(TAG, MB_SLAVE_FMT(", send data successful: TID=0x%04x, %d (bytes)"),
+             (int)pxInfo->xIndex, (int)pxInfo->xSockId, pxInfo->pcIpAddr, (unsigned)usTid, (int)xRes);
+    return pxTrans;
+}
+
+eMBMasterReqErrCode eMBMasterTCPPortTransact(UCHAR ucSlaveAddr, UCHAR *pucFrame, USHORT *pusPduLen, ULONG ulTimeoutMs)
+{
+    MB_PORT_CHECK((pucFrame && pusPduLen && (*pusPduLen > 0) && (*pusPduLen <= (MB_TCP_BUF_SIZE - MB_TCP_FUNC))),
+                    MB_MRE_ILL_ARG, "Incorrect request frame.");
+    MbSlaveInfo_t *pxInfo = xMBTCPPortMasterLookupSlave(ucSlaveAddr);
+    if (!pxInfo) {
+        ESP_LOGD(TAG, "Send data to unknown slave, address = %u", (unsigned)ucSlaveAddr);
+        return MB_MRE_TIMEDOUT;
+    }
+    TickType_t xStartTick = xTaskGetTickCount();
+    TickType_t xTimeoutTicks = pdMS_TO_TICKS(ulTimeoutMs);
+    // Wait for a free slot in the request window of the connection
+    if (xSemaphoreTake(pxInfo->xWindowSema, xTimeoutTicks) != pdTRUE) {
+        return MB_MRE_MASTER_BUSY;
+    }
+    MbTransaction_t *pxTrans = pxMBTCPPortMasterTransSend(pxInfo, ucSlaveAddr, pucFrame, *pusPduLen,
+                                                          ulTimeoutMs, NULL, NULL);
+    if (!pxTrans) {
+        return MB_MRE_TIMEDOUT;
+    }
+    // Wait for the response matched by the port task, then release the slot.
+    // A response given after the timeout is dropped together with the slot.
+    TickType_t xElapsedTicks = xTaskGetTickCount() - xStartTick;
+    (void)xSemaphoreTake(pxTrans->xDoneSema, (xElapsedTicks < xTimeoutTicks) ? (xTimeoutTicks - xElapsedTicks) : 0);
+    xSemaphoreTake(pxInfo->xTransLock, portMAX_DELAY);
+    int xStatus = pxTrans->xStatus;
+    USHORT usRespLen = pxTrans->usRespLen;
+    pxTrans->xActive = FALSE;
+    (void)xSemaphoreTake(pxTrans->xDoneSema, 0);
+    xSemaphoreGive(pxInfo->xTransLock);
+    xSemaphoreGive(pxInfo->xWindowSema);
+
+    if (xStatus == ERR_INPROGRESS) {
+        vMBMasterPortRespondTimeoutExpired(ucSlaveAddr);
+        return MB_MRE_TIMEDOUT;
+    }
+    if (xStatus == ERR_OK) {
+        *pusPduLen = usRespLen;
+    }
+    return eMBTCPPortMasterTransError(xStatus);
+}
+
+eMBMasterReqErrCode eMBMasterTCPPortSubmit(UCHAR ucSlaveAddr, UCHAR *pucFrame, USHORT usPduLen, ULONG ulTimeoutMs,
+                                           pxMBMasterTCPDoneCB pxDoneCB, void *pvArg)
+{
+    MB_PORT_CHECK((pucFrame && pxDoneCB && (usPduLen > 0) && (usPduLen <= (MB_TCP_BUF_SIZE - MB_TCP_FUNC))),
+                    MB_MRE_ILL_ARG, "Incorrect request frame.");
+    MbSlaveInfo_t *pxInfo = xMBTCPPortMasterLookupSlave(ucSlaveAddr);
+    if (!pxInfo) {
+        ESP_LOGD(TAG, "Send data to unknown slave, address = %u", (unsigned)ucSlaveAddr);
+        return MB_MRE_TIMEDOUT;
+    }
+    if (xSemaphoreTake(pxInfo->xWindowSema, 0) != pdTRUE) {
+        return MB_MRE_MASTER_BUSY;
+    }
+    MbTransaction_t *pxTrans = pxMBTCPPortMasterTransSend(pxInfo, ucSlaveAddr, pucFrame, usPduLen,
+                                                          ulTimeoutMs, pxDoneCB, pvArg);
+    return pxTrans ? MB_MRE_NO_ERR : MB_MRE_TIMEDOUT;
+}
+
+BOOL xMBTCPPortMasterGetConnStats(UCHAR ucSlaveAddr, MbConnStats_t *pxStats)
+{
+    MB_PORT_CHECK((pxStats), FALSE, "Incorrect stats pointer.");
+    MbSlaveInfo_t *pxInfo = xMBTCPPortMasterLookupSlave(ucSlaveAddr);
+    if (!pxInfo) {
+        return FALSE;
+    }
+    xSemaphoreTake(pxInfo->xTransLock, portMAX_DELAY);
+    *pxStats = pxInfo->xConnStats;
+    pxStats->xConnected = (pxInfo->eConnState == MB_TCP_CONN_CONNECTED);
+    xSemaphoreGive(pxInfo->xTransLock);
+    return TRUE;
+}
+
+#endif
+
 // Timer handler to check timeout of socket response
 BOOL MB_PORT_ISR_ATTR
 xMBMasterTCPTimerExpired(void)
@@ -43,7 +43,9 @@
 
 #include "lwip/sys.h"
 #include "freertos/event_groups.h"
+#include "freertos/semphr.h"
 #include "port.h"
+#include "mb_m.h"
 
 /* ----------------------- Defines ------------------------------------------*/
 
@@ -61,6 +63,45 @@ PR_BEGIN_EXTERN_C
 
 /* ----------------------- Type definitions ---------------------------------*/
 
+/**
+ * Completion callback of a request sent by eMBMasterTCPPortSubmit(), called from the port task
+ *
+ * @param eErrStatus MB_MRE_NO_ERR if the response is received, MB_MRE_TIMEDOUT if not
+ * @param usPduLen length of the response PDU in the frame buffer of the request
+ * @param pvArg argument given to eMBMasterTCPPortSubmit()
+ */
+typedef void (*pxMBMasterTCPDoneCB)(eMBMasterReqErrCode eErrStatus, USHORT usPduLen, void* pvArg);
+
+typedef struct {
+    BOOL xActive;                   /*!< The slot holds an outstanding request */
+    USHORT usTid;                   /*!< Transaction identifier (TID) of the request */
+    int xStatus;                    /*!< ERR_INPROGRESS until the response is received */
+    UCHAR* pucRespPdu;              /*!< Response PDU buffer of the waiting task */
+    USHORT usRespMax;               /*!< Size of the response PDU buffer */
+    USHORT usRespLen;               /*!< Length of the received response PDU */
+    int64_t xSendTimeStamp;         /*!< Send time stamp of the request */
+    int64_t xDeadline;              /*!< Response deadline of the request */
+    pxMBMasterTCPDoneCB pxDoneCB;   /*!< Completion callback of a submitted request, NULL if a task waits */
+    void* pvDoneArg;                /*!< Argument of the completion callback */
+    SemaphoreHandle_t xDoneSema;    /*!< Given when the response of a waiting task is received */
+} MbTransaction_t;
+
+typedef enum {
+    MB_TCP_CONN_IDLE,           /*!< Not connected, waits for the next connect attempt */
+    MB_TCP_CONN_CONNECTING,     /*!< Non-blocking connect is pending */
+    MB_TCP_CONN_CONNECTED       /*!< Connected, the requests can be sent */
+} eMBTCPConnState;
+
+typedef struct {
+    BOOL xConnected;            /*!< The slave is connected */
+    ULONG ulConnects;           /*!< Number of established connections */
+    ULONG ulReconnects;         /*!< Number of connections established after the first one */
+    ULONG ulConnectFailures;    /*!< Number of failed connect attempts */
+    ULONG ulConnectLastUs;      /*!< Latency of the last established connection */
+    ULONG ulConnectAvgUs;       /*!< Smoothed connect latency */
+    ULONG ulConnectMaxUs;       /*!< Longest connect latency */
+} MbConnStats_t;
+
 typedef struct {
     int xIndex;                 /*!< Slave information index */
     int xSockId;                /*!< Socket ID of slave */
@@ -75,6 +116,16 @@ typedef struct {
     int64_t xSendTimeStamp;     /*!< Send request time stamp */
     int64_t xRecvTimeStamp;     /*!< Receive response time stamp */
     uint16_t usTidCnt;          /*!< Transaction identifier (TID) for slave */
+#if MB_TCP_MASTER_CONCURRENT
+    SemaphoreHandle_t xTransLock;   /*!< Protects the transaction slots and the socket writes */
+    SemaphoreHandle_t xWindowSema;  /*!< Counts the free transaction slots */
+    MbTransaction_t xTrans[MB_TCP_MASTER_REQUEST_WINDOW]; /*!< Outstanding requests of the slave */
+    eMBTCPConnState eConnState;     /*!< Connection state, changed to and from connected with xTransLock held */
+    int64_t xConnStartTime;         /*!< Start time of the last connect attempt */
+    int64_t xConnRetryTime;         /*!< Time of the next connect attempt */
+    ULONG ulConnBackoffMs;          /*!< Delay before the next connect attempt */
+    MbConnStats_t xConnStats;       /*!< Connection statistics */
+#endif
 } MbSlaveInfo_t;
 
 typedef struct {
@@ -132,6 +183,55 @@ BOOL xMBTCPPortMasterWaitEvent(EventGroupHandle_t xEventHandle, EventBits_t xEve
  */
 void vMBTCPPortMasterSetNetOpt(void* pvNetIf, eMBPortIpVer xIpVersion, eMBPortProto xProto);
 
+#if MB_TCP_MASTER_CONCURRENT
+/**
+ * Sends a request to the slave and waits for its response. Up to MB_TCP_MASTER_REQUEST_WINDOW
+ * requests of different tasks are outstanding on the connection at a time. The responses are
+ * matched to the requests by the transaction identifier and complete in any order.
+ * The master state machine is not involved in these requests.
+ *
+ * @param ucSlaveAddr slave short address
+ * @param pucFrame buffer of MB_TCP_BUF_SIZE bytes which holds the request PDU at MB_TCP_FUNC,
+ *                 the response PDU is returned at the same position
+ * @param pusPduLen length of the request PDU, returns the length of the response PDU
+ * @param ulTimeoutMs response timeout of the request
+ *
+ * @return MB_MRE_NO_ERR if the response is received, MB_MRE_TIMEDOUT if the slave did not
+ *         respond, MB_MRE_MASTER_BUSY if the request window stayed full for the timeout
+ */
+eMBMasterReqErrCode eMBMasterTCPPortTransact(UCHAR ucSlaveAddr, UCHAR* pucFrame, USHORT* pusPduLen, ULONG ulTimeoutMs);
+
+/**
+ * Sends a request to the slave without waiting for its response. The port task calls the
+ * callback when the response is received or the timeout has passed, so requests to many
+ * slaves are outstanding at the same time.
+ *
+ * @param ucSlaveAddr slave short address
+ * @param pucFrame buffer of MB_TCP_BUF_SIZE bytes which holds the request PDU at MB_TCP_FUNC,
+ *                 it receives the response PDU and must be kept until the callback is called
+ * @param usPduLen length of the request PDU
+ * @param ulTimeoutMs response timeout of the request
+ * @param pxDoneCB completion callback
+ * @param pvArg argument of the callback
+ *
+ * @return MB_MRE_NO_ERR if the request is sent and the callback will be called,
+ *         MB_MRE_MASTER_BUSY if the request window of the slave is full,
+ *         MB_MRE_TIMEDOUT if the slave is not connected; the callback is not called on errors
+ */
+eMBMasterReqErrCode eMBMasterTCPPortSubmit(UCHAR ucSlaveAddr, UCHAR* pucFrame, USHORT usPduLen, ULONG ulTimeoutMs,
+                                           pxMBMasterTCPDoneCB pxDoneCB, void* pvArg);
+
+/**
+ * Gets the connection statistics of the slave
+ *
+ * @param ucSlaveAddr slave short address
+ * @param pxStats statistics of the slave
+ *
+ * @return TRUE if the slave is registered, else FALSE
+ */
+BOOL xMBTCPPortMasterGetConnStats(UCHAR ucSlaveAddr, MbConnStats_t* pxStats);
+#endif
+
 #ifdef __cplusplus
 PR_END_EXTERN_C
 #endif
@@ -0,0 +1,879 @@
+/*
+ * SPDX-FileCopyrightText: 2006 Christian Walter
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * SPDX-FileContributor: 2016-2022 Espressif Systems (Shanghai) CO LTD
+ */
+/*
+ * FreeModbus Libary: ESP32 TCP Port
+ * Copyright (C) 2006 Christian Walter <wolti@sil.at>
+ * Parts of crt0.S Copyright (c) 1995, 1996, 1998 Cygnus Support
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * IF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * File: $Id: port.c,v 1.2 2006/09/04 14:39:20 wolti Exp $
+ */
+
+/* ----------------------- System includes ----------------------------------*/
+#include <stdio.h>
+#include <string.h>
+#include "esp_err.h"
+#include "esp_timer.h"
+#include "sys/time.h"
+#include "esp_netif.h"
+
+/* ----------------------- lwIP includes ------------------------------------*/
+#include "lwip/err.h"
+#include "lwip/sockets.h"
+#include "lwip/netdb.h"
+#include "net/if.h"
+
+/* ----------------------- Modbus includes ----------------------------------*/
+#include "mb.h"
+#include "mbport.h"
+#include "port.h"
+#include "mbframe.h"
+#include "port_tcp_slave.h"
+#include "esp_modbus_common.h"      // for common types for network options
+
+#if MB_TCP_ENABLED
+
+/* ----------------------- Defines  -----------------------------------------*/
+#define MB_TCP_DISCONNECT_TIMEOUT       ( CONFIG_FMB_TCP_CONNECTION_TOUT_SEC * 1000000 ) // disconnect timeout in uS
+#define MB_TCP_RESP_TIMEOUT_MS          ( MB_MASTER_TIMEOUT_MS_RESPOND - 1 ) // slave response time limit
+#define MB_TCP_NET_LISTEN_BACKLOG       ( SOMAXCONN )
+#define MB_TCP_WHEEL_TICK_US            ( 1000000 ) // tick of the idle connection timer wheel in uS
+
+/* ----------------------- Prototypes ---------------------------------------*/
+void vMBPortEventClose( void );
+
+/* ----------------------- Static variables ---------------------------------*/
+static const char *TAG = "MB_TCP_SLAVE_PORT";
+static int xListenSock = -1;
+static SemaphoreHandle_t xShutdownSema = NULL;
+static MbSlavePortConfig_t xConfig = { 0 };
+
+/* ----------------------- Static functions ---------------------------------*/
+// The helper function to get time stamp in microseconds
+static int64_t xMBTCPGetTimeStamp(void)
+{
+    int64_t xTimeStamp = esp_timer_get_time();
+    return xTimeStamp;
+}
+
+static void vxMBTCPPortMStoTimeVal(USHORT usTimeoutMs, struct timeval *pxTimeout)
+{
+    pxTimeout->tv_sec = usTimeoutMs / 1000;
+    pxTimeout->tv_usec = (usTimeoutMs - (pxTimeout->tv_sec * 1000)) * 1000;
+}
+
+static QueueHandle_t xMBTCPPortRespQueueCreate(void)
+{
+    QueueHandle_t xRespQueueHandle = xQueueCreate(2, sizeof(void*));
+    MB_PORT_CHECK((xRespQueueHandle != NULL), NULL, "TCP respond queue creation failure.");
+    return xRespQueueHandle;
+}
+
+static void vMBTCPPortRespQueueDelete(QueueHandle_t xRespQueueHandle)
+{
+    vQueueDelete(xRespQueueHandle);
+}
+
+static void* vxMBTCPPortRespQueueRecv(QueueHandle_t xRespQueueHandle)
+{
+    void* pvResp = NULL;
+    MB_PORT_CHECK(xRespQueueHandle != NULL, NULL, "Response queue is not initialized.");
+    BaseType_t xStatus = xQueueReceive(xRespQueueHandle,
+                                        (void*)&pvResp,
+                                        pdMS_TO_TICKS(MB_TCP_RESP_TIMEOUT_MS));
+    if (xStatus != pdTRUE) {
+        ESP_LOGD(TAG, "Could not get respond confirmation.");
+    }
+    return pvResp;
+}
+
+static BOOL vxMBTCPPortRespQueueSend(QueueHandle_t xRespQueueHandle, void* pvResp)
+{
+    MB_PORT_CHECK(xRespQueueHandle != NULL, FALSE, "Response queue is not initialized.");
+    BaseType_t xStatus = xQueueSend(xConfig.xRespQueueHandle,
+                                    (const void*)&pvResp,
+                                    pdMS_TO_TICKS(MB_TCP_RESP_TIMEOUT_MS));
+    MB_PORT_CHECK((xStatus == pdTRUE), FALSE, "FAIL to send to response queue.");
+    return TRUE;
+}
+
+static void vMBTCPPortServerTask(void *pvParameters);
+
+static void vMBTCPPortFreeSlab(void)
+{
+    free(xConfig.pxClientSlab);
+    free(xConfig.pucBufPool);
+    free(xConfig.ppucFreeBufs);
+    xConfig.pxClientSlab = NULL;
+    xConfig.pucBufPool = NULL;
+    xConfig.ppucFreeBufs = NULL;
+}
+
+/* ----------------------- Begin implementation -----------------------------*/
+BOOL
+xMBTCPPortInit( USHORT usTCPPort )
+{
+    BOOL bOkay = FALSE;
+
+    // The client information and the receive buffers are allocated once for all connections
+    xConfig.pxClientSlab = calloc(MB_TCP_PORT_MAX_CONN, sizeof(MbClientInfo_t));
+    xConfig.pucBufPool = calloc(MB_TCP_SLAVE_BUF_POOL_SIZE, MB_TCP_BUF_SIZE);
+    xConfig.ppucFreeBufs = calloc(MB_TCP_SLAVE_BUF_POOL_SIZE, sizeof(UCHAR*));
+    if (!xConfig.pxClientSlab || !xConfig.pucBufPool || !xConfig.ppucFreeBufs) {
+        ESP_LOGE(TAG, "TCP client info allocation failure.");
+        vMBTCPPortFreeSlab();
+        return FALSE;
+    }
+    xConfig.pxFreeClients = NULL;
+    xConfig.pxActiveClients = NULL;
+    for (int idx = MB_TCP_PORT_MAX_CONN - 1; idx >= 0; idx--) {
+        MbClientInfo_t *pxClientInfo = &xConfig.pxClientSlab[idx];
+        pxClientInfo->xIndex = idx;
+        pxClientInfo->xSockId = -1;
+        pxClientInfo->pxNext = xConfig.pxFreeClients;
+        xConfig.pxFreeClients = pxClientInfo;
+    }
+    for (int idx = 0; idx < MB_TCP_SLAVE_BUF_POOL_SIZE; idx++) {
+        xConfig.ppucFreeBufs[idx] = &xConfig.pucBufPool[idx * MB_TCP_BUF_SIZE];
+    }
+    xConfig.usFreeBufCount = MB_TCP_SLAVE_BUF_POOL_SIZE;
+    memset(xConfig.pxWheel, 0, sizeof(xConfig.pxWheel));
+
+    xConfig.xRespQueueHandle = xMBTCPPortRespQueueCreate();
+    if (!xConfig.xRespQueueHandle) {
+        ESP_LOGE(TAG, "Response queue allocation failure.");
+        vMBTCPPortFreeSlab();
+        return FALSE;
+    }
+#if MB_TCP_GATEWAY_ENABLED
+    xConfig.xClientLock = xSemaphoreCreateMutex();
+    xConfig.xFrameCBLock = xSemaphoreCreateMutex();
+    if (!xConfig.xClientLock || !xConfig.xFrameCBLock) {
+        ESP_LOGE(TAG, "Client lock allocation failure.");
+        if (xConfig.xClientLock) {
+            vSemaphoreDelete(xConfig.xClientLock);
+            xConfig.xClientLock = NULL;
+        }
+        if (xConfig.xFrameCBLock) {
+            vSemaphoreDelete(xConfig.xFrameCBLock);
+            xConfig.xFrameCBLock = NULL;
+        }
+        vMBTCPPortRespQueueDelete(xConfig.xRespQueueHandle);
+        vMBTCPPortFreeSlab();
+        return FALSE;
+    }
+#endif
+
+    xConfig.usPort = usTCPPort;
+    xConfig.eMbProto = MB_PROTO_TCP;
+    xConfig.usClientCount = 0;
+    xConfig.pvNetIface = NULL;
+    xConfig.xIpVer = MB_PORT_IPV4;
+    xConfig.pcBindAddr = NULL;
+
+    // Create task for packet processing
+    BaseType_t xErr = xTaskCreatePinnedToCore(vMBTCPPortServerTask,
+                                    "tcp_slave_task",
+                                    MB_TCP_STACK_SIZE,
+                                    NULL,
+                                    MB_TCP_TASK_PRIO,
+                                    &xConfig.xMbTcpTaskHandle,
+                                    MB_PORT_TASK_AFFINITY);
+    if (xErr != pdTRUE)
+    {
+        ESP_LOGE(TAG, "Server task creation failure.");
+        vTaskDelete(xConfig.xMbTcpTaskHandle);
+    } else {
+        ESP_LOGI(TAG, "Protocol stack initialized.");
+        bOkay = TRUE;
+    }
+    return bOkay;
+}
+
+void vMBTCPPortSlaveSetNetOpt(void* pvNetIf, eMBPortIpVer xIpVersion, eMBPortProto xProto, CHAR* pcBindAddrStr)
+{
+    // Set network options
+    xConfig.pvNetIface = pvNetIf;
+    xConfig.eMbProto = xProto;
+    xConfig.xIpVer = xIpVersion;
+    xConfig.pcBindAddr = pcBindAddrStr;
+}
+
+static int xMBTCPPortAcceptConnection(int xListenSockId, CHAR* pcIPAddr, size_t xAddrLen)
+{
+    MB_PORT_CHECK(pcIPAddr, -1, "Wrong IP address pointer.");
+    MB_PORT_CHECK((xListenSockId > 0), -1, "Incorrect listen socket ID.");
+
+    // Address structure large enough for both IPv4 or IPv6 address
+    struct sockaddr_storage xSrcAddr;
+    int xSockId = -1;
+    socklen_t xSize = sizeof(struct sockaddr_storage);
+
+    // Accept new socket connection if not active
+    xSockId = accept(xListenSockId, (struct sockaddr *)&xSrcAddr, &xSize);
+    if (xSockId < 0) {
+        ESP_LOGE(TAG, "Unable to accept connection: errno=%u", (unsigned)errno);
+    } else {
+        // Get the sender's ip address as string
+        if (xSrcAddr.ss_family == PF_INET) {
+            inet_ntoa_r(((struct sockaddr_in *)&xSrcAddr)->sin_addr.s_addr, pcIPAddr, xAddrLen - 1);
+        }
+#if CONFIG_LWIP_IPV6
+        else if (xSrcAddr.ss_family == PF_INET6) {
+            inet6_ntoa_r(((struct sockaddr_in6 *)&xSrcAddr)->sin6_addr, pcIPAddr, xAddrLen - 1);
+        }
+#endif
+        else {
+            // Make sure ss_family is valid
+            abort();
+        }
+        ESP_LOGI(TAG, "Socket (#%d), accept client connection from address: %s", (int)xSockId, pcIPAddr);
+    }
+    return xSockId;
+}
+
+// Returns the receive buffer of the client to the pool and hands it to a client
+// which waits for a buffer
+static void vMBTCPPortReleaseBuf(MbClientInfo_t* pxInfo)
+{
+    if (!pxInfo->pucTCPBuf) {
+        return;
+    }
+    UCHAR* pucBuf = pxInfo->pucTCPBuf;
+    pxInfo->pucTCPBuf = NULL;
+    for (MbClientInfo_t* pxWaiting = xConfig.pxActiveClients; pxWaiting; pxWaiting = pxWaiting->pxNext) {
+        if (pxWaiting->xWaitBuf) {
+            memcpy(pucBuf, pxWaiting->ucTCPHdr, MB_TCP_FUNC);
+            pxWaiting->pucTCPBuf = pucBuf;
+            pxWaiting->xWaitBuf = FALSE;
+            FD_SET(pxWaiting->xSockId, &xConfig.xActiveSet);
+            return;
+        }
+    }
+    xConfig.ppucFreeBufs[xConfig.usFreeBufCount++] = pucBuf;
+}
+
+static void vMBTCPPortWheelRemove(MbClientInfo_t* pxInfo)
+{
+    if (pxInfo->pxWheelPrev) {
+        pxInfo->pxWheelPrev->pxWheelNext = pxInfo->pxWheelNext;
+    } else {
+        for (int xSlot = 0; xSlot < MB_TCP_WHEEL_SLOTS; xSlot++) {
+            if (xConfig.pxWheel[xSlot] == pxInfo) {
+                xConfig.pxWheel[xSlot] = pxInfo->pxWheelNext;
+                break;
+            }
+        }
+    }
+    if (pxInfo->pxWheelNext) {
+        pxInfo->pxWheelNext->pxWheelPrev = pxInfo->pxWheelPrev;
+    }
+    pxInfo->pxWheelNext = NULL;
+    pxInfo->pxWheelPrev = NULL;
+}
+
+// Adds the client to the wheel slot of its disconnect deadline. The deadline is
+// checked lazily: data received from the client only updates xRecvTimeStamp and the
+// client is moved to its new slot when the old one expires.
+static void vMBTCPPortWheelAdd(MbClientInfo_t* pxInfo)
+{
+    int64_t xTick = ((pxInfo->xRecvTimeStamp + MB_TCP_DISCONNECT_TIMEOUT) / MB_TCP_WHEEL_TICK_US) + 1;
+    MbClientInfo_t** ppxSlot = &xConfig.pxWheel[xTick & (MB_TCP_WHEEL_SLOTS - 1)];
+    pxInfo->pxWheelPrev = NULL;
+    pxInfo->pxWheelNext = *ppxSlot;
+    if (*ppxSlot) {
+        (*ppxSlot)->pxWheelPrev = pxInfo;
+    }
+    *ppxSlot = pxInfo;
+}
+static BOOL xMBTCPPortCloseConnection(MbClientInfo_t* pxInfo)
+{
+    MB_PORT_CHECK(pxInfo, FALSE, "Client info is NULL.");
+
+    if (pxInfo->xSockId == -1) {
+        ESP_LOGE(TAG, "Wrong socket info or disconnected socket: %d.", (int)pxInfo->xSockId);
+        return FALSE;
+    }
+
+    // Empty tcp buffer before shutdown
+    (void)recv(pxInfo->xSockId, &pxInfo->ucTCPHdr[0], MB_TCP_FUNC, MSG_DONTWAIT);
+
+    if (shutdown(pxInfo->xSockId, SHUT_RDWR) == -1)
+    {
+        ESP_LOGE(TAG, "Socket (#%d), shutdown failed: errno %u", (int)pxInfo->xSockId, (unsigned)errno);
+    }
+    FD_CLR(pxInfo->xSockId, &xConfig.xActiveSet);
+#if MB_TCP_GATEWAY_ENABLED
+    // The gateway task may be sending a response to the client
+    xSemaphoreTake(xConfig.xClientLock, portMAX_DELAY);
+#endif
+    close(pxInfo->xSockId);
+    pxInfo->xSockId = -1;
+#if MB_TCP_GATEWAY_ENABLED
+    xSemaphoreGive(xConfig.xClientLock);
+#endif
+
+    // Return the client slot and its buffer
+    vMBTCPPortWheelRemove(pxInfo);
+    if (pxInfo->pxPrev) {
+        pxInfo->pxPrev->pxNext = pxInfo->pxNext;
+    } else {
+        xConfig.pxActiveClients = pxInfo->pxNext;
+    }
+    if (pxInfo->pxNext) {
+        pxInfo->pxNext->pxPrev = pxInfo->pxPrev;
+    }
+    pxInfo->xWaitBuf = FALSE;
+    vMBTCPPortReleaseBuf(pxInfo);
+    pxInfo->pxPrev = NULL;
+    pxInfo->pxNext = xConfig.pxFreeClients;
+    xConfig.pxFreeClients = pxInfo;
+    if (xConfig.pxCurClientInfo == pxInfo) {
+        xConfig.pxCurClientInfo = NULL;
+    }
+    if (xConfig.usClientCount) {
+        xConfig.usClientCount--; // decrement counter of client connections
+    }
+    return TRUE;
+}
+
+// The connections and buffers are released by vMBTCPPortClose() once the task is gone
+static void vMBTCPPortShutdown(void)
+{
+    xSemaphoreGive(xShutdownSema);
+    vTaskDelete(NULL);
+}
+
+// Reads the data available on the client socket without blocking. Returns the length of
+// the frame once it is complete, 0 if more data is expected, or a negative error.
+static int xMBTCPPortClientRead(MbClientInfo_t *pxClientInfo)
+{
+    while (pxClientInfo->usTCPFrameBytesLeft) {
+        UCHAR* pucDst = pxClientInfo->pucTCPBuf ? pxClientInfo->pucTCPBuf : pxClientInfo->ucTCPHdr;
+        int xLength = recv(pxClientInfo->xSockId, &pucDst[pxClientInfo->usTCPBufPos],
+                           pxClientInfo->usTCPFrameBytesLeft, MSG_DONTWAIT);
+        if (xLength < 0) {
+            if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
+                return 0;
+            }
+            // If an error occurred during receiving
+            ESP_LOGE(TAG, "Receive failed: length=%d, errno=%u", (int)xLength, (unsigned)errno);
+            return ERR_CLSD;
+        } else if (xLength == 0) {
+            // Socket connection closed
+            ESP_LOGD(TAG, "Socket (#%d)(%s), connection closed.",
+                                                (int)pxClientInfo->xSockId, pxClientInfo->pcIpAddr);
+            return ERR_CLSD;
+        }
+        pxClientInfo->usTCPBufPos += xLength;
+        pxClientInfo->usTCPFrameBytesLeft -= xLength;
+        if ((pxClientInfo->usTCPBufPos == MB_TCP_FUNC) && !pxClientInfo->pucTCPBuf) {
+            // Length is a byte count of Modbus PDU (function code + data) and the
+            // unit identifier.
+            USHORT usLength = MB_TCP_GET_FIELD(pxClientInfo->ucTCPHdr, MB_TCP_LEN);
+            if ((usLength < 2) || ((MB_TCP_UID + usLength) > MB_TCP_BUF_SIZE)) {
+                ESP_LOGE(TAG, "Incorrect buffer received (%u) bytes.", (unsigned)usLength);
+                // This should not happen. We can't deal with such a client and
+                // drop the connection for security reasons.
+                return ERR_BUF;
+            }
+            pxClientInfo->usTCPFrameBytesLeft = MB_TCP_UID + usLength - MB_TCP_FUNC;
+            if (!xConfig.usFreeBufCount) {
+                // Stop reading the client until a buffer is returned to the pool
+                pxClientInfo->xWaitBuf = TRUE;
+                FD_CLR(pxClientInfo->xSockId, &xConfig.xActiveSet);
+                return 0;
+            }
+            pxClientInfo->pucTCPBuf = xConfig.ppucFreeBufs[--xConfig.usFreeBufCount];
+            memcpy(pxClientInfo->pucTCPBuf, pxClientInfo->ucTCPHdr, MB_TCP_FUNC);
+        }
+    }
+    prvvMBTCPLogFrame(TAG, (UCHAR*)&pxClientInfo->pucTCPBuf[0], pxClientInfo->usTCPBufPos);
+    // Copy TID field from incoming packet
+    pxClientInfo->usTidCnt = MB_TCP_GET_FIELD(pxClientInfo->pucTCPBuf, MB_TCP_TID);
+    return pxClientInfo->usTCPBufPos;
+}
+
+// Create a listening socket on pcBindIp: Port
+static int
+vMBTCPPortBindAddr(const CHAR* pcBindIp)
+{
+    int xPar, xRet;
+    int xListenSockFd = -1;
+    struct addrinfo xHint;
+    struct addrinfo* pxAddrList;
+    struct addrinfo* pxCurAddr;
+    CHAR* pcStr = NULL;
+
+    memset( &xHint, 0, sizeof( xHint ) );
+
+    // Bind to IPv6 and/or IPv4, but only in the desired protocol
+    // Todo: Find a reason why AF_UNSPEC does not work for IPv6
+    xHint.ai_family = (xConfig.xIpVer == MB_PORT_IPV4) ? AF_INET : AF_INET6;
+    xHint.ai_socktype = (xConfig.eMbProto == MB_PROTO_UDP) ? SOCK_DGRAM : SOCK_STREAM;
+    // The LWIP has an issue when connection to IPv6 socket
+    xHint.ai_protocol = (xConfig.eMbProto == MB_PROTO_UDP) ? IPPROTO_UDP : IPPROTO_TCP;
+    xHint.ai_flags = AI_NUMERICSERV;
+
+    if (pcBindIp == NULL) {
+        xHint.ai_flags |= AI_PASSIVE;
+    } else {
+        xHint.ai_flags |= AI_CANONNAME;
+    }
+
+    if (asprintf(&pcStr, "%u", xConfig.usPort) == -1) {
+        abort();
+    }
+
+    xRet = getaddrinfo(pcBindIp, pcStr, &xHint, &pxAddrList);
+    free(pcStr);
+
+    if (xRet != 0) {
+        return -1;
+    }
+
+    // Try the sockaddr until a binding succeeds
+    for (pxCurAddr = pxAddrList; pxCurAddr != NULL; pxCurAddr = pxCurAddr->ai_next)
+    {
+        xListenSockFd = (int)socket(pxCurAddr->ai_family, pxCurAddr->ai_socktype,
+                                        pxCurAddr->ai_protocol);
+        if (xListenSockFd < 0)
+        {
+            continue;
+        }
+
+        xPar = 1;
+        // Allow multi client connections
+        if (setsockopt(xListenSockFd, SOL_SOCKET, SO_REUSEADDR,
+                        (const char*)&xPar, sizeof(xPar)) != 0)
+        {
+            close(xListenSockFd);
+            xListenSockFd = -1;
+            continue;
+        }
+
+        if (bind(xListenSockFd, (struct sockaddr *)pxCurAddr->ai_addr,
+                                        (socklen_t)pxCurAddr->ai_addrlen) != 0 )
+        {
+            close(xListenSockFd);
+            xListenSockFd = -1;
+            continue;
+        }
+
+        // Listen only makes sense for TCP
+        if (xConfig.eMbProto == MB_PROTO_TCP)
+        {
+            if (listen(xListenSockFd, MB_TCP_NET_LISTEN_BACKLOG) != 0)
+            {
+                ESP_LOGE(TAG, "Error occurred during listen: errno=%u", (unsigned)errno);
+                close(xListenSockFd);
+                xListenSockFd = -1;
+                continue;
+            }
+        }
+        // Bind was successful
+        pcStr = (pxCurAddr->ai_canonname == NULL) ? (CHAR*)"\0" : pxCurAddr->ai_canonname;
+        ESP_LOGI(TAG, "Socket (#%d), listener %s on port: %u, errno=%u",
+                                            (int)xListenSockFd, pcStr, (unsigned)xConfig.usPort, (unsigned)errno);
+        break;
+    }
+
+    freeaddrinfo(pxAddrList);
+    return(xListenSockFd);
+}
+
+// Accepts the pending connection into a free client slot
+static void vMBTCPPortAcceptClient(void)
+{
+    CHAR pcClientIp[MB_TCP_IP_ADDR_LEN] = { 0 };
+    int xSockId = xMBTCPPortAcceptConnection(xListenSock, pcClientIp, sizeof(pcClientIp));
+    if (xSockId < 0) {
+        return;
+    }
+    MbClientInfo_t* pxClientInfo = xConfig.pxFreeClients;
+    if (!pxClientInfo) {
+        ESP_LOGE(TAG, "Fail to accept connection %u, only %u connections supported.",
+                 (unsigned)(xConfig.usClientCount + 1), (unsigned)MB_TCP_PORT_MAX_CONN);
+        shutdown(xSockId, SHUT_RDWR);
+        close(xSockId);
+        return;
+    }
+    xConfig.pxFreeClients = pxClientInfo->pxNext;
+    // Fill the connection info structure
+#if MB_TCP_GATEWAY_ENABLED
+    xSemaphoreTake(xConfig.xClientLock, portMAX_DELAY);
+    pxClientInfo->ulConnId = ++xConfig.ulConnSeq;
+    pxClientInfo->xSockId = xSockId;
+    xSemaphoreGive(xConfig.xClientLock);
+#else
+    pxClientInfo->xSockId = xSockId;
+#endif
+    pxClientInfo->xError = 0;
+    memcpy(pxClientInfo->pcIpAddr, pcClientIp, sizeof(pcClientIp));
+    pxClientInfo->pucTCPBuf = NULL;
+    pxClientInfo->xWaitBuf = FALSE;
+    pxClientInfo->usTCPFrameBytesLeft = MB_TCP_FUNC;
+    pxClientInfo->usTCPBufPos = 0;
+    pxClientInfo->xRecvTimeStamp = xMBTCPGetTimeStamp();
+    pxClientInfo->pxPrev = NULL;
+    pxClientInfo->pxNext = xConfig.pxActiveClients;
+    if (xConfig.pxActiveClients) {
+        xConfig.pxActiveClients->pxPrev = pxClientInfo;
+    }
+    xConfig.pxActiveClients = pxClientInfo;
+    xConfig.usClientCount++;
+    vMBTCPPortWheelAdd(pxClientInfo);
+    FD_SET(xSockId, &xConfig.xActiveSet);
+    xConfig.xMaxSd = (xSockId > xConfig.xMaxSd) ? xSockId : xConfig.xMaxSd;
+}
+
+// Reads the client whose socket is readable and lets the stack process a complete frame
+static void vMBTCPPortClientReady(MbClientInfo_t* pxClientInfo)
+{
+    int xErr = xMBTCPPortClientRead(pxClientInfo);
+    if (xErr < 0) {
+        // If an invalid data received from socket or connection fail then drop connection
+        switch(xErr)
+        {
+            case ERR_CLSD:
+                ESP_LOGE(TAG, "Socket (#%d)(%s), connection closed by peer.",
+                                                    (int)pxClientInfo->xSockId, pxClientInfo->pcIpAddr);
+                break;
+            case ERR_BUF:
+            default:
+                ESP_LOGE(TAG, "Socket (#%d)(%s), read data error: 0x%x",
+                                                    (int)pxClientInfo->xSockId, pxClientInfo->pcIpAddr, (int)xErr);
+                break;
+        }
+        xMBTCPPortCloseConnection(pxClientInfo);
+        return;
+    }
+    pxClientInfo->xRecvTimeStamp = xMBTCPGetTimeStamp();
+    if (xErr == 0) {
+        return;
+    }
+
+#if MB_TCP_GATEWAY_ENABLED
+    // The lock keeps the gateway from being stopped while its callback runs
+    xSemaphoreTake(xConfig.xFrameCBLock, portMAX_DELAY);
+    pxMBTCPPortFrameCB pxFrameCB = xConfig.pxFrameCB;
+    if (pxFrameCB) {
+        // The gateway queues the request and answers it later through xMBTCPPortSendTo()
+        pxFrameCB((USHORT)pxClientInfo->xIndex, pxClientInfo->ulConnId, pxClientInfo->pucTCPBuf, (USHORT)xErr);
+        xSemaphoreGive(xConfig.xFrameCBLock);
+        pxClientInfo->usTCPBufPos = 0;
+        pxClientInfo->usTCPFrameBytesLeft = MB_TCP_FUNC;
+        vMBTCPPortReleaseBuf(pxClientInfo);
+        return;
+    }
+    xSemaphoreGive(xConfig.xFrameCBLock);
+#endif
+
+    // set current client info to active client from which we received request
+    xConfig.pxCurClientInfo = pxClientInfo;
+
+    // Complete frame received, inform state machine to process frame
+    xMBPortEventPost(EV_FRAME_RECEIVED);
+
+    ESP_LOGD(TAG, "Socket (#%d)(%s), get packet TID=0x%X, %d bytes.",
+                                        (int)pxClientInfo->xSockId, pxClientInfo->pcIpAddr,
+                                        (int)pxClientInfo->usTidCnt, (int)xErr);
+
+    // Wait while response is not processed by stack by timeout
+    UCHAR* pucSentBuffer = vxMBTCPPortRespQueueRecv(xConfig.xRespQueueHandle);
+    if (pucSentBuffer == NULL) {
+        ESP_LOGD(TAG, "Response is ignored, time exceeds configured %d [ms].",
+                                            (unsigned)MB_TCP_RESP_TIMEOUT_MS);
+    } else  {
+        USHORT usSentTid = MB_TCP_GET_FIELD(pucSentBuffer, MB_TCP_TID);
+        if (usSentTid != pxClientInfo->usTidCnt) {
+            ESP_LOGE(TAG, "Sent TID(%x) != Recv TID(%x), ignore packet.",
+                                                (int)usSentTid, (int)pxClientInfo->usTidCnt);
+        }
+    }
+    xConfig.pxCurClientInfo = NULL;
+
+    // The request is answered, prepare for the next one and return the buffer
+    pxClientInfo->usTCPBufPos = 0;
+    pxClientInfo->usTCPFrameBytesLeft = MB_TCP_FUNC;
+    vMBTCPPortReleaseBuf(pxClientInfo);
+
+    // Get time stamp of last data update
+    pxClientInfo->xSendTimeStamp = xMBTCPGetTimeStamp();
+    ESP_LOGD(TAG, "Client %d, Socket(#%d), processing time = %" PRIu64 "(us).",
+                                (int)pxClientInfo->xIndex, (int)pxClientInfo->xSockId,
+                                (uint64_t)(pxClientInfo->xSendTimeStamp - pxClientInfo->xRecvTimeStamp));
+}
+
+// Processes the timer wheel slots up to the current time and drops the connections
+// which did not receive data for MB_TCP_DISCONNECT_TIMEOUT
+static void vMBTCPPortWheelAdvance(int64_t xNow)
+{
+    int64_t xNowTick = xNow / MB_TCP_WHEEL_TICK_US;
+    if ((xNowTick - xConfig.xWheelTick) >= MB_TCP_WHEEL_SLOTS) {
+        // Each slot is processed once at most
+        xConfig.xWheelTick = xNowTick - MB_TCP_WHEEL_SLOTS + 1;
+    }
+    for (; xConfig.xWheelTick <= xNowTick; xConfig.xWheelTick++) {
+        MbClientInfo_t* pxNext = NULL;
+        for (MbClientInfo_t* pxInfo = xConfig.pxWheel[xConfig.xWheelTick & (MB_TCP_WHEEL_SLOTS - 1)];
+                pxInfo; pxInfo = pxNext) {
+            pxNext = pxInfo->pxWheelNext;
+            int64_t xTime = xNow - pxInfo->xRecvTimeStamp;
+            if (xTime > MB_TCP_DISCONNECT_TIMEOUT) {
+                ESP_LOGE(TAG, "Client %d, Socket(#%d) do not answer for %" PRIu64 " (us). Drop connection...",
+                                                (int)pxInfo->xIndex, (int)pxInfo->xSockId, (uint64_t)xTime);
+                xMBTCPPortCloseConnection(pxInfo);
+            } else {
+                // Data was received after the client was added, move it to its new deadline
+                vMBTCPPortWheelRemove(pxInfo);
+                vMBTCPPortWheelAdd(pxInfo);
+            }
+        }
+    }
+}
+
+// Returns the time until the next timer wheel tick
+static USHORT usMBTCPPortWheelWaitMs(void)
+{
+    if (!xConfig.pxActiveClients) {
+        return MB_TCP_RESP_TIMEOUT_MS;
+    }
+    int64_t xLeftUs = (xConfig.xWheelTick * MB_TCP_WHEEL_TICK_US) - xMBTCPGetTimeStamp();
+    return (xLeftUs > 0) ? (USHORT)((xLeftUs / 1000) + 1) : 0;
+}
+
+// Server task in reactor style: one select() waits for the listener and all connected
+// clients, the sockets are read without blocking and the idle connections are dropped
+// by the timer wheel.
+static void vMBTCPPortServerTask(void *pvParameters)
+{
+    int xErr = 0;
+    fd_set xReadSet;
+    struct timeval xTimeVal;
+
+    // Main connection cycle
+    while (1) {
+        // Create listen socket
+        xListenSock = vMBTCPPortBindAddr(xConfig.pcBindAddr);
+        if (xListenSock < 0) {
+            TCP_PORT_CHECK_SHDN(xShutdownSema, vMBTCPPortShutdown);
+            continue;
+        }
+        FD_ZERO(&xConfig.xActiveSet);
+        FD_SET(xListenSock, &xConfig.xActiveSet);
+        xConfig.xMaxSd = xListenSock;
+        xConfig.xWheelTick = (xMBTCPGetTimeStamp() / MB_TCP_WHEEL_TICK_US) + 1;
+
+        // Connections handling cycle
+        while (1) {
+            xReadSet = xConfig.xActiveSet;
+            vxMBTCPPortMStoTimeVal(usMBTCPPortWheelWaitMs(), &xTimeVal);
+
+            // Wait for an activity on one of the sockets during timeout
+            xErr = select(xConfig.xMaxSd + 1, &xReadSet, NULL, NULL, &xTimeVal);
+            TCP_PORT_CHECK_SHDN(xShutdownSema, vMBTCPPortShutdown);
+            if ((xErr < 0) && (errno != EINTR)) {
+                // error occurred during wait for read
+                ESP_LOGE(TAG, "select() errno = %u.", (unsigned)errno);
+                continue;
+            } else if (xErr > 0) {
+                // If something happened on the master socket, then its an incoming connection.
+                if (FD_ISSET(xListenSock, &xReadSet)) {
+                    vMBTCPPortAcceptClient();
+                }
+                // Handle data request from clients
+                MbClientInfo_t* pxNext = NULL;
+                for (MbClientInfo_t* pxClientInfo = xConfig.pxActiveClients; pxClientInfo; pxClientInfo = pxNext) {
+                    pxNext = pxClientInfo->pxNext;
+                    if (FD_ISSET(pxClientInfo->xSockId, &xReadSet)) {
+                        vMBTCPPortClientReady(pxClientInfo);
+                    }
+                }
+            }
+            vMBTCPPortWheelAdvance(xMBTCPGetTimeStamp());
+        } // while(1) // Handle connection cycle
+    } // Main connection cycle
+    vTaskDelete(NULL);
+}
+
+void
+vMBTCPPortClose( )
+{
+    // Try to exit the task gracefully, so select could release its internal callbacks
+    // that were allocated on the stack of the task we're going to delete
+    xShutdownSema = xSemaphoreCreateBinary();
+    if (xShutdownSema == NULL || // if no semaphore (alloc issues) or couldn't acquire it, just delete the task
+        xSemaphoreTake(xShutdownSema, 2 * pdMS_TO_TICKS(CONFIG_FMB_MASTER_TIMEOUT_MS_RESPOND)) != pdTRUE) {
+        ESP_LOGE(TAG, "Task couldn't exit gracefully within timeout -> abruptly deleting the task");
+        vTaskDelete(xConfig.xMbTcpTaskHandle);
+    }
+    xConfig.xMbTcpTaskHandle = NULL;
+
+    close(xListenSock);
+    xListenSock = -1;
+    while (xConfig.pxActiveClients) {
+        xMBTCPPortCloseConnection(xConfig.pxActiveClients);
+    }
+    vMBTCPPortFreeSlab();
+
+    vMBTCPPortRespQueueDelete(xConfig.xRespQueueHandle);
+#if MB_TCP_GATEWAY_ENABLED
+    vSemaphoreDelete(xConfig.xClientLock);
+    xConfig.xClientLock = NULL;
+    vSemaphoreDelete(xConfig.xFrameCBLock);
+    xConfig.xFrameCBLock = NULL;
+#endif
+
+    if (xShutdownSema) {
+        vSemaphoreDelete(xShutdownSema);
+        xShutdownSema = NULL;
+    }
+    vMBPortEventClose();
+}
+
+void vMBTCPPortEnable( void )
+{
+
+}
+
+void
+vMBTCPPortDisable( void )
+{
+
+}
+
+BOOL
+xMBTCPPortGetRequest( UCHAR ** ppucMBTCPFrame, USHORT * usTCPLength )
+{
+    BOOL xRet = FALSE;
+    if (xConfig.pxCurClientInfo) {
+        *ppucMBTCPFrame = &xConfig.pxCurClientInfo->pucTCPBuf[0];
+        *usTCPLength = xConfig.pxCurClientInfo->usTCPBufPos;
+        // The buffer is returned to the pool by the server task once the response is sent
+        xRet = TRUE;
+    }
+    return xRet;
+}
+
+// Waits until the socket of the client is writable and sends the frame
+static BOOL xMBTCPPortWriteFrame(MbClientInfo_t* pxInfo, UCHAR* pucFrame, USHORT usLength)
+{
+    fd_set xWriteSet;
+    fd_set xErrorSet;
+    int xErr = -1;
+    struct timeval xTimeVal;
+
+    FD_ZERO(&xWriteSet);
+    FD_ZERO(&xErrorSet);
+    FD_SET(pxInfo->xSockId, &xWriteSet);
+    FD_SET(pxInfo->xSockId, &xErrorSet);
+    vxMBTCPPortMStoTimeVal(MB_TCP_SEND_TIMEOUT_MS, &xTimeVal);
+    // Check if socket writable
+    xErr = select(pxInfo->xSockId + 1, NULL, &xWriteSet, &xErrorSet, &xTimeVal);
+    if ((xErr == -1) || FD_ISSET(pxInfo->xSockId, &xErrorSet)) {
+        ESP_LOGE(TAG, "Socket(#%d) , send select() error = %u.",
+                        (int)pxInfo->xSockId, (unsigned)errno);
+        return FALSE;
+    }
+
+    // Write message into socket and disable Nagle's algorithm
+    xErr = send(pxInfo->xSockId, pucFrame, usLength, TCP_NODELAY);
+    if (xErr < 0) {
+        ESP_LOGE(TAG, "Socket(#%d), fail to send data, errno = %u",
+                    (int)pxInfo->xSockId, (unsigned)errno);
+        pxInfo->xError = xErr;
+        return FALSE;
+    }
+    return TRUE;
+}
+
+BOOL
+xMBTCPPortSendResponse( UCHAR * pucMBTCPFrame, USHORT usTCPLength )
+{
+    BOOL bFrameSent = FALSE;
+
+    if (xConfig.pxCurClientInfo) {
+        // Apply TID field from request to the frame before send response
+        pucMBTCPFrame[MB_TCP_TID] = (UCHAR)(xConfig.pxCurClientInfo->usTidCnt >> 8U);
+        pucMBTCPFrame[MB_TCP_TID + 1] = (UCHAR)(xConfig.pxCurClientInfo->usTidCnt & 0xFF);
+
+        bFrameSent = xMBTCPPortWriteFrame(xConfig.pxCurClientInfo, pucMBTCPFrame, usTCPLength);
+        if (bFrameSent) {
+            vxMBTCPPortRespQueueSend(xConfig.xRespQueueHandle, (void*)pucMBTCPFrame);
+        }
+    } else {
+        ESP_LOGD(TAG, "Port is not active. Release lock.");
+        vxMBTCPPortRespQueueSend(xConfig.xRespQueueHandle, (void*)pucMBTCPFrame);
+    }
+    return bFrameSent;
+}
+
+#if MB_TCP_GATEWAY_ENABLED
+void vMBTCPPortSetFrameCB(pxMBTCPPortFrameCB pxFrameCB)
+{
+    if (!xConfig.xFrameCBLock) {
+        xConfig.pxFrameCB = pxFrameCB; // the server task is not running
+        return;
+    }
+    xSemaphoreTake(xConfig.xFrameCBLock, portMAX_DELAY);
+    xConfig.pxFrameCB = pxFrameCB;
+    xSemaphoreGive(xConfig.xFrameCBLock);
+}
+
+BOOL xMBTCPPortSendTo(USHORT usClientId, ULONG ulConnId, UCHAR* pucFrame, USHORT usLength)
+{
+    BOOL bFrameSent = FALSE;
+    MB_PORT_CHECK((usClientId < MB_TCP_PORT_MAX_CONN) && pucFrame, FALSE, "Incorrect client or frame.");
+    MB_PORT_CHECK((xConfig.xClientLock && xConfig.pxClientSlab), FALSE, "Port is not initialized.");
+
+    // The lock keeps the server task from closing the socket during the send
+    xSemaphoreTake(xConfig.xClientLock, portMAX_DELAY);
+    MbClientInfo_t* pxInfo = &xConfig.pxClientSlab[usClientId];
+    if ((pxInfo->xSockId > -1) && (pxInfo->ulConnId == ulConnId)) {
+        bFrameSent = xMBTCPPortWriteFrame(pxInfo, pucFrame, usLength);
+    } else {
+        ESP_LOGD(TAG, "Client %u, connection %u is closed, drop response.",
+                        (unsigned)usClientId, (unsigned)ulConnId);
+    }
+    xSemaphoreGive(xConfig.xClientLock);
+    return bFrameSent;
+}
+
+BOOL xMBTCPPortClientActive(USHORT usClientId, ULONG ulConnId)
+{
+    if ((usClientId >= MB_TCP_PORT_MAX_CONN) || !xConfig.pxClientSlab) {
+        return FALSE;
+    }
+    MbClientInfo_t* pxInfo = &xConfig.pxClientSlab[usClientId];
+    return (pxInfo->xSockId > -1) && (pxInfo->ulConnId == ulConnId);
+}
+#endif
+
+#endif //#if MB_TCP_ENABLED
@@ -43,7 +43,10 @@
 
 #include "lwip/opt.h"
 #include "lwip/sys.h"
+#include "lwip/sockets.h"
+#include "freertos/semphr.h"
 #include "port.h"
+#include "mbframe.h"                // for MBAP header fields
 #include "esp_modbus_common.h"      // for common types for network options
 
 /* ----------------------- Defines ------------------------------------------*/
@@ -56,35 +59,66 @@
 #define FALSE                   0
 #endif
 
+#define MB_TCP_IP_ADDR_LEN      (46)    // Length of an IPv6 address string with terminator
+#define MB_TCP_WHEEL_SLOTS      (64)    // Slots of the idle connection timer wheel, power of two
+
 #ifdef __cplusplus
 PR_BEGIN_EXTERN_C
 #endif
 
 /* ----------------------- Type definitions ---------------------------------*/
-typedef struct {
+typedef struct MbClientInfo_s {
     int xIndex;                     /*!< Modbus info index */
-    int xSockId;                    /*!< Socket id */
+    int xSockId;                    /*!< Socket id, -1 if the slot is free */
     int xError;                     /*!< TCP/UDP sock error */
-    const char* pcIpAddr;           /*!< TCP/UDP IP address (string) */
-    UCHAR* pucTCPBuf;               /*!< buffer pointer */
+    CHAR pcIpAddr[MB_TCP_IP_ADDR_LEN]; /*!< TCP/UDP IP address (string) */
+    UCHAR* pucTCPBuf;               /*!< buffer taken from the pool once the MBAP header is received */
+    UCHAR ucTCPHdr[MB_TCP_FUNC];    /*!< MBAP header received before the buffer is taken */
     USHORT usTCPBufPos;             /*!< buffer active position */
     USHORT usTCPFrameBytesLeft;     /*!< buffer left bytes to receive transaction */
+    BOOL xWaitBuf;                  /*!< the pool is empty, the client is not read until a buffer is free */
     int64_t xSendTimeStamp;         /*!< send request timestamp */
     int64_t xRecvTimeStamp;         /*!< receive response timestamp */
     USHORT usTidCnt;                /*!< last TID counter from packet */
+    struct MbClientInfo_s* pxNext;  /*!< next client in the active or free list */
+    struct MbClientInfo_s* pxPrev;  /*!< previous client in the active list */
+    struct MbClientInfo_s* pxWheelNext; /*!< next client in the same timer wheel slot */
+    struct MbClientInfo_s* pxWheelPrev; /*!< previous client in the same timer wheel slot */
+#if MB_TCP_GATEWAY_ENABLED
+    ULONG ulConnId;                 /*!< connection number, tells a new connection in the same slot */
+#endif
 } MbClientInfo_t;
 
+// Receives the complete request frames (MBAP header and PDU) instead of the slave stack,
+// called from the server task. The frame is only valid during the call.
+typedef void (*pxMBTCPPortFrameCB)(USHORT usClientId, ULONG ulConnId, UCHAR* pucFrame, USHORT usLength);
+
 typedef struct {
     TaskHandle_t xMbTcpTaskHandle;      /*!< Server task handle */
     QueueHandle_t xRespQueueHandle;      /*!< Response queue handle */
     MbClientInfo_t* pxCurClientInfo;    /*!< Current client info */
-    MbClientInfo_t** pxMbClientInfo;    /*!< Pointers to information about connected clients */
+    MbClientInfo_t* pxClientSlab;       /*!< Preallocated information of all clients */
+    MbClientInfo_t* pxFreeClients;      /*!< List of the free client slots */
+    MbClientInfo_t* pxActiveClients;    /*!< List of the connected clients */
+    UCHAR* pucBufPool;                  /*!< Memory of the receive buffer pool */
+    UCHAR** ppucFreeBufs;               /*!< Stack of the free receive buffers */
+    USHORT usFreeBufCount;              /*!< Number of free receive buffers */
+    fd_set xActiveSet;                  /*!< Descriptors of the listener and the clients being read */
+    int xMaxSd;                         /*!< Highest descriptor in xActiveSet */
+    MbClientInfo_t* pxWheel[MB_TCP_WHEEL_SLOTS]; /*!< Idle connection timer wheel */
+    int64_t xWheelTick;                 /*!< Next timer wheel tick to process */
     USHORT usPort;                      /*!< TCP/UDP port number */
     CHAR* pcBindAddr;                   /*!< IP address to bind */
     eMBPortProto eMbProto;              /*!< Protocol type used by port */
     USHORT usClientCount;               /*!< Client connection count */
     void* pvNetIface;                   /*!< Network netif interface pointer for port */
     eMBPortIpVer xIpVer;                /*!< IP protocol version */
+#if MB_TCP_GATEWAY_ENABLED
+    pxMBTCPPortFrameCB pxFrameCB;       /*!< Receiver of the request frames in gateway mode */
+    SemaphoreHandle_t xFrameCBLock;     /*!< Held by the server task while it calls the frame callback */
+    SemaphoreHandle_t xClientLock;      /*!< Protects the sockets sent from other tasks */
+    ULONG ulConnSeq;                    /*!< Number of the last accepted connection */
+#endif
 } MbSlavePortConfig_t;
 
 /* ----------------------- Function prototypes ------------------------------*/
@@ -101,6 +135,38 @@ typedef struct {
  */
 void vMBTCPPortSlaveSetNetOpt(void* pvNetIf, eMBPortIpVer xIpVersion, eMBPortProto xProto, CHAR* pcBindAddr);
 
+#if MB_TCP_GATEWAY_ENABLED
+/**
+ * Function to pass the received requests to a gateway instead of the slave stack.
+ * The previous callback is not called any more once this function returns.
+ *
+ * @param pxFrameCB receiver of the request frames, NULL to return them to the slave stack
+ */
+void vMBTCPPortSetFrameCB(pxMBTCPPortFrameCB pxFrameCB);
+
+/**
+ * Function to send a response frame to a client from any task
+ *
+ * @param usClientId client slot given to the frame callback
+ * @param ulConnId connection number given to the frame callback
+ * @param pucFrame response frame with the MBAP header
+ * @param usLength length of the frame
+ *
+ * @return TRUE if the frame is sent, FALSE if the connection is closed or the send failed
+ */
+BOOL xMBTCPPortSendTo(USHORT usClientId, ULONG ulConnId, UCHAR* pucFrame, USHORT usLength);
+
+/**
+ * Function to check whether the connection of a request is still open
+ *
+ * @param usClientId client slot given to the frame callback
+ * @param ulConnId connection number given to the frame callback
+ *
+ * @return TRUE if the connection is open
+ */
+BOOL xMBTCPPortClientActive(USHORT usClientId, ULONG ulConnId);
+#endif
+
 #ifdef __cplusplus
 PR_END_EXTERN_C
 #endif
@@ -1,9 +1,13 @@
 #include "string.h"
 #include "esp_log.h"
+#include "nvs_flash.h"
 #include "modbus_params.h" // for modbus parameters structures
 #include "mbcontroller.h"
 #include "sdkconfig.h"
 #include "tusb_msc.h"
+#include "esp_timer.h"
+#include "data_log.h"
+#include "poll_sched.h"
 
 #define MB_PORT_NUM 1   // Number of UART port used for Modbus connection
 #define MB_DEV_SPEED 9600 // The communication speed of the UART
@@ -21,9 +25,11 @@
 // Number of reading of parameters from slave
 #define MASTER_MAX_RETRY 30
 
-// Timeout to update cid over Modbus
+// Default polling period of a cid that has no entry in poll_schedule[]
 #define UPDATE_CIDS_TIMEOUT_MS (5000)
-#define UPDATE_CIDS_TIMEOUT_TICS (UPDATE_CIDS_TIMEOUT_MS / portTICK_PERIOD_MS)
+
+// Interval of the missed deadline report
+#define SCHED_STATS_INTERVAL_MS (60000)
 
 // Timeout between polls
 #define POLL_TIMEOUT_MS (1)
@@ -75,6 +81,13 @@ const mb_parameter_descriptor_t device_parameters[] = {
 // Calculate number of parameters in the table
 const uint16_t num_device_parameters = (sizeof(device_parameters) / sizeof(device_parameters[0]));
 
+// Polling schedule, characteristics are served earliest deadline first.
+// { CID, Period ms, Priority (0 highest), Jitter budget ms }
+static const poll_sched_config_t poll_schedule[] = {
+    {CID_HOL_DATA_0, 1000, 0, 200}};
+
+static const uint16_t num_poll_schedule = (sizeof(poll_schedule) / sizeof(poll_schedule[0]));
+
 // The function to get pointer to parameter storage (instance) according to parameter description table
 static void *master_get_param_data(const mb_parameter_descriptor_t *param_descriptor)
 {
@@ -105,75 +118,116 @@ static void *master_get_param_data(const mb_parameter_descriptor_t *param_descri
     return instance_ptr;
 }
 
+// Read one characteristic from its slave and append the value to the data log
+static esp_err_t master_read_cid(uint16_t cid)
+{
+    const mb_parameter_descriptor_t *param_descriptor = NULL;
+
+    // Get data from parameters description table
+    // and use this information to fill the characteristics description table
+    // and having all required fields in just one table
+    esp_err_t err = mbc_master_get_cid_info(cid, &param_descriptor);
+    if ((err == ESP_ERR_NOT_FOUND) || (param_descriptor == NULL)) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    void *temp_data_ptr = master_get_param_data(param_descriptor);
+    assert(temp_data_ptr);
+    uint8_t type = 0;
+    err = mbc_master_get_parameter(cid, (char *)param_descriptor->param_key, (uint8_t *)temp_data_ptr, &type);
+    if (err == ESP_ERR_NOT_ALLOWED) {
+        // the slave is skipped until it answers a probe, see master_health_changed()
+        ESP_LOGD(TAG, "characteristic #%d (%s) skipped.",
+                 param_descriptor->cid,
+                 (char *)param_descriptor->param_key);
+    } else if (err != ESP_OK) {
+        ESP_LOGE(TAG, "characteristic #%d (%s) read fail, err = 0x%x (%s).",
+                 param_descriptor->cid,
+                 (char *)param_descriptor->param_key,
+                 (int)err,
+                 (char *)esp_err_to_name(err));
+    }
+    if (err != ESP_OK) {
+        if ((param_descriptor->mb_param_type == MB_PARAM_HOLDING) || (param_descriptor->mb_param_type == MB_PARAM_INPUT)) {
+            // keep the gap visible in the log
+            data_log_append(param_descriptor->cid, 0, DATA_LOG_QUALITY_READ_ERROR);
+        }
+        return err;
+    }
+    if (param_descriptor->param_type == PARAM_TYPE_ASCII) {
+        // Check for long array of registers of type PARAM_TYPE_ASCII
+        ESP_LOGI(TAG, "characteristic #%d %s (%s) value = (0x%08" PRIx32 ") read successful.",
+                 param_descriptor->cid,
+                 (char *)param_descriptor->param_key,
+                 (char *)param_descriptor->param_units,
+                 *(uint32_t *)temp_data_ptr);
+    } else if ((param_descriptor->mb_param_type == MB_PARAM_HOLDING) || (param_descriptor->mb_param_type == MB_PARAM_INPUT)) {
+        uint16_t value = *(uint16_t *)temp_data_ptr;
+        ESP_LOGI(TAG, "characteristic #%d %s (%s) value = %d (0x%" PRIx32 ") read successful.",
+                 param_descriptor->cid,
+                 (char *)param_descriptor->param_key,
+                 (char *)param_descriptor->param_units,
+                 value,
+                 *(uint32_t *)temp_data_ptr);
+        data_log_append(param_descriptor->cid, value, DATA_LOG_QUALITY_GOOD);
+    } else {
+        uint16_t state = *(uint16_t *)temp_data_ptr;
+        const char *rw_str = (state & param_descriptor->param_opts.opt1) ? "ON" : "OFF";
+        ESP_LOGI(TAG, "characteristic #%d %s (%s) value = %s (0x%x) read successful.",
+                 param_descriptor->cid,
+                 (char *)param_descriptor->param_key,
+                 (char *)param_descriptor->param_units,
+                 (const char *)rw_str,
+                 *(uint16_t *)temp_data_ptr);
+    }
+    return ESP_OK;
+}
+
+static void master_log_sched_stats(void)
+{
+    poll_sched_stats_t stats;
+    for (uint16_t cid = 0; cid < MASTER_MAX_CIDS; cid++) {
+        if ((poll_sched_get_stats(cid, &stats) == ESP_OK) && stats.missed) {
+            ESP_LOGW(TAG, "characteristic #%d missed %" PRIu32 " of %" PRIu32 " deadlines, max late %" PRId64 " ms.",
+                     cid, stats.missed, stats.polls, stats.max_late_us / 1000);
+        }
+    }
+}
+
 // User operation function to read slave values and check alarm
 static void master_task(void *arg)
 {
-    esp_err_t err = ESP_OK;
-    const mb_parameter_descriptor_t *param_descriptor = NULL;
+    int64_t stats_us = esp_timer_get_time();
+
+    ESP_ERROR_CHECK(poll_sched_init(MASTER_MAX_CIDS, UPDATE_CIDS_TIMEOUT_MS));
+    for (int i = 0; i < num_poll_schedule; i++) {
+        ESP_ERROR_CHECK(poll_sched_configure(&poll_schedule[i]));
+    }
 
     while (1) {
-        // Read all found characteristics from slave(s)
-        for (uint16_t cid = 0; (err != ESP_ERR_NOT_FOUND) && cid < MASTER_MAX_CIDS; cid++) {
-            // Get data from parameters description table
-            // and use this information to fill the characteristics description table
-            // and having all required fields in just one table
-            err = mbc_master_get_cid_info(cid, &param_descriptor);
-            if ((err != ESP_ERR_NOT_FOUND) && (param_descriptor != NULL)) {
-                void *temp_data_ptr = master_get_param_data(param_descriptor);
-                assert(temp_data_ptr);
-                uint8_t type = 0;
-                if (param_descriptor->param_type == PARAM_TYPE_ASCII) {
-                    // Check for long array of registers of type PARAM_TYPE_ASCII
-                    if (mbc_master_get_parameter(cid, (char *)param_descriptor->param_key, (uint8_t *)temp_data_ptr, &type) == ESP_OK) {
-                        ESP_LOGI(TAG, "characteristic #%d %s (%s) value = (0x%08x) read successful.",
-                                 param_descriptor->cid,
-                                 (char *)param_descriptor->param_key,
-                                 (char *)param_descriptor->param_units,
-                                 *(uint32_t *)temp_data_ptr);
-                    } else {
-                        ESP_LOGE(TAG, "characteristic #%d (%s) read fail, err = 0x%x (%s).",
-                                 param_descriptor->cid,
-                                 (char *)param_descriptor->param_key,
-                                 (int)err,
-                                 (char *)esp_err_to_name(err));
-                    }
-                } else {
-                    if (mbc_master_get_parameter(cid, (char *)param_descriptor->param_key, (uint8_t *)temp_data_ptr, &type) == ESP_OK) {
-                        if ((param_descriptor->mb_param_type == MB_PARAM_HOLDING) || (param_descriptor->mb_param_type == MB_PARAM_INPUT)) {
-                            uint16_t value = *(uint16_t *)temp_data_ptr;
-                            ESP_LOGI(TAG, "characteristic #%d %s (%s) value = %d (0x%" PRIx32 ") read successful.",
-                                     param_descriptor->cid,
-                                     (char *)param_descriptor->param_key,
-                                     (char *)param_descriptor->param_units,
-                                     value,
-                                     *(uint32_t *)temp_data_ptr);
-                            append_data(value);
-                            
-                        } else {
-                            uint16_t state = *(uint16_t *)temp_data_ptr;
-                            const char *rw_str = (state & param_descriptor->param_opts.opt1) ? "ON" : "OFF";
-                            ESP_LOGI(TAG, "characteristic #%d %s (%s) value = %s (0x%x) read successful.",
-                                     param_descriptor->cid,
-                                     (char *)param_descriptor->param_key,
-                                     (char *)param_descriptor->param_units,
-                                     (const char *)rw_str,
-                                     *(uint16_t *)temp_data_ptr);
-                        }
-                    } else {
-                        ESP_LOGE(TAG, "characteristic #%d (%s) read fail, err = 0x%x (%s).",
-                                 param_descriptor->cid,
-                                 (char *)param_descriptor->param_key,
-                                 (int)err,
-                                 (char *)esp_err_to_name(err));
-                    }
-                }
-                vTaskDelay(POLL_TIMEOUT_TICS); // timeout between polls
-            }
+        int64_t wait_us = 0;
+        int64_t now_us = esp_timer_get_time();
+        int cid = poll_sched_next(now_us, &wait_us);
+        if (cid < 0) {
+            TickType_t ticks = pdMS_TO_TICKS(wait_us / 1000);
+            vTaskDelay(ticks ? ticks : 1);
+            continue;
+        }
+        master_read_cid(cid);
+        poll_sched_done(cid, now_us, esp_timer_get_time());
+        if (now_us - stats_us >= SCHED_STATS_INTERVAL_MS * 1000LL) {
+            master_log_sched_stats();
+            stats_us = now_us;
         }
-        vTaskDelay(UPDATE_CIDS_TIMEOUT_TICS); //
+        vTaskDelay(POLL_TIMEOUT_TICS); // timeout between polls
     }
 }
 
+static void master_health_changed(uint8_t slave_addr, mb_slave_health_t old_state, mb_slave_health_t new_state, void *arg)
+{
+    static const char *const health_names[] = { "healthy", "suspect", "open", "half-open" };
+    ESP_LOGW(TAG, "slave %u health %s -> %s.", slave_addr, health_names[old_state], health_names[new_state]);
+}
+
 // Modbus master initialization
 static esp_err_t master_init(void)
 {
@@ -202,6 +256,8 @@ static esp_err_t master_init(void)
 
     err = mbc_master_start();
     MB_RETURN_ON_FALSE((err == ESP_OK), ESP_ERR_INVALID_STATE, TAG, "mb controller start fail, returns(0x%x).", (uint32_t)err);
+    // Not supported if the slave health tracking is disabled in the configuration
+    (void)mbc_master_set_health_cb(master_health_changed, NULL);
 
     // Set driver mode to Half Duplex
     err = uart_set_mode(MB_PORT_NUM, UART_MODE_RS485_HALF_DUPLEX);
@@ -216,6 +272,14 @@ static esp_err_t master_init(void)
 
 void app_main(void)
 {
+    // the data log keeps its segment index in nvs
+    esp_err_t ret = nvs_flash_init();
+    if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {
+        ESP_ERROR_CHECK(nvs_flash_erase());
+        ret = nvs_flash_init();
+    }
+    ESP_ERROR_CHECK(ret);
+
     storage_main();
     ESP_ERROR_CHECK(master_init());
     vTaskDelay(10);
@@ -0,0 +1,865 @@
+#include <errno.h>
+#include <dirent.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <sys/param.h>
+#include <sys/stat.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_rom_crc.h"
+#include "esp_timer.h"
+#include "nvs.h"
+#include "sdkconfig.h"
+#include "data_log.h"
+#include "log_format.h"
+#include "log_hold.h"
+#include "sample_ring.h"
+
+static const char *TAG = "log";
+
+#define AS_FILE_BLOCKS 200 // blocks per segment including the header block
+#define AS_FILE_NAME_MAX 24
+
+// Blocks are committed so that every write ends on a wear-levelling sector boundary,
+// the remainder stays in RAM until the next batch (or a forced flush).
+#define LOG_SECTOR_BLOCKS (CONFIG_WL_SECTOR_SIZE / LOG_BLOCK_SIZE)
+// The buffer size is rounded up to whole sectors
+#define LOG_BUF_BLOCKS (((CONFIG_DATA_LOG_BUFFER_SIZE + CONFIG_WL_SECTOR_SIZE - 1) / CONFIG_WL_SECTOR_SIZE) * LOG_SECTOR_BLOCKS)
+#define LOG_ROLLUP_BUF_BLOCKS LOG_SECTOR_BLOCKS // rollups are rare, one sector is staged per tier
+#define LOG_FLUSH_INTERVAL_US ((int64_t)CONFIG_DATA_LOG_FLUSH_INTERVAL_MS * 1000)
+#define LOG_FLUSH_INTERVAL_TICS (CONFIG_DATA_LOG_FLUSH_INTERVAL_MS ? pdMS_TO_TICKS(CONFIG_DATA_LOG_FLUSH_INTERVAL_MS) : portMAX_DELAY)
+#define LOG_WALL_CLOCK_MIN 1577836800 // 2020-01-01, anything earlier means the clock was never set
+
+#define LOG_NVS_NAMESPACE "data_log"
+#define LOG_SUPERBLOCK_VERSION 1
+
+#define LOG_ROLLUP_TIERS 2
+#define LOG_ROLLUP_GRACE_S 5 // a window is closed this long after its end if no newer sample arrives
+
+#define LOG_TASK_STACK_SIZE 4096
+#define LOG_TASK_PRIO 4 // below the modbus poller, flash latency must not delay polling
+
+#if CONFIG_DATA_LOG_ENCODING_DELTA
+#define LOG_BLOCK_FLAGS LOG_BLOCK_FLAG_DELTA
+#elif CONFIG_DATA_LOG_ENCODING_XOR
+#define LOG_BLOCK_FLAGS LOG_BLOCK_FLAG_XOR
+#else
+#define LOG_BLOCK_FLAGS 0
+#endif
+
+#if CONFIG_DATA_LOG_QUEUE_DROP_OLDEST
+#define LOG_QUEUE_OVERWRITE true
+#else
+#define LOG_QUEUE_OVERWRITE false
+#endif
+
+_Static_assert(CONFIG_WL_SECTOR_SIZE % LOG_BLOCK_SIZE == 0, "sector size must be a multiple of the log block size");
+_Static_assert((CONFIG_DATA_LOG_QUEUE_LEN & (CONFIG_DATA_LOG_QUEUE_LEN - 1)) == 0, "log queue length must be a power of two");
+
+// Segment state persisted in NVS after every commit, so that mounting does not need to scan
+// the directory. NVS replaces a blob atomically, a record is either the old or the new one.
+typedef struct {
+    uint32_t version;           // LOG_SUPERBLOCK_VERSION
+    uint32_t generation;        // incremented with every update
+    uint16_t file_min;
+    uint16_t file_max;
+    uint32_t file_blocks;       // complete blocks in the newest file
+    uint32_t seq;               // sequence number of the next block
+    uint8_t partial;            // a partial block follows the complete ones
+    uint8_t reserved[3];
+    uint32_t crc;               // CRC32 of all preceding bytes
+} log_superblock_t;
+
+// A series of segment files <prefix><n>.bin with its own staging buffer and retention.
+typedef struct {
+    const char *prefix;         // file name prefix
+    const char *nvs_key;        // superblock key
+    uint16_t max_files;         // the oldest file is deleted once the series has more files
+    uint8_t flags;              // LOG_BLOCK_FLAG_* of new blocks
+    uint16_t record_size;       // record size stored in the segment header
+    uint16_t file_min;
+    uint16_t file_max;
+    uint32_t file_blocks;       // complete blocks (including the header) in the newest file
+    uint32_t seq;               // sequence number of the next block
+    uint32_t generation;        // superblock generation
+    log_block_t *blocks;        // staging buffer
+    size_t buf_blocks;          // size of the staging buffer
+    size_t blocks_used;         // staged blocks, only the last one may be partially filled
+    log_encoder_t enc;          // encoder state of the last staged block
+    bool partial_written;       // the last staged block is also on flash (after file_blocks)
+    int64_t buf_since;          // time the oldest entry not yet on flash was staged, 0 if none
+    uint32_t held;              // blocks of the series waiting in the hold store
+} log_series_t;
+
+// Running aggregate of one characteristic over the current window of a rollup tier
+typedef struct {
+    bool open;
+    uint8_t flags;              // LOG_ROLLUP_*
+    uint32_t start_s;
+    uint32_t min;
+    uint32_t max;
+    uint64_t sum;
+    uint16_t count;
+    uint16_t errors;
+} log_window_t;
+
+static SemaphoreHandle_t log_lock;     // owns the staging buffers and the consumer side of the queue
+static StaticSemaphore_t log_lock_buf;
+static TaskHandle_t log_task_handle;
+static sample_ring_t log_queue;
+static data_log_sample_t log_queue_slots[CONFIG_DATA_LOG_QUEUE_LEN];
+static bool log_mounted = false;
+static log_block_t raw_blocks[LOG_BUF_BLOCKS];
+static data_log_stats_t log_stats = { 0 };
+static nvs_handle_t log_nvs;
+static int64_t log_mount_time = 0;     // time of the last mount until the first write after it
+static FILE *export_fd = NULL;         // file last read by the usb export, see data_log_read_file()
+static char export_name[AS_FILE_NAME_MAX];
+
+static log_series_t raw_series = {
+    .prefix = "",
+    .nvs_key = "sb",
+    .max_files = CONFIG_DATA_LOG_RAW_FILES,
+    .flags = LOG_BLOCK_FLAGS,
+    .record_size = sizeof(log_record_t),
+    .blocks = raw_blocks,
+    .buf_blocks = LOG_BUF_BLOCKS,
+};
+
+#if CONFIG_DATA_LOG_ROLLUP
+static log_block_t minute_blocks[LOG_ROLLUP_BUF_BLOCKS];
+static log_block_t hour_blocks[LOG_ROLLUP_BUF_BLOCKS];
+
+static log_series_t rollup_series[LOG_ROLLUP_TIERS] = {
+    {
+        .prefix = "m",
+        .nvs_key = "sb_m",
+        .max_files = CONFIG_DATA_LOG_MINUTE_FILES,
+        .flags = LOG_BLOCK_FLAG_ROLLUP,
+        .record_size = sizeof(log_rollup_t),
+        .blocks = minute_blocks,
+        .buf_blocks = LOG_ROLLUP_BUF_BLOCKS,
+    },
+    {
+        .prefix = "h",
+        .nvs_key = "sb_h",
+        .max_files = CONFIG_DATA_LOG_HOUR_FILES,
+        .flags = LOG_BLOCK_FLAG_ROLLUP,
+        .record_size = sizeof(log_rollup_t),
+        .blocks = hour_blocks,
+        .buf_blocks = LOG_ROLLUP_BUF_BLOCKS,
+    },
+};
+static const uint32_t rollup_period_s[LOG_ROLLUP_TIERS] = { 60, 3600 };
+static log_window_t rollup_windows[LOG_ROLLUP_TIERS][CONFIG_DATA_LOG_ROLLUP_CIDS];
+
+static log_series_t *const log_series[] = { &raw_series, &rollup_series[0], &rollup_series[1] };
+#else
+static log_series_t *const log_series[] = { &raw_series };
+#endif
+#define LOG_SERIES_COUNT (sizeof(log_series) / sizeof(log_series[0]))
+
+static log_block_t replay_blocks[LOG_SECTOR_BLOCKS];
+
+// blocks of the series that are not on flash yet
+static bool log_pending(const log_series_t *series)
+{
+    return series->blocks_used || series->held;
+}
+
+static void log_file_name(const log_series_t *series, char *name, uint16_t index)
+{
+    snprintf(name, AS_FILE_NAME_MAX, DATA_LOG_BASE_PATH "/%s%u.bin", series->prefix, index);
+}
+
+static uint32_t log_wall_clock(void)
+{
+    time_t now = time(NULL);
+    return (now >= LOG_WALL_CLOCK_MIN) ? (uint32_t)now : 0;
+}
+
+// Find the last valid block of a segment to continue the sequence numbers.
+// A torn block at the end of the file is dropped and overwritten by the next commit.
+static void log_recover_tail(log_series_t *series, uint16_t index)
+{
+    char filename[AS_FILE_NAME_MAX];
+    log_file_name(series, filename, index);
+    FILE *fd = fopen(filename, "rb");
+    if (!fd) {
+        return;
+    }
+    log_block_t *block = &series->blocks[0];
+    while (series->file_blocks > 1) {
+        if (fseek(fd, (series->file_blocks - 1) * LOG_BLOCK_SIZE, SEEK_SET) == 0
+                && fread(block, LOG_BLOCK_SIZE, 1, fd) == 1
+                && log_block_valid(block)) {
+            series->seq = block->header.seq + 1;
+            break;
+        }
+        ESP_LOGW(TAG, "dropping invalid block %" PRIu32 " of %s", series->file_blocks - 1, filename);
+        series->file_blocks--;
+    }
+    fclose(fd);
+}
+
+static void log_save_superblock(log_series_t *series)
+{
+    if (!log_nvs) {
+        return;
+    }
+    log_superblock_t sb = {
+        .version = LOG_SUPERBLOCK_VERSION,
+        .generation = ++series->generation,
+        .file_min = series->file_min,
+        .file_max = series->file_max,
+        .file_blocks = series->file_blocks,
+        .seq = series->seq,
+        .partial = series->partial_written,
+    };
+    sb.crc = esp_rom_crc32_le(0, (const uint8_t *)&sb, offsetof(log_superblock_t, crc));
+    esp_err_t err = nvs_set_blob(log_nvs, series->nvs_key, &sb, sizeof(sb));
+    if (err == ESP_OK) {
+        err = nvs_commit(log_nvs);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "failed to save log superblock %s: %s", series->nvs_key, esp_err_to_name(err));
+    }
+}
+
+static bool log_load_superblock(const log_series_t *series, log_superblock_t *sb)
+{
+    size_t len = sizeof(*sb);
+    if (!log_nvs || nvs_get_blob(log_nvs, series->nvs_key, sb, &len) != ESP_OK || len != sizeof(*sb)) {
+        return false;
+    }
+    return (sb->version == LOG_SUPERBLOCK_VERSION)
+           && (sb->crc == esp_rom_crc32_le(0, (const uint8_t *)sb, offsetof(log_superblock_t, crc)));
+}
+
+// The superblock is trusted if the newest file has exactly the recorded size and no newer
+// file exists. Anything else (power loss between write and update, files changed over USB)
+// falls back to a directory scan.
+static bool log_check_superblock(const log_series_t *series, const log_superblock_t *sb)
+{
+    char filename[AS_FILE_NAME_MAX];
+    struct stat st;
+    log_file_name(series, filename, sb->file_max);
+    uint32_t blocks = (stat(filename, &st) == 0) ? st.st_size / LOG_BLOCK_SIZE : 0;
+    if (blocks != sb->file_blocks + sb->partial) {
+        return false;
+    }
+    log_file_name(series, filename, sb->file_max + 1);
+    return stat(filename, &st) != 0;
+}
+
+// rebuild the segment range of a series from the directory contents
+static void log_scan(log_series_t *series)
+{
+    uint16_t lo = UINT16_MAX;
+    uint16_t hi = 0;
+    size_t prefix_len = strlen(series->prefix);
+    DIR *d = opendir(DATA_LOG_BASE_PATH);
+    struct dirent *dir;
+    if (d) {
+        while ((dir = readdir(d)) != NULL) {
+            unsigned int index = 0;
+            char ext[4] = { 0 };
+            if (strncasecmp(dir->d_name, series->prefix, prefix_len) == 0
+                    && sscanf(dir->d_name + prefix_len, "%u.%3s", &index, ext) == 2
+                    && !strcasecmp(ext, "bin") && index <= UINT16_MAX) {
+                if (index > hi) hi = index;
+                if (index < lo) lo = index;
+            }
+        }
+        closedir(d);
+    }
+    if (lo > hi) {
+        lo = hi = 0;
+    }
+
+    char filename[AS_FILE_NAME_MAX];
+    struct stat st;
+    log_file_name(series, filename, hi);
+    uint32_t blocks = (stat(filename, &st) == 0) ? st.st_size / LOG_BLOCK_SIZE : 0;
+    if (!log_pending(series)) {
+        series->file_blocks = blocks;
+        log_recover_tail(series, hi);
+    } else {
+        // samples were staged across an unmount and the volume was modified meanwhile,
+        // continue in a fresh segment instead of overwriting whatever is there now
+        ESP_LOGW(TAG, "log changed while unmounted, starting a new file");
+        series->file_blocks = AS_FILE_BLOCKS;
+    }
+    series->file_min = lo;
+    series->file_max = hi;
+}
+
+// Restore the segment state of a series after the file system has been mounted to the application.
+static void log_open(log_series_t *series)
+{
+    int64_t start = esp_timer_get_time();
+    log_superblock_t sb;
+    bool valid;
+    if (log_pending(series)) {
+        // remount with staged or held samples, the state in RAM is the reference
+        sb.file_max = series->file_max;
+        sb.file_blocks = series->file_blocks;
+        sb.partial = series->partial_written;
+        valid = log_check_superblock(series, &sb);
+    } else {
+        valid = log_load_superblock(series, &sb) && log_check_superblock(series, &sb);
+        if (valid) {
+            series->file_min = sb.file_min;
+            series->file_max = sb.file_max;
+            series->file_blocks = sb.file_blocks + sb.partial;
+            series->seq = sb.seq;
+            series->generation = sb.generation;
+        }
+    }
+    if (!valid) {
+        ESP_LOGW(TAG, "log superblock %s not valid, scanning %s", series->nvs_key, DATA_LOG_BASE_PATH);
+        log_scan(series);
+        log_save_superblock(series);
+    }
+    ESP_LOGI(TAG, "series '%s': file index[%d, %d], %" PRIu32 " blocks in latest file, next block %" PRIu32
+             ", opened in %" PRId64 " us",
+             series->prefix, series->file_min, series->file_max, series->file_blocks, series->seq,
+             esp_timer_get_time() - start);
+}
+
+static void log_export_close(void)
+{
+    if (export_fd) {
+        fclose(export_fd);
+        export_fd = NULL;
+    }
+}
+
+// start a new segment and drop the eldest one once the retention limit is reached
+static void log_rotate(log_series_t *series)
+{
+    series->file_max++;
+    series->file_blocks = 0;
+    ESP_LOGI(TAG, "creating file %s%d, %d", series->prefix, series->file_max, series->max_files);
+    if (series->file_max - series->file_min + 1 > series->max_files) {
+        char filename[AS_FILE_NAME_MAX];
+        log_file_name(series, filename, series->file_min);
+        log_export_close();
+        ESP_LOGI(TAG, "storage is full, have to delete oldest file: %s", filename);
+        if (remove(filename) != 0 && errno != ENOENT) {
+            ESP_LOGW(TAG, "failed to delete file: %d", errno);
+        } else {
+            series->file_min++;
+        }
+    }
+}
+
+// write n blocks to the newest file of a series starting at block index offset
+static esp_err_t log_write(log_series_t *series, const void *blocks, uint32_t offset, size_t n)
+{
+    char filename[AS_FILE_NAME_MAX];
+    log_file_name(series, filename, series->file_max);
+    FILE *fd = fopen(filename, offset ? "r+b" : "wb");
+    if (!fd) {
+        ESP_LOGW(TAG, "failed to open %s, keep %u blocks staged.", filename, (unsigned)series->blocks_used);
+        return ESP_FAIL;
+    }
+    // the batch is already buffered, hand it to FATFS in a single write
+    setvbuf(fd, NULL, _IONBF, 0);
+    size_t written = 0;
+    if (fseek(fd, offset * LOG_BLOCK_SIZE, SEEK_SET) == 0) {
+        written = fwrite(blocks, LOG_BLOCK_SIZE, n, fd);
+    }
+    fclose(fd);
+
+    log_stats.commits++;
+    log_stats.bytes += written * LOG_BLOCK_SIZE;
+    if (log_mount_time) {
+        log_stats.resume_us = esp_timer_get_time() - log_mount_time;
+        log_mount_time = 0;
+        ESP_LOGI(TAG, "first write %" PRId64 " us after mount", log_stats.resume_us);
+    }
+    ESP_LOGD(TAG, "committed %u blocks to %s at block %" PRIu32, (unsigned)written, filename, offset);
+    if (written != n) {
+        ESP_LOGW(TAG, "short write to %s (%u of %u blocks).", filename, (unsigned)written, (unsigned)n);
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t log_create_segment(log_series_t *series)
+{
+    static log_block_t header_block;
+    memset(&header_block, 0, sizeof(header_block));
+    log_segment_header_init((log_segment_header_t *)&header_block, series->file_max, log_wall_clock(),
+                            series->record_size);
+    esp_err_t err = log_write(series, &header_block, 0, 1);
+    if (err == ESP_OK) {
+        series->file_blocks = 1;
+    }
+    return err;
+}
+
+// Write the blocks collected in the hold store while the volume was owned by the USB host,
+// oldest first, in batches of up to one sector of the same series.
+static esp_err_t log_replay(void)
+{
+    esp_err_t err = ESP_OK;
+    while (log_hold_count()) {
+        int tag = log_hold_peek(0, &replay_blocks[0]);
+        log_series_t *series = log_series[tag];
+        if (series->file_blocks >= AS_FILE_BLOCKS) {
+            log_rotate(series);
+        }
+        if (series->file_blocks == 0) {
+            err = log_create_segment(series);
+            if (err != ESP_OK) {
+                break;
+            }
+        }
+        size_t n = 1;
+        size_t max = MIN(LOG_SECTOR_BLOCKS, AS_FILE_BLOCKS - series->file_blocks);
+        while (n < max && n < log_hold_count()) {
+            if (log_hold_peek(n, &replay_blocks[n]) != tag) {
+                break;
+            }
+            n++;
+        }
+        err = log_write(series, replay_blocks, series->file_blocks, n);
+        if (err != ESP_OK) {
+            break;
+        }
+        for (size_t i = 0; i < n; i++) {
+            log_stats.replayed += replay_blocks[i].header.count;
+        }
+        series->file_blocks += n;
+        series->partial_written = false;
+        series->held -= n;
+        log_hold_pop(n);
+        log_save_superblock(series);
+    }
+    return err;
+}
+
+// Called on unmount. A partial block that is already on flash is left there as it is, new
+// samples start a new block. Otherwise the block would go to the hold store once filled, and
+// the samples on flash would be lost if the hold store drops it.
+static void log_seal_partial(log_series_t *series)
+{
+    if (series->partial_written && series->blocks_used == 1 && !series->buf_since) {
+        series->file_blocks++;
+        series->blocks_used = 0;
+        series->partial_written = false;
+        log_save_superblock(series);
+    }
+}
+
+// Move the full staged blocks of a series to the hold store, the staging buffer is full and
+// can not be committed because the volume is owned by the USB host.
+static void log_hold(log_series_t *series)
+{
+    log_block_t *blocks = series->blocks;
+    size_t n = 0;
+    uint8_t tag = 0;
+    while (log_series[tag] != series) {
+        tag++;
+    }
+    while (n < series->blocks_used && log_block_full(&blocks[n])) {
+        uint8_t dropped_tag;
+        uint8_t dropped_count;
+        log_block_seal(&blocks[n]);
+        log_stats.held += blocks[n].header.count;
+        series->held++;
+        if (log_hold_push(tag, &blocks[n], &dropped_tag, &dropped_count)) {
+            // the oldest held block, or this one if nothing can be held, is lost
+            log_stats.hold_dropped += dropped_count;
+            log_series[dropped_tag]->held--;
+        }
+        n++;
+    }
+    series->blocks_used -= n;
+    memmove(blocks, blocks + n, series->blocks_used * sizeof(log_block_t));
+    log_stats.spilled = log_hold_spilled();
+}
+
+// Write staged blocks of a series to the log. Without force only complete blocks are written,
+// and only as many as end the file on a sector boundary. A partial block written with force
+// stays staged and is rewritten in place by the next commit. Must be called with log_lock held.
+static esp_err_t log_commit(log_series_t *series, bool force)
+{
+    if (series->blocks_used == 0) {
+        return ESP_OK;
+    }
+    if (!log_mounted) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (series->held) {
+        // held blocks are older than the staged ones
+        esp_err_t err = log_replay();
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
+    log_block_t *blocks = series->blocks;
+    bool last_full = log_block_full(&blocks[series->blocks_used - 1]);
+    size_t count = (force || last_full) ? series->blocks_used : series->blocks_used - 1;
+    size_t done = 0;
+    bool wrote = false;
+    esp_err_t err = ESP_OK;
+
+    while (done < count) {
+        if (series->file_blocks >= AS_FILE_BLOCKS) {
+            log_rotate(series);
+        }
+        if (series->file_blocks == 0) {
+            err = log_create_segment(series);
+            if (err != ESP_OK) {
+                break;
+            }
+        }
+        size_t n = MIN(count - done, AS_FILE_BLOCKS - series->file_blocks);
+        // close the segment completely, otherwise keep the file end sector aligned
+        if (!force && (series->file_blocks + n < AS_FILE_BLOCKS)) {
+            size_t end = ((series->file_blocks + n) / LOG_SECTOR_BLOCKS) * LOG_SECTOR_BLOCKS;
+            n = (end > series->file_blocks) ? end - series->file_blocks : 0;
+            if (n == 0) {
+                break;
+            }
+        }
+        for (size_t i = done; i < done + n; i++) {
+            log_block_seal(&blocks[i]);
+        }
+        err = log_write(series, &blocks[done], series->file_blocks, n);
+        if (err != ESP_OK) {
+            break;
+        }
+        wrote = true;
+        series->partial_written = (done + n == series->blocks_used) && !last_full;
+        if (series->partial_written) {
+            // everything is on flash, the partial block stays staged
+            series->file_blocks += n - 1;
+            done += n - 1;
+            series->buf_since = 0;
+            break;
+        }
+        series->file_blocks += n;
+        done += n;
+    }
+
+    series->blocks_used -= done;
+    memmove(blocks, blocks + done, series->blocks_used * sizeof(log_block_t));
+    if (series->blocks_used == 0) {
+        series->buf_since = 0;
+    }
+    if (wrote) {
+        log_save_superblock(series);
+    }
+    return err;
+}
+
+static bool log_block_put(log_series_t *series, log_block_t *block, const void *entry)
+{
+    if (series->flags & LOG_BLOCK_FLAG_ROLLUP) {
+        return log_block_add_rollup(block, entry);
+    }
+    return log_block_add(block, &series->enc, entry);
+}
+
+// Add one sample or rollup to the staging buffer of a series. Must be called with log_lock held.
+static bool log_stage(log_series_t *series, const void *entry)
+{
+    log_block_t *blocks = series->blocks;
+    if (series->blocks_used == 0 || !log_block_put(series, &blocks[series->blocks_used - 1], entry)) {
+        if (series->blocks_used == series->buf_blocks) {
+            log_commit(series, true);
+        }
+        if (series->blocks_used == series->buf_blocks) {
+            log_hold(series);
+        }
+        if (series->blocks_used == series->buf_blocks) {
+            log_stats.dropped++;
+            return false;
+        }
+        log_block_t *block = &blocks[series->blocks_used++];
+        log_block_init(block, &series->enc, series->seq++, series->flags);
+        log_block_put(series, block, entry);
+        log_stats.blocks++;
+    }
+    if (!series->buf_since) {
+        series->buf_since = esp_timer_get_time();
+    }
+    return true;
+}
+
+#if CONFIG_DATA_LOG_ROLLUP
+// Write the aggregate of a window to its tier and start over.
+static void log_rollup_close(int tier, uint16_t cid)
+{
+    log_window_t *window = &rollup_windows[tier][cid];
+    log_rollup_t rollup = {
+        .start_s = window->start_s,
+        .min = window->count ? window->min : 0,
+        .max = window->max,
+        .mean = window->count ? (uint32_t)(window->sum / window->count) : 0,
+        .cid = cid,
+        .count = window->count,
+        .errors = window->errors,
+        .flags = window->flags,
+    };
+    if (log_stage(&rollup_series[tier], &rollup)) {
+        log_stats.rollups++;
+    } else {
+        ESP_LOGE(TAG, "rollup buffer full, window of cid %d dropped.", cid);
+    }
+    window->open = false;
+}
+
+// Fold a sample into the current window of every tier. Windows follow the wall clock once
+// it is set, before that they are aligned to the time since boot.
+static void log_rollup_add(const data_log_sample_t *sample)
+{
+    if (sample->cid >= CONFIG_DATA_LOG_ROLLUP_CIDS) {
+        return;
+    }
+    uint8_t flags = sample->wall_s ? LOG_ROLLUP_WALL_CLOCK : 0;
+    uint32_t now_s = sample->wall_s ? sample->wall_s : (uint32_t)(sample->time_us / 1000000);
+    for (int tier = 0; tier < LOG_ROLLUP_TIERS; tier++) {
+        log_window_t *window = &rollup_windows[tier][sample->cid];
+        uint32_t start_s = now_s - now_s % rollup_period_s[tier];
+        if (window->open && (window->start_s != start_s || window->flags != flags)) {
+            log_rollup_close(tier, sample->cid);
+        }
+        if (!window->open) {
+            *window = (log_window_t) {
+                .open = true,
+                .flags = flags,
+                .start_s = start_s,
+                .min = UINT32_MAX,
+            };
+        }
+        if (sample->quality != DATA_LOG_QUALITY_GOOD) {
+            window->errors += (window->errors < UINT16_MAX);
+            continue;
+        }
+        if (window->count == UINT16_MAX) {
+            continue;
+        }
+        window->count++;
+        window->sum += sample->raw;
+        window->min = MIN(window->min, sample->raw);
+        window->max = MAX(window->max, sample->raw);
+    }
+}
+
+// close the windows of characteristics that are no longer sampled
+static void log_rollup_expire(void)
+{
+    uint32_t wall_s = log_wall_clock();
+    uint32_t mono_s = (uint32_t)(esp_timer_get_time() / 1000000);
+    for (int tier = 0; tier < LOG_ROLLUP_TIERS; tier++) {
+        for (uint16_t cid = 0; cid < CONFIG_DATA_LOG_ROLLUP_CIDS; cid++) {
+            log_window_t *window = &rollup_windows[tier][cid];
+            uint32_t now_s = (window->flags & LOG_ROLLUP_WALL_CLOCK) ? wall_s : mono_s;
+            if (window->open && now_s >= window->start_s + rollup_period_s[tier] + LOG_ROLLUP_GRACE_S) {
+                log_rollup_close(tier, cid);
+            }
+        }
+    }
+}
+#endif
+
+// Move queued samples into the staging buffers and commit what is due.
+// Must be called with log_lock held.
+static esp_err_t log_drain(bool force)
+{
+    data_log_sample_t sample;
+    while (sample_ring_pop(&log_queue, &sample)) {
+        if (log_stage(&raw_series, &sample)) {
+            log_stats.samples++;
+        } else {
+            ESP_LOGE(TAG, "log buffer full, sample of cid %d dropped.", sample.cid);
+        }
+#if CONFIG_DATA_LOG_ROLLUP
+        log_rollup_add(&sample);
+#endif
+    }
+#if CONFIG_DATA_LOG_ROLLUP
+    log_rollup_expire();
+#endif
+    esp_err_t err = ESP_OK;
+    if (log_mounted && log_hold_count()) {
+        err = log_replay();
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
+    int64_t now = esp_timer_get_time();
+    for (size_t i = 0; i < LOG_SERIES_COUNT; i++) {
+        log_series_t *series = log_series[i];
+        bool due = force || (series->buf_since && (now - series->buf_since) >= LOG_FLUSH_INTERVAL_US);
+        esp_err_t series_err = log_commit(series, due);
+        if (series_err != ESP_OK) {
+            err = series_err;
+        }
+    }
+    return err;
+}
+
+// storage writer, the only task that touches the file system on behalf of the poller
+static void log_task(void *arg)
+{
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, LOG_FLUSH_INTERVAL_TICS);
+        xSemaphoreTake(log_lock, portMAX_DELAY);
+        // staged data is kept on failure, it is retried with the next batch
+        log_drain(false);
+        xSemaphoreGive(log_lock);
+    }
+}
+
+void data_log_init(void)
+{
+    if (log_lock) {
+        return;
+    }
+    log_lock = xSemaphoreCreateMutexStatic(&log_lock_buf);
+    esp_err_t err = nvs_open(LOG_NVS_NAMESPACE, NVS_READWRITE, &log_nvs);
+    if (err != ESP_OK) {
+        // the log still works, every mount scans the directory
+        ESP_LOGW(TAG, "failed to open nvs namespace %s: %s", LOG_NVS_NAMESPACE, esp_err_to_name(err));
+        log_nvs = 0;
+    }
+    sample_ring_init(&log_queue, log_queue_slots, CONFIG_DATA_LOG_QUEUE_LEN);
+    if (log_hold_init(CONFIG_DATA_LOG_HOLD_BLOCKS) != ESP_OK) {
+        ESP_LOGW(TAG, "no hold store, samples are dropped while the volume is exported");
+    }
+    xTaskCreate(&log_task, "log_task", LOG_TASK_STACK_SIZE, NULL, LOG_TASK_PRIO, &log_task_handle);
+}
+
+// Called from the poller only, never touches the file system.
+esp_err_t data_log_append(uint16_t cid, uint32_t raw, uint8_t quality)
+{
+    data_log_sample_t sample = {
+        .time_us = esp_timer_get_time(),
+        .wall_s = log_wall_clock(),
+        .raw = raw,
+        .cid = cid,
+        .quality = quality,
+    };
+    while (!sample_ring_push(&log_queue, &sample, LOG_QUEUE_OVERWRITE)) {
+        // block policy: wait for the storage task to catch up
+        xTaskNotifyGive(log_task_handle);
+        vTaskDelay(1);
+    }
+    xTaskNotifyGive(log_task_handle);
+    return ESP_OK;
+}
+
+esp_err_t data_log_flush(void)
+{
+    xSemaphoreTake(log_lock, portMAX_DELAY);
+    esp_err_t err = log_drain(true);
+    xSemaphoreGive(log_lock);
+    return err;
+}
+
+esp_err_t data_log_release(void)
+{
+    xSemaphoreTake(log_lock, portMAX_DELAY);
+    esp_err_t err = log_drain(true);
+    // nothing is written to the volume from here on, new blocks go to the hold store
+    log_mounted = false;
+    log_export_close();
+    xSemaphoreGive(log_lock);
+    return err;
+}
+
+void data_log_mount_changed(bool mounted)
+{
+    xSemaphoreTake(log_lock, portMAX_DELAY);
+    log_mounted = mounted;
+    log_export_close();
+    if (mounted) {
+        log_mount_time = esp_timer_get_time();
+        for (size_t i = 0; i < LOG_SERIES_COUNT; i++) {
+            log_open(log_series[i]);
+        }
+        if (log_hold_count()) {
+            ESP_LOGI(TAG, "replaying %u held blocks", (unsigned)log_hold_count());
+            xTaskNotifyGive(log_task_handle);
+        }
+    } else {
+        for (size_t i = 0; i < LOG_SERIES_COUNT; i++) {
+            log_seal_partial(log_series[i]);
+        }
+    }
+    xSemaphoreGive(log_lock);
+}
+
+void data_log_get_stats(data_log_stats_t *stats)
+{
+    xSemaphoreTake(log_lock, portMAX_DELAY);
+    *stats = log_stats;
+    stats->queue_hwm = atomic_load(&log_queue.hwm);
+    stats->queue_dropped = atomic_load(&log_queue.dropped);
+    xSemaphoreGive(log_lock);
+}
+
+// List the segment files of all series from the segment index, oldest first within a series.
+size_t data_log_list_files(data_log_file_t *files, size_t max)
+{
+    size_t n = 0;
+    xSemaphoreTake(log_lock, portMAX_DELAY);
+    for (size_t i = 0; log_mounted && i < LOG_SERIES_COUNT; i++) {
+        const log_series_t *series = log_series[i];
+        for (uint32_t index = series->file_min; index <= series->file_max && n < max; index++) {
+            char filename[AS_FILE_NAME_MAX];
+            struct stat st;
+            log_file_name(series, filename, index);
+            if (stat(filename, &st) != 0) {
+                continue;
+            }
+            snprintf(files[n].name, sizeof(files[n].name), "%s%" PRIu32 ".bin", series->prefix, index);
+            files[n].size = st.st_size;
+            files[n].mtime = st.st_mtime;
+            n++;
+        }
+    }
+    xSemaphoreGive(log_lock);
+    return n;
+}
+
+// Read part of a log file for the usb export. Serialized with the storage task so that retention
+// can not delete the file while it is read; the file is kept open for the next call. Bytes past
+// the end of the file read as zero.
+esp_err_t data_log_read_file(const char *name, uint32_t offset, void *buf, size_t size)
+{
+    esp_err_t err = ESP_OK;
+    size_t got = 0;
+    xSemaphoreTake(log_lock, portMAX_DELAY);
+    if (!log_mounted) {
+        err = ESP_ERR_INVALID_STATE;
+    } else {
+        if (!export_fd || strcmp(export_name + sizeof(DATA_LOG_BASE_PATH), name)) {
+            log_export_close();
+            snprintf(export_name, sizeof(export_name), DATA_LOG_BASE_PATH "/%s", name);
+            export_fd = fopen(export_name, "rb");
+            if (export_fd) {
+                setvbuf(export_fd, NULL, _IONBF, 0);
+            }
+        }
+        if (!export_fd) {
+            err = ESP_ERR_NOT_FOUND;
+        } else if (fseek(export_fd, offset, SEEK_SET) == 0) {
+            got = fread(buf, 1, size, export_fd);
+        }
+    }
+    xSemaphoreGive(log_lock);
+    memset((uint8_t *)buf + got, 0, size - got);
+    return err;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+#include "esp_err.h"
+
+#define DATA_LOG_BASE_PATH "/data" // base path the log partition is mounted to
+
+typedef enum {
+    DATA_LOG_QUALITY_GOOD = 0,          // value read successfully
+    DATA_LOG_QUALITY_READ_ERROR = 1,    // slave did not answer, value is not valid
+} data_log_quality_t;
+
+typedef struct {
+    int64_t time_us;    // time since boot the sample was taken at
+    uint32_t wall_s;    // unix time the sample was taken at, 0 if the clock was not set
+    uint32_t raw;       // raw register value
+    uint16_t cid;       // characteristic the sample belongs to
+    uint8_t quality;    // data_log_quality_t
+} data_log_sample_t;
+
+typedef struct {
+    uint32_t samples;   // samples accepted into the staging buffer
+    uint32_t blocks;    // log blocks opened
+    uint32_t dropped;   // samples and rollups discarded because a staging buffer was full
+    uint32_t rollups;   // minute and hour aggregates written
+    uint32_t commits;   // batches written to the file system
+    uint32_t bytes;     // bytes written to the file system
+    uint32_t queue_hwm;     // maximum number of samples waiting for the storage task
+    uint32_t queue_dropped; // samples lost to queue overflow
+    int64_t resume_us;      // time from the last mount to the first write after it
+    uint32_t held;          // samples kept in the hold store while the volume was exported over usb
+    uint32_t replayed;      // held samples written to the log after the volume came back
+    uint32_t hold_dropped;  // held samples lost because the hold store was full
+    uint32_t spilled;       // blocks moved from RAM to the spill partition
+} data_log_stats_t;
+
+typedef struct {
+    char name[13];      // 8.3 file name in DATA_LOG_BASE_PATH
+    uint32_t size;      // bytes
+    time_t mtime;       // time of the last modification
+} data_log_file_t;
+
+void data_log_init(void);
+esp_err_t data_log_append(uint16_t cid, uint32_t raw, uint8_t quality);
+esp_err_t data_log_flush(void);
+esp_err_t data_log_release(void);
+void data_log_mount_changed(bool mounted);
+void data_log_get_stats(data_log_stats_t *stats);
+size_t data_log_list_files(data_log_file_t *files, size_t max);
+esp_err_t data_log_read_file(const char *name, uint32_t offset, void *buf, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
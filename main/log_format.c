@@ -0,0 +1,143 @@
+#include <stddef.h>
+#include <string.h>
+#include "esp_rom_crc.h"
+#include "log_format.h"
+
+#define LOG_VARINT_MAX 5 // bytes of a 32 bit varint
+#define LOG_RECORD_ENCODED_MAX (4 * LOG_VARINT_MAX)
+#define LOG_RECORD_ENCODED_MIN 4
+
+void log_segment_header_init(log_segment_header_t *header, uint32_t segment, uint32_t created_s, uint16_t record_size)
+{
+    memset(header, 0, sizeof(*header));
+    header->magic = LOG_SEGMENT_MAGIC;
+    header->version = LOG_FORMAT_VERSION;
+    header->block_size = LOG_BLOCK_SIZE;
+    header->record_size = record_size;
+    header->segment = segment;
+    header->created_s = created_s;
+    header->crc = esp_rom_crc32_le(0, (const uint8_t *)header, offsetof(log_segment_header_t, crc));
+}
+
+static inline uint32_t log_zigzag(uint32_t v)
+{
+    return (v << 1) ^ (uint32_t)((int32_t)v >> 31);
+}
+
+static inline uint8_t *log_put_varint(uint8_t *p, uint32_t v)
+{
+    while (v >= 0x80) {
+        *p++ = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    *p++ = (uint8_t)v;
+    return p;
+}
+
+void log_block_init(log_block_t *block, log_encoder_t *enc, uint32_t seq, uint8_t flags)
+{
+    memset(block, 0, sizeof(*block));
+    block->header.magic = LOG_BLOCK_MAGIC;
+    block->header.seq = seq;
+    block->header.flags = flags & (LOG_BLOCK_FLAG_DELTA | LOG_BLOCK_FLAG_XOR | LOG_BLOCK_FLAG_ROLLUP);
+    memset(enc, 0, sizeof(*enc));
+    for (int i = 0; i < LOG_CODEC_CID_SLOTS; i++) {
+        enc->last[i].cid = UINT16_MAX;
+    }
+}
+
+bool log_block_full(const log_block_t *block)
+{
+    return block->header.flags & LOG_BLOCK_FLAG_FULL;
+}
+
+static bool log_block_add_record(log_block_t *block, const data_log_sample_t *sample)
+{
+    log_record_t *record = &block->records[block->header.count++];
+    record->mono_ms = (uint32_t)(sample->time_us / 1000);
+    record->wall_s = sample->wall_s;
+    record->raw = sample->raw;
+    record->cid = sample->cid;
+    record->quality = sample->quality;
+    record->reserved = 0;
+    if (block->header.count == LOG_BLOCK_RECORDS) {
+        block->header.flags |= LOG_BLOCK_FLAG_FULL;
+    }
+    return true;
+}
+
+static bool log_block_add_encoded(log_block_t *block, log_encoder_t *enc, const data_log_sample_t *sample)
+{
+    uint8_t buf[LOG_RECORD_ENCODED_MAX];
+    uint8_t *p = buf;
+    uint32_t mono_ms = (uint32_t)(sample->time_us / 1000);
+    uint32_t mono_delta = mono_ms - enc->mono_ms;
+    uint32_t wall_offset = sample->wall_s - mono_ms / 1000;
+    uint32_t slot = sample->cid % LOG_CODEC_CID_SLOTS;
+    uint32_t prev = (enc->last[slot].cid == sample->cid) ? enc->last[slot].raw : 0;
+
+    p = log_put_varint(p, log_zigzag(mono_delta - enc->mono_delta));
+    p = log_put_varint(p, log_zigzag(wall_offset - enc->wall_offset));
+    p = log_put_varint(p, ((uint32_t)sample->cid << 2) | (sample->quality & 0x03));
+    if (block->header.flags & LOG_BLOCK_FLAG_XOR) {
+        p = log_put_varint(p, sample->raw ^ prev);
+    } else {
+        p = log_put_varint(p, log_zigzag(sample->raw - prev));
+    }
+
+    size_t len = p - buf;
+    if (enc->len + len > LOG_BLOCK_PAYLOAD || block->header.count == UINT8_MAX) {
+        block->header.flags |= LOG_BLOCK_FLAG_FULL;
+        return false;
+    }
+    memcpy(block->payload + enc->len, buf, len);
+    enc->len += len;
+    enc->mono_ms = mono_ms;
+    enc->mono_delta = mono_delta;
+    enc->wall_offset = wall_offset;
+    enc->last[slot].cid = sample->cid;
+    enc->last[slot].raw = sample->raw;
+    block->header.count++;
+    if (LOG_BLOCK_PAYLOAD - enc->len < LOG_RECORD_ENCODED_MIN) {
+        block->header.flags |= LOG_BLOCK_FLAG_FULL;
+    }
+    return true;
+}
+
+// Returns false if the block is full, the sample then has to go into a new block.
+bool log_block_add(log_block_t *block, log_encoder_t *enc, const data_log_sample_t *sample)
+{
+    if (log_block_full(block)) {
+        return false;
+    }
+    if (block->header.flags & (LOG_BLOCK_FLAG_DELTA | LOG_BLOCK_FLAG_XOR)) {
+        return log_block_add_encoded(block, enc, sample);
+    }
+    return log_block_add_record(block, sample);
+}
+
+bool log_block_add_rollup(log_block_t *block, const log_rollup_t *rollup)
+{
+    if (log_block_full(block)) {
+        return false;
+    }
+    block->rollups[block->header.count++] = *rollup;
+    if (block->header.count == LOG_BLOCK_ROLLUPS) {
+        block->header.flags |= LOG_BLOCK_FLAG_FULL;
+    }
+    return true;
+}
+
+void log_block_seal(log_block_t *block)
+{
+    block->crc = esp_rom_crc32_le(0, (const uint8_t *)block, offsetof(log_block_t, crc));
+}
+
+bool log_block_valid(const log_block_t *block)
+{
+    bool encoded = block->header.flags & (LOG_BLOCK_FLAG_DELTA | LOG_BLOCK_FLAG_XOR);
+    uint8_t max = (block->header.flags & LOG_BLOCK_FLAG_ROLLUP) ? LOG_BLOCK_ROLLUPS : LOG_BLOCK_RECORDS;
+    return (block->header.magic == LOG_BLOCK_MAGIC)
+           && (encoded || block->header.count <= max)
+           && (block->crc == esp_rom_crc32_le(0, (const uint8_t *)block, offsetof(log_block_t, crc)));
+}
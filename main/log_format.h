@@ -0,0 +1,119 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+#include <stdbool.h>
+#include <stdint.h>
+#include "data_log.h"
+
+// On-flash layout of a log segment (all fields little endian):
+//   block 0      log_segment_header_t, padded with zeros to LOG_BLOCK_SIZE
+//   block 1..n   log_block_t, each one covered by its own CRC32
+// A partially filled block may be rewritten in place until it is full.
+//
+// A block either holds fixed-width log_record_t entries, or, if LOG_BLOCK_FLAG_DELTA or
+// LOG_BLOCK_FLAG_XOR is set, a compressed stream of count records. Every compressed block
+// is self-contained, the encoder state starts from zero for each block. Per record:
+//   varint  zigzag(delta-of-delta of mono_ms)
+//   varint  zigzag(delta of (wall_s - mono_ms / 1000))
+//   varint  cid << 2 | quality
+//   varint  zigzag(raw - prev) for DELTA, raw ^ prev for XOR, where prev is the last raw value
+//           of the same cid in the block (LOG_CODEC_CID_SLOTS entry table indexed by cid, 0 if
+//           the slot holds another cid)
+//
+// Rollup segments (LOG_BLOCK_FLAG_ROLLUP, record_size 24 in the segment header) hold
+// log_rollup_t entries, the min/max/mean of one characteristic over a time window.
+#define LOG_FORMAT_VERSION 2
+#define LOG_SEGMENT_MAGIC 0x474c4d56 // "VMLG"
+#define LOG_BLOCK_MAGIC 0xb10c
+#define LOG_BLOCK_SIZE 512
+#define LOG_BLOCK_RECORDS 31
+#define LOG_BLOCK_PAYLOAD (LOG_BLOCK_RECORDS * sizeof(log_record_t))
+#define LOG_BLOCK_ROLLUPS 20
+#define LOG_CODEC_CID_SLOTS 16
+
+#define LOG_BLOCK_FLAG_DELTA 0x01   // compressed, values delta encoded
+#define LOG_BLOCK_FLAG_XOR 0x02     // compressed, values xor encoded
+#define LOG_BLOCK_FLAG_ROLLUP 0x04  // log_rollup_t entries
+#define LOG_BLOCK_FLAG_FULL 0x80    // no more records are added to the block
+
+typedef struct __attribute__((packed)) {
+    uint32_t mono_ms;           // milliseconds since boot
+    uint32_t wall_s;            // unix time, 0 if the clock was not set
+    uint32_t raw;               // raw register value
+    uint16_t cid;               // characteristic the value belongs to
+    uint8_t quality;            // data_log_quality_t
+    uint8_t reserved;
+} log_record_t;
+
+#define LOG_ROLLUP_WALL_CLOCK 0x01  // start_s is unix time, otherwise seconds since boot
+
+typedef struct __attribute__((packed)) {
+    uint32_t start_s;           // start of the window
+    uint32_t min;               // smallest raw value of the good samples
+    uint32_t max;               // largest raw value of the good samples
+    uint32_t mean;              // mean raw value of the good samples, rounded down
+    uint16_t cid;               // characteristic the window belongs to
+    uint16_t count;             // good samples in the window
+    uint16_t errors;            // samples with a bad quality in the window
+    uint8_t flags;              // LOG_ROLLUP_*
+    uint8_t reserved;
+} log_rollup_t;
+
+typedef struct __attribute__((packed)) {
+    uint16_t magic;             // LOG_BLOCK_MAGIC
+    uint8_t count;              // number of valid records
+    uint8_t flags;              // LOG_BLOCK_FLAG_*
+    uint32_t seq;               // block sequence number, increases across segments
+    uint32_t boot;              // reserved, 0
+} log_block_header_t;
+
+typedef struct __attribute__((packed)) {
+    log_block_header_t header;
+    union {
+        log_record_t records[LOG_BLOCK_RECORDS];
+        log_rollup_t rollups[LOG_BLOCK_ROLLUPS];
+        uint8_t payload[LOG_BLOCK_PAYLOAD];
+    };
+    uint32_t crc;               // CRC32 of all preceding bytes of the block
+} log_block_t;
+
+typedef struct __attribute__((packed)) {
+    uint32_t magic;             // LOG_SEGMENT_MAGIC
+    uint16_t version;           // LOG_FORMAT_VERSION
+    uint16_t block_size;        // LOG_BLOCK_SIZE
+    uint16_t record_size;       // sizeof(log_record_t), sizeof(log_rollup_t) for rollup segments
+    uint16_t reserved;
+    uint32_t segment;           // segment number, matches the file name
+    uint32_t created_s;         // unix time the segment was created, 0 if unknown
+    uint32_t crc;               // CRC32 of all preceding bytes of the header
+} log_segment_header_t;
+
+// encoder state of the block that is being filled, kept in RAM only
+typedef struct {
+    uint16_t len;               // payload bytes used
+    uint32_t mono_ms;           // previous record
+    uint32_t mono_delta;
+    uint32_t wall_offset;
+    struct {
+        uint16_t cid;
+        uint32_t raw;
+    } last[LOG_CODEC_CID_SLOTS];
+} log_encoder_t;
+
+_Static_assert(sizeof(log_record_t) == 16, "unexpected record size");
+_Static_assert(sizeof(log_rollup_t) == 24, "unexpected rollup size");
+_Static_assert(sizeof(log_block_t) == LOG_BLOCK_SIZE, "unexpected block size");
+
+void log_segment_header_init(log_segment_header_t *header, uint32_t segment, uint32_t created_s, uint16_t record_size);
+void log_block_init(log_block_t *block, log_encoder_t *enc, uint32_t seq, uint8_t flags);
+bool log_block_add(log_block_t *block, log_encoder_t *enc, const data_log_sample_t *sample);
+bool log_block_add_rollup(log_block_t *block, const log_rollup_t *rollup);
+bool log_block_full(const log_block_t *block);
+void log_block_seal(log_block_t *block);
+bool log_block_valid(const log_block_t *block);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,210 @@
+#include <stdlib.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_partition.h"
+#include "sdkconfig.h"
+#include "log_hold.h"
+
+static const char *TAG = "hold";
+
+#define HOLD_SECTOR_SIZE 4096 // flash erase unit of the spill partition
+#define HOLD_SECTOR_BLOCKS (HOLD_SECTOR_SIZE / LOG_BLOCK_SIZE)
+
+typedef struct {
+    size_t cap;
+    size_t tail;                // oldest entry
+    size_t count;
+    uint8_t *tags;
+} hold_fifo_t;
+
+static hold_fifo_t ram;
+static log_block_t *ram_blocks = NULL;
+
+#if CONFIG_DATA_LOG_SPILL
+// The spill partition is used as a ring of block slots. A sector is erased when the head
+// enters it, one sector is always kept free so that this never destroys held blocks.
+// The slot index lives in RAM only, spilled blocks do not survive a reboot.
+static hold_fifo_t spill;
+static const esp_partition_t *spill_part = NULL;
+static size_t spill_slots = 0;
+static size_t spill_total = 0;
+#endif
+
+static bool fifo_init(hold_fifo_t *fifo, size_t cap)
+{
+    fifo->cap = cap;
+    fifo->tail = 0;
+    fifo->count = 0;
+    fifo->tags = calloc(cap ? cap : 1, 1);
+    return fifo->tags != NULL;
+}
+
+esp_err_t log_hold_init(size_t ram_blocks_max)
+{
+    if (!fifo_init(&ram, ram_blocks_max)) {
+        return ESP_ERR_NO_MEM;
+    }
+    if (ram_blocks_max) {
+        ram_blocks = malloc(ram_blocks_max * sizeof(log_block_t));
+        if (!ram_blocks) {
+            ESP_LOGE(TAG, "no memory to hold %u blocks.", (unsigned)ram_blocks_max);
+            ram.cap = 0;
+            return ESP_ERR_NO_MEM;
+        }
+    }
+#if CONFIG_DATA_LOG_SPILL
+    spill_part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY,
+                                          CONFIG_DATA_LOG_SPILL_PARTITION);
+    if (!spill_part || spill_part->size < 2 * HOLD_SECTOR_SIZE) {
+        ESP_LOGW(TAG, "spill partition %s not found, holding blocks in RAM only.", CONFIG_DATA_LOG_SPILL_PARTITION);
+        spill_part = NULL;
+        return ESP_OK;
+    }
+    spill_slots = (spill_part->size / HOLD_SECTOR_SIZE) * HOLD_SECTOR_BLOCKS;
+    if (!fifo_init(&spill, spill_slots)) {
+        spill_part = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+    spill.cap = spill_slots - HOLD_SECTOR_BLOCKS;
+    ESP_LOGI(TAG, "spilling up to %u blocks to partition %s.", spill.cap, spill_part->label);
+#endif
+    return ESP_OK;
+}
+
+#if CONFIG_DATA_LOG_SPILL
+static size_t spill_offset(size_t slot)
+{
+    return (slot % spill_slots) * LOG_BLOCK_SIZE;
+}
+
+// Append a block to the spill ring. The head never enters the sector of the tail, so a full
+// ring can take one more block before the caller drops its oldest one.
+static bool spill_push(uint8_t tag, const log_block_t *block)
+{
+    size_t head = (spill.tail + spill.count) % spill_slots;
+    size_t offset = spill_offset(head);
+    esp_err_t err = ESP_OK;
+    if (offset % HOLD_SECTOR_SIZE == 0) {
+        err = esp_partition_erase_range(spill_part, offset, HOLD_SECTOR_SIZE);
+    }
+    if (err == ESP_OK) {
+        err = esp_partition_write(spill_part, offset, block, LOG_BLOCK_SIZE);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "failed to spill block: %s", esp_err_to_name(err));
+        return false;
+    }
+    spill.tags[head] = tag;
+    spill.count++;
+    spill_total++;
+    return true;
+}
+#endif
+
+// Returns true if the oldest block had to be dropped to make room, its tag and sample count
+// are returned so that the caller can account for it. At most one block is dropped per push.
+bool log_hold_push(uint8_t tag, const log_block_t *block, uint8_t *dropped_tag, uint8_t *dropped_count)
+{
+    bool dropped = false;
+    if (ram.cap == 0) {
+        *dropped_tag = tag;
+        *dropped_count = block->header.count;
+        return true;
+    }
+    if (ram.count == ram.cap) {
+        const log_block_t *oldest = &ram_blocks[ram.tail];
+        uint8_t oldest_tag = ram.tags[ram.tail];
+        bool kept = false;
+#if CONFIG_DATA_LOG_SPILL
+        if (spill_part) {
+            bool spill_full = (spill.count == spill.cap);
+            kept = spill_push(oldest_tag, oldest);
+            if (kept && spill_full) {
+                // the spill ring is full as well, give up its oldest block
+                *dropped_tag = spill.tags[spill.tail];
+                *dropped_count = 0;
+                log_block_header_t header;
+                if (esp_partition_read(spill_part, spill_offset(spill.tail), &header, sizeof(header)) == ESP_OK) {
+                    *dropped_count = header.count;
+                }
+                spill.tail = (spill.tail + 1) % spill_slots;
+                spill.count--;
+                dropped = true;
+            }
+        }
+#endif
+        if (!kept) {
+            *dropped_tag = oldest_tag;
+            *dropped_count = oldest->header.count;
+            dropped = true;
+        }
+        ram.tail = (ram.tail + 1) % ram.cap;
+        ram.count--;
+    }
+    size_t head = (ram.tail + ram.count) % ram.cap;
+    ram_blocks[head] = *block;
+    ram.tags[head] = tag;
+    ram.count++;
+    return dropped;
+}
+
+size_t log_hold_count(void)
+{
+#if CONFIG_DATA_LOG_SPILL
+    return spill.count + ram.count;
+#else
+    return ram.count;
+#endif
+}
+
+// Copy the block at index (0 is the oldest) and return its tag, -1 if there is none.
+int log_hold_peek(size_t index, log_block_t *block)
+{
+#if CONFIG_DATA_LOG_SPILL
+    if (index < spill.count) {
+        size_t slot = (spill.tail + index) % spill_slots;
+        if (esp_partition_read(spill_part, spill_offset(slot), block, LOG_BLOCK_SIZE) != ESP_OK) {
+            // keep the tag, the block fails the CRC check on export
+            memset(block, 0, sizeof(*block));
+        }
+        return spill.tags[slot];
+    }
+    index -= spill.count;
+#endif
+    if (index >= ram.count) {
+        return -1;
+    }
+    size_t slot = (ram.tail + index) % ram.cap;
+    *block = ram_blocks[slot];
+    return ram.tags[slot];
+}
+
+// remove the oldest count blocks
+void log_hold_pop(size_t count)
+{
+#if CONFIG_DATA_LOG_SPILL
+    size_t n = (count < spill.count) ? count : spill.count;
+    if (n) {
+        spill.tail = (spill.tail + n) % spill_slots;
+        spill.count -= n;
+        count -= n;
+    }
+#endif
+    if (count > ram.count) {
+        count = ram.count;
+    }
+    if (count) {
+        ram.tail = (ram.tail + count) % ram.cap;
+        ram.count -= count;
+    }
+}
+
+// total number of blocks moved to the spill partition
+size_t log_hold_spilled(void)
+{
+#if CONFIG_DATA_LOG_SPILL
+    return spill_total;
+#else
+    return 0;
+#endif
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "log_format.h"
+
+// FIFO of sealed log blocks that can not be written while the volume is owned by the USB host.
+// Blocks are kept in RAM; if a spill partition is configured, the oldest blocks move on to it
+// when RAM is full. Every block carries a tag (the index of its segment series). When the
+// store is full the oldest block is dropped.
+esp_err_t log_hold_init(size_t ram_blocks);
+bool log_hold_push(uint8_t tag, const log_block_t *block, uint8_t *dropped_tag, uint8_t *dropped_count);
+size_t log_hold_count(void);
+int log_hold_peek(size_t index, log_block_t *block);
+void log_hold_pop(size_t count);
+size_t log_hold_spilled(void);
+
+#ifdef __cplusplus
+}
+#endif
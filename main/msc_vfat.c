@@ -0,0 +1,444 @@
+#include <ctype.h>
+#include <inttypes.h>
+#include <string.h>
+#include <time.h>
+#include <sys/param.h>
+#include "esp_log.h"
+#include "esp_partition.h"
+#include "esp_rom_crc.h"
+#include "esp_timer.h"
+#include "sdkconfig.h"
+#include "tusb.h"
+#include "data_log.h"
+#include "msc_vfat.h"
+
+static const char *TAG = "vfat";
+
+#define VFAT_SECTOR_SIZE 512
+#define VFAT_CLUSTER_SECTORS 8      // 4 KiB clusters
+#define VFAT_RESERVED_SECTORS 1     // boot sector
+#define VFAT_FAT_COPIES 2
+#define VFAT_ROOT_ENTRIES 512
+#define VFAT_ROOT_SECTORS (VFAT_ROOT_ENTRIES * 32 / VFAT_SECTOR_SIZE)
+#define VFAT_FAT12_MAX_CLUSTERS 4084
+#define VFAT_FAT16_MAX_CLUSTERS 65524
+#define VFAT_IDLE_US (2 * 1000 * 1000)  // the view is not rebuilt within this time after a read
+#define VFAT_REFRESH_US ((int64_t)CONFIG_DATA_LOG_MSC_REFRESH_S * 1000 * 1000)
+#define VFAT_LABEL "VM485 LOG  "
+
+#if CONFIG_DATA_LOG_ROLLUP
+#define VFAT_LOG_FILES (CONFIG_DATA_LOG_RAW_FILES + CONFIG_DATA_LOG_MINUTE_FILES + CONFIG_DATA_LOG_HOUR_FILES)
+#else
+#define VFAT_LOG_FILES (CONFIG_DATA_LOG_RAW_FILES)
+#endif
+#define VFAT_MAX_FILES MIN(VFAT_LOG_FILES, VFAT_ROOT_ENTRIES - 1) // the first entry is the volume label
+
+#define SCSI_CODE_ASC_MEDIUM_NOT_PRESENT 0x3A
+#define SCSI_CODE_ASC_MEDIUM_CHANGED 0x28
+#define SCSI_CODE_ASC_WRITE_PROTECTED 0x27
+#define SCSI_CODE_ASC_INVALID_COMMAND_OPERATION_CODE 0x20
+#define SCSI_CODE_ASCQ 0x00
+
+typedef struct {
+    char name[11];          // 8.3 directory name, space padded
+    uint16_t first_cluster; // 0 for an empty file
+    uint16_t clusters;
+    uint32_t size;          // file size when the view was built
+    uint16_t date;
+    uint16_t time;
+} vfat_file_t;
+
+// Layout of the generated volume. All callbacks run in the tinyusb task, no locking is needed.
+typedef struct {
+    uint32_t sectors;           // total sectors of the volume
+    uint32_t clusters;          // data clusters
+    uint32_t fat_sectors;       // sectors of one FAT copy
+    uint32_t root_start;        // first sector of the root directory
+    uint32_t data_start;        // first sector of cluster 2
+    bool fat16;
+    vfat_file_t files[VFAT_MAX_FILES];
+    size_t file_count;
+    uint32_t signature;         // CRC of the listing the view was built from
+    int64_t built_us;
+    int64_t last_read_us;
+    bool changed;               // report a medium change with the next test unit ready
+    bool ejected;
+} vfat_t;
+
+static vfat_t vfat;
+static data_log_file_t listing[VFAT_MAX_FILES];
+static uint8_t bounce[VFAT_SECTOR_SIZE];
+
+static void vfat_layout(uint32_t sectors)
+{
+    vfat.sectors = sectors;
+    vfat.fat_sectors = 1;
+    // the FAT size depends on the cluster count and vice versa, this settles in a few rounds
+    for (int i = 0; i < 4; i++) {
+        uint32_t meta = VFAT_RESERVED_SECTORS + VFAT_FAT_COPIES * vfat.fat_sectors + VFAT_ROOT_SECTORS;
+        vfat.clusters = MIN((sectors - meta) / VFAT_CLUSTER_SECTORS, VFAT_FAT16_MAX_CLUSTERS);
+        vfat.fat16 = vfat.clusters > VFAT_FAT12_MAX_CLUSTERS;
+        uint32_t fat_bytes = vfat.fat16 ? (vfat.clusters + 2) * 2 : ((vfat.clusters + 2) * 3 + 1) / 2;
+        vfat.fat_sectors = (fat_bytes + VFAT_SECTOR_SIZE - 1) / VFAT_SECTOR_SIZE;
+    }
+    vfat.root_start = VFAT_RESERVED_SECTORS + VFAT_FAT_COPIES * vfat.fat_sectors;
+    vfat.data_start = vfat.root_start + VFAT_ROOT_SECTORS;
+    // no partial cluster at the end, and no more clusters than FAT16 can address
+    vfat.sectors = vfat.data_start + vfat.clusters * VFAT_CLUSTER_SECTORS;
+}
+
+// Convert a file name like "m12.bin" to its directory form "M12     BIN".
+static void vfat_short_name(char out[11], const char *name)
+{
+    memset(out, ' ', 11);
+    const char *dot = strchr(name, '.');
+    size_t base = dot ? (size_t)(dot - name) : strlen(name);
+    for (size_t i = 0; i < MIN(base, 8); i++) {
+        out[i] = toupper((unsigned char)name[i]);
+    }
+    for (size_t i = 0; dot && i < 3 && dot[i + 1]; i++) {
+        out[8 + i] = toupper((unsigned char)dot[i + 1]);
+    }
+}
+
+static void vfat_timestamp(time_t t, uint16_t *date, uint16_t *time)
+{
+    struct tm tm;
+    localtime_r(&t, &tm);
+    if (tm.tm_year < 80) {
+        // no clock, FAT can not represent anything before 1980
+        tm = (struct tm) { .tm_year = 120, .tm_mday = 1 };
+    }
+    *date = ((tm.tm_year - 80) << 9) | ((tm.tm_mon + 1) << 5) | tm.tm_mday;
+    *time = (tm.tm_hour << 11) | (tm.tm_min << 5) | (tm.tm_sec / 2);
+}
+
+// Rebuild the view from the segment index. Returns true if the listing differs from the last one.
+static bool vfat_build(void)
+{
+    size_t count = data_log_list_files(listing, VFAT_MAX_FILES);
+    uint32_t signature = 0;
+    for (size_t i = 0; i < count; i++) {
+        signature = esp_rom_crc32_le(signature, (const uint8_t *)listing[i].name, strlen(listing[i].name));
+        signature = esp_rom_crc32_le(signature, (const uint8_t *)&listing[i].size, sizeof(listing[i].size));
+    }
+    vfat.built_us = esp_timer_get_time();
+    if (vfat.file_count == count && vfat.signature == signature) {
+        return false;
+    }
+    uint32_t next = 2;
+    vfat.file_count = 0;
+    for (size_t i = 0; i < count; i++) {
+        uint32_t clusters = (listing[i].size + VFAT_CLUSTER_SECTORS * VFAT_SECTOR_SIZE - 1)
+                            / (VFAT_CLUSTER_SECTORS * VFAT_SECTOR_SIZE);
+        if (next + clusters > vfat.clusters + 2) {
+            ESP_LOGW(TAG, "%s does not fit into the volume, %u files listed", listing[i].name, (unsigned)vfat.file_count);
+            break;
+        }
+        vfat_file_t *file = &vfat.files[vfat.file_count++];
+        vfat_short_name(file->name, listing[i].name);
+        file->first_cluster = next;
+        file->clusters = clusters;
+        file->size = listing[i].size;
+        vfat_timestamp(listing[i].mtime, &file->date, &file->time);
+        next += clusters;
+    }
+    vfat.signature = signature;
+    ESP_LOGI(TAG, "view rebuilt, %u files in %" PRIu32 " clusters", (unsigned)vfat.file_count, next - 2);
+    return true;
+}
+
+// File that owns a cluster, files are allocated contiguously in ascending order.
+static const vfat_file_t *vfat_find(uint32_t cluster)
+{
+    size_t lo = 0;
+    size_t hi = vfat.file_count;
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (vfat.files[mid].first_cluster <= cluster) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    if (lo == 0) {
+        return NULL;
+    }
+    const vfat_file_t *file = &vfat.files[lo - 1];
+    return (cluster < file->first_cluster + file->clusters) ? file : NULL;
+}
+
+static uint16_t vfat_fat_entry(uint32_t cluster)
+{
+    uint16_t eoc = vfat.fat16 ? 0xFFFF : 0x0FFF;
+    if (cluster == 0) {
+        return eoc & 0xFFF8; // media descriptor
+    }
+    if (cluster == 1) {
+        return eoc;
+    }
+    const vfat_file_t *file = vfat_find(cluster);
+    if (!file) {
+        return 0;
+    }
+    return (cluster + 1 == file->first_cluster + file->clusters) ? eoc : cluster + 1;
+}
+
+static void vfat_boot_sector(uint8_t *buf)
+{
+    static const uint8_t jump[] = { 0xEB, 0x3C, 0x90 };
+    memcpy(buf, jump, sizeof(jump));
+    memcpy(buf + 3, "MSDOS5.0", 8);
+    buf[11] = VFAT_SECTOR_SIZE & 0xFF;
+    buf[12] = VFAT_SECTOR_SIZE >> 8;
+    buf[13] = VFAT_CLUSTER_SECTORS;
+    buf[14] = VFAT_RESERVED_SECTORS;
+    buf[16] = VFAT_FAT_COPIES;
+    buf[17] = VFAT_ROOT_ENTRIES & 0xFF;
+    buf[18] = VFAT_ROOT_ENTRIES >> 8;
+    if (vfat.sectors < 0x10000) {
+        buf[19] = vfat.sectors & 0xFF;
+        buf[20] = vfat.sectors >> 8;
+    } else {
+        memcpy(buf + 32, &vfat.sectors, 4);
+    }
+    buf[21] = 0xF8; // fixed disk
+    buf[22] = vfat.fat_sectors & 0xFF;
+    buf[23] = vfat.fat_sectors >> 8;
+    buf[24] = 63;   // sectors per track
+    buf[26] = 255;  // heads
+    buf[36] = 0x80; // drive number
+    buf[38] = 0x29; // extended boot signature
+    memcpy(buf + 39, &vfat.signature, 4); // volume serial number
+    memcpy(buf + 43, VFAT_LABEL, 11);
+    memcpy(buf + 54, vfat.fat16 ? "FAT16   " : "FAT12   ", 8);
+    buf[510] = 0x55;
+    buf[511] = 0xAA;
+}
+
+static void vfat_fat_sector(uint32_t index, uint8_t *buf)
+{
+    if (vfat.fat16) {
+        uint32_t cluster = index * (VFAT_SECTOR_SIZE / 2);
+        for (size_t i = 0; i < VFAT_SECTOR_SIZE; i += 2, cluster++) {
+            uint16_t entry = (cluster < vfat.clusters + 2) ? vfat_fat_entry(cluster) : 0;
+            buf[i] = entry & 0xFF;
+            buf[i + 1] = entry >> 8;
+        }
+        return;
+    }
+    // FAT12 packs two entries into three bytes, pairs may straddle sector boundaries
+    uint32_t offset = index * VFAT_SECTOR_SIZE;
+    for (size_t i = 0; i < VFAT_SECTOR_SIZE; i++, offset++) {
+        uint32_t cluster = offset / 3 * 2;
+        uint16_t a = (cluster < vfat.clusters + 2) ? vfat_fat_entry(cluster) : 0;
+        uint16_t b = (cluster + 1 < vfat.clusters + 2) ? vfat_fat_entry(cluster + 1) : 0;
+        switch (offset % 3) {
+        case 0:
+            buf[i] = a & 0xFF;
+            break;
+        case 1:
+            buf[i] = (a >> 8) | ((b & 0x0F) << 4);
+            break;
+        default:
+            buf[i] = b >> 4;
+            break;
+        }
+    }
+}
+
+static void vfat_root_sector(uint32_t index, uint8_t *buf)
+{
+    for (size_t i = 0; i < VFAT_SECTOR_SIZE / 32; i++) {
+        uint8_t *entry = buf + i * 32;
+        size_t slot = index * (VFAT_SECTOR_SIZE / 32) + i;
+        if (slot == 0) {
+            memcpy(entry, VFAT_LABEL, 11);
+            entry[11] = 0x08; // volume label
+            continue;
+        }
+        if (slot > vfat.file_count) {
+            break;
+        }
+        const vfat_file_t *file = &vfat.files[slot - 1];
+        memcpy(entry, file->name, 11);
+        entry[11] = 0x01; // read only
+        memcpy(entry + 14, &file->time, 2);  // creation
+        memcpy(entry + 16, &file->date, 2);
+        memcpy(entry + 18, &file->date, 2);  // last access
+        memcpy(entry + 22, &file->time, 2);  // modification
+        memcpy(entry + 24, &file->date, 2);
+        uint16_t first = file->clusters ? file->first_cluster : 0;
+        memcpy(entry + 26, &first, 2);
+        memcpy(entry + 28, &file->size, 4);
+    }
+}
+
+// Fill up to count sectors starting at sector, returns the number of sectors filled (at least one).
+// Consecutive data sectors of one file are read in a single call.
+static uint32_t vfat_read(uint32_t sector, uint8_t *buf, uint32_t count)
+{
+    memset(buf, 0, VFAT_SECTOR_SIZE);
+    if (sector < VFAT_RESERVED_SECTORS) {
+        vfat_boot_sector(buf);
+        return 1;
+    }
+    if (sector < vfat.root_start) {
+        vfat_fat_sector((sector - VFAT_RESERVED_SECTORS) % vfat.fat_sectors, buf);
+        return 1;
+    }
+    if (sector < vfat.data_start) {
+        vfat_root_sector(sector - vfat.root_start, buf);
+        return 1;
+    }
+    const vfat_file_t *file = vfat_find((sector - vfat.data_start) / VFAT_CLUSTER_SECTORS + 2);
+    if (!file) {
+        return 1;
+    }
+    uint32_t first = vfat.data_start + (file->first_cluster - 2) * VFAT_CLUSTER_SECTORS;
+    uint32_t offset = (sector - first) * VFAT_SECTOR_SIZE;
+    uint32_t n = MIN(count, file->clusters * VFAT_CLUSTER_SECTORS - (sector - first));
+    // only the bytes the view was built with, the file may have grown since
+    uint32_t size = (offset < file->size) ? MIN(n * VFAT_SECTOR_SIZE, file->size - offset) : 0;
+    char name[13];
+    size_t len = 0;
+    for (size_t i = 0; i < 8 && file->name[i] != ' '; i++) {
+        name[len++] = tolower((unsigned char)file->name[i]);
+    }
+    name[len++] = '.';
+    for (size_t i = 8; i < 11 && file->name[i] != ' '; i++) {
+        name[len++] = tolower((unsigned char)file->name[i]);
+    }
+    name[len] = '\0';
+    if (size && data_log_read_file(name, offset, buf, size) != ESP_OK) {
+        // deleted by retention after the view was built
+        ESP_LOGD(TAG, "failed to read %s at %" PRIu32, name, offset);
+    }
+    memset(buf + size, 0, n * VFAT_SECTOR_SIZE - size);
+    return n;
+}
+
+esp_err_t msc_vfat_init(void)
+{
+    const esp_partition_t *part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_DATA_FAT, NULL);
+    if (part == NULL) {
+        ESP_LOGE(TAG, "failed to find fatfs partition. check the partition table.");
+        return ESP_ERR_NOT_FOUND;
+    }
+    // the log can never exceed the partition it is stored on
+    vfat_layout(part->size / VFAT_SECTOR_SIZE);
+    vfat_build();
+    ESP_LOGI(TAG, "%s view, %" PRIu32 " sectors, %" PRIu32 " clusters of %d bytes", vfat.fat16 ? "FAT16" : "FAT12",
+             vfat.sectors, vfat.clusters, VFAT_CLUSTER_SECTORS * VFAT_SECTOR_SIZE);
+    return ESP_OK;
+}
+
+/* TinyUSB MSC callbacks
+   ********************************************************************* */
+
+void tud_msc_inquiry_cb(uint8_t lun, uint8_t vendor_id[8], uint8_t product_id[16], uint8_t product_rev[4])
+{
+    (void) lun;
+    const char vid[] = "TinyUSB";
+    const char pid[] = "Log Export";
+    const char rev[] = "0.1";
+
+    memcpy(vendor_id, vid, strlen(vid));
+    memcpy(product_id, pid, strlen(pid));
+    memcpy(product_rev, rev, strlen(rev));
+}
+
+// Hosts poll this every second or two, it is used to refresh the view while the host is idle.
+bool tud_msc_test_unit_ready_cb(uint8_t lun)
+{
+    if (vfat.ejected) {
+        tud_msc_set_sense(lun, SCSI_SENSE_NOT_READY, SCSI_CODE_ASC_MEDIUM_NOT_PRESENT, SCSI_CODE_ASCQ);
+        return false;
+    }
+    int64_t now = esp_timer_get_time();
+    if (VFAT_REFRESH_US && now - vfat.built_us >= VFAT_REFRESH_US && now - vfat.last_read_us >= VFAT_IDLE_US) {
+        vfat.changed |= vfat_build();
+    }
+    if (vfat.changed) {
+        // makes the host drop its cached FAT and directory
+        vfat.changed = false;
+        tud_msc_set_sense(lun, SCSI_SENSE_UNIT_ATTENTION, SCSI_CODE_ASC_MEDIUM_CHANGED, SCSI_CODE_ASCQ);
+        return false;
+    }
+    return true;
+}
+
+void tud_msc_capacity_cb(uint8_t lun, uint32_t *block_count, uint16_t *block_size)
+{
+    (void) lun;
+    *block_count = vfat.sectors;
+    *block_size = VFAT_SECTOR_SIZE;
+}
+
+bool tud_msc_start_stop_cb(uint8_t lun, uint8_t power_condition, bool start, bool load_eject)
+{
+    (void) lun;
+    (void) power_condition;
+
+    if (load_eject) {
+        vfat.ejected = !start;
+        if (start) {
+            vfat.changed |= vfat_build();
+        }
+    }
+    return true;
+}
+
+bool tud_msc_is_writable_cb(uint8_t lun)
+{
+    (void) lun;
+    return false;
+}
+
+int32_t tud_msc_read10_cb(uint8_t lun, uint32_t lba, uint32_t offset, void *buffer, uint32_t bufsize)
+{
+    (void) lun;
+    uint8_t *out = buffer;
+    uint32_t done = 0;
+    while (done < bufsize) {
+        uint32_t sector = lba + (offset + done) / VFAT_SECTOR_SIZE;
+        uint32_t skip = (offset + done) % VFAT_SECTOR_SIZE;
+        if (skip == 0 && bufsize - done >= VFAT_SECTOR_SIZE) {
+            done += vfat_read(sector, out + done, (bufsize - done) / VFAT_SECTOR_SIZE) * VFAT_SECTOR_SIZE;
+        } else {
+            uint32_t n = MIN(VFAT_SECTOR_SIZE - skip, bufsize - done);
+            vfat_read(sector, bounce, 1);
+            memcpy(out + done, bounce + skip, n);
+            done += n;
+        }
+    }
+    vfat.last_read_us = esp_timer_get_time();
+    return bufsize;
+}
+
+int32_t tud_msc_write10_cb(uint8_t lun, uint32_t lba, uint32_t offset, uint8_t *buffer, uint32_t bufsize)
+{
+    tud_msc_set_sense(lun, SCSI_SENSE_DATA_PROTECT, SCSI_CODE_ASC_WRITE_PROTECTED, SCSI_CODE_ASCQ);
+    return -1;
+}
+
+int32_t tud_msc_scsi_cb(uint8_t lun, uint8_t const scsi_cmd[16], void *buffer, uint16_t bufsize)
+{
+    switch (scsi_cmd[0]) {
+    case SCSI_CMD_PREVENT_ALLOW_MEDIUM_REMOVAL:
+        return 0;
+    default:
+        ESP_LOGW(TAG, "tud_msc_scsi_cb() invoked: %d", scsi_cmd[0]);
+        tud_msc_set_sense(lun, SCSI_SENSE_ILLEGAL_REQUEST, SCSI_CODE_ASC_INVALID_COMMAND_OPERATION_CODE, SCSI_CODE_ASCQ);
+        return -1;
+    }
+}
+
+// Invoked when the host configures the device, it gets a fresh view.
+void tud_mount_cb(void)
+{
+    vfat.ejected = false;
+    vfat.changed = false;
+    vfat_build();
+}
+/*********************************************************************** TinyUSB MSC callbacks*/
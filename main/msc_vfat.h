@@ -0,0 +1,17 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+#include "esp_err.h"
+
+// Read-only USB mass storage view of the log. The host sees a FAT12/16 volume that is generated
+// on the fly from the segment index: boot sector, FAT and root directory are computed, data
+// sectors are read from the log files. The log partition stays mounted to the application.
+// The view is a snapshot, it is rebuilt when the host (re)connects or loads the medium, and
+// every CONFIG_DATA_LOG_MSC_REFRESH_S while the host is not reading.
+esp_err_t msc_vfat_init(void);
+
+#ifdef __cplusplus
+}
+#endif
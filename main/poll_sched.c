@@ -0,0 +1,170 @@
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include "esp_log.h"
+#include "poll_sched.h"
+
+static const char *TAG = "sched";
+
+#define POLL_PERIOD_MS_MAX (UINT32_MAX / 1000) // longest period and jitter budget held in us
+
+// Earliest-deadline-first polling. Every characteristic is released once per period; released
+// characteristics are served in order of their deadline (release time + jitter budget), ties are
+// broken by priority. Characteristics that are not due yet wait in a second heap ordered by
+// release time, so the poller knows how long it can sleep.
+typedef struct {
+    int64_t due_us;         // release time of the next poll
+    uint32_t period_us;
+    uint32_t jitter_us;
+    uint8_t priority;
+    poll_sched_stats_t stats;
+} poll_entry_t;
+
+typedef struct {
+    uint16_t *items;
+    uint16_t len;
+    bool (*before)(uint16_t a, uint16_t b);
+} poll_heap_t;
+
+static poll_entry_t *entries = NULL;
+static uint16_t entry_count = 0;
+static poll_heap_t release_heap;
+static poll_heap_t ready_heap;
+
+static bool release_before(uint16_t a, uint16_t b)
+{
+    return entries[a].due_us < entries[b].due_us;
+}
+
+static bool deadline_before(uint16_t a, uint16_t b)
+{
+    int64_t da = entries[a].due_us + entries[a].jitter_us;
+    int64_t db = entries[b].due_us + entries[b].jitter_us;
+    return (da < db) || ((da == db) && (entries[a].priority < entries[b].priority));
+}
+
+static void heap_push(poll_heap_t *heap, uint16_t item)
+{
+    uint16_t i = heap->len++;
+    while (i > 0) {
+        uint16_t parent = (i - 1) / 2;
+        if (!heap->before(item, heap->items[parent])) {
+            break;
+        }
+        heap->items[i] = heap->items[parent];
+        i = parent;
+    }
+    heap->items[i] = item;
+}
+
+static uint16_t heap_pop(poll_heap_t *heap)
+{
+    uint16_t top = heap->items[0];
+    uint16_t item = heap->items[--heap->len];
+    uint16_t i = 0;
+    while (true) {
+        uint16_t child = 2 * i + 1;
+        if (child >= heap->len) {
+            break;
+        }
+        if ((child + 1 < heap->len) && heap->before(heap->items[child + 1], heap->items[child])) {
+            child++;
+        }
+        if (!heap->before(heap->items[child], item)) {
+            break;
+        }
+        heap->items[i] = heap->items[child];
+        i = child;
+    }
+    if (heap->len) {
+        heap->items[i] = item;
+    }
+    return top;
+}
+
+esp_err_t poll_sched_init(uint16_t cid_count, uint32_t default_period_ms)
+{
+    if (!cid_count || !default_period_ms || (default_period_ms > POLL_PERIOD_MS_MAX)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    free(entries);
+    free(release_heap.items);
+    free(ready_heap.items);
+    entries = calloc(cid_count, sizeof(poll_entry_t));
+    release_heap.items = calloc(cid_count, sizeof(uint16_t));
+    ready_heap.items = calloc(cid_count, sizeof(uint16_t));
+    if (!entries || !release_heap.items || !ready_heap.items) {
+        ESP_LOGE(TAG, "no memory for %d schedule entries.", cid_count);
+        return ESP_ERR_NO_MEM;
+    }
+    entry_count = cid_count;
+    release_heap.len = 0;
+    release_heap.before = release_before;
+    ready_heap.len = 0;
+    ready_heap.before = deadline_before;
+    for (uint16_t cid = 0; cid < cid_count; cid++) {
+        entries[cid].period_us = default_period_ms * 1000;
+        entries[cid].jitter_us = default_period_ms * 1000;
+        heap_push(&release_heap, cid);
+    }
+    return ESP_OK;
+}
+
+// Must be called before the first poll_sched_next(), all characteristics are released at start.
+esp_err_t poll_sched_configure(const poll_sched_config_t *config)
+{
+    if (!entries || (config->cid >= entry_count) || !config->period_ms
+        || (config->period_ms > POLL_PERIOD_MS_MAX) || (config->jitter_ms > POLL_PERIOD_MS_MAX)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    poll_entry_t *entry = &entries[config->cid];
+    entry->period_us = config->period_ms * 1000;
+    entry->jitter_us = config->jitter_ms * 1000;
+    entry->priority = config->priority;
+    return ESP_OK;
+}
+
+// Returns the characteristic to poll now, or -1 and the time until the next release.
+int poll_sched_next(int64_t now_us, int64_t *wait_us)
+{
+    while (release_heap.len && (entries[release_heap.items[0]].due_us <= now_us)) {
+        heap_push(&ready_heap, heap_pop(&release_heap));
+    }
+    if (ready_heap.len) {
+        return heap_pop(&ready_heap);
+    }
+    *wait_us = release_heap.len ? entries[release_heap.items[0]].due_us - now_us : INT64_MAX;
+    return -1;
+}
+
+// Account a finished poll and schedule the next release of the characteristic.
+void poll_sched_done(uint16_t cid, int64_t start_us, int64_t end_us)
+{
+    poll_entry_t *entry = &entries[cid];
+    int64_t late_us = start_us - entry->due_us;
+    entry->stats.polls++;
+    if (late_us > entry->stats.max_late_us) {
+        entry->stats.max_late_us = late_us;
+    }
+    if (late_us > entry->jitter_us) {
+        entry->stats.missed++;
+        ESP_LOGD(TAG, "cid #%d started %" PRId64 " us late", cid, late_us);
+    }
+    entry->due_us += entry->period_us;
+    if (entry->due_us <= end_us) {
+        // overrun, skip the periods that can not be served anymore
+        int64_t skipped = (end_us - entry->due_us) / entry->period_us + 1;
+        entry->stats.missed += skipped;
+        entry->due_us += skipped * entry->period_us;
+    }
+    heap_push(&release_heap, cid);
+}
+
+esp_err_t poll_sched_get_stats(uint16_t cid, poll_sched_stats_t *stats)
+{
+    if (!entries || (cid >= entry_count)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    *stats = entries[cid].stats;
+    return ESP_OK;
+}
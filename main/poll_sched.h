@@ -0,0 +1,30 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+#include <stdint.h>
+#include "esp_err.h"
+
+typedef struct {
+    uint16_t cid;           // characteristic to poll
+    uint32_t period_ms;     // polling period, 1 to UINT32_MAX / 1000
+    uint8_t priority;       // breaks ties between equal deadlines, 0 is the highest priority
+    uint32_t jitter_ms;     // how late a poll may start before it counts as a missed deadline, up to UINT32_MAX / 1000
+} poll_sched_config_t;
+
+typedef struct {
+    uint32_t polls;         // polls started
+    uint32_t missed;        // polls started after their deadline, or skipped because of an overrun
+    int64_t max_late_us;    // worst start time after the release of a poll
+} poll_sched_stats_t;
+
+esp_err_t poll_sched_init(uint16_t cid_count, uint32_t default_period_ms);
+esp_err_t poll_sched_configure(const poll_sched_config_t *config);
+int poll_sched_next(int64_t now_us, int64_t *wait_us);
+void poll_sched_done(uint16_t cid, int64_t start_us, int64_t end_us);
+esp_err_t poll_sched_get_stats(uint16_t cid, poll_sched_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
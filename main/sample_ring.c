@@ -0,0 +1,54 @@
+#include <assert.h>
+#include "sample_ring.h"
+
+void sample_ring_init(sample_ring_t *ring, data_log_sample_t *slots, uint32_t count)
+{
+    assert(count && !(count & (count - 1)));
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    atomic_init(&ring->hwm, 0);
+    atomic_init(&ring->dropped, 0);
+    ring->mask = count - 1;
+    ring->slots = slots;
+}
+
+// Called by the producer only. Returns false if the ring is full and overwrite is not allowed.
+bool sample_ring_push(sample_ring_t *ring, const data_log_sample_t *sample, bool overwrite)
+{
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    if (head - tail > ring->mask) {
+        if (!overwrite) {
+            return false;
+        }
+        // drop the oldest entry, a failed exchange means the consumer has just freed a slot
+        if (atomic_compare_exchange_strong_explicit(&ring->tail, &tail, tail + 1,
+                                                    memory_order_acq_rel, memory_order_acquire)) {
+            atomic_fetch_add_explicit(&ring->dropped, 1, memory_order_relaxed);
+        }
+    }
+    ring->slots[head & ring->mask] = *sample;
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+
+    uint32_t used = head + 1 - atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    if (used > atomic_load_explicit(&ring->hwm, memory_order_relaxed)) {
+        atomic_store_explicit(&ring->hwm, used, memory_order_relaxed);
+    }
+    return true;
+}
+
+// Called by the consumer only. Returns false if the ring is empty.
+bool sample_ring_pop(sample_ring_t *ring, data_log_sample_t *sample)
+{
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    while (tail != atomic_load_explicit(&ring->head, memory_order_acquire)) {
+        *sample = ring->slots[tail & ring->mask];
+        // the copy is only valid if the producer did not overwrite the slot meanwhile,
+        // otherwise tail is reloaded and the next oldest entry is read
+        if (atomic_compare_exchange_weak_explicit(&ring->tail, &tail, tail + 1,
+                                                  memory_order_acq_rel, memory_order_relaxed)) {
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "data_log.h"
+
+// Lock-free single producer / single consumer ring of samples.
+// The producer may overwrite the oldest entry when the ring is full; in that case it advances
+// the tail itself, and the consumer detects the lost race through the failed compare-and-swap.
+typedef struct {
+    _Atomic uint32_t head;      // next slot written by the producer
+    _Atomic uint32_t tail;      // next slot read by the consumer
+    _Atomic uint32_t hwm;       // maximum number of entries observed in the ring
+    _Atomic uint32_t dropped;   // entries overwritten before the consumer read them
+    uint32_t mask;              // number of slots - 1, the number of slots is a power of two
+    data_log_sample_t *slots;
+} sample_ring_t;
+
+void sample_ring_init(sample_ring_t *ring, data_log_sample_t *slots, uint32_t count);
+bool sample_ring_push(sample_ring_t *ring, const data_log_sample_t *sample, bool overwrite);
+bool sample_ring_pop(sample_ring_t *ring, data_log_sample_t *sample);
+
+#ifdef __cplusplus
+}
+#endif
@@ -1,14 +1,16 @@
-#include <errno.h>
-#include <dirent.h>
 #include "esp_console.h"
 #include "esp_check.h"
 #include "esp_partition.h"
 #include "driver/gpio.h"
 #include "tinyusb.h"
+#if CONFIG_DATA_LOG_MSC_VIRTUAL
+#include "esp_vfs_fat.h"
+#include "msc_vfat.h"
+#else
 #include "tusb_msc_storage.h"
+#endif
 #include "tusb_msc.h"
-#include <dirent.h>
-#include <stdio.h>
+#include "data_log.h"
 #include "led_strip.h"
 #include "iot_button.h"
 
@@ -18,12 +20,8 @@ static const char *TAG = "msc";
    ********************************************************************* */
 #define EPNUM_MSC       1
 #define TUSB_DESC_TOTAL_LEN (TUD_CONFIG_DESC_LEN + TUD_MSC_DESC_LEN)
-#define BASE_PATH "/data" // base path to mount the partition
+#define BASE_PATH DATA_LOG_BASE_PATH // base path to mount the partition
 #define STORAGE_MAX 14540800
-#define AS_FILE_LINE_SIZE 6
-#define AS_FILE_LINE_MAX 17280
-#define AS_FILE_SIZE 103680
-#define AS_FILE_MAX 100
 #define BLINK_GPIO 48
 
 enum {
@@ -40,8 +38,6 @@ enum {
 };
 
 static led_strip_handle_t led_strip;
-static uint16_t file_max = 0;
-static uint16_t file_min = UINT16_MAX;
 static uint8_t const desc_configuration[] = {
     // Config number, interface count, string index, total length, attribute, power in mA
     TUD_CONFIG_DESCRIPTOR(1, ITF_NUM_TOTAL, 0, TUSB_DESC_TOTAL_LEN, TUSB_DESC_CONFIG_ATT_REMOTE_WAKEUP, 100),
@@ -74,26 +70,27 @@ static char const *string_desc_arr[] = {
 };
 /*********************************************************************** TinyUSB descriptors*/
 
-// callback that is delivered when storage is mounted/unmounted by application.
-static void storage_mount_changed_cb(tinyusb_msc_event_t *event)
+#if !CONFIG_DATA_LOG_MSC_VIRTUAL
+// callback that is delivered before storage is mounted/unmounted by application.
+static void storage_premount_changed_cb(tinyusb_msc_event_t *event)
 {
-    DIR *d = opendir(BASE_PATH);
-    struct dirent *dir;
-    if (d) {
-        while ((dir = readdir(d)) != NULL) {
-            ESP_LOGI(TAG, "found file: %s", dir->d_name);
-            uint8_t index = 0;
-            if (sscanf(dir->d_name, "%d.txt", &index)) {
-                if (index > file_max) file_max = index;
-                if (index < file_min) file_min = index;
-            }
+    // commit staged samples and stop writing before the volume is handed over to the usb host
+    if (event->mount_changed_data.is_mounted) {
+        esp_err_t err = data_log_release();
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "failed to flush log before unmount: %s", esp_err_to_name(err));
         }
-        closedir(d);
     }
+}
+
+// callback that is delivered when storage is mounted/unmounted by application.
+static void storage_mount_changed_cb(tinyusb_msc_event_t *event)
+{
+    data_log_mount_changed(event->mount_changed_data.is_mounted);
 
     // ESP_ERROR_CHECK(led_strip_set_pixel(led_strip, event->mount_changed_data.is_mounted ? 0 : 32, 5, 5, 5));
     // ESP_ERROR_CHECK(led_strip_refresh(led_strip));
-    ESP_LOGI(TAG, "storage mounted to application: %s, file index[%d, %d]", event->mount_changed_data.is_mounted ? "Yes" : "No", file_min, file_max);
+    ESP_LOGI(TAG, "storage mounted to application: %s", event->mount_changed_data.is_mounted ? "Yes" : "No");
 }
 
 static esp_err_t storage_init_spiflash(wl_handle_t *wl_handle)
@@ -108,6 +105,7 @@ static esp_err_t storage_init_spiflash(wl_handle_t *wl_handle)
 
     return wl_mount(data_partition, wl_handle);
 }
+#endif
 
 static void button_single_click_cb(void *arg, void *data)
 {
@@ -131,49 +129,6 @@ static void button_long_press_start_cb(void *arg, void *data)
     esp_restart();
 }
 
-int append_data(uint16_t value)
-{
-    if (tinyusb_msc_storage_in_use_by_usb_host()) {
-        ESP_LOGE(TAG, "storage exposed over usb. application can't write to storage.");
-        return -1;
-    }
-    // read latest file
-    char filename[20];
-    sprintf(filename, BASE_PATH "/%d.txt", file_max);
-    FILE *fd = fopen(filename, "a+");
-    uint32_t len = ftell(fd);
-    // if lines in latest file exceeds, create new file
-    if (len / AS_FILE_LINE_SIZE >= AS_FILE_LINE_MAX) {
-        file_max++;
-        ESP_LOGI(TAG, "creating file %d, %d", file_max, AS_FILE_MAX);
-        // if files in storage exceeds, remove eldest file
-        if (file_max >= AS_FILE_MAX) {
-            sprintf(filename, BASE_PATH "/%d.txt", file_min);
-            ESP_LOGI(TAG, "storage is full, have to delete oldest file: %s", filename);
-            int ret = remove(filename);
-            if (ret != 0) {
-                ESP_LOGI(TAG, "failed to delete file: %d", ret);
-            } else {
-                file_min++;
-            }
-        }
-        // close last file
-        fclose(fd);
-        // open new file
-        sprintf(filename, BASE_PATH "/%d.txt", file_max);
-        fd = fopen(filename, "a+");
-        len = ftell(fd);
-    }
-    if (!fd) {
-        ESP_LOGW(TAG, "failed to open %s, skip writing.", filename);
-        return -1;
-    }
-    ESP_LOGI(TAG, "writing value %d to file %s at line %lu", value, filename, len/AS_FILE_LINE_SIZE);
-    fprintf(fd, "%.1f\n", (float)value / 10);
-    fclose(fd);
-    return 0;
-}
-
 void storage_main(void)
 {
     // led_strip_config_t strip_config = {
@@ -206,13 +161,26 @@ void storage_main(void)
     iot_button_register_cb(handle, BUTTON_LONG_PRESS_START, button_long_press_start_cb, NULL);
 
     ESP_LOGI(TAG, "initializing storage...");
+    data_log_init();
 
     static wl_handle_t wl_handle = WL_INVALID_HANDLE;
+#if CONFIG_DATA_LOG_MSC_VIRTUAL
+    // the log stays mounted to the application, the host gets a read-only view of it
+    const esp_vfs_fat_mount_config_t mount_config = {
+        .max_files = 5,
+        .format_if_mount_failed = true,
+        .allocation_unit_size = CONFIG_WL_SECTOR_SIZE,
+    };
+    ESP_ERROR_CHECK(esp_vfs_fat_spiflash_mount_rw_wl(BASE_PATH, NULL, &mount_config, &wl_handle));
+    data_log_mount_changed(true);
+    ESP_ERROR_CHECK(msc_vfat_init());
+#else
     ESP_ERROR_CHECK(storage_init_spiflash(&wl_handle));
 
     const tinyusb_msc_spiflash_config_t config_spi = {
         .wl_handle = wl_handle,
         .callback_mount_changed = storage_mount_changed_cb,  /* First way to register the callback. This is while initializing the storage. */
+        .callback_premount_changed = storage_premount_changed_cb,
         .mount_config.max_files = 5,
     };
     ESP_ERROR_CHECK(tinyusb_msc_storage_init_spiflash(&config_spi));
@@ -220,6 +188,7 @@ void storage_main(void)
 
     //mounted in the app by default
     ESP_ERROR_CHECK(tinyusb_msc_storage_mount(BASE_PATH));
+#endif
 
     ESP_LOGI(TAG, "usb msc initialization");
     const tinyusb_config_t tusb_cfg = {
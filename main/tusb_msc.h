@@ -5,7 +5,6 @@ extern "C" {
 #endif
 #include "stdint.h"
 
-int append_data(uint16_t value);
 void storage_main(void);
 
 #ifdef __cplusplus
@@ -1,63 +0,0 @@
-/*
- * SPDX-FileCopyrightText: 2006 Christian Walter
- *
- * SPDX-License-Identifier: BSD-3-Clause
- *
- * SPDX-FileContributor: 2016-2021 Espressif Systems (Shanghai) CO LTD
- */
-/*
- * FreeModbus Libary: ESP32 Demo Application
- * Copyright (c) 2006 Christian Walter <wolti@sil.at>
- * All rights reserved.
- *
- * Redistribution and use in source and binary forms, with or without
- * modification, are permitted provided that the following conditions
- * are met:
- * 1. Redistributions of source code must retain the above copyright
- *    notice, this list of conditions and the following disclaimer.
- * 2. Redistributions in binary form must reproduce the above copyright
- *    notice, this list of conditions and the following disclaimer in the
- *    documentation and/or other materials provided with the distribution.
- * 3. The name of the author may not be used to endorse or promote products
- *    derived from this software without specific prior written permission.
- *
- * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
- * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
- * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
- * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
- * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
- * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
- * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
- * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
- * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
- * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
- *
- * File: $Id: portother.c,v 1.1 2010/06/06 13:07:20 wolti Exp $
- */
-
-/* ----------------------- System includes ----------------------------------*/
-#include <stdlib.h>
-#include <freertos/FreeRTOS.h>
-#include <freertos/task.h>
-#include <freertos/semphr.h>
-
-/* ----------------------- Modbus includes ----------------------------------*/
-#include "mb_m.h"
-#include "mbport.h"
-
-/* ----------------------- Modbus includes ----------------------------------*/
-
-/* ----------------------- Variables ----------------------------------------*/
-
-/* ----------------------- Start implementation -----------------------------*/
-
-void
-vMBMasterPortClose( void )
-{
-    extern void     vMBMasterPortSerialClose( void );
-    extern void     vMBMasterPortTimerClose( void );
-    extern void     vMBMasterPortEventClose( void );
-    vMBMasterPortSerialClose(  );
-    vMBMasterPortTimerClose(  );
-    vMBMasterPortEventClose(  );
-}
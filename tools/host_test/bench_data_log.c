@@ -0,0 +1,154 @@
+// Samples/s and flash writes per sample of the batched data log writer (main/data_log.c),
+// compared to the per-sample text file append it replaced (append_data() in main/tusb_msc.c).
+// Time is simulated: the poller reads SAMPLE_CIDS characteristics every SAMPLE_PERIOD_US.
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "sdkconfig.h"
+#include "host.h"
+#include "host_libc.h"
+#include "data_log.h"
+#include "log_format.h"
+
+#define SAMPLE_CIDS         3
+#define SAMPLE_PERIOD_US    1000000
+#define LEGACY_SAMPLES      20000
+#define BATCHED_SAMPLES     400000
+
+// append_data() as it was before the data log, one line per sample
+#define BASE_PATH "/data"
+#define AS_FILE_LINE_SIZE 6
+#define AS_FILE_LINE_MAX 17280
+#define AS_FILE_MAX 100
+
+static int file_min = 0;
+static int file_max = 0;
+
+static int legacy_append_data(uint16_t value)
+{
+    char filename[20];
+    sprintf(filename, BASE_PATH "/%d.txt", file_max);
+    FILE *fd = fopen(filename, "a+");
+    uint32_t len = ftell(fd);
+    if (len / AS_FILE_LINE_SIZE >= AS_FILE_LINE_MAX) {
+        file_max++;
+        if (file_max >= AS_FILE_MAX) {
+            sprintf(filename, BASE_PATH "/%d.txt", file_min);
+            if (remove(filename) == 0) {
+                file_min++;
+            }
+        }
+        fclose(fd);
+        sprintf(filename, BASE_PATH "/%d.txt", file_max);
+        fd = fopen(filename, "a+");
+    }
+    if (!fd) {
+        return -1;
+    }
+    fprintf(fd, "%.1f\n", (float)value / 10);
+    fclose(fd);
+    return 0;
+}
+
+static uint32_t sample_value(uint32_t i)
+{
+    // phase voltages around 230 V in 0.1 V with a little noise
+    return 2300 + (i % SAMPLE_CIDS) * 7 + (i * 2654435761u >> 29);
+}
+
+static double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void report(const char *path, uint32_t samples, double elapsed, const host_fs_stats_t *fs,
+                   uint32_t nvs_writes)
+{
+    printf("%-10s %8lu %11.0f %10.3f %10.3f %10.3f %12.1f %10.4f\n", path, (unsigned long)samples,
+           samples / elapsed, (double)fs->opens / samples, (double)fs->writes / samples,
+           (double)fs->bytes / samples, (double)fs->sectors * CONFIG_WL_SECTOR_SIZE / samples,
+           (double)nvs_writes / samples);
+}
+
+// samples in the valid blocks of the raw segments
+static uint32_t count_logged(const char *dir)
+{
+    uint32_t count = 0;
+    DIR *d = opendir(dir);
+    struct dirent *entry;
+    while (d && (entry = readdir(d)) != NULL) {
+        unsigned index;
+        char path[300];
+        log_block_t block;
+        if (sscanf(entry->d_name, "%u.bin", &index) != 1) {
+            continue;
+        }
+        snprintf(path, sizeof(path), "%s/%s", dir, entry->d_name);
+        FILE *fd = fopen(path, "rb");
+        fseek(fd, LOG_BLOCK_SIZE, SEEK_SET);
+        while (fread(&block, sizeof(block), 1, fd) == 1) {
+            count += log_block_valid(&block) ? block.header.count : 0;
+        }
+        fclose(fd);
+    }
+    if (d) {
+        closedir(d);
+    }
+    return count;
+}
+
+int main(void)
+{
+    host_fs_stats_t fs;
+    int failures = 0;
+
+    printf("path        samples   samples/s opens/smp writes/smp  bytes/smp flash B/smp   nvs/smp\n");
+
+    host_fs_init(BASE_PATH);
+    double start = now_s();
+    for (uint32_t i = 0; i < LEGACY_SAMPLES; i++) {
+        if (legacy_append_data(sample_value(i)) != 0) {
+            printf("FAIL: legacy append %lu\n", (unsigned long)i);
+            return EXIT_FAILURE;
+        }
+    }
+    host_fs_get_stats(&fs);
+    report("per-sample", LEGACY_SAMPLES, now_s() - start, &fs, 0);
+    double legacy_flash = (double)fs.sectors / LEGACY_SAMPLES;
+
+    const char *dir = host_fs_init(DATA_LOG_BASE_PATH);
+    data_log_init();
+    data_log_mount_changed(true);
+    uint32_t nvs_start = host_nvs_writes();
+    start = now_s();
+    for (uint32_t i = 0; i < BATCHED_SAMPLES; i++) {
+        data_log_append(i % SAMPLE_CIDS, sample_value(i), DATA_LOG_QUALITY_GOOD);
+        host_time_advance(SAMPLE_PERIOD_US / SAMPLE_CIDS);
+    }
+    data_log_flush();
+    double elapsed = now_s() - start;
+    host_fs_get_stats(&fs);
+    report("batched", BATCHED_SAMPLES, elapsed, &fs, host_nvs_writes() - nvs_start);
+
+    data_log_stats_t stats;
+    data_log_get_stats(&stats);
+    uint32_t logged = count_logged(dir);
+    if (stats.samples != BATCHED_SAMPLES || stats.dropped || stats.queue_dropped || logged != BATCHED_SAMPLES) {
+        printf("FAIL: %lu samples accepted, %lu dropped, %lu lost in the queue, %lu on the volume\n",
+               (unsigned long)stats.samples, (unsigned long)stats.dropped, (unsigned long)stats.queue_dropped,
+               (unsigned long)logged);
+        failures++;
+    }
+    if ((double)fs.sectors / BATCHED_SAMPLES >= legacy_flash) {
+        printf("FAIL: the batched writer writes no less flash than the per-sample path\n");
+        failures++;
+    }
+    printf("%lu commits, %lu rollups, flash bytes per sample %.1fx less than per-sample\n",
+           (unsigned long)stats.commits, (unsigned long)stats.rollups,
+           legacy_flash * BATCHED_SAMPLES / fs.sectors);
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,276 @@
+// Compression ratio and encode cost per sample of the log block encodings (main/log_format.c).
+//   bench_log_codec [-o dir] [recording.csv ...]
+// A recording is the CSV written by tools/log_export.py for raw samples. Without recordings
+// synthetic meter traces are used. With -o every dataset is written to <dir>/<name>.csv and
+// one segment per encoding to <dir>/<name>_<encoding>/0.bin, for the round trip through
+// tools/log_export.py in check_log_export.py.
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include "log_format.h"
+
+#define BENCH_MIN_NS 200000000.0 // encode each dataset for at least this long
+#define WALL_CLOCK_BASE 1760000000u
+
+typedef struct {
+    const char *name;
+    uint8_t flags;
+} encoding_t;
+
+static const encoding_t encodings[] = {
+    { "raw", 0 },
+    { "delta", LOG_BLOCK_FLAG_DELTA },
+    { "xor", LOG_BLOCK_FLAG_XOR },
+};
+
+typedef struct {
+    char name[64];
+    data_log_sample_t *samples;
+    size_t count;
+    size_t cap;
+} dataset_t;
+
+static uint32_t rng_state = 1;
+
+static uint32_t rng(void)
+{
+    rng_state = rng_state * 1664525u + 1013904223u;
+    return rng_state >> 8;
+}
+
+static void dataset_add(dataset_t *set, const data_log_sample_t *sample)
+{
+    if (set->count == set->cap) {
+        set->cap = set->cap ? set->cap * 2 : 4096;
+        set->samples = realloc(set->samples, set->cap * sizeof(*set->samples));
+    }
+    set->samples[set->count++] = *sample;
+}
+
+// three phase voltages in 0.1 V polled every second, with a slow drift, noise and poll jitter
+static void make_voltage(dataset_t *set, bool wall_clock)
+{
+    snprintf(set->name, sizeof(set->name), wall_clock ? "voltage" : "voltage_no_clock");
+    int32_t drift = 0;
+    for (uint32_t s = 0; s < 86400; s++) {
+        if (rng() % 60 == 0) {
+            drift += (int32_t)(rng() % 21) - 10;
+        }
+        for (uint16_t cid = 0; cid < 3; cid++) {
+            int64_t time_us = (int64_t)s * 1000000 + cid * 12000 + rng() % 4000;
+            data_log_sample_t sample = {
+                .time_us = time_us,
+                .wall_s = wall_clock ? WALL_CLOCK_BASE + (uint32_t)(time_us / 1000000) : 0,
+                .raw = 2300 + cid * 4 + drift + rng() % 5,
+                .cid = cid,
+                .quality = DATA_LOG_QUALITY_GOOD,
+            };
+            dataset_add(set, &sample);
+        }
+    }
+}
+
+// a full meter: voltages, currents, power, frequency and an energy counter, with read errors
+static void make_meter(dataset_t *set)
+{
+    snprintf(set->name, sizeof(set->name), "meter");
+    uint32_t energy = 123456789;
+    uint32_t current = 500;
+    for (uint32_t s = 0; s < 28800; s++) {
+        current = (rng() % 300 == 0) ? 100 + rng() % 2000 : current + rng() % 7 - 3;
+        for (uint16_t cid = 0; cid < 12; cid++) {
+            uint32_t raw;
+            if (cid < 3) {
+                raw = 2300 + rng() % 9;
+            } else if (cid < 6) {
+                raw = current + rng() % 20;
+            } else if (cid < 9) {
+                raw = current * 23 / 10 + rng() % 50;
+            } else if (cid == 9) {
+                raw = 5000 + rng() % 5 - 2;
+            } else if (cid == 10) {
+                energy += current / 100;
+                raw = energy;
+            } else {
+                raw = 950 + rng() % 30;
+            }
+            data_log_sample_t sample = {
+                .time_us = (int64_t)s * 1000000 + cid * 9000 + rng() % 3000,
+                .raw = raw,
+                .cid = cid,
+                .quality = DATA_LOG_QUALITY_GOOD,
+            };
+            sample.wall_s = WALL_CLOCK_BASE + (uint32_t)(sample.time_us / 1000000);
+            if (rng() % 1000 == 0) {
+                sample.raw = 0;
+                sample.quality = DATA_LOG_QUALITY_READ_ERROR;
+            }
+            dataset_add(set, &sample);
+        }
+    }
+}
+
+// raw sample CSV of tools/log_export.py: segment,block,mono_ms,wall_s,cid,raw,quality
+static bool load_recording(dataset_t *set, const char *path)
+{
+    FILE *fd = fopen(path, "r");
+    if (!fd) {
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        return false;
+    }
+    const char *base = strrchr(path, '/');
+    snprintf(set->name, sizeof(set->name), "%s", base ? base + 1 : path);
+    char *dot = strrchr(set->name, '.');
+    if (dot) {
+        *dot = 0;
+    }
+    char line[256];
+    while (fgets(line, sizeof(line), fd)) {
+        unsigned long mono_ms, wall_s, raw;
+        unsigned cid;
+        char quality[32];
+        if (sscanf(line, "%*u,%*u,%lu,%lu,%u,%lu,%31s", &mono_ms, &wall_s, &cid, &raw, quality) != 5) {
+            continue; // header
+        }
+        data_log_sample_t sample = {
+            .time_us = (int64_t)mono_ms * 1000,
+            .wall_s = wall_s,
+            .raw = raw,
+            .cid = cid,
+            .quality = strcmp(quality, "good") ? DATA_LOG_QUALITY_READ_ERROR : DATA_LOG_QUALITY_GOOD,
+        };
+        dataset_add(set, &sample);
+    }
+    fclose(fd);
+    return set->count != 0;
+}
+
+// encode a dataset into sealed blocks the way the storage task stages them, returns the block count
+static size_t encode(const dataset_t *set, uint8_t flags, log_block_t *blocks)
+{
+    log_encoder_t enc;
+    size_t n = 0;
+    for (size_t i = 0; i < set->count; i++) {
+        if (n == 0 || !log_block_add(&blocks[n - 1], &enc, &set->samples[i])) {
+            if (n) {
+                log_block_seal(&blocks[n - 1]);
+            }
+            log_block_init(&blocks[n], &enc, n, flags);
+            log_block_add(&blocks[n++], &enc, &set->samples[i]);
+        }
+    }
+    if (n) {
+        log_block_seal(&blocks[n - 1]);
+    }
+    return n;
+}
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static bool write_segment(const char *dir, const dataset_t *set, const encoding_t *encoding,
+                          const log_block_t *blocks, size_t n)
+{
+    char path[512];
+    if (snprintf(path, sizeof(path), "%s/%s_%s", dir, set->name, encoding->name) >= (int)sizeof(path) - 6) {
+        return false;
+    }
+    mkdir(path, 0755);
+    strcat(path, "/0.bin");
+    FILE *fd = fopen(path, "wb");
+    if (!fd) {
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        return false;
+    }
+    log_block_t header = { 0 };
+    log_segment_header_init((log_segment_header_t *)&header, 0, WALL_CLOCK_BASE, sizeof(log_record_t));
+    bool ok = fwrite(&header, sizeof(header), 1, fd) == 1 && fwrite(blocks, sizeof(*blocks), n, fd) == n;
+    return (fclose(fd) == 0) && ok;
+}
+
+static bool write_expected(const char *dir, const dataset_t *set)
+{
+    char path[512];
+    if (snprintf(path, sizeof(path), "%s/%s.csv", dir, set->name) >= (int)sizeof(path)) {
+        return false;
+    }
+    FILE *fd = fopen(path, "w");
+    if (!fd) {
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        return false;
+    }
+    fprintf(fd, "mono_ms,wall_s,cid,raw,quality\n");
+    for (size_t i = 0; i < set->count; i++) {
+        const data_log_sample_t *s = &set->samples[i];
+        fprintf(fd, "%lu,%lu,%u,%lu,%u\n", (unsigned long)(s->time_us / 1000), (unsigned long)s->wall_s,
+                s->cid, (unsigned long)s->raw, s->quality);
+    }
+    return fclose(fd) == 0;
+}
+
+int main(int argc, char **argv)
+{
+    const char *out_dir = NULL;
+    dataset_t sets[16] = { 0 };
+    size_t set_count = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-o") && i + 1 < argc) {
+            out_dir = argv[++i];
+        } else if (set_count < sizeof(sets) / sizeof(sets[0])) {
+            if (!load_recording(&sets[set_count++], argv[i])) {
+                return EXIT_FAILURE;
+            }
+        }
+    }
+    if (set_count == 0) {
+        make_voltage(&sets[set_count++], true);
+        make_voltage(&sets[set_count++], false);
+        make_meter(&sets[set_count++]);
+    }
+
+    printf("dataset            encoding   samples  blocks  bytes/sample   ratio  encode ns/sample\n");
+    for (size_t s = 0; s < set_count; s++) {
+        const dataset_t *set = &sets[s];
+        log_block_t *blocks = malloc((set->count + 1) * sizeof(log_block_t));
+        double raw_bytes = 0;
+        for (size_t e = 0; e < sizeof(encodings) / sizeof(encodings[0]); e++) {
+            size_t n = 0;
+            int rounds = 0;
+            double start = now_ns();
+            double elapsed;
+            do {
+                n = encode(set, encodings[e].flags, blocks);
+                rounds++;
+                elapsed = now_ns() - start;
+            } while (elapsed < BENCH_MIN_NS);
+            double bytes = (double)n * LOG_BLOCK_SIZE;
+            if (e == 0) {
+                raw_bytes = bytes;
+            }
+            printf("%-18s %-8s %9zu %7zu %13.2f %7.2f %17.1f\n", set->name, encodings[e].name, set->count, n,
+                   bytes / set->count, raw_bytes / bytes, elapsed / rounds / set->count);
+            for (size_t b = 0; b < n; b++) {
+                if (!log_block_valid(&blocks[b])) {
+                    printf("FAIL: %s %s block %zu not valid\n", set->name, encodings[e].name, b);
+                    return EXIT_FAILURE;
+                }
+            }
+            if (out_dir && !write_segment(out_dir, set, &encodings[e], blocks, n)) {
+                return EXIT_FAILURE;
+            }
+        }
+        if (out_dir && !write_expected(out_dir, set)) {
+            return EXIT_FAILURE;
+        }
+        free(blocks);
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,137 @@
+// Time from a remount to the first write of the data log (main/data_log.c), restoring the segment
+// state from the NVS superblock against the directory scan it falls back to (and that every
+// mount did before the superblock). Flash reads are counted by the FATFS model in stub/host_fs.c.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sdkconfig.h"
+#include "nvs.h"
+#include "host.h"
+#include "host_libc.h"
+#include "data_log.h"
+
+#define SAMPLE_CIDS         3
+#define SAMPLE_PERIOD_US    1000000
+#define FILL_SAMPLES        3000000
+#define REMOUNTS            20
+#define FILES_MAX           (CONFIG_DATA_LOG_RAW_FILES + CONFIG_DATA_LOG_MINUTE_FILES + CONFIG_DATA_LOG_HOUR_FILES)
+
+typedef struct {
+    int64_t resume_us;          // sum of the mount to first write times
+    uint64_t sectors_read;
+    uint32_t opens;
+    uint32_t nvs_writes;
+} remount_cost_t;
+
+static data_log_file_t files_before[FILES_MAX];
+static data_log_file_t files_after[FILES_MAX];
+
+static uint32_t sample_value(uint32_t i)
+{
+    return 2300 + (i % SAMPLE_CIDS) * 7 + (i * 2654435761u >> 29);
+}
+
+// make the superblocks of all series unreadable, the next mount has to scan the directory
+static void drop_superblocks(void)
+{
+    static const char *keys[] = { "sb", "sb_m", "sb_h" };
+    nvs_handle_t nvs;
+    uint8_t junk = 0;
+    nvs_open("data_log", NVS_READWRITE, &nvs);
+    for (size_t i = 0; i < sizeof(keys) / sizeof(keys[0]); i++) {
+        nvs_set_blob(nvs, keys[i], &junk, sizeof(junk));
+    }
+}
+
+// unmount, remount and write one sample
+static void remount(bool scan, uint32_t sample, remount_cost_t *cost)
+{
+    host_fs_stats_t before, after;
+    data_log_stats_t stats;
+
+    data_log_mount_changed(false);
+    if (scan) {
+        drop_superblocks();
+    }
+    host_time_advance(SAMPLE_PERIOD_US);
+    uint32_t nvs_start = host_nvs_writes();
+    host_fs_get_stats(&before);
+    data_log_mount_changed(true);
+    data_log_append(sample % SAMPLE_CIDS, sample_value(sample), DATA_LOG_QUALITY_GOOD);
+    data_log_flush();
+    host_fs_get_stats(&after);
+    data_log_get_stats(&stats);
+    cost->resume_us += stats.resume_us;
+    cost->sectors_read += after.sectors_read - before.sectors_read;
+    cost->opens += after.opens - before.opens;
+    cost->nvs_writes += host_nvs_writes() - nvs_start;
+}
+
+static void report(const char *path, const remount_cost_t *cost)
+{
+    printf("%-11s %10.1f %12.1f %10.1f %9.1f\n", path, (double)cost->resume_us / REMOUNTS,
+           (double)cost->sectors_read / REMOUNTS, (double)cost->opens / REMOUNTS,
+           (double)cost->nvs_writes / REMOUNTS);
+}
+
+int main(void)
+{
+    int failures = 0;
+    remount_cost_t superblock = { 0 };
+    remount_cost_t scan = { 0 };
+
+    host_fs_init(DATA_LOG_BASE_PATH);
+    data_log_init();
+    data_log_mount_changed(true);
+    for (uint32_t i = 0; i < FILL_SAMPLES; i++) {
+        data_log_append(i % SAMPLE_CIDS, sample_value(i), DATA_LOG_QUALITY_GOOD);
+        host_time_advance(SAMPLE_PERIOD_US / SAMPLE_CIDS);
+    }
+    data_log_flush();
+    size_t files = data_log_list_files(files_before, FILES_MAX);
+
+    uint32_t sample = FILL_SAMPLES;
+    for (int i = 0; i < REMOUNTS; i++) {
+        remount(false, sample++, &superblock);
+        remount(true, sample++, &scan);
+    }
+
+    printf("%u files, %u byte sectors\n", (unsigned)files, CONFIG_WL_SECTOR_SIZE);
+    printf("path        resume us sectors read  opens/mnt  nvs/mnt\n");
+    report("superblock", &superblock);
+    report("scan", &scan);
+
+    data_log_stats_t stats;
+    data_log_get_stats(&stats);
+    if (stats.samples != sample || stats.dropped || stats.queue_dropped) {
+        printf("FAIL: %lu of %lu samples accepted, %lu dropped, %lu lost in the queue\n",
+               (unsigned long)stats.samples, (unsigned long)sample, (unsigned long)stats.dropped,
+               (unsigned long)stats.queue_dropped);
+        failures++;
+    }
+    // both paths continue the same segments, a remount never starts a new file
+    size_t files_now = data_log_list_files(files_after, FILES_MAX);
+    if (files_now != files) {
+        printf("FAIL: %u files before the remounts, %u after\n", (unsigned)files, (unsigned)files_now);
+        failures++;
+    }
+    for (size_t i = 0; i < files && i < files_now; i++) {
+        if (strcmp(files_before[i].name, files_after[i].name)) {
+            printf("FAIL: file %u is %s after the remounts, was %s\n", (unsigned)i, files_after[i].name,
+                   files_before[i].name);
+            failures++;
+            break;
+        }
+    }
+    if (superblock.nvs_writes >= scan.nvs_writes) {
+        printf("FAIL: the scan did not rewrite the superblocks\n");
+        failures++;
+    }
+    if (superblock.sectors_read >= scan.sectors_read) {
+        printf("FAIL: the superblock path reads no less than the scan\n");
+        failures++;
+    }
+    printf("sectors read per remount %.1fx less with the superblock\n",
+           (double)scan.sectors_read / superblock.sectors_read);
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,126 @@
+// Cost of finding a master characteristic by cid and name (mbc_master_find_param() in
+// common/esp_modbus_master.c) as the descriptor table grows to 1000 entries, compared to
+// the linear search of the table that get_parameter()/set_parameter() did before.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "mbc_master.h"
+#include "check.h"
+
+#define TABLE_MAX       1000
+#define BENCH_LOOKUPS   2000000
+#define LEGACY_LOOKUPS  20000
+
+static mb_parameter_descriptor_t table[TABLE_MAX];
+static char keys[TABLE_MAX][24];
+// mbc_serial_master_set_request() as it was before the index
+static const mb_parameter_descriptor_t* legacy_find_param(const mb_master_options_t* mbm_opts, const char* name)
+{
+    const mb_parameter_descriptor_t* reg_ptr = mbm_opts->mbm_param_descriptor_table;
+    for (uint16_t counter = 0; counter < (mbm_opts->mbm_param_descriptor_size); counter++, reg_ptr++)
+    {
+        size_t param_key_len = strlen((const char*)reg_ptr->param_key);
+        if (param_key_len != strlen((const char*)name)) {
+            continue;
+        }
+        if (memcmp((const void*)name, (const void*)reg_ptr->param_key, (size_t)param_key_len) == 0) {
+            return reg_ptr;
+        }
+    }
+    return NULL;
+}
+
+static void set_table(mb_master_options_t* mbm_opts, size_t size)
+{
+    mbm_opts->mbm_param_descriptor_table = table;
+    mbm_opts->mbm_param_descriptor_size = size;
+    CHECK(mbc_master_build_key_index(mbm_opts) == ESP_OK, "index of %zu entries", size);
+}
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// ns per lookup of every cid in turn, with the cid of the characteristic or a wrong one
+static double bench(const mb_master_options_t* mbm_opts, int mode, int lookups)
+{
+    const size_t size = mbm_opts->mbm_param_descriptor_size;
+    const mb_parameter_descriptor_t* volatile found;
+    uint16_t cid = 0;
+    double start = now_ns();
+    for (int i = 0; i < lookups; i++) {
+        switch (mode) {
+        case 0:
+            found = legacy_find_param(mbm_opts, keys[cid]);
+            break;
+        case 1:
+            found = mbc_master_find_param(mbm_opts, cid, keys[cid]);
+            break;
+        default:
+            found = mbc_master_find_param(mbm_opts, (cid + 1) % size, keys[cid]);
+            break;
+        }
+        // a stride prime to the table size visits every entry in a scattered order
+        cid = (cid + 617) % size;
+    }
+    (void)found;
+    return (now_ns() - start) / lookups;
+}
+
+int main(void)
+{
+    mb_master_options_t opts = { 0 };
+
+    for (uint16_t cid = 0; cid < TABLE_MAX; cid++) {
+        snprintf(keys[cid], sizeof(keys[cid]), "Meter%02u_Reg%03u", cid / 40, cid % 40 * 2);
+        table[cid] = (mb_parameter_descriptor_t){ .cid = cid, .param_key = keys[cid], .param_units = "V",
+                                                  .mb_slave_addr = 1 + cid / 40, .mb_param_type = MB_PARAM_HOLDING,
+                                                  .mb_reg_start = cid % 40 * 2, .mb_size = 2 };
+    }
+
+    set_table(&opts, TABLE_MAX);
+    for (uint16_t cid = 0; cid < TABLE_MAX; cid++) {
+        CHECK(mbc_master_find_param(&opts, cid, keys[cid]) == &table[cid], "cid %u", cid);
+        CHECK(mbc_master_find_param(&opts, (cid + 1) % TABLE_MAX, keys[cid]) == &table[cid], "cid %u by name", cid);
+        CHECK(mbc_master_find_param(&opts, 0xFFFF, keys[cid]) == &table[cid], "cid %u out of range", cid);
+    }
+    CHECK(mbc_master_find_param(&opts, 0, "Meter00") == NULL, "prefix of a key found");
+    CHECK(mbc_master_find_param(&opts, 0, "") == NULL, "empty key found");
+    // with duplicate keys the first characteristic keeps the name, as in the linear search
+    table[700].param_key = keys[300];
+    set_table(&opts, TABLE_MAX);
+    CHECK(mbc_master_find_param(&opts, 0, keys[300]) == legacy_find_param(&opts, keys[300]), "duplicate key");
+    CHECK(mbc_master_find_param(&opts, 700, keys[300]) == &table[700], "duplicate key at its cid");
+    CHECK(mbc_master_find_param(&opts, 0, keys[700]) == NULL, "renamed key found");
+    table[700].param_key = keys[700];
+    set_table(&opts, 1);
+    CHECK(mbc_master_find_param(&opts, 0, keys[0]) == &table[0], "table of one entry");
+    CHECK(mbc_master_find_param(&opts, 0, keys[1]) == NULL, "key past the table found");
+
+    printf("entries  linear[ns]  cid[ns]  name[ns]\n");
+    const size_t sizes[] = { 10, 100, 250, 500, 1000 };
+    double indexed[2] = { 0 };
+    double linear = 0;
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        set_table(&opts, sizes[s]);
+        linear = bench(&opts, 0, LEGACY_LOOKUPS);
+        double by_cid = bench(&opts, 1, BENCH_LOOKUPS);
+        double by_name = bench(&opts, 2, BENCH_LOOKUPS);
+        printf("%7zu %11.1f %8.1f %9.1f\n", sizes[s], linear, by_cid, by_name);
+        if (s == 0) {
+            indexed[0] = by_name;
+        }
+        indexed[1] = by_name;
+    }
+    printf("name lookup at %d entries costs %.1fx the lookup at %zu\n", TABLE_MAX, indexed[1] / indexed[0], sizes[0]);
+    if (indexed[1] >= linear) {
+        printf("FAIL: the index is not faster than the linear search at %d entries\n", TABLE_MAX);
+        failures++;
+    }
+    mbc_master_free_key_index(&opts);
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
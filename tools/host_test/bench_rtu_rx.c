@@ -0,0 +1,211 @@
+// CPU cost per received frame of the RTU master receive path (modbus/rtu/mbrtu_m.c), one
+// driver read per byte (xMBMasterRTUReceiveFSM) against one read per chunk
+// (xMBMasterRTUReceiveBlock), for 8 and 255 byte responses.
+//
+// usMBMasterPortSerialRxPoll() of port/portserial_m.c is reproduced below for both paths.
+// uart_read_bytes() is modelled on the ESP-IDF driver: a mutex, a critical section around
+// the ring buffer access and one around the buffered length. The byte path also ends every
+// frame with a read that finds the buffer empty; on the device that read waits for
+// MB_SERIAL_RX_TOUT_TICKS, here it returns at once.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "port.h"
+#include "mb_m.h"
+#include "mbport.h"
+#include "mbframe.h"
+#include "mbcrc.h"
+#include "mbrtu.h"
+#include "check.h"
+
+#define BENCH_BYTES 4000000
+#define MIN(a, b) (((a) < (b)) ? (a) : (b))
+
+volatile UCHAR ucMasterRcvBuf[MB_MASTER_INSTANCES][MB_SERIAL_BUF_SIZE];
+volatile UCHAR ucMasterSndBuf[MB_MASTER_INSTANCES][MB_SERIAL_BUF_SIZE];
+
+static portMUX_TYPE port_mux = portMUX_INITIALIZER_UNLOCKED;
+static SemaphoreHandle_t uart_rx_mux;
+static UCHAR uart_rx[2 * MB_SERIAL_BUF_SIZE];
+static size_t uart_rx_len;
+static size_t uart_rx_pos;
+static uint32_t uart_reads;
+static eMBMasterEventEnum last_event;
+static int uart_read_bytes(UCHAR *buf, size_t len)
+{
+    xSemaphoreTake(uart_rx_mux, portMAX_DELAY);
+    portENTER_CRITICAL(&port_mux);
+    size_t n = MIN(len, uart_rx_len - uart_rx_pos);
+    memcpy(buf, uart_rx + uart_rx_pos, n);
+    uart_rx_pos += n;
+    portEXIT_CRITICAL(&port_mux);
+    portENTER_CRITICAL(&port_mux);
+    uart_reads++;
+    portEXIT_CRITICAL(&port_mux);
+    xSemaphoreGive(uart_rx_mux);
+    return (int)n;
+}
+
+/* ----------------------- Port functions used by mbrtu_m.c ---------------------*/
+void vMBPortEnterCritical(void) { portENTER_CRITICAL(&port_mux); }
+void vMBPortExitCritical(void) { portEXIT_CRITICAL(&port_mux); }
+BOOL xMBMasterPortSerialInit(UCHAR ucPort, ULONG ulBaudRate, UCHAR ucDataBits, eMBParity eParity) { return TRUE; }
+BOOL xMBMasterPortTimersInit(USHORT usTimeOut50us) { return TRUE; }
+void vMBMasterPortSerialEnable(BOOL xRxEnable, BOOL xTxEnable) { }
+void vMBMasterPortTimersT35Enable(void) { }
+void vMBMasterPortTimersConvertDelayEnable(void) { }
+void vMBMasterPortTimersRespondTimeoutEnable(void) { }
+void vMBMasterPortTimersDisable(void) { }
+void vMBMasterRequestSetType(BOOL xIsBroadcast) { }
+BOOL xMBMasterRequestIsBroadcast(void) { return FALSE; }
+void vMBMasterSetErrorType(eMBMasterErrorEventType errorType) { }
+eMBMasterTimerMode xMBMasterGetCurTimerMode(void) { return MB_TMODE_T35; }
+BOOL xMBMasterPortSerialGetResponse(UCHAR **ppucMBSerialFrame, USHORT *usSerialLength) { return TRUE; }
+BOOL xMBMasterPortSerialSendRequest(UCHAR *pucMBSerialFrame, USHORT usSerialLength) { return TRUE; }
+BOOL xMBMasterPortSerialPutBytes(const UCHAR *pucBuf, USHORT usLength) { return TRUE; }
+
+BOOL xMBMasterPortEventPost(eMBMasterEventEnum eEvent)
+{
+    last_event = eEvent;
+    return TRUE;
+}
+
+BOOL xMBMasterPortSerialGetByte(CHAR *pucByte)
+{
+    return uart_read_bytes((UCHAR *)pucByte, 1) == 1;
+}
+
+USHORT usMBMasterPortSerialGetBytes(UCHAR *pucBuf, USHORT usLength)
+{
+    int iLength = uart_read_bytes(pucBuf, usLength);
+    return (iLength > 0) ? (USHORT)iLength : 0;
+}
+
+/* ----------------------- Receive path ---------------------------------------*/
+// the idle line event of the driver: the bytes are buffered, the port task polls them in
+static void rx_event(const UCHAR *frame, size_t len)
+{
+    memcpy(uart_rx, frame, len);
+    uart_rx_len = len;
+    uart_rx_pos = 0;
+}
+
+static void rx_poll(int block, size_t xEventSize)
+{
+    BOOL xStatus = TRUE;
+    USHORT usCnt = 0;
+    if (block) {
+        xMBMasterRTUReceiveBlock((USHORT)xEventSize);
+    } else {
+        while (xStatus && (usCnt++ <= xEventSize)) {
+            xStatus = xMBMasterRTUReceiveFSM();
+        }
+    }
+    // uart_flush_input() and the t3.5 expiry that follows without a timer port
+    uart_rx_len = uart_rx_pos = 0;
+    xMBMasterRTUTimerExpired();
+}
+
+// one response through the receive path and the frame check, returns the PDU length
+static int receive(int block, const UCHAR *frame, size_t len, size_t chunk)
+{
+    for (size_t done = 0; done < len; done += chunk) {
+        rx_event(frame + done, MIN(chunk, len - done));
+        if (done + chunk < len) {
+            // the next chunk follows within t3.5, the frame goes on
+            if (block) {
+                xMBMasterRTUReceiveBlock((USHORT)MIN(chunk, len - done));
+            } else {
+                for (size_t i = 0; i < MIN(chunk, len - done); i++) {
+                    xMBMasterRTUReceiveFSM();
+                }
+            }
+            continue;
+        }
+        rx_poll(block, MIN(chunk, len - done));
+    }
+    UCHAR ucAddress;
+    UCHAR *pucPDU;
+    USHORT usLength;
+    if (last_event != EV_MASTER_FRAME_RECEIVED || eMBMasterRTUReceive(&ucAddress, &pucPDU, &usLength) != MB_ENOERR) {
+        return -1;
+    }
+    return usLength;
+}
+
+static size_t make_frame(UCHAR *frame, size_t len)
+{
+    frame[0] = 1;
+    frame[1] = (len == 8) ? MB_FUNC_WRITE_REGISTER : MB_FUNC_READ_HOLDING_REGISTER;
+    frame[2] = (UCHAR)(len - 5);
+    for (size_t i = 3; i < len - 2; i++) {
+        frame[i] = (UCHAR)(i * 37);
+    }
+    USHORT crc = usMBCRC16(frame, len - 2);
+    frame[len - 2] = (UCHAR)(crc & 0xFF);
+    frame[len - 1] = (UCHAR)(crc >> 8);
+    return len;
+}
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+int main(void)
+{
+    static const char *path_name[] = { "byte", "block" };
+    UCHAR frame[MB_SER_PDU_SIZE_MAX + 8];
+    UCHAR noisy[sizeof(frame) + 2];
+
+    uart_rx_mux = xSemaphoreCreateMutex();
+    eMBMasterRTUInit(0, 115200, MB_PAR_NONE);
+    eMBMasterRTUStart();
+    xMBMasterRTUTimerExpired();
+
+    for (int block = FALSE; block <= TRUE; block++) {
+        const char *path = path_name[block];
+        // eMBMasterRTUReceive() takes frames shorter than MB_SER_PDU_SIZE_MAX
+        for (size_t len = 4; len < MB_SER_PDU_SIZE_MAX; len++) {
+            make_frame(frame, len);
+            CHECK(receive(block, frame, len, len) == (int)len - 3, "%s path, %zu byte frame", path, len);
+            CHECK(receive(block, frame, len, 120) == (int)len - 3, "%s path, %zu byte frame in chunks", path, len);
+        }
+        make_frame(frame, 8);
+        frame[4] ^= 1;
+        CHECK(receive(block, frame, 8, 8) < 0, "%s path, bad CRC accepted", path);
+        // zero bytes ahead of the address are dropped
+        make_frame(frame, 8);
+        memset(noisy, 0, 2);
+        memcpy(noisy + 2, frame, 8);
+        CHECK(receive(block, noisy, 10, 10) == 5, "%s path, leading zero bytes", path);
+        memset(frame, 0x55, MB_SER_PDU_SIZE_MAX + 1);
+        make_frame(frame, MB_SER_PDU_SIZE_MAX + 1);
+        CHECK(receive(block, frame, MB_SER_PDU_SIZE_MAX + 1, MB_SER_PDU_SIZE_MAX + 1) < 0,
+              "%s path, oversized frame accepted", path);
+    }
+
+    printf("frame  path   driver reads/frame  ns/frame\n");
+    const size_t sizes[] = { 8, 255 };
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        double ns[2];
+        int frames = BENCH_BYTES / (int)sizes[s];
+        for (int block = FALSE; block <= TRUE; block++) {
+            make_frame(frame, sizes[s]);
+            uart_reads = 0;
+            double start = now_ns();
+            for (int i = 0; i < frames; i++) {
+                receive(block, frame, sizes[s], sizes[s]);
+            }
+            ns[block] = (now_ns() - start) / frames;
+            printf("%5zu  %-6s %18.1f %9.1f\n", sizes[s], path_name[block], (double)uart_reads / frames, ns[block]);
+        }
+        printf("%5zu  block path %.1fx faster\n", sizes[s], ns[FALSE] / ns[TRUE]);
+    }
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,174 @@
+// Cost of finding the register area of a slave request (mbc_slave_find_reg_descriptor() in
+// common/esp_modbus_slave.c, reached through eMBRegHoldingCB()) against the
+// number of areas, compared to the walk of the area list it replaced.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "mbc_slave.h"
+#include "mb.h"
+#include "check.h"
+
+#define AREAS_MAX       4000
+#define AREA_REGS       8
+#define AREA_STRIDE     10      // registers from one area to the next, the rest is a gap
+#define BENCH_READS     1000000
+#define LEGACY_READS    20000
+
+static uint16_t regs[AREAS_MAX][AREA_REGS];
+static uint32_t queued;
+/* ----------------------- Controller functions used by esp_modbus_slave.c -----*/
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t ticks)
+{
+    queued++;
+    return pdTRUE;
+}
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t group, const EventBits_t bits)
+{
+    return bits;
+}
+
+static esp_err_t slave_destroy(void)
+{
+    return ESP_OK;
+}
+
+// mbc_slave_find_reg_descriptor() as it was before the sorted index
+#define REG_SIZE(type, nregs) ((type == MB_PARAM_INPUT) || (type == MB_PARAM_HOLDING)) ? (nregs >> 1) : (nregs << 3)
+
+static mb_descr_entry_t* legacy_find_reg_descriptor(mb_slave_options_t* mbs_opts, mb_param_type_t type,
+                                                    uint16_t addr, size_t regs)
+{
+    mb_descr_entry_t* it;
+    uint16_t reg_size = 0;
+
+    if (LIST_EMPTY(&mbs_opts->mbs_area_descriptors[type])) {
+        return NULL;
+    }
+    for (it = LIST_FIRST(&mbs_opts->mbs_area_descriptors[type]); it != NULL; it = LIST_NEXT(it, entries)) {
+        reg_size = REG_SIZE(type, it->size);
+        if ((addr >= it->start_offset)
+            && (it->p_data)
+            && (regs >= 1)
+            && ((addr + regs) <= (it->start_offset + reg_size))
+            && (reg_size >= 1)) {
+            return it;
+        }
+    }
+    return NULL;
+}
+
+static esp_err_t add_area(mb_param_type_t type, uint16_t start, void* data, size_t size)
+{
+    mb_register_area_descriptor_t area = { .start_offset = start, .type = type, .address = data, .size = size };
+    return mbc_slave_set_descriptor(area);
+}
+
+// a slave with the areas registered in a scattered order, returns its options
+static mb_slave_options_t* slave_create(size_t areas)
+{
+    mb_slave_interface_t* iface = calloc(1, sizeof(mb_slave_interface_t));
+    iface->destroy = slave_destroy;
+    mbc_slave_init_iface(iface);
+    for (size_t n = 0, i = 0; n < areas; n++, i = (i + 617) % areas) {
+        CHECK(add_area(MB_PARAM_HOLDING, i * AREA_STRIDE, regs[i], sizeof(regs[i])) == ESP_OK, "area %zu", i);
+    }
+    return &iface->opts;
+}
+
+// reads registers through the stack callback, returns the first one or -1 if there is no area
+static int read_regs(uint16_t addr, uint16_t count)
+{
+    UCHAR buf[2 * AREA_STRIDE];
+    if (eMBRegHoldingCB(buf, addr + 1, count, MB_REG_READ) != MB_ENOERR) {
+        return -1;
+    }
+    return (buf[0] << 8) | buf[1];
+}
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// ns per read of two registers in every area in turn, through the callback or the old list walk
+static double bench(mb_slave_options_t* mbs_opts, size_t areas, int legacy, int reads)
+{
+    mb_descr_entry_t* volatile found;
+    UCHAR buf[4];
+    size_t i = 0;
+    double start = now_ns();
+    for (int n = 0; n < reads; n++) {
+        uint16_t addr = i * AREA_STRIDE + 3;
+        if (legacy) {
+            found = legacy_find_reg_descriptor(mbs_opts, MB_PARAM_HOLDING, addr, 2);
+        } else {
+            eMBRegHoldingCB(buf, addr + 1, 2, MB_REG_READ);
+        }
+        i = (i + 617) % areas;
+    }
+    (void)found;
+    return (now_ns() - start) / reads;
+}
+
+int main(void)
+{
+    for (size_t i = 0; i < AREAS_MAX; i++) {
+        for (size_t r = 0; r < AREA_REGS; r++) {
+            regs[i][r] = i * AREA_STRIDE + r;
+        }
+    }
+
+    mb_slave_options_t* mbs_opts = slave_create(AREAS_MAX);
+    CHECK(mbs_opts->mbs_area_count[MB_PARAM_HOLDING] == AREAS_MAX, "areas indexed");
+    for (size_t i = 0; i < AREAS_MAX; i++) {
+        uint16_t start = i * AREA_STRIDE;
+        for (uint16_t r = 0; r < AREA_REGS; r++) {
+            CHECK(read_regs(start + r, AREA_REGS - r) == start + r, "register %u", start + r);
+            CHECK(legacy_find_reg_descriptor(mbs_opts, MB_PARAM_HOLDING, start + r, 1)->p_data == regs[i],
+                  "register %u in the list", start + r);
+        }
+        CHECK(read_regs(start, AREA_REGS + 1) < 0, "read past area %zu", i);
+        CHECK(read_regs(start + AREA_REGS, 1) < 0, "gap after area %zu", i);
+    }
+    CHECK(read_regs(AREAS_MAX * AREA_STRIDE, 1) < 0, "register past the last area");
+    UCHAR value[2] = { 0x12, 0x34 };
+    CHECK(eMBRegHoldingCB(value, 5 * AREA_STRIDE + 2 + 1, 1, MB_REG_WRITE) == MB_ENOERR, "write");
+    CHECK(read_regs(5 * AREA_STRIDE + 2, 1) == 0x1234, "read back");
+    regs[5][2] = 5 * AREA_STRIDE + 2;
+    CHECK(queued == AREAS_MAX * AREA_REGS + 2, "parameter info of %u reads and writes queued", (unsigned)queued);
+
+    // overlaps are rejected at registration, adjacent areas and other types are not
+    static uint16_t extra[2 * AREA_STRIDE];
+    CHECK(add_area(MB_PARAM_HOLDING, 3 * AREA_STRIDE, extra, 2) != ESP_OK, "same start accepted");
+    CHECK(add_area(MB_PARAM_HOLDING, 3 * AREA_STRIDE + AREA_REGS - 1, extra, 4) != ESP_OK, "overlap of the end accepted");
+    CHECK(add_area(MB_PARAM_HOLDING, 3 * AREA_STRIDE - 1, extra, 4) != ESP_OK, "overlap of the start accepted");
+    CHECK(add_area(MB_PARAM_HOLDING, 3 * AREA_STRIDE - 1, extra, 2 * AREA_STRIDE * 2) != ESP_OK, "covering area accepted");
+    CHECK(add_area(MB_PARAM_HOLDING, 3 * AREA_STRIDE + AREA_REGS, extra, 2 * (AREA_STRIDE - AREA_REGS)) == ESP_OK,
+          "area filling a gap rejected");
+    CHECK(read_regs(3 * AREA_STRIDE + AREA_REGS, 1) == 0, "area filling a gap");
+    CHECK(add_area(MB_PARAM_INPUT, 3 * AREA_STRIDE, extra, 2) == ESP_OK, "input area rejected");
+    CHECK(mbs_opts->mbs_area_count[MB_PARAM_HOLDING] == AREAS_MAX + 1, "rejected areas indexed");
+    CHECK(mbc_slave_destroy() == ESP_OK, "destroy");
+
+    printf("areas  list walk[ns]  callback[ns]\n");
+    const size_t sizes[] = { 1, 10, 100, 1000, AREAS_MAX };
+    double indexed[2] = { 0 };
+    double linear = 0;
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        mbs_opts = slave_create(sizes[s]);
+        linear = bench(mbs_opts, sizes[s], 1, LEGACY_READS);
+        indexed[s > 0] = bench(mbs_opts, sizes[s], 0, BENCH_READS);
+        printf("%5zu %14.1f %13.1f\n", sizes[s], linear, indexed[s > 0]);
+        mbc_slave_destroy();
+    }
+    printf("callback at %d areas costs %.1fx the callback at %zu\n", AREAS_MAX, indexed[1] / indexed[0], sizes[0]);
+    if (indexed[1] >= linear) {
+        printf("FAIL: the callback is slower than the list walk alone at %d areas\n", AREAS_MAX);
+        failures++;
+    }
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
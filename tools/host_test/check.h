@@ -0,0 +1,16 @@
+// Checks of the host tests: a failed check is printed with its location and counted, the
+// test goes on and returns EXIT_FAILURE if failures is not 0 at the end
+#pragma once
+
+#include <stdio.h>
+
+static int failures;
+
+#define CHECK(cond, ...) do { \
+    if (!(cond)) { \
+        printf("FAIL %s:%d: ", __FILE__, __LINE__); \
+        printf(__VA_ARGS__); \
+        printf("\n"); \
+        failures++; \
+    } \
+} while (0)
@@ -0,0 +1,46 @@
+#!/usr/bin/env python3
+"""Round trip of the log block encodings through the decoder of tools/log_export.py.
+
+Usage:
+    check_log_export.py <bench_log_codec> [recording.csv ...]
+
+Runs bench_log_codec with an output directory and checks that every segment it writes
+decodes to exactly the samples of its dataset.
+"""
+import csv
+import os
+import subprocess
+import sys
+import tempfile
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), '..'))
+import log_export  # noqa: E402
+
+ENCODINGS = ('raw', 'delta', 'xor')
+
+
+def main():
+    bench, recordings = sys.argv[1], sys.argv[2:]
+    failures = 0
+    with tempfile.TemporaryDirectory() as out:
+        subprocess.run([bench, '-o', out] + recordings, check=True)
+        for name in sorted(f[:-4] for f in os.listdir(out) if f.endswith('.csv')):
+            with open(os.path.join(out, name + '.csv'), newline='') as f:
+                expected = [tuple(int(v) for v in row) for row in list(csv.reader(f))[1:]]
+            for encoding in ENCODINGS:
+                path = os.path.join(out, '%s_%s' % (name, encoding), '0.bin')
+                decoded = [(mono_ms, wall_s, cid, raw, quality)
+                           for _, _, (mono_ms, wall_s, raw, cid, quality, _) in log_export.read_segment(path)]
+                mismatch = next((i for i, (a, b) in enumerate(zip(decoded, expected)) if a != b), None)
+                if len(decoded) != len(expected) or mismatch is not None:
+                    at = mismatch if mismatch is not None else min(len(decoded), len(expected))
+                    print('FAIL %s %s: %d of %d samples decoded, first difference at %d' %
+                          (name, encoding, len(decoded), len(expected), at))
+                    failures += 1
+                else:
+                    print('%s %s: %d samples decoded' % (name, encoding, len(decoded)))
+    return 1 if failures else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
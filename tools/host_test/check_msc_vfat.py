@@ -0,0 +1,153 @@
+#!/usr/bin/env python3
+"""Check the FAT image served by the virtual FAT view against the log files it shows.
+
+Usage:
+    check_msc_vfat.py <test_msc_vfat> <partition bytes>
+
+Runs test_msc_vfat, then reads the image with mtools (mdir/mcopy) and fsck.fat when they are
+installed, and always with the FAT12/16 reader below, which follows the cluster chains of
+every file. Each file must match the log file of the same name byte by byte.
+"""
+import os
+import re
+import shutil
+import struct
+import subprocess
+import sys
+import tempfile
+
+BOOT_SECTOR = struct.Struct('<3s8sHBHBHHBHHHII')
+DIR_ENTRY = struct.Struct('<11sBBBHHHHHHHI')
+ATTR_READ_ONLY = 0x01
+ATTR_VOLUME_LABEL = 0x08
+
+
+class FatImage:
+    def __init__(self, data):
+        self.data = data
+        (_, _, self.sector_size, self.cluster_sectors, reserved, self.fat_count, root_entries,
+         sectors16, _, fat_sectors, _, _, _, sectors32) = BOOT_SECTOR.unpack_from(data)
+        if data[510:512] != b'\x55\xaa':
+            raise ValueError('no boot sector signature')
+        self.sectors = sectors16 or sectors32
+        self.fat_start = reserved * self.sector_size
+        self.fat_size = fat_sectors * self.sector_size
+        self.root_start = self.fat_start + self.fat_count * self.fat_size
+        self.root_entries = root_entries
+        self.data_start = self.root_start + root_entries * 32
+        self.cluster_size = self.cluster_sectors * self.sector_size
+        self.clusters = (self.sectors * self.sector_size - self.data_start) // self.cluster_size
+        # the FAT type follows from the cluster count alone
+        self.fat16 = self.clusters >= 4085
+
+    def fat(self, copy=0):
+        start = self.fat_start + copy * self.fat_size
+        return self.data[start:start + self.fat_size]
+
+    def next_cluster(self, cluster):
+        fat = self.fat()
+        if self.fat16:
+            value = struct.unpack_from('<H', fat, cluster * 2)[0]
+            return None if value >= 0xFFF8 else value
+        pair = struct.unpack_from('<H', fat, cluster * 3 // 2)[0]
+        value = pair >> 4 if cluster & 1 else pair & 0xFFF
+        return None if value >= 0xFF8 else value
+
+    def entries(self):
+        for i in range(self.root_entries):
+            name, attr, _, _, _, _, _, _, _, _, first, size = DIR_ENTRY.unpack_from(self.data, self.root_start + i * 32)
+            if name[0] == 0:
+                return
+            if name[0] == 0xE5:
+                continue
+            yield name, attr, first, size
+
+    def read(self, first, size):
+        out = bytearray()
+        cluster = first
+        seen = set()
+        while cluster is not None and len(out) < size:
+            if cluster < 2 or cluster >= self.clusters + 2 or cluster in seen:
+                raise ValueError('bad cluster chain at %d' % cluster)
+            seen.add(cluster)
+            offset = self.data_start + (cluster - 2) * self.cluster_size
+            out += self.data[offset:offset + self.cluster_size]
+            cluster = self.next_cluster(cluster)
+        if cluster is not None or len(out) < size or len(out) - size >= self.cluster_size:
+            raise ValueError('cluster chain does not match the file size %d' % size)
+        return bytes(out[:size])
+
+
+def dos_name(name):
+    base, ext = name[:8].decode('ascii').rstrip(), name[8:].decode('ascii').rstrip()
+    return (base + '.' + ext if ext else base).lower()
+
+
+def main():
+    test, size = sys.argv[1], sys.argv[2]
+    failures = []
+    with tempfile.TemporaryDirectory() as tmp:
+        image_path = os.path.join(tmp, 'vfat.img')
+        result = subprocess.run([test, image_path, size], stdout=subprocess.PIPE, universal_newlines=True)
+        sys.stdout.write(result.stdout)
+        if result.returncode:
+            return 1
+        log_dir = re.search(r'^log: (.*)$', result.stdout, re.MULTILINE).group(1)
+        try:
+            with open(image_path, 'rb') as f:
+                image = FatImage(f.read())
+            logs = {name.lower(): os.path.join(log_dir, name) for name in os.listdir(log_dir)}
+            shown = {}
+            for name, attr, first, size in image.entries():
+                if attr & ATTR_VOLUME_LABEL:
+                    continue
+                if not attr & ATTR_READ_ONLY:
+                    failures.append('%s is not read only' % dos_name(name))
+                shown[dos_name(name)] = image.read(first, size) if size else b''
+            for copy in range(1, image.fat_count):
+                if image.fat(copy) != image.fat():
+                    failures.append('FAT copy %d differs' % copy)
+            if set(shown) != set(logs):
+                failures.append('files %s shown, log has %s' % (sorted(shown), sorted(logs)))
+            for name in set(shown) & set(logs):
+                with open(logs[name], 'rb') as f:
+                    if shown[name] != f.read():
+                        failures.append('%s differs from the log file' % name)
+            print('FAT%d image: %d files, %d bytes checked' %
+                  (16 if image.fat16 else 12, len(shown), sum(len(v) for v in shown.values())))
+
+            if shutil.which('mdir') and shutil.which('mcopy'):
+                listing = subprocess.run(['mdir', '-b', '-i', image_path, '::'], stdout=subprocess.PIPE,
+                                         universal_newlines=True, check=True).stdout.split()
+                names = sorted(os.path.basename(n).lower() for n in listing)
+                if names != sorted(logs):
+                    failures.append('mdir lists %s' % names)
+                for name in names:
+                    data = subprocess.run(['mcopy', '-n', '-i', image_path, '::' + name, '-'],
+                                          stdout=subprocess.PIPE, check=True).stdout
+                    with open(logs[name], 'rb') as f:
+                        if data != f.read():
+                            failures.append('mcopy: %s differs from the log file' % name)
+                print('mtools: %d files checked' % len(names))
+            else:
+                print('mtools not installed, skipped')
+            fsck = shutil.which('fsck.fat') or shutil.which('dosfsck')
+            if fsck:
+                check = subprocess.run([fsck, '-n', image_path], stdout=subprocess.PIPE, stderr=subprocess.STDOUT,
+                                       universal_newlines=True)
+                if check.returncode:
+                    failures.append('fsck.fat:\n' + check.stdout)
+                print('fsck.fat: %s' % ('clean' if not check.returncode else 'errors'))
+            else:
+                print('fsck.fat not installed, skipped')
+        except (ValueError, struct.error) as e:
+            failures.append(str(e))
+        finally:
+            shutil.rmtree(log_dir, ignore_errors=True)
+    for failure in failures:
+        print('FAIL %s' % failure)
+    return 1 if failures else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
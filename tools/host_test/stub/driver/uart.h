@@ -0,0 +1,7 @@
+#pragma once
+
+#include "esp_bit_defs.h"
+
+typedef int uart_port_t;
+typedef enum { UART_PARITY_DISABLE, UART_PARITY_EVEN = 2, UART_PARITY_ODD } uart_parity_t;
+typedef struct { int type; unsigned size; } uart_event_t;
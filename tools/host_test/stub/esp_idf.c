@@ -0,0 +1,121 @@
+// ESP-IDF services used by the firmware sources: timer, ROM CRC, error names and NVS
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "esp_err.h"
+#include "esp_rom_crc.h"
+#include "esp_timer.h"
+#include "nvs.h"
+#include "host.h"
+
+#define NVS_KEYS 16
+#define NVS_BLOB_MAX 64
+
+static _Atomic int64_t time_offset_us;
+static uint32_t nvs_writes;
+
+int64_t esp_timer_get_time(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000LL + ts.tv_nsec / 1000 + atomic_load(&time_offset_us);
+}
+
+time_t host_time(time_t *t)
+{
+    time_t now = time(NULL) + atomic_load(&time_offset_us) / 1000000;
+    if (t) {
+        *t = now;
+    }
+    return now;
+}
+
+void host_time_advance(int64_t us)
+{
+    atomic_fetch_add(&time_offset_us, us);
+}
+
+uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t *buf, uint32_t len)
+{
+    static uint32_t table[256];
+    if (!table[1]) {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int bit = 0; bit < 8; bit++) {
+                c = (c & 1) ? (c >> 1) ^ 0xEDB88320 : (c >> 1);
+            }
+            table[i] = c;
+        }
+    }
+    crc = ~crc;
+    while (len--) {
+        crc = (crc >> 8) ^ table[(crc ^ *buf++) & 0xFF];
+    }
+    return ~crc;
+}
+
+const char *esp_err_to_name(esp_err_t code)
+{
+    static __thread char name[16];
+    snprintf(name, sizeof(name), "0x%x", code);
+    return name;
+}
+
+static struct {
+    char key[16];
+    size_t len;
+    uint8_t value[NVS_BLOB_MAX];
+} nvs_keys[NVS_KEYS];
+
+esp_err_t nvs_open(const char *name, nvs_open_mode_t mode, nvs_handle_t *handle)
+{
+    (void)name; (void)mode;
+    *handle = 1;
+    return ESP_OK;
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char *key, const void *value, size_t length)
+{
+    (void)handle;
+    if (length > NVS_BLOB_MAX) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    for (int i = 0; i < NVS_KEYS; i++) {
+        if (!nvs_keys[i].key[0] || !strcmp(nvs_keys[i].key, key)) {
+            snprintf(nvs_keys[i].key, sizeof(nvs_keys[i].key), "%s", key);
+            memcpy(nvs_keys[i].value, value, length);
+            nvs_keys[i].len = length;
+            nvs_writes++;
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NO_MEM;
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char *key, void *out_value, size_t *length)
+{
+    (void)handle;
+    for (int i = 0; i < NVS_KEYS && nvs_keys[i].key[0]; i++) {
+        if (!strcmp(nvs_keys[i].key, key)) {
+            if (*length < nvs_keys[i].len) {
+                return ESP_ERR_INVALID_SIZE;
+            }
+            memcpy(out_value, nvs_keys[i].value, nvs_keys[i].len);
+            *length = nvs_keys[i].len;
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NVS_NOT_FOUND;
+}
+
+uint32_t host_nvs_writes(void)
+{
+    return nvs_writes;
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle)
+{
+    (void)handle;
+    return ESP_OK;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <stdio.h>
+
+typedef enum {
+    ESP_LOG_NONE,
+    ESP_LOG_ERROR,
+    ESP_LOG_WARN,
+    ESP_LOG_INFO,
+    ESP_LOG_DEBUG,
+    ESP_LOG_VERBOSE
+} esp_log_level_t;
+
+#ifndef LOG_LOCAL_LEVEL
+#define LOG_LOCAL_LEVEL ESP_LOG_WARN
+#endif
+
+// Errors and warnings of the firmware go to stderr, the arguments of the rest are only evaluated
+#define ESP_LOGE(tag, format, ...) fprintf(stderr, "E %s: " format "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...) fprintf(stderr, "W %s: " format "\n", tag, ##__VA_ARGS__)
+#define ESP_LOG_DROP(tag, format, ...) do { if (0) fprintf(stderr, "%s" format, tag, ##__VA_ARGS__); } while (0)
+#define ESP_LOGI(tag, format, ...) ESP_LOG_DROP(tag, format, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...) ESP_LOG_DROP(tag, format, ##__VA_ARGS__)
+#define ESP_LOGV(tag, format, ...) ESP_LOG_DROP(tag, format, ##__VA_ARGS__)
+#define ESP_EARLY_LOGD(tag, format, ...) ESP_LOG_DROP(tag, format, ##__VA_ARGS__)
+#define ESP_LOG_BUFFER_HEX_LEVEL(tag, buffer, len, level) do { (void)(buffer); } while (0)
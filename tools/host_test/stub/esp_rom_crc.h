@@ -0,0 +1,6 @@
+#pragma once
+
+#include <stdint.h>
+
+// CRC32 as computed by the ROM (and by zlib.crc32 for crc = 0)
+uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t *buf, uint32_t len);
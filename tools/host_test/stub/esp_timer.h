@@ -0,0 +1,8 @@
+#pragma once
+
+#include <stdint.h>
+
+typedef struct esp_timer *esp_timer_handle_t;
+
+// host monotonic clock plus the offset added by host_time_advance()
+int64_t esp_timer_get_time(void);
@@ -0,0 +1,284 @@
+// FreeRTOS subset on POSIX threads. Priorities and core affinity are ignored, critical
+// sections share one recursive lock.
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <time.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+struct host_task {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    uint32_t notify;
+    TaskFunction_t fn;
+    void *arg;
+};
+
+struct host_sema {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    bool recursive;
+    bool mutex;
+    pthread_t owner;
+    uint32_t count;             // available count of a binary semaphore, depth of a held mutex
+};
+
+static pthread_mutex_t critical_lock;
+static pthread_once_t critical_once = PTHREAD_ONCE_INIT;
+static __thread struct host_task *current_task;
+
+static void critical_init(void)
+{
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&critical_lock, &attr);
+}
+
+void vPortEnterCritical(portMUX_TYPE *mux)
+{
+    (void)mux;
+    pthread_once(&critical_once, critical_init);
+    pthread_mutex_lock(&critical_lock);
+}
+
+void vPortExitCritical(portMUX_TYPE *mux)
+{
+    (void)mux;
+    pthread_mutex_unlock(&critical_lock);
+}
+
+static struct timespec deadline(TickType_t ticks)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_sec += ticks / configTICK_RATE_HZ;
+    ts.tv_nsec += (long)(ticks % configTICK_RATE_HZ) * (1000000000L / configTICK_RATE_HZ);
+    if (ts.tv_nsec >= 1000000000L) {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000L;
+    }
+    return ts;
+}
+
+// wait on cond until ready() holds, false on timeout
+static bool wait_until(pthread_cond_t *cond, pthread_mutex_t *lock, TickType_t ticks,
+                       bool (*ready)(void *), void *ctx)
+{
+    struct timespec ts = deadline(ticks);
+    while (!ready(ctx)) {
+        if (ticks == 0) {
+            return false;
+        }
+        if (ticks == portMAX_DELAY) {
+            pthread_cond_wait(cond, lock);
+        } else if (pthread_cond_timedwait(cond, lock, &ts) == ETIMEDOUT) {
+            return ready(ctx);
+        }
+    }
+    return true;
+}
+
+static struct host_task *task_new(TaskFunction_t fn, void *arg)
+{
+    struct host_task *task = calloc(1, sizeof(*task));
+    if (task) {
+        pthread_mutex_init(&task->lock, NULL);
+        pthread_cond_init(&task->cond, NULL);
+        task->fn = fn;
+        task->arg = arg;
+    }
+    return task;
+}
+
+static void *task_entry(void *arg)
+{
+    current_task = arg;
+    current_task->fn(current_task->arg);
+    return NULL;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stack, void *arg,
+                                   UBaseType_t prio, TaskHandle_t *handle, BaseType_t core)
+{
+    (void)name; (void)stack; (void)prio; (void)core;
+    struct host_task *task = task_new(fn, arg);
+    if (!task) {
+        return pdFALSE;
+    }
+    if (handle) {
+        *handle = task;
+    }
+    if (pthread_create(&task->thread, NULL, task_entry, task) != 0) {
+        free(task);
+        return pdFALSE;
+    }
+    pthread_detach(task->thread);
+    return pdPASS;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stack, void *arg,
+                       UBaseType_t prio, TaskHandle_t *handle)
+{
+    return xTaskCreatePinnedToCore(fn, name, stack, arg, prio, handle, 0);
+}
+
+// Only a task can delete itself, the handle stays valid.
+void vTaskDelete(TaskHandle_t task)
+{
+    if (!task || task == current_task) {
+        pthread_exit(NULL);
+    }
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    if (!current_task) {
+        // the main thread gets a handle on first use
+        current_task = task_new(NULL, NULL);
+        current_task->thread = pthread_self();
+    }
+    return current_task;
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    struct timespec ts = {
+        .tv_sec = ticks / configTICK_RATE_HZ,
+        .tv_nsec = (long)(ticks % configTICK_RATE_HZ) * (1000000000L / configTICK_RATE_HZ),
+    };
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR) {
+    }
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (TickType_t)(ts.tv_sec * configTICK_RATE_HZ + ts.tv_nsec / (1000000000L / configTICK_RATE_HZ));
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task)
+{
+    pthread_mutex_lock(&task->lock);
+    task->notify++;
+    pthread_cond_signal(&task->cond);
+    pthread_mutex_unlock(&task->lock);
+    return pdPASS;
+}
+
+static bool task_notified(void *ctx)
+{
+    return ((struct host_task *)ctx)->notify != 0;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t ticks)
+{
+    struct host_task *task = xTaskGetCurrentTaskHandle();
+    pthread_mutex_lock(&task->lock);
+    wait_until(&task->cond, &task->lock, ticks, task_notified, task);
+    uint32_t value = task->notify;
+    if (value) {
+        task->notify = clear ? 0 : value - 1;
+    }
+    pthread_mutex_unlock(&task->lock);
+    return value;
+}
+
+static SemaphoreHandle_t sema_new(struct host_sema *sema, bool mutex, bool recursive)
+{
+    if (!sema) {
+        return NULL;
+    }
+    pthread_mutex_init(&sema->lock, NULL);
+    pthread_cond_init(&sema->cond, NULL);
+    sema->mutex = mutex;
+    sema->recursive = recursive;
+    sema->count = 0;
+    return sema;
+}
+
+_Static_assert(sizeof(struct host_sema) <= sizeof(StaticSemaphore_t), "StaticSemaphore_t too small");
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+    return sema_new(malloc(sizeof(struct host_sema)), true, false);
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutexStatic(StaticSemaphore_t *buf)
+{
+    return sema_new((struct host_sema *)buf, true, false);
+}
+
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutex(void)
+{
+    return sema_new(malloc(sizeof(struct host_sema)), true, true);
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void)
+{
+    return sema_new(malloc(sizeof(struct host_sema)), false, false);
+}
+
+static bool sema_available(void *ctx)
+{
+    struct host_sema *sema = ctx;
+    if (sema->mutex) {
+        return sema->count == 0 || (sema->recursive && pthread_equal(sema->owner, pthread_self()));
+    }
+    return sema->count != 0;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sema, TickType_t ticks)
+{
+    pthread_mutex_lock(&sema->lock);
+    bool taken = wait_until(&sema->cond, &sema->lock, ticks, sema_available, sema);
+    if (taken && sema->mutex) {
+        sema->owner = pthread_self();
+        sema->count++;
+    } else if (taken) {
+        sema->count = 0;
+    }
+    pthread_mutex_unlock(&sema->lock);
+    return taken ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sema)
+{
+    pthread_mutex_lock(&sema->lock);
+    BaseType_t ret = pdTRUE;
+    if (sema->mutex) {
+        if (sema->count == 0 || !pthread_equal(sema->owner, pthread_self())) {
+            ret = pdFALSE;
+        } else {
+            sema->count--;
+        }
+    } else if (sema->count) {
+        ret = pdFALSE;
+    } else {
+        sema->count = 1;
+    }
+    pthread_cond_broadcast(&sema->cond);
+    pthread_mutex_unlock(&sema->lock);
+    return ret;
+}
+
+BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t sema, TickType_t ticks)
+{
+    return xSemaphoreTake(sema, ticks);
+}
+
+BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t sema)
+{
+    return xSemaphoreGive(sema);
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t sema)
+{
+    pthread_cond_destroy(&sema->cond);
+    pthread_mutex_destroy(&sema->lock);
+    free(sema);
+}
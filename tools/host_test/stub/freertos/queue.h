@@ -0,0 +1,9 @@
+#pragma once
+
+#include "freertos/FreeRTOS.h"
+
+typedef struct host_queue *QueueHandle_t;
+
+#define errQUEUE_FULL   ((BaseType_t)0)
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t ticks);
@@ -0,0 +1,16 @@
+#pragma once
+
+#include "freertos/FreeRTOS.h"
+
+typedef struct host_sema *SemaphoreHandle_t;
+typedef struct { uint8_t storage[128]; } StaticSemaphore_t;
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void);
+SemaphoreHandle_t xSemaphoreCreateMutexStatic(StaticSemaphore_t *buf);
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutex(void);
+SemaphoreHandle_t xSemaphoreCreateBinary(void);
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sema, TickType_t ticks);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sema);
+BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t sema, TickType_t ticks);
+BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t sema);
+void vSemaphoreDelete(SemaphoreHandle_t sema);
@@ -0,0 +1,26 @@
+// Helpers of the host build without an ESP-IDF counterpart
+#pragma once
+
+#include <stdint.h>
+
+// File system activity as FATFS on wear levelling would see it: one FAT sector per
+// CONFIG_WL_SECTOR_SIZE bytes, clusters of one sector, a single FAT. A file closed after a
+// write costs its dirty data sectors, its directory entry sector and one FAT sector per 256
+// newly allocated clusters (FAT16). Opening, stat or removing a file reads the directory
+// up to its entry (all of it if there is none, FATFS has no directory index), the order of
+// the host directory stands in for the order of the FAT directory.
+typedef struct {
+    uint32_t opens;
+    uint32_t writes;            // write calls
+    uint64_t bytes;             // bytes passed to write calls
+    uint64_t sectors;           // sectors written to the volume
+    uint64_t sectors_read;      // directory and file sectors read from the volume
+} host_fs_stats_t;
+
+// Paths below mount are redirected to a new temporary directory
+const char *host_fs_init(const char *mount);
+void host_fs_get_stats(host_fs_stats_t *stats);
+uint32_t host_nvs_writes(void);
+
+// move esp_timer_get_time() and time() forward, for tests that simulate the passage of time
+void host_time_advance(int64_t us);
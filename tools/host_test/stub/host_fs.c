@@ -0,0 +1,250 @@
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "sdkconfig.h"
+#include "host.h"
+#include "host_libc.h"
+
+// the wrappers below call the C library
+#undef fopen
+#undef fclose
+#undef fwrite
+#undef fread
+#undef fprintf
+#undef remove
+#undef stat
+#undef opendir
+#undef time
+
+#define FS_SECTOR CONFIG_WL_SECTOR_SIZE
+#define FS_FAT_ENTRIES_PER_SECTOR (FS_SECTOR / 2)
+#define FS_DIR_ENTRY_SIZE 32
+#define FS_OPEN_MAX 16
+
+typedef struct {
+    FILE *fd;
+    bool append;
+    bool modified;
+    long size_open;             // size when opened
+    long size;
+    uint8_t *dirty;             // bitmap of written sectors
+    size_t dirty_len;
+} host_file_t;
+
+static char fs_mount[32];
+static char fs_dir[64];
+static host_file_t fs_files[FS_OPEN_MAX];
+static host_fs_stats_t fs_stats;
+
+const char *host_fs_init(const char *mount)
+{
+    snprintf(fs_mount, sizeof(fs_mount), "%s", mount);
+    snprintf(fs_dir, sizeof(fs_dir), "/tmp/host_fs_XXXXXX");
+    if (!mkdtemp(fs_dir)) {
+        perror("mkdtemp");
+        exit(EXIT_FAILURE);
+    }
+    memset(&fs_stats, 0, sizeof(fs_stats));
+    return fs_dir;
+}
+
+void host_fs_get_stats(host_fs_stats_t *stats)
+{
+    *stats = fs_stats;
+}
+
+static const char *fs_path(const char *path, char *buf, size_t size)
+{
+    size_t len = strlen(fs_mount);
+    if (len && !strncmp(path, fs_mount, len) && (path[len] == '/' || path[len] == 0)) {
+        snprintf(buf, size, "%s%s", fs_dir, path + len);
+        return buf;
+    }
+    return path;
+}
+
+static host_file_t *fs_file(FILE *fd)
+{
+    for (int i = 0; i < FS_OPEN_MAX; i++) {
+        if (fs_files[i].fd == fd) {
+            return &fs_files[i];
+        }
+    }
+    return NULL;
+}
+
+static uint32_t fs_clusters(long size)
+{
+    return (size + FS_SECTOR - 1) / FS_SECTOR;
+}
+
+static uint32_t fs_fat_sectors(uint32_t clusters)
+{
+    return (clusters + FS_FAT_ENTRIES_PER_SECTOR - 1) / FS_FAT_ENTRIES_PER_SECTOR;
+}
+
+// Directory sectors read to find name in dir, or to list the directory if name is NULL
+static uint32_t fs_dir_sectors(const char *dir, const char *name)
+{
+    DIR *d = opendir(dir);
+    if (!d) {
+        return 0;
+    }
+    uint32_t entries = 0;
+    struct dirent *entry;
+    while ((entry = readdir(d)) != NULL) {
+        if (!strcmp(entry->d_name, ".") || !strcmp(entry->d_name, "..")) {
+            continue;
+        }
+        entries++;
+        if (name && !strcasecmp(entry->d_name, name)) {
+            break;
+        }
+    }
+    closedir(d);
+    return entries ? (entries * FS_DIR_ENTRY_SIZE + FS_SECTOR - 1) / FS_SECTOR : 1;
+}
+
+// Directory sectors read to find the file at path, paths outside the mount are free
+static uint32_t fs_lookup_sectors(const char *path)
+{
+    const char *name = strrchr(path, '/');
+    size_t len = strlen(fs_dir);
+    if (!name || strncmp(path, fs_dir, len) || (path[len] != '/')) {
+        return 0;
+    }
+    char dir[256];
+    snprintf(dir, sizeof(dir), "%.*s", (int)(name - path), path);
+    return fs_dir_sectors(dir, name + 1);
+}
+
+FILE *host_fopen(const char *path, const char *mode)
+{
+    char buf[256];
+    host_file_t *file = fs_file(NULL);
+    if (!file) {
+        return NULL;
+    }
+    path = fs_path(path, buf, sizeof(buf));
+    fs_stats.sectors_read += fs_lookup_sectors(path);
+    FILE *fd = fopen(path, mode);
+    if (!fd) {
+        return NULL;
+    }
+    fs_stats.opens++;
+    *file = (host_file_t) {
+        .fd = fd,
+        .append = (mode[0] == 'a'),
+        .modified = (mode[0] == 'w'),
+    };
+    fseek(fd, 0, SEEK_END);
+    file->size_open = file->size = ftell(fd);
+    if (!file->append) {
+        rewind(fd);
+    }
+    return fd;
+}
+
+size_t host_fwrite(const void *ptr, size_t size, size_t n, FILE *fd)
+{
+    host_file_t *file = fs_file(fd);
+    if (!file) {
+        // stderr and files opened before host_fs_init()
+        return fwrite(ptr, size, n, fd);
+    }
+    long pos = file->append ? file->size : ftell(fd);
+    size_t done = fwrite(ptr, size, n, fd);
+    size_t len = done * size;
+    fs_stats.writes++;
+    fs_stats.bytes += len;
+    if (len) {
+        size_t last = (pos + len - 1) / FS_SECTOR;
+        if (last / 8 >= file->dirty_len) {
+            size_t grow = last / 8 + 16;
+            file->dirty = realloc(file->dirty, grow);
+            memset(file->dirty + file->dirty_len, 0, grow - file->dirty_len);
+            file->dirty_len = grow;
+        }
+        for (size_t s = pos / FS_SECTOR; s <= last; s++) {
+            file->dirty[s / 8] |= 1 << (s % 8);
+        }
+        file->modified = true;
+        if (pos + (long)len > file->size) {
+            file->size = pos + len;
+        }
+    }
+    return done;
+}
+
+size_t host_fread(void *ptr, size_t size, size_t n, FILE *fd)
+{
+    long pos = ftell(fd);
+    size_t done = fread(ptr, size, n, fd);
+    size_t len = done * size;
+    if (fs_file(fd) && len) {
+        fs_stats.sectors_read += (pos + len - 1) / FS_SECTOR - pos / FS_SECTOR + 1;
+    }
+    return done;
+}
+
+int host_fprintf(FILE *fd, const char *format, ...)
+{
+    char buf[256];
+    va_list ap;
+    va_start(ap, format);
+    int len = vsnprintf(buf, sizeof(buf), format, ap);
+    va_end(ap);
+    return host_fwrite(buf, 1, len, fd) == (size_t)len ? len : -1;
+}
+
+int host_fclose(FILE *fd)
+{
+    host_file_t *file = fs_file(fd);
+    if (!file) {
+        return fclose(fd);
+    }
+    if (file->modified) {
+        for (size_t i = 0; i < file->dirty_len; i++) {
+            fs_stats.sectors += __builtin_popcount(file->dirty[i]);
+        }
+        uint32_t allocated = fs_clusters(file->size) - fs_clusters(file->size_open);
+        fs_stats.sectors += 1 + (allocated ? fs_fat_sectors(allocated) : 0);
+    }
+    free(file->dirty);
+    memset(file, 0, sizeof(*file));
+    return fclose(fd);
+}
+
+int host_remove(const char *path)
+{
+    char buf[256];
+    struct stat st;
+    path = fs_path(path, buf, sizeof(buf));
+    fs_stats.sectors_read += fs_lookup_sectors(path);
+    if (stat(path, &st) == 0) {
+        fs_stats.sectors += 1 + fs_fat_sectors(fs_clusters(st.st_size));
+    }
+    return remove(path);
+}
+
+int host_stat(const char *path, struct stat *st)
+{
+    char buf[256];
+    path = fs_path(path, buf, sizeof(buf));
+    fs_stats.sectors_read += fs_lookup_sectors(path);
+    return stat(path, st);
+}
+
+DIR *host_opendir(const char *path)
+{
+    char buf[256];
+    path = fs_path(path, buf, sizeof(buf));
+    DIR *d = opendir(path);
+    if (d && !strncmp(path, fs_dir, strlen(fs_dir))) {
+        fs_stats.sectors_read += fs_dir_sectors(path, NULL);
+    }
+    return d;
+}
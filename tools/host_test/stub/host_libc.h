@@ -0,0 +1,27 @@
+// Included ahead of firmware sources to redirect the file system and the wall clock, see host.h
+#pragma once
+
+#include <dirent.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <time.h>
+
+FILE *host_fopen(const char *path, const char *mode);
+int host_fclose(FILE *fd);
+size_t host_fwrite(const void *ptr, size_t size, size_t n, FILE *fd);
+size_t host_fread(void *ptr, size_t size, size_t n, FILE *fd);
+int host_fprintf(FILE *fd, const char *format, ...) __attribute__((format(printf, 2, 3)));
+int host_remove(const char *path);
+int host_stat(const char *path, struct stat *st);
+DIR *host_opendir(const char *path);
+time_t host_time(time_t *t);
+
+#define fopen(path, mode) host_fopen(path, mode)
+#define fclose(fd) host_fclose(fd)
+#define fwrite(ptr, size, n, fd) host_fwrite(ptr, size, n, fd)
+#define fread(ptr, size, n, fd) host_fread(ptr, size, n, fd)
+#define fprintf(fd, ...) host_fprintf(fd, __VA_ARGS__)
+#define remove(path) host_remove(path)
+#define stat(path, st) host_stat(path, st)
+#define opendir(path) host_opendir(path)
+#define time(t) host_time(t)
@@ -0,0 +1,41 @@
+// Configuration of the firmware sources in the host build, see tools/host_test.
+// Values follow the defaults of the project, a test overrides them with compile definitions.
+#pragma once
+
+#define CONFIG_FMB_COMM_MODE_RTU_EN 1
+#ifndef CONFIG_FMB_CRC16_SLICES
+#define CONFIG_FMB_CRC16_SLICES 1
+#endif
+#define CONFIG_FMB_SERIAL_BUF_SIZE 256
+#define CONFIG_FMB_QUEUE_LENGTH 20
+#define CONFIG_FMB_PORT_TASK_STACK_SIZE 4096
+#define CONFIG_FMB_PORT_TASK_PRIO 10
+#define CONFIG_FMB_PORT_TASK_AFFINITY 0
+#define CONFIG_FMB_MASTER_TIMEOUT_MS_RESPOND 400
+#define CONFIG_FMB_MASTER_DELAY_MS_CONVERT 200
+
+#define CONFIG_WL_SECTOR_SIZE 512
+#ifndef CONFIG_DATA_LOG_BUFFER_SIZE
+#define CONFIG_DATA_LOG_BUFFER_SIZE 4096
+#endif
+#ifndef CONFIG_DATA_LOG_FLUSH_INTERVAL_MS
+#define CONFIG_DATA_LOG_FLUSH_INTERVAL_MS 60000
+#endif
+#if !defined(CONFIG_DATA_LOG_ENCODING_RAW) && !defined(CONFIG_DATA_LOG_ENCODING_XOR)
+#define CONFIG_DATA_LOG_ENCODING_DELTA 1
+#endif
+#define CONFIG_DATA_LOG_RAW_FILES 100
+#define CONFIG_DATA_LOG_ROLLUP 1
+#define CONFIG_DATA_LOG_ROLLUP_CIDS 32
+#define CONFIG_DATA_LOG_MINUTE_FILES 16
+#define CONFIG_DATA_LOG_HOUR_FILES 8
+#define CONFIG_DATA_LOG_HOLD_BLOCKS 64
+#ifndef CONFIG_DATA_LOG_QUEUE_LEN
+#define CONFIG_DATA_LOG_QUEUE_LEN 64
+#endif
+#ifndef CONFIG_DATA_LOG_QUEUE_BLOCK
+#define CONFIG_DATA_LOG_QUEUE_DROP_OLDEST 1
+#endif
+#define CONFIG_DATA_LOG_MSC_VIRTUAL 1
+#define CONFIG_DATA_LOG_MSC_REFRESH_S 60
+#define CONFIG_TINYUSB_MSC_BUFSIZE 512
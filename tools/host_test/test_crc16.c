@@ -0,0 +1,89 @@
+// Checks the CRC16 engine selected by CONFIG_FMB_CRC16_SLICES against a bitwise
+// reference and prints its speed.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "port.h"
+#include "mbcrc.h"
+#include "check.h"
+
+#define BENCH_FRAME_LEN     256
+#define BENCH_BYTES         (64 * 1024 * 1024)
+
+static USHORT crc16_reference(const UCHAR *data, size_t len)
+{
+    USHORT crc = 0xFFFF;
+    while (len--) {
+        crc ^= *data++;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 1) ? (crc >> 1) ^ 0xA001 : (crc >> 1);
+        }
+    }
+    return crc;
+}
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+int main(void)
+{
+    static UCHAR data[BENCH_FRAME_LEN + 2];
+    unsigned seed = 1;
+
+    UCHAR vector[] = "123456789";
+    CHECK(usMBCRC16(vector, 9) == 0x4B37, "check value %04X", usMBCRC16(vector, 9));
+    CHECK(usMBCRC16(vector, 0) == MB_CRC16_INIT, "empty input");
+
+    for (int round = 0; round < 200; round++) {
+        for (int i = 0; i < BENCH_FRAME_LEN; i++) {
+            data[i] = (UCHAR)rand_r(&seed);
+        }
+        // every length hits the 8, 4 and 1 byte loops in another mix
+        for (USHORT len = 0; len <= BENCH_FRAME_LEN; len++) {
+            USHORT expected = crc16_reference(data, len);
+            USHORT crc = usMBCRC16(data, len);
+            CHECK(crc == expected, "len %u: %04X, expected %04X", len, crc, expected);
+            USHORT split = rand_r(&seed) % (len + 1);
+            crc = usMBCRC16Update(usMBCRC16Update(MB_CRC16_INIT, data, split), data + split, len - split);
+            CHECK(crc == expected, "len %u split at %u: %04X, expected %04X", len, split, crc, expected);
+            // the frame is sent with the CRC low byte first, the check over all of it is 0
+            UCHAR frame[BENCH_FRAME_LEN + 2];
+            memcpy(frame, data, len);
+            frame[len] = (UCHAR)(expected & 0xFF);
+            frame[len + 1] = (UCHAR)(expected >> 8);
+            CHECK(usMBCRC16(frame, len + 2) == 0, "len %u: residue %04X", len, usMBCRC16(frame, len + 2));
+        }
+        if (failures > 20) {
+            break;
+        }
+    }
+
+    const struct { USHORT len; const char *what; } sizes[] = {
+        { 8, "8 byte frame" }, { BENCH_FRAME_LEN, "256 byte frame" }
+    };
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        volatile USHORT sink = 0;
+        long frames = BENCH_BYTES / sizes[s].len;
+        double start = now_ns();
+        for (long i = 0; i < frames; i++) {
+            data[0] = (UCHAR)i;
+            sink ^= usMBCRC16(data, sizes[s].len);
+        }
+        double elapsed = now_ns() - start;
+        printf("slices %d, %-14s: %6.2f ns/byte, %8.1f ns/frame\n", MB_CRC16_SLICES, sizes[s].what,
+               elapsed / ((double)frames * sizes[s].len), elapsed / frames);
+        (void)sink;
+    }
+
+    if (failures) {
+        printf("%d checks failed\n", failures);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,145 @@
+// Serves the virtual FAT view (main/msc_vfat.c) of a data log written on the host through the
+// TinyUSB MSC callbacks and reports the read throughput.
+//   test_msc_vfat <image> <partition bytes>
+// The volume is read with CONFIG_TINYUSB_MSC_BUFSIZE byte requests, as the device sees them,
+// and written to <image>. The directory holding the log files is printed as "log: <dir>",
+// check_msc_vfat.py compares the files of the image against it.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "esp_partition.h"
+#include "sdkconfig.h"
+#include "tusb.h"
+#include "host.h"
+#include "data_log.h"
+#include "msc_vfat.h"
+#include "check.h"
+
+#define SAMPLE_CIDS         3
+#define SAMPLE_PERIOD_US    1000000
+#define LOG_SAMPLES         300000
+#define READ_ROUNDS         3
+
+static esp_partition_t storage = { .label = "storage" };
+static uint8_t sense_key;
+static uint8_t sense_code;
+const esp_partition_t *esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype,
+                                                const char *label)
+{
+    return (type == ESP_PARTITION_TYPE_DATA && subtype == ESP_PARTITION_SUBTYPE_DATA_FAT) ? &storage : NULL;
+}
+
+bool tud_msc_set_sense(uint8_t lun, uint8_t key, uint8_t code, uint8_t qualifier)
+{
+    sense_key = key;
+    sense_code = code;
+    return true;
+}
+
+static void log_samples(uint32_t count)
+{
+    static uint32_t n;
+    for (uint32_t i = 0; i < count; i++, n++) {
+        data_log_append(n % SAMPLE_CIDS, 2300 + (n % SAMPLE_CIDS) * 7 + (n * 2654435761u >> 29),
+                        DATA_LOG_QUALITY_GOOD);
+        host_time_advance(SAMPLE_PERIOD_US / SAMPLE_CIDS);
+    }
+    data_log_flush();
+}
+
+static double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static uint8_t *read_volume(uint32_t sectors)
+{
+    uint8_t *image = malloc((size_t)sectors * 512);
+    for (uint32_t lba = 0; lba < sectors; lba++) {
+        CHECK(tud_msc_read10_cb(0, lba, 0, image + (size_t)lba * 512, CONFIG_TINYUSB_MSC_BUFSIZE)
+              == CONFIG_TINYUSB_MSC_BUFSIZE, "read of sector %lu", (unsigned long)lba);
+    }
+    return image;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc != 3) {
+        fprintf(stderr, "usage: %s <image> <partition bytes>\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    storage.size = strtoul(argv[2], NULL, 0);
+    printf("log: %s\n", host_fs_init(DATA_LOG_BASE_PATH));
+    data_log_init();
+    data_log_mount_changed(true);
+    log_samples(LOG_SAMPLES);
+
+    CHECK(msc_vfat_init() == ESP_OK, "init");
+    tud_mount_cb();
+    CHECK(tud_msc_test_unit_ready_cb(0), "unit not ready after mount");
+    CHECK(!tud_msc_is_writable_cb(0), "volume is writable");
+    uint8_t sector[512] = { 0 };
+    CHECK(tud_msc_write10_cb(0, 0, 0, sector, sizeof(sector)) < 0 && sense_key == SCSI_SENSE_DATA_PROTECT,
+          "write accepted");
+
+    uint32_t sectors;
+    uint16_t sector_size;
+    tud_msc_capacity_cb(0, &sectors, &sector_size);
+    CHECK(sector_size == 512 && (uint64_t)sectors * 512 <= storage.size, "capacity %lu x %u",
+          (unsigned long)sectors, sector_size);
+
+    // reads of unaligned, partial requests must match whole sector reads
+    uint8_t *image = read_volume(sectors);
+    uint8_t part[700];
+    uint32_t lba = sectors / 2;
+    tud_msc_read10_cb(0, lba, 100, part, sizeof(part));
+    CHECK(!memcmp(part, image + (size_t)lba * 512 + 100, sizeof(part)), "unaligned read differs");
+
+    // the listing is a snapshot, the log grows underneath it until the view is rebuilt
+    uint32_t root_entries = image[17] | image[18] << 8;
+    uint32_t meta = image[14] + image[16] * (image[22] | image[23] << 8) + root_entries * 32 / 512;
+    log_samples(LOG_SAMPLES / 10);
+    uint8_t *snapshot = read_volume(sectors);
+    CHECK(!memcmp(snapshot, image, (size_t)meta * 512), "boot sector, FAT or directory changed before a refresh");
+    free(snapshot);
+    host_time_advance((int64_t)CONFIG_DATA_LOG_MSC_REFRESH_S * 1000000);
+    CHECK(!tud_msc_test_unit_ready_cb(0) && sense_key == SCSI_SENSE_UNIT_ATTENTION, "no medium change reported");
+    CHECK(tud_msc_test_unit_ready_cb(0), "unit not ready after the medium change");
+
+    double start = now_s();
+    for (int round = 0; round < READ_ROUNDS; round++) {
+        free(image);
+        image = read_volume(sectors);
+    }
+    double volume_s = (now_s() - start) / READ_ROUNDS;
+
+    // the clusters of the files follow each other from cluster 2 on
+    uint32_t used = 0;
+    for (uint32_t entry = 1; entry < root_entries; entry++) {
+        const uint8_t *dir = image + (size_t)meta * 512 - root_entries * 32 + entry * 32;
+        uint32_t size;
+        memcpy(&size, dir + 28, 4);
+        used += (size + image[13] * 512 - 1) / (image[13] * 512) * image[13];
+    }
+    start = now_s();
+    for (int round = 0; round < READ_ROUNDS; round++) {
+        for (uint32_t lba = meta; lba < meta + used; lba++) {
+            tud_msc_read10_cb(0, lba, 0, sector, sizeof(sector));
+        }
+    }
+    double data_s = (now_s() - start) / READ_ROUNDS;
+    printf("%s volume of %lu sectors in %d byte requests: whole volume %.1f MB/s, %lu sectors of log data %.1f MB/s\n",
+           memcmp(image + 54, "FAT16", 5) ? "FAT12" : "FAT16", (unsigned long)sectors, CONFIG_TINYUSB_MSC_BUFSIZE,
+           (double)sectors * 512 / volume_s / 1e6, (unsigned long)used, (double)used * 512 / data_s / 1e6);
+
+    FILE *fd = fopen(argv[1], "wb");
+    CHECK(fd && fwrite(image, 512, sectors, fd) == sectors, "writing %s", argv[1]);
+    if (fd) {
+        fclose(fd);
+    }
+    free(image);
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
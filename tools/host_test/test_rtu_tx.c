@@ -0,0 +1,194 @@
+// RTU transmit path of master and slave (modbus/rtu/mbrtu_m.c, modbus/rtu/mbrtu.c): every
+// frame leaves the transmit FSM in one port write, address, PDU and CRC, for all PDU lengths.
+//
+// The FSMs are polled as xMBMasterPortSerialTxPoll() and xMBPortSerialTxPoll() do, the port
+// writes land in a UART model that records each uart_write_bytes() call. The CRC is checked
+// against a bitwise reference, not the engine the FSMs use.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "port.h"
+#include "mb_m.h"
+#include "mbport.h"
+#include "mbframe.h"
+#include "mbrtu.h"
+#include "check.h"
+
+#define BENCH_FRAMES        1000000
+#define PDU_SIZE_MAX        (MB_SER_PDU_SIZE_MAX - MB_SER_PDU_PDU_OFF - MB_SER_PDU_SIZE_CRC)
+
+volatile UCHAR ucMasterRcvBuf[MB_MASTER_INSTANCES][MB_SERIAL_BUF_SIZE];
+volatile UCHAR ucMasterSndBuf[MB_MASTER_INSTANCES][MB_SERIAL_BUF_SIZE];
+volatile UCHAR ucMbSlaveBuf[MB_SERIAL_BUF_SIZE];
+
+static portMUX_TYPE port_mux = portMUX_INITIALIZER_UNLOCKED;
+static UCHAR uart_tx[2 * MB_SERIAL_BUF_SIZE];
+static size_t uart_tx_len;
+static uint32_t uart_writes;
+static uint32_t byte_writes;
+static void uart_write_bytes(const UCHAR *buf, size_t len)
+{
+    if (uart_tx_len + len <= sizeof(uart_tx)) {
+        memcpy(uart_tx + uart_tx_len, buf, len);
+    }
+    uart_tx_len += len;
+    uart_writes++;
+}
+
+/* ----------------------- Port functions used by mbrtu_m.c and mbrtu.c ---------*/
+void vMBPortEnterCritical(void) { portENTER_CRITICAL(&port_mux); }
+void vMBPortExitCritical(void) { portEXIT_CRITICAL(&port_mux); }
+BOOL xMBMasterPortSerialInit(UCHAR ucPort, ULONG ulBaudRate, UCHAR ucDataBits, eMBParity eParity) { return TRUE; }
+BOOL xMBMasterPortTimersInit(USHORT usTimeOut50us) { return TRUE; }
+void vMBMasterPortSerialEnable(BOOL xRxEnable, BOOL xTxEnable) { }
+void vMBMasterPortTimersT35Enable(void) { }
+void vMBMasterPortTimersConvertDelayEnable(void) { }
+void vMBMasterPortTimersRespondTimeoutEnable(void) { }
+void vMBMasterPortTimersDisable(void) { }
+void vMBMasterRequestSetType(BOOL xIsBroadcast) { }
+BOOL xMBMasterRequestIsBroadcast(void) { return FALSE; }
+void vMBMasterSetErrorType(eMBMasterErrorEventType errorType) { }
+eMBMasterTimerMode xMBMasterGetCurTimerMode(void) { return MB_TMODE_T35; }
+BOOL xMBMasterPortEventPost(eMBMasterEventEnum eEvent) { return TRUE; }
+BOOL xMBMasterPortSerialGetByte(CHAR *pucByte) { return FALSE; }
+USHORT usMBMasterPortSerialGetBytes(UCHAR *pucBuf, USHORT usLength) { return 0; }
+BOOL xMBMasterPortSerialGetResponse(UCHAR **ppucMBSerialFrame, USHORT *usSerialLength) { return TRUE; }
+BOOL xMBMasterPortSerialSendRequest(UCHAR *pucMBSerialFrame, USHORT usSerialLength) { return TRUE; }
+
+BOOL xMBPortSerialInit(UCHAR ucPort, ULONG ulBaudRate, UCHAR ucDataBits, eMBParity eParity) { return TRUE; }
+BOOL xMBPortTimersInit(USHORT usTimeOut50us) { return TRUE; }
+void vMBPortSerialEnable(BOOL xRxEnable, BOOL xTxEnable) { }
+void vMBPortTimersEnable(void) { }
+void vMBPortTimersDisable(void) { }
+BOOL xMBPortEventPost(eMBEventType eEvent) { return TRUE; }
+BOOL xMBPortSerialGetByte(CHAR *pucByte) { return FALSE; }
+BOOL xMBPortSerialSendResponse(UCHAR *pucMBSerialFrame, USHORT usSerialLength) { return TRUE; }
+
+// the one byte writes the FSMs made before whole frame transmit
+BOOL xMBMasterPortSerialPutByte(CHAR ucByte)
+{
+    byte_writes++;
+    uart_write_bytes((UCHAR *)&ucByte, 1);
+    return TRUE;
+}
+
+BOOL xMBPortSerialPutByte(CHAR ucByte)
+{
+    byte_writes++;
+    uart_write_bytes((UCHAR *)&ucByte, 1);
+    return TRUE;
+}
+
+BOOL xMBMasterPortSerialPutBytes(const UCHAR *pucBuf, USHORT usLength)
+{
+    uart_write_bytes(pucBuf, usLength);
+    return TRUE;
+}
+
+BOOL xMBPortSerialPutBytes(const UCHAR *pucBuf, USHORT usLength)
+{
+    uart_write_bytes(pucBuf, usLength);
+    return TRUE;
+}
+
+/* ----------------------- Transmit path --------------------------------------*/
+static USHORT crc16_reference(const UCHAR *data, size_t len)
+{
+    USHORT crc = 0xFFFF;
+    while (len--) {
+        crc ^= *data++;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 1) ? (crc >> 1) ^ 0xA001 : (crc >> 1);
+        }
+    }
+    return crc;
+}
+
+static void make_pdu(UCHAR *pdu, USHORT len)
+{
+    pdu[0] = MB_FUNC_READ_HOLDING_REGISTER;
+    for (USHORT i = 1; i < len; i++) {
+        pdu[i] = (UCHAR)(i * 37);
+    }
+}
+
+// one frame through eMB(Master)RTUSend() and the transmit poll loop of the port
+static void transmit(int master, UCHAR address, USHORT len)
+{
+    // the stack builds the PDU in place, behind the address byte of the frame buffer
+    UCHAR *pdu = (UCHAR *)(master ? ucMasterSndBuf[0] : ucMbSlaveBuf) + MB_SER_PDU_PDU_OFF;
+    BOOL (*tx_fsm)(void) = master ? xMBMasterRTUTransmitFSM : xMBRTUTransmitFSM;
+    BOOL bNeedPoll = TRUE;
+    USHORT usCount = 0;
+
+    make_pdu(pdu, len);
+    uart_tx_len = 0;
+    if ((master ? eMBMasterRTUSend(address, pdu, len) : eMBRTUSend(address, pdu, len)) != MB_ENOERR) {
+        return;
+    }
+    while (bNeedPoll && (usCount++ < MB_SERIAL_BUF_SIZE)) {
+        bNeedPoll = tx_fsm();
+    }
+    if (master) {
+        // the response timeout of the request expires, the master receiver is idle again
+        xMBMasterRTUTimerExpired();
+    }
+}
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+int main(void)
+{
+    static const char *side_name[] = { "slave", "master" };
+    UCHAR expected[MB_SER_PDU_SIZE_MAX];
+
+    eMBMasterRTUInit(0, 115200, MB_PAR_NONE);
+    eMBMasterRTUStart();
+    xMBMasterRTUTimerExpired();
+    eMBRTUInit(1, 0, 115200, MB_PAR_NONE);
+    eMBRTUStart();
+    xMBRTUTimerT35Expired();
+
+    for (int master = FALSE; master <= TRUE; master++) {
+        const char *side = side_name[master];
+        for (USHORT len = 1; len <= PDU_SIZE_MAX; len++) {
+            size_t frame_len = MB_SER_PDU_PDU_OFF + len + MB_SER_PDU_SIZE_CRC;
+            expected[MB_SER_PDU_ADDR_OFF] = 17;
+            make_pdu(expected + MB_SER_PDU_PDU_OFF, len);
+            USHORT crc = crc16_reference(expected, frame_len - MB_SER_PDU_SIZE_CRC);
+            expected[frame_len - 2] = (UCHAR)(crc & 0xFF);
+            expected[frame_len - 1] = (UCHAR)(crc >> 8);
+
+            uart_writes = byte_writes = 0;
+            transmit(master, 17, len);
+            CHECK(uart_writes == 1 && byte_writes == 0, "%s, %u byte PDU sent in %" PRIu32 " writes, %" PRIu32
+                  " of one byte", side, len, uart_writes, byte_writes);
+            CHECK(uart_tx_len == frame_len, "%s, %u byte PDU sent as %u bytes, expected %u", side, len,
+                  (unsigned)uart_tx_len, (unsigned)frame_len);
+            CHECK(uart_tx_len == frame_len && !memcmp(uart_tx, expected, frame_len),
+                  "%s, %u byte PDU: address, PDU or CRC differ from the reference frame", side, len);
+        }
+    }
+
+    printf("side    frame  writes/frame  ns/frame\n");
+    const USHORT sizes[] = { 5, PDU_SIZE_MAX };
+    for (int master = FALSE; master <= TRUE; master++) {
+        for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+            uart_writes = 0;
+            double start = now_ns();
+            for (int i = 0; i < BENCH_FRAMES; i++) {
+                transmit(master, 17, sizes[s]);
+            }
+            double ns = (now_ns() - start) / BENCH_FRAMES;
+            printf("%-6s  %5u  %12.1f %9.1f\n", side_name[master], MB_SER_PDU_PDU_OFF + sizes[s] + MB_SER_PDU_SIZE_CRC,
+                   (double)uart_writes / BENCH_FRAMES, ns);
+        }
+    }
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
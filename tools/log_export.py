@@ -0,0 +1,181 @@
+#!/usr/bin/env python3
+"""Decode binary log segments (<n>.bin) written by the voltage monitor and export them as CSV.
+
+Usage:
+    log_export.py [-o out.csv] [--series raw|minute|hour] <segment.bin | directory> ...
+
+Raw samples are stored in <n>.bin, minute and hour rollups (min/max/mean per window)
+in m<n>.bin and h<n>.bin.
+
+The layout mirrors main/log_format.h.
+"""
+import argparse
+import csv
+import os
+import re
+import struct
+import sys
+import zlib
+
+LOG_FORMAT_VERSIONS = (1, 2)
+LOG_SEGMENT_MAGIC = 0x474C4D56
+LOG_BLOCK_MAGIC = 0xB10C
+LOG_BLOCK_SIZE = 512
+LOG_BLOCK_RECORDS = 31
+LOG_BLOCK_ROLLUPS = 20
+LOG_CODEC_CID_SLOTS = 16
+LOG_BLOCK_FLAG_DELTA = 0x01
+LOG_BLOCK_FLAG_XOR = 0x02
+LOG_BLOCK_FLAG_ROLLUP = 0x04
+LOG_ROLLUP_WALL_CLOCK = 0x01
+
+SEGMENT_HEADER = struct.Struct('<IHHHHIII')
+BLOCK_HEADER = struct.Struct('<HBBII')
+RECORD = struct.Struct('<IIIHBB')
+ROLLUP = struct.Struct('<IIIIHHHBB')
+
+SERIES = {'raw': '', 'minute': 'm', 'hour': 'h'}
+
+QUALITY = {0: 'good', 1: 'read_error'}
+
+
+class FormatError(Exception):
+    pass
+
+
+def get_varint(data, pos):
+    value = shift = 0
+    while True:
+        if pos >= len(data):
+            raise FormatError('truncated varint')
+        byte = data[pos]
+        pos += 1
+        value |= (byte & 0x7F) << shift
+        if byte < 0x80:
+            return value & 0xFFFFFFFF, pos
+        shift += 7
+
+
+def unzigzag(v):
+    return (v >> 1) ^ (0xFFFFFFFF if v & 1 else 0)
+
+
+def decode_block(payload, count, flags):
+    """Decode a compressed block, the mirror of log_block_add_encoded() in main/log_format.c."""
+    mono_ms = mono_delta = wall_offset = 0
+    last = [(None, 0)] * LOG_CODEC_CID_SLOTS
+    pos = 0
+    for _ in range(count):
+        dod, pos = get_varint(payload, pos)
+        wall_delta, pos = get_varint(payload, pos)
+        tag, pos = get_varint(payload, pos)
+        value, pos = get_varint(payload, pos)
+        mono_delta = (mono_delta + unzigzag(dod)) & 0xFFFFFFFF
+        mono_ms = (mono_ms + mono_delta) & 0xFFFFFFFF
+        wall_offset = (wall_offset + unzigzag(wall_delta)) & 0xFFFFFFFF
+        wall_s = (wall_offset + mono_ms // 1000) & 0xFFFFFFFF
+        cid, quality = tag >> 2, tag & 0x03
+        slot = cid % LOG_CODEC_CID_SLOTS
+        prev = last[slot][1] if last[slot][0] == cid else 0
+        if flags & LOG_BLOCK_FLAG_XOR:
+            raw = value ^ prev
+        else:
+            raw = (prev + unzigzag(value)) & 0xFFFFFFFF
+        last[slot] = (cid, raw)
+        yield mono_ms, wall_s, raw, cid, quality, 0
+
+
+def read_segment(path, rollup=False):
+    """Yield (segment, block_seq, record) tuples of all valid blocks in a segment file."""
+    with open(path, 'rb') as f:
+        data = f.read()
+    if len(data) < LOG_BLOCK_SIZE:
+        raise FormatError('%s: too short for a segment header' % path)
+    magic, version, block_size, record_size, _, segment, created_s, crc = SEGMENT_HEADER.unpack_from(data)
+    if magic != LOG_SEGMENT_MAGIC:
+        raise FormatError('%s: bad segment magic 0x%08x' % (path, magic))
+    if zlib.crc32(data[:SEGMENT_HEADER.size - 4]) != crc:
+        raise FormatError('%s: segment header crc mismatch' % path)
+    if version not in LOG_FORMAT_VERSIONS or block_size != LOG_BLOCK_SIZE:
+        raise FormatError('%s: unsupported format version %d' % (path, version))
+    if record_size != (ROLLUP.size if rollup else RECORD.size):
+        raise FormatError('%s: not a %s segment' % (path, 'rollup' if rollup else 'raw sample'))
+
+    for offset in range(LOG_BLOCK_SIZE, len(data) - LOG_BLOCK_SIZE + 1, LOG_BLOCK_SIZE):
+        block = data[offset:offset + LOG_BLOCK_SIZE]
+        magic, count, flags, seq, _ = BLOCK_HEADER.unpack_from(block)
+        crc, = struct.unpack_from('<I', block, LOG_BLOCK_SIZE - 4)
+        encoded = flags & (LOG_BLOCK_FLAG_DELTA | LOG_BLOCK_FLAG_XOR)
+        limit = LOG_BLOCK_ROLLUPS if flags & LOG_BLOCK_FLAG_ROLLUP else LOG_BLOCK_RECORDS
+        if magic != LOG_BLOCK_MAGIC or (not encoded and count > limit) or zlib.crc32(block[:-4]) != crc:
+            sys.stderr.write('%s: skipping invalid block at offset %d\n' % (path, offset))
+            continue
+        if flags & LOG_BLOCK_FLAG_ROLLUP:
+            for i in range(count):
+                yield segment, seq, ROLLUP.unpack_from(block, BLOCK_HEADER.size + i * ROLLUP.size)
+            continue
+        if encoded:
+            try:
+                for record in decode_block(block[BLOCK_HEADER.size:-4], count, flags):
+                    yield segment, seq, record
+            except FormatError as e:
+                sys.stderr.write('%s: block at offset %d: %s\n' % (path, offset, e))
+            continue
+        for i in range(count):
+            yield segment, seq, RECORD.unpack_from(block, BLOCK_HEADER.size + i * RECORD.size)
+
+
+def segment_files(paths, prefix=''):
+    files = []
+    for path in paths:
+        if os.path.isdir(path):
+            for name in os.listdir(path):
+                match = re.match(r'^%s(\d+)\.bin$' % prefix, name, re.IGNORECASE)
+                if match:
+                    files.append((int(match.group(1)), os.path.join(path, name)))
+        else:
+            files.append((len(files), path))
+    return [f for _, f in sorted(files)]
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('paths', nargs='+', help='segment files or directories containing them')
+    parser.add_argument('-o', '--output', help='CSV file to write, stdout by default')
+    parser.add_argument('-s', '--stats', action='store_true',
+                        help='print the compression ratio against fixed-width records to stderr')
+    parser.add_argument('--series', choices=SERIES.keys(), default='raw',
+                        help='segment series read from directories, raw samples by default')
+    args = parser.parse_args()
+    rollup = args.series != 'raw'
+
+    out = open(args.output, 'w', newline='') if args.output else sys.stdout
+    writer = csv.writer(out)
+    if rollup:
+        writer.writerow(['segment', 'block', 'start_s', 'clock', 'cid', 'count', 'errors', 'min', 'max', 'mean'])
+    else:
+        writer.writerow(['segment', 'block', 'mono_ms', 'wall_s', 'cid', 'raw', 'quality'])
+    records = size = 0
+    for path in segment_files(args.paths, SERIES[args.series]):
+        try:
+            for segment, seq, record in read_segment(path, rollup):
+                if rollup:
+                    start_s, lo, hi, mean, cid, count, errors, flags, _ = record
+                    clock = 'wall' if flags & LOG_ROLLUP_WALL_CLOCK else 'boot'
+                    writer.writerow([segment, seq, start_s, clock, cid, count, errors, lo, hi, mean])
+                else:
+                    mono_ms, wall_s, raw, cid, quality, _ = record
+                    writer.writerow([segment, seq, mono_ms, wall_s, cid, raw, QUALITY.get(quality, quality)])
+                records += 1
+            size += os.path.getsize(path)
+        except FormatError as e:
+            sys.stderr.write('%s\n' % e)
+    if args.stats and records:
+        sys.stderr.write('%d records in %d bytes, %.2f bytes/record, ratio %.2f against fixed-width records\n'
+                         % (records, size, size / records, records * RECORD.size / size))
+    if out is not sys.stdout:
+        out.close()
+
+
+if __name__ == '__main__':
+    main()
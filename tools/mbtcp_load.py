@@ -0,0 +1,110 @@
+#!/usr/bin/env python3
+"""Load a Modbus TCP slave with concurrent clients and report throughput and latency.
+
+Usage:
+    mbtcp_load.py [--port 502] [--clients 1,5,10,20,40] [--duration 10] [--unit 1]
+                  [--register 0] [--count 1] <host>
+
+Every client keeps one connection and sends Read Holding Registers requests in a closed
+loop (next request after the previous response). After a timeout or a response that does
+not match the request the client reconnects, so a late response can not be taken for the
+next one. For each client count the requests per
+second, the p50/p99 latency and the number of failed requests and connections are printed.
+"""
+import argparse
+import asyncio
+import struct
+import sys
+import time
+
+MBAP_HEADER = struct.Struct('>HHHB')
+READ_HOLDING_REGISTERS = 0x03
+
+
+class Stats:
+    def __init__(self):
+        self.latencies = []
+        self.errors = 0
+        self.refused = 0
+
+
+async def connect(args, stats):
+    try:
+        return await asyncio.wait_for(asyncio.open_connection(args.host, args.port), args.timeout)
+    except (OSError, asyncio.TimeoutError):
+        stats.refused += 1
+        return None, None
+
+
+async def transact(args, reader, writer, tid):
+    """Send one request and return the response PDU, None if the stream is out of step."""
+    pdu = struct.pack('>BHH', READ_HOLDING_REGISTERS, args.register, args.count)
+    writer.write(MBAP_HEADER.pack(tid, 0, len(pdu) + 1, args.unit) + pdu)
+    header = await asyncio.wait_for(reader.readexactly(MBAP_HEADER.size), args.timeout)
+    rx_tid, _, length, _ = MBAP_HEADER.unpack(header)
+    if length < 2:
+        return None
+    body = await asyncio.wait_for(reader.readexactly(length - 1), args.timeout)
+    return body if rx_tid == tid else None
+
+
+async def client(args, stats, deadline):
+    reader, writer = await connect(args, stats)
+    tid = 0
+    while writer and time.monotonic() < deadline:
+        tid = (tid + 1) & 0xFFFF
+        start = time.perf_counter()
+        try:
+            body = await transact(args, reader, writer, tid)
+        except (OSError, asyncio.IncompleteReadError, asyncio.TimeoutError):
+            body = None
+        if body is not None and not body[0] & 0x80:
+            stats.latencies.append(time.perf_counter() - start)
+            continue
+        stats.errors += 1
+        if body is None:
+            # a late or foreign response may still be in the stream, start a new connection
+            writer.close()
+            reader, writer = await connect(args, stats)
+    if writer:
+        writer.close()
+
+
+def percentile(values, p):
+    if not values:
+        return float('nan')
+    return values[min(len(values) - 1, int(len(values) * p / 100))]
+
+
+async def run(args, clients):
+    stats = Stats()
+    start = time.monotonic()
+    deadline = start + args.duration
+    await asyncio.gather(*(client(args, stats, deadline) for _ in range(clients)))
+    elapsed = time.monotonic() - start
+    latencies = sorted(stats.latencies)
+    print('%7d %10.1f %9.1f %9.1f %7d %8d' % (clients, len(latencies) / elapsed,
+          percentile(latencies, 50) * 1000, percentile(latencies, 99) * 1000, stats.errors, stats.refused))
+    sys.stdout.flush()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('host', help='address of the Modbus TCP slave')
+    parser.add_argument('--port', type=int, default=502)
+    parser.add_argument('--clients', default='1,5,10,20,40',
+                        help='comma separated client counts, one run per count')
+    parser.add_argument('--duration', type=float, default=10, help='seconds per run')
+    parser.add_argument('--timeout', type=float, default=2, help='response timeout in seconds')
+    parser.add_argument('--unit', type=int, default=1, help='unit identifier')
+    parser.add_argument('--register', type=int, default=0, help='first holding register')
+    parser.add_argument('--count', type=int, default=1, help='number of registers to read')
+    args = parser.parse_args()
+
+    print('clients      req/s   p50[ms]   p99[ms]  errors  refused')
+    for clients in (int(n) for n in args.clients.split(',')):
+        asyncio.run(run(args, clients))
+
+
+if __name__ == '__main__':
+    main()